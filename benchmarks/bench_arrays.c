@@ -0,0 +1,208 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/* Measures the binary encoding and decoding of large numeric arrays in a
+ * Variant. The encoding uses the byte order of the host. So also the byte-swap
+ * kernels that are used on big-endian hosts are measured against their scalar
+ * versions. Arrays of padded ChannelSecurityTokens are measured with the packed
+ * copy and member by member.
+ *
+ * Usage: bench_arrays [elements] (default: 1000000) */
+
+#include "ua_types.h"
+#include "ua_types_generated.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_types_encoding_binary_kernels.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#define ITERATIONS 50
+
+typedef void (*kernel)(UA_Byte *dst, const UA_Byte *src, size_t count);
+
+static double
+seconds(UA_DateTime time) {
+    return (double)time / UA_SEC_TO_DATETIME;
+}
+
+static double
+throughput(size_t bytes, UA_DateTime time) {
+    return (double)bytes * ITERATIONS / (1024.0 * 1024.0) / seconds(time);
+}
+
+static void
+benchmarkArray(const char *name, const UA_DataType *type, size_t elements) {
+    UA_Variant v;
+    UA_Variant_init(&v);
+    UA_Byte *data = UA_Array_new(elements, type);
+    for(size_t i = 0; i < elements * type->memSize; i++)
+        data[i] = (UA_Byte)(i * 7);
+    if(type == &UA_TYPES[UA_TYPES_BOOLEAN]) {
+        for(size_t i = 0; i < elements; i++)
+            data[i] = (UA_Byte)(i & 1);
+    } else if(type == &UA_TYPES[UA_TYPES_FLOAT]) {
+        UA_Float *f = (UA_Float*)data;
+        for(size_t i = 0; i < elements; i++)
+            f[i] = (UA_Float)i * 0.25f;
+    } else if(type == &UA_TYPES[UA_TYPES_DOUBLE]) {
+        UA_Double *d = (UA_Double*)data;
+        for(size_t i = 0; i < elements; i++)
+            d[i] = (UA_Double)i * 0.25;
+    }
+    UA_Variant_setArray(&v, data, elements, type);
+
+    UA_ByteString buf;
+    size_t size = UA_calcSizeBinary(&v, &UA_TYPES[UA_TYPES_VARIANT]);
+    UA_ByteString_allocBuffer(&buf, size);
+
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        size_t offset = 0;
+        if(UA_encodeBinary(&v, &UA_TYPES[UA_TYPES_VARIANT], &buf, &offset) != UA_STATUSCODE_GOOD) {
+            printf("%-8s encoding failed\n", name);
+            break;
+        }
+    }
+    UA_DateTime encodeTime = UA_DateTime_nowMonotonic() - start;
+
+    start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        UA_Variant decoded;
+        size_t offset = 0;
+        if(UA_decodeBinary(&buf, &offset, &decoded, &UA_TYPES[UA_TYPES_VARIANT]) != UA_STATUSCODE_GOOD) {
+            printf("%-8s decoding failed\n", name);
+            break;
+        }
+        UA_Variant_deleteMembers(&decoded);
+    }
+    UA_DateTime decodeTime = UA_DateTime_nowMonotonic() - start;
+
+    printf("%-8s %10lu bytes  encode %8.1f MB/s  decode %8.1f MB/s\n", name,
+           (unsigned long)size, throughput(size, encodeTime), throughput(size, decodeTime));
+    UA_ByteString_deleteMembers(&buf);
+    UA_Variant_deleteMembers(&v);
+}
+
+/* Structures with an array of ChannelSecurityTokens, which have padding in front
+ * of the DateTime. The second one refers to a copy of the type outside of
+ * UA_TYPES that is encoded member by member. */
+typedef struct {
+    size_t tokensSize;
+    UA_ChannelSecurityToken *tokens;
+} Tokens;
+
+static UA_DataTypeMember tokensMembers[1] = {
+    {.memberTypeIndex = UA_TYPES_CHANNELSECURITYTOKEN, .namespaceZero = true, .padding = 0,
+     .isArray = true}};
+
+static UA_DataTypeMember memberwiseTokensMembers[1] = {
+    {.memberTypeIndex = 0, .namespaceZero = false, .padding = 0, .isArray = true}};
+
+static UA_DataType tokenTypes[3] = {
+    {.typeId = {0}}, // copy of the ChannelSecurityToken type
+    {.typeId = {.namespaceIndex = 1, .identifierType = UA_NODEIDTYPE_NUMERIC, .identifier.numeric = 1},
+     .memSize = sizeof(Tokens), .typeIndex = 1, .membersSize = 1, .builtin = false,
+     .fixedSize = false, .zeroCopyable = false, .members = tokensMembers},
+    {.typeId = {.namespaceIndex = 1, .identifierType = UA_NODEIDTYPE_NUMERIC, .identifier.numeric = 2},
+     .memSize = sizeof(Tokens), .typeIndex = 2, .membersSize = 1, .builtin = false,
+     .fixedSize = false, .zeroCopyable = false, .members = memberwiseTokensMembers}};
+
+static void
+benchmarkTokens(const char *name, const UA_DataType *type, size_t elements) {
+    Tokens t = {elements, UA_Array_new(elements, &UA_TYPES[UA_TYPES_CHANNELSECURITYTOKEN])};
+    for(size_t i = 0; i < elements; i++) {
+        t.tokens[i].channelId = (UA_UInt32)i;
+        t.tokens[i].tokenId = (UA_UInt32)i + 1;
+        t.tokens[i].createdAt = (UA_DateTime)i;
+        t.tokens[i].revisedLifetime = 600000;
+    }
+    UA_ByteString buf;
+    size_t size = UA_calcSizeBinary(&t, type);
+    UA_ByteString_allocBuffer(&buf, size);
+
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        size_t offset = 0;
+        if(UA_encodeBinary(&t, type, &buf, &offset) != UA_STATUSCODE_GOOD) {
+            printf("%-8s encoding failed\n", name);
+            break;
+        }
+    }
+    UA_DateTime encodeTime = UA_DateTime_nowMonotonic() - start;
+
+    start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        Tokens decoded;
+        size_t offset = 0;
+        if(UA_decodeBinary(&buf, &offset, &decoded, type) != UA_STATUSCODE_GOOD) {
+            printf("%-8s decoding failed\n", name);
+            break;
+        }
+        UA_deleteMembers(&decoded, type);
+    }
+    UA_DateTime decodeTime = UA_DateTime_nowMonotonic() - start;
+
+    printf("%-8s %10lu bytes  encode %8.1f MB/s  decode %8.1f MB/s\n", name,
+           (unsigned long)size, throughput(size, encodeTime), throughput(size, decodeTime));
+    UA_ByteString_deleteMembers(&buf);
+    UA_deleteMembers(&t, type);
+}
+
+static UA_DateTime
+timeKernel(kernel k, UA_Byte *dst, const UA_Byte *src, size_t count) {
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < ITERATIONS; i++)
+        k(dst, src, count);
+    return UA_DateTime_nowMonotonic() - start;
+}
+
+static void
+benchmarkKernel(const char *name, kernel vector, kernel scalar, size_t size, size_t elements) {
+    size_t bytes = size * elements;
+    UA_Byte *src = malloc(bytes);
+    UA_Byte *dst = malloc(bytes);
+    if(!src || !dst) {
+        free(src);
+        free(dst);
+        return;
+    }
+    for(size_t i = 0; i < bytes; i++)
+        src[i] = (UA_Byte)(i * 7);
+    UA_DateTime vectorTime = timeKernel(vector, dst, src, elements);
+    UA_DateTime scalarTime = timeKernel(scalar, dst, src, elements);
+    printf("%-8s %10lu bytes  %-6s %8.1f MB/s  scalar %8.1f MB/s\n", name, (unsigned long)bytes,
+           UA_kernelsName(), throughput(bytes, vectorTime), throughput(bytes, scalarTime));
+    free(src);
+    free(dst);
+}
+
+int main(int argc, char **argv) {
+    size_t elements = 1000000;
+    if(argc > 1)
+        elements = (size_t)strtoul(argv[1], NULL, 10);
+    printf("binary codec of arrays with %lu elements, %d iterations\n",
+           (unsigned long)elements, ITERATIONS);
+
+    benchmarkArray("Boolean", &UA_TYPES[UA_TYPES_BOOLEAN], elements);
+    benchmarkArray("Int16", &UA_TYPES[UA_TYPES_INT16], elements);
+    benchmarkArray("Int32", &UA_TYPES[UA_TYPES_INT32], elements);
+    benchmarkArray("Float", &UA_TYPES[UA_TYPES_FLOAT], elements);
+    benchmarkArray("Double", &UA_TYPES[UA_TYPES_DOUBLE], elements);
+
+    printf("\nChannelSecurityTokens (padded)\n");
+    tokenTypes[0] = UA_TYPES[UA_TYPES_CHANNELSECURITYTOKEN];
+    tokenTypes[0].typeIndex = 0;
+    benchmarkTokens("packed", &tokenTypes[1], elements / 100);
+    benchmarkTokens("members", &tokenTypes[2], elements / 100);
+
+    printf("\nkernels (byte swaps as on big-endian hosts)\n");
+    benchmarkKernel("Boolean", UA_normalizeBooleans, UA_normalizeBooleans_scalar, 1, elements);
+    benchmarkKernel("Int16", UA_swapBytes16, UA_swapBytes16_scalar, 2, elements);
+    benchmarkKernel("Int32", UA_swapBytes32, UA_swapBytes32_scalar, 4, elements);
+    benchmarkKernel("Float", UA_swapBytes32, UA_swapBytes32_scalar, 4, elements);
+    benchmarkKernel("Double", UA_swapBytes64, UA_swapBytes64_scalar, 8, elements);
+    return EXIT_SUCCESS;
+}
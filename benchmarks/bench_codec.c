@@ -0,0 +1,152 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/* Measures the throughput of the binary encoding and decoding for a
+ * ReadResponse with many DataValues and for a PublishResponse with a
+ * DataChangeNotification. Without UA_ENABLE_SUBSCRIPTIONS the
+ * DataChangeNotification type is not generated. Then the notification data
+ * carries the same DataValues in WriteValues.
+ *
+ * Usage: bench_codec [values] (default: 1000) */
+
+#include "ua_types.h"
+#include "ua_types_generated.h"
+#include "ua_types_encoding_binary.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#define ITERATIONS 2000
+
+static void
+setValue(UA_DataValue *dv, size_t i) {
+    UA_DataValue_init(dv);
+    if(i % 3 == 0) {
+        UA_Double d = (UA_Double)i * 0.5;
+        UA_Variant_setScalarCopy(&dv->value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    } else if(i % 3 == 1) {
+        UA_Int32 v = (UA_Int32)i;
+        UA_Variant_setScalarCopy(&dv->value, &v, &UA_TYPES[UA_TYPES_INT32]);
+    } else {
+        UA_String s = UA_STRING("the quick brown fox");
+        UA_Variant_setScalarCopy(&dv->value, &s, &UA_TYPES[UA_TYPES_STRING]);
+    }
+    dv->hasValue = true;
+    dv->sourceTimestamp = UA_DateTime_now();
+    dv->hasSourceTimestamp = true;
+    dv->serverTimestamp = dv->sourceTimestamp;
+    dv->hasServerTimestamp = true;
+}
+
+static void
+makeReadResponse(UA_ReadResponse *rr, size_t values) {
+    UA_ReadResponse_init(rr);
+    rr->responseHeader.timestamp = UA_DateTime_now();
+    rr->responseHeader.requestHandle = 42;
+    rr->results = UA_Array_new(values, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    rr->resultsSize = values;
+    for(size_t i = 0; i < values; i++)
+        setValue(&rr->results[i], i);
+}
+
+static void
+makePublishResponse(UA_PublishResponse *pr, size_t values) {
+    UA_PublishResponse_init(pr);
+    pr->responseHeader.timestamp = UA_DateTime_now();
+    pr->responseHeader.requestHandle = 43;
+    pr->subscriptionId = 1;
+    pr->notificationMessage.sequenceNumber = 1;
+    pr->notificationMessage.publishTime = UA_DateTime_now();
+    UA_ExtensionObject *eo = UA_ExtensionObject_new();
+    pr->notificationMessage.notificationData = eo;
+    pr->notificationMessage.notificationDataSize = 1;
+
+#ifdef UA_TYPES_DATACHANGENOTIFICATION
+    UA_DataChangeNotification *dcn = UA_DataChangeNotification_new();
+    dcn->monitoredItems = UA_Array_new(values, &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
+    dcn->monitoredItemsSize = values;
+    for(size_t i = 0; i < values; i++) {
+        dcn->monitoredItems[i].clientHandle = (UA_UInt32)i;
+        setValue(&dcn->monitoredItems[i].value, i);
+    }
+    eo->encoding = UA_EXTENSIONOBJECT_DECODED;
+    eo->content.decoded.type = &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION];
+    eo->content.decoded.data = dcn;
+#else
+    /* Every notification is wrapped in its own ExtensionObject. The WriteValue
+     * carries a DataValue like the MonitoredItemNotification. */
+    UA_Array_delete(eo, 1, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]);
+    eo = UA_Array_new(values, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]);
+    pr->notificationMessage.notificationData = eo;
+    pr->notificationMessage.notificationDataSize = values;
+    for(size_t i = 0; i < values; i++) {
+        UA_WriteValue *wv = UA_WriteValue_new();
+        wv->nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        wv->attributeId = UA_ATTRIBUTEID_VALUE;
+        setValue(&wv->value, i);
+        eo[i].encoding = UA_EXTENSIONOBJECT_DECODED;
+        eo[i].content.decoded.type = &UA_TYPES[UA_TYPES_WRITEVALUE];
+        eo[i].content.decoded.data = wv;
+    }
+#endif
+}
+
+static void
+benchmark(const char *name, const void *msg, const UA_DataType *type) {
+    UA_ByteString buf;
+    size_t size = UA_calcSizeBinary((void*)(uintptr_t)msg, type);
+    UA_ByteString_allocBuffer(&buf, size);
+
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        size_t offset = 0;
+        if(UA_encodeBinary(msg, type, &buf, &offset) != UA_STATUSCODE_GOOD) {
+            printf("%-16s encoding failed\n", name);
+            UA_ByteString_deleteMembers(&buf);
+            return;
+        }
+    }
+    UA_DateTime encodeTime = UA_DateTime_nowMonotonic() - start;
+
+    void *decoded = UA_new(type);
+    start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        size_t offset = 0;
+        if(UA_decodeBinary(&buf, &offset, decoded, type) != UA_STATUSCODE_GOOD) {
+            printf("%-16s decoding failed\n", name);
+            break;
+        }
+        UA_deleteMembers(decoded, type);
+    }
+    UA_DateTime decodeTime = UA_DateTime_nowMonotonic() - start;
+    UA_delete(decoded, type);
+    UA_ByteString_deleteMembers(&buf);
+
+    double mb = (double)size * ITERATIONS / (1024.0 * 1024.0);
+    double encodeSec = (double)encodeTime / UA_SEC_TO_DATETIME;
+    double decodeSec = (double)decodeTime / UA_SEC_TO_DATETIME;
+    printf("%-16s %8lu bytes  encode %8.1f MB/s %9.0f msg/s  decode %8.1f MB/s %9.0f msg/s\n",
+           name, (unsigned long)size, mb / encodeSec, ITERATIONS / encodeSec,
+           mb / decodeSec, ITERATIONS / decodeSec);
+}
+
+int main(int argc, char **argv) {
+    size_t values = 1000;
+    if(argc > 1)
+        values = (size_t)strtoul(argv[1], NULL, 10);
+    printf("binary codec with %lu values per message, %d iterations\n",
+           (unsigned long)values, ITERATIONS);
+
+    UA_ReadResponse rr;
+    makeReadResponse(&rr, values);
+    benchmark("ReadResponse", &rr, &UA_TYPES[UA_TYPES_READRESPONSE]);
+    UA_ReadResponse_deleteMembers(&rr);
+
+    UA_PublishResponse pr;
+    makePublishResponse(&pr, values);
+    benchmark("PublishResponse", &pr, &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
+    UA_PublishResponse_deleteMembers(&pr);
+    return EXIT_SUCCESS;
+}
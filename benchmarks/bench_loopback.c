@@ -0,0 +1,122 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/* Measures the request throughput of the whole stack without a socket. The
+ * server runs in its own thread and every client thread reads the current
+ * time of the server over the loopback networklayer.
+ *
+ * Usage: bench_loopback [clients ...] (default: 1 2 4 8) */
+
+#define _XOPEN_SOURCE 500 // usleep
+#include "ua_types.h"
+#include "ua_server.h"
+#include "ua_client.h"
+#include "ua_client_highlevel.h"
+#include "networklayer_loopback.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define BENCH_NAME "bench_loopback"
+#define BENCH_URL "opc.loopback://" BENCH_NAME
+#define READS 20000 /* per client */
+
+static void
+nullLogger(UA_LogLevel level, UA_LogCategory category, const char *msg, ...) { }
+
+static volatile UA_Boolean running;
+
+static void *
+serverLoop(void *data) {
+    UA_Server_run(data, &running);
+    return NULL;
+}
+
+static void *
+clientLoop(void *data) {
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard, nullLogger);
+    UA_StatusCode retval = UA_Client_connect(client, UA_ClientConnectionLoopback, BENCH_URL);
+    for(size_t i = 0; i < READS && retval == UA_STATUSCODE_GOOD; i++) {
+        UA_Variant value;
+        UA_Variant_init(&value);
+        retval = UA_Client_readValueAttribute(client, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                                              &value);
+        UA_Variant_deleteMembers(&value);
+    }
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    *(UA_StatusCode*)data = retval;
+    return NULL;
+}
+
+static void
+benchmark(size_t clients) {
+    pthread_t *threads = malloc(sizeof(pthread_t) * clients);
+    UA_StatusCode *results = malloc(sizeof(UA_StatusCode) * clients);
+    if(!threads || !results) {
+        free(threads);
+        free(results);
+        return;
+    }
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < clients; i++)
+        pthread_create(&threads[i], NULL, clientLoop, &results[i]);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < clients; i++) {
+        pthread_join(threads[i], NULL);
+        retval |= results[i];
+    }
+    double seconds = (double)(UA_DateTime_nowMonotonic() - start) / (double)(UA_MSEC_TO_DATETIME * 1000);
+    if(retval != UA_STATUSCODE_GOOD)
+        printf("%3lu clients: failed with 0x%08x\n", (unsigned long)clients, retval);
+    else
+        printf("%3lu clients: %9.0f reads/s, %7.2f us per read\n", (unsigned long)clients,
+               (double)(clients * READS) / seconds, seconds * 1e6 / (double)(clients * READS));
+    free(threads);
+    free(results);
+}
+
+int main(int argc, char **argv) {
+    UA_ServerNetworkLayer nl = UA_ServerNetworkLayerLoopback(UA_ConnectionConfig_standard, BENCH_NAME);
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.logger = nullLogger;
+    config.networkLayers = &nl;
+    config.networkLayersSize = 1;
+    UA_Server *server = UA_Server_new(config);
+    running = true;
+    pthread_t serverThread;
+    pthread_create(&serverThread, NULL, serverLoop, server);
+
+    /* wait until the server has started the networklayer */
+    UA_Boolean started = false;
+    for(size_t i = 0; i < 5000 && !started; i++) {
+        UA_Connection probe = UA_ClientConnectionLoopback(UA_ConnectionConfig_standard, BENCH_URL, nullLogger);
+        started = (probe.state == UA_CONNECTION_OPENING);
+        if(started)
+            probe.close(&probe);
+        else
+            usleep(1000);
+    }
+
+    if(!started)
+        printf("the server did not start\n");
+    else if(argc > 1) {
+        for(int i = 1; i < argc; i++)
+            benchmark((size_t)strtoul(argv[i], NULL, 10));
+    } else {
+        benchmark(1);
+        benchmark(2);
+        benchmark(4);
+        benchmark(8);
+    }
+
+    running = false;
+    pthread_join(serverThread, NULL);
+    UA_Server_delete(server);
+    nl.deleteMembers(&nl);
+    return started ? EXIT_SUCCESS : EXIT_FAILURE;
+}
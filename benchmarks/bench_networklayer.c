@@ -0,0 +1,137 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/* Measures the cost of a single getJobs call of the TCP server networklayer
+ * with many idle connections. Build once with and once without
+ * UA_ENABLE_EPOLL to compare the select and the epoll backend.
+ *
+ * Usage: bench_networklayer [connections ...] (default: 100 1000 10000) */
+
+#include "ua_types.h"
+#include "ua_server.h"
+#include "networklayer_tcp.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define BENCH_PORT 16667
+#define ITERATIONS 2000
+
+static void
+nullLogger(UA_LogLevel level, UA_LogCategory category, const char *msg, ...) { }
+
+static void
+processJobs(UA_Job *jobs, size_t jobsSize) {
+    for(size_t i = 0; i < jobsSize; i++) {
+        if(jobs[i].type == UA_JOBTYPE_METHODCALL_DELAYED)
+            jobs[i].job.methodCall.method(NULL, jobs[i].job.methodCall.data);
+        else if(jobs[i].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER) {
+            /* the buffers come from the pool of the networklayer */
+            UA_Connection *c = jobs[i].job.binaryMessage.connection;
+            c->releaseRecvBuffer(c, &jobs[i].job.binaryMessage.message);
+        }
+    }
+    if(jobsSize > 0)
+        free(jobs);
+}
+
+static int
+connectClient(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0)
+        return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(BENCH_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void
+benchmark(size_t connections) {
+#ifndef UA_ENABLE_EPOLL
+    /* every connection takes a descriptor on the client and on the server side */
+    if(connections * 2 + 16 > FD_SETSIZE) {
+        printf("%6lu connections: skipped, select is limited to FD_SETSIZE (%d)\n",
+               (unsigned long)connections, FD_SETSIZE);
+        return;
+    }
+#endif
+    UA_ServerNetworkLayer nl = UA_ServerNetworkLayerTCP(UA_ConnectionConfig_standard, BENCH_PORT);
+    if(nl.start(&nl, nullLogger) != UA_STATUSCODE_GOOD) {
+        printf("%6lu connections: could not start the networklayer\n", (unsigned long)connections);
+        nl.deleteMembers(&nl);
+        return;
+    }
+
+    UA_Job *jobs;
+    int *clients = malloc(sizeof(int) * connections);
+    size_t opened = 0;
+    for(; opened < connections; opened++) {
+        clients[opened] = connectClient();
+        if(clients[opened] < 0)
+            break;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 0);
+        processJobs(jobs, jobsSize);
+    }
+
+    if(opened == connections) {
+        UA_DateTime start = UA_DateTime_nowMonotonic();
+        for(size_t i = 0; i < ITERATIONS; i++) {
+            size_t jobsSize = nl.getJobs(&nl, &jobs, 0);
+            processJobs(jobs, jobsSize);
+        }
+        UA_DateTime duration = UA_DateTime_nowMonotonic() - start;
+        printf("%6lu connections: %9.2f us per iteration\n", (unsigned long)connections,
+               ((double)duration / UA_USEC_TO_DATETIME) / ITERATIONS);
+    } else {
+        printf("%6lu connections: could only open %lu connections (descriptor limit?)\n",
+               (unsigned long)connections, (unsigned long)opened);
+    }
+
+    for(size_t i = 0; i < opened; i++)
+        close(clients[i]);
+    free(clients);
+    size_t jobsSize = nl.stop(&nl, &jobs);
+    processJobs(jobs, jobsSize);
+    nl.deleteMembers(&nl);
+}
+
+int main(int argc, char **argv) {
+    /* lift the descriptor limit as far as allowed */
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+#ifdef UA_ENABLE_EPOLL
+    printf("TCP networklayer with epoll, %d iterations\n", ITERATIONS);
+#else
+    printf("TCP networklayer with select, %d iterations\n", ITERATIONS);
+#endif
+
+    if(argc > 1) {
+        for(int i = 1; i < argc; i++)
+            benchmark((size_t)strtoul(argv[i], NULL, 10));
+    } else {
+        benchmark(100);
+        benchmark(1000);
+        benchmark(10000);
+    }
+    return EXIT_SUCCESS;
+}
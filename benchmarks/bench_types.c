@@ -0,0 +1,468 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/* Measures encode, decode, calcSize, copy and deleteMembers for every builtin
+ * type, for Variant arrays and for the messages of the hot services. Every
+ * measurement runs for at least 50ms. The results are written as JSON, so that
+ * the runs of different releases can be compared.
+ *
+ * Usage: bench_types [-o results.json] [filter]
+ *
+ * Only the cases whose name contains the filter are run. */
+
+#define _XOPEN_SOURCE 500 // clock_gettime
+
+#include "ua_types.h"
+#include "ua_types_generated.h"
+#include "ua_nodeids.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_types_encoding_binary_kernels.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BATCH 256
+#define MIN_NSEC 50000000LL
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+typedef struct {
+    const char *name;
+    const UA_DataType *type;
+    void *value;
+} BenchCase;
+
+typedef enum {
+    OP_ENCODE,
+    OP_DECODE,
+    OP_CALCSIZE,
+    OP_COPY,
+    OP_DELETEMEMBERS,
+    OP_COUNT
+} BenchOp;
+
+static const char *opNames[OP_COUNT] = {"encode", "decode", "calcSize", "copy", "deleteMembers"};
+
+static long long
+nsec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Runs the operation on a batch of values and returns the time of the
+ * operation only. The values are prepared and cleaned up outside of the
+ * measured time. */
+static long long
+runBatch(BenchOp op, const BenchCase *c, UA_ByteString *buf, void *values) {
+    const UA_DataType *type = c->type;
+    uintptr_t v = (uintptr_t)values;
+    long long start = 0, time = 0;
+    size_t s = 0;
+    switch(op) {
+    case OP_ENCODE:
+        start = nsec();
+        for(size_t i = 0; i < BATCH; i++) {
+            size_t offset = 0;
+            if(UA_encodeBinary(c->value, type, buf, &offset) != UA_STATUSCODE_GOOD)
+                return -1;
+        }
+        return nsec() - start;
+    case OP_DECODE:
+        start = nsec();
+        for(size_t i = 0; i < BATCH; i++) {
+            size_t offset = 0;
+            if(UA_decodeBinary(buf, &offset, (void*)(v + i * type->memSize), type) != UA_STATUSCODE_GOOD)
+                return -1;
+        }
+        time = nsec() - start;
+        for(size_t i = 0; i < BATCH; i++)
+            UA_deleteMembers((void*)(v + i * type->memSize), type);
+        return time;
+    case OP_CALCSIZE:
+        start = nsec();
+        for(size_t i = 0; i < BATCH; i++)
+            s += UA_calcSizeBinary(c->value, type);
+        time = nsec() - start;
+        return s > 0 ? time : -1;
+    case OP_COPY:
+        start = nsec();
+        for(size_t i = 0; i < BATCH; i++) {
+            if(UA_copy(c->value, (void*)(v + i * type->memSize), type) != UA_STATUSCODE_GOOD)
+                return -1;
+        }
+        time = nsec() - start;
+        for(size_t i = 0; i < BATCH; i++)
+            UA_deleteMembers((void*)(v + i * type->memSize), type);
+        return time;
+    case OP_DELETEMEMBERS:
+        for(size_t i = 0; i < BATCH; i++) {
+            if(UA_copy(c->value, (void*)(v + i * type->memSize), type) != UA_STATUSCODE_GOOD)
+                return -1;
+        }
+        start = nsec();
+        for(size_t i = 0; i < BATCH; i++)
+            UA_deleteMembers((void*)(v + i * type->memSize), type);
+        return nsec() - start;
+    default:
+        return -1;
+    }
+}
+
+static void
+runCase(FILE *out, const BenchCase *c, UA_Boolean *first) {
+    size_t size = UA_calcSizeBinary(c->value, c->type);
+    UA_ByteString buf;
+    if(UA_ByteString_allocBuffer(&buf, size) != UA_STATUSCODE_GOOD)
+        return;
+    size_t offset = 0;
+    if(UA_encodeBinary(c->value, c->type, &buf, &offset) != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "%s: encoding failed\n", c->name);
+        UA_ByteString_deleteMembers(&buf);
+        return;
+    }
+    void *values = calloc(BATCH, c->type->memSize);
+    if(!values) {
+        UA_ByteString_deleteMembers(&buf);
+        return;
+    }
+
+    for(int op = 0; op < OP_COUNT; op++) {
+        long long time = 0;
+        size_t ops = 0;
+        while(time < MIN_NSEC) {
+            long long t = runBatch((BenchOp)op, c, &buf, values);
+            if(t < 0)
+                break;
+            time += t;
+            ops += BATCH;
+        }
+        if(time < MIN_NSEC) {
+            fprintf(stderr, "%s: %s failed\n", c->name, opNames[op]);
+            continue;
+        }
+        double nsPerOp = (double)time / (double)ops;
+        fprintf(out, "%s\n    {\"case\": \"%s\", \"op\": \"%s\", \"bytes\": %lu, \"ops\": %lu, "
+                "\"ns_per_op\": %.2f, \"bytes_per_s\": %.0f}", *first ? "" : ",", c->name,
+                opNames[op], (unsigned long)size, (unsigned long)ops, nsPerOp,
+                (double)size * 1e9 / nsPerOp);
+        *first = false;
+    }
+    free(values);
+    UA_ByteString_deleteMembers(&buf);
+}
+
+/*********/
+/* Cases */
+/*********/
+
+static void *
+newCopy(const void *src, const UA_DataType *type) {
+    void *p = UA_new(type);
+    if(p && UA_copy(src, p, type) != UA_STATUSCODE_GOOD) {
+        UA_delete(p, type);
+        return NULL;
+    }
+    return p;
+}
+
+static void
+setDataValue(UA_DataValue *dv, size_t i) {
+    UA_DataValue_init(dv);
+    if(i % 3 == 0) {
+        UA_Double d = (UA_Double)i * 0.5;
+        UA_Variant_setScalarCopy(&dv->value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    } else if(i % 3 == 1) {
+        UA_Int32 v = (UA_Int32)i;
+        UA_Variant_setScalarCopy(&dv->value, &v, &UA_TYPES[UA_TYPES_INT32]);
+    } else {
+        UA_String s = UA_STRING("the quick brown fox");
+        UA_Variant_setScalarCopy(&dv->value, &s, &UA_TYPES[UA_TYPES_STRING]);
+    }
+    dv->hasValue = true;
+    dv->sourceTimestamp = UA_DateTime_now();
+    dv->hasSourceTimestamp = true;
+    dv->serverTimestamp = dv->sourceTimestamp;
+    dv->hasServerTimestamp = true;
+}
+
+static void *
+newVariantArray(const UA_DataType *type, size_t length) {
+    UA_Variant *v = UA_Variant_new();
+    void *data = UA_Array_new(length, type);
+    uintptr_t p = (uintptr_t)data;
+    for(size_t i = 0; i < length; i++) {
+        if(type == &UA_TYPES[UA_TYPES_INT32])
+            *(UA_Int32*)p = (UA_Int32)i;
+        else if(type == &UA_TYPES[UA_TYPES_DOUBLE])
+            *(UA_Double*)p = (UA_Double)i * 0.5;
+        else if(type == &UA_TYPES[UA_TYPES_STRING])
+            *(UA_String*)p = UA_STRING_ALLOC("the quick brown fox");
+        p += type->memSize;
+    }
+    UA_Variant_setArray(v, data, length, type);
+    return v;
+}
+
+static void *
+newReadRequest(size_t nodes) {
+    UA_ReadRequest *r = UA_ReadRequest_new();
+    r->requestHeader.timestamp = UA_DateTime_now();
+    r->requestHeader.requestHandle = 42;
+    r->timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    r->nodesToRead = UA_Array_new(nodes, &UA_TYPES[UA_TYPES_READVALUEID]);
+    r->nodesToReadSize = nodes;
+    for(size_t i = 0; i < nodes; i++) {
+        if(i % 2)
+            r->nodesToRead[i].nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        else
+            r->nodesToRead[i].nodeId = UA_NODEID_STRING_ALLOC(1, "the.answer.node");
+        r->nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    return r;
+}
+
+static void *
+newReadResponse(size_t values) {
+    UA_ReadResponse *r = UA_ReadResponse_new();
+    r->responseHeader.timestamp = UA_DateTime_now();
+    r->responseHeader.requestHandle = 42;
+    r->results = UA_Array_new(values, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    r->resultsSize = values;
+    for(size_t i = 0; i < values; i++)
+        setDataValue(&r->results[i], i);
+    return r;
+}
+
+static void *
+newBrowseRequest(size_t nodes) {
+    UA_BrowseRequest *r = UA_BrowseRequest_new();
+    r->requestHeader.timestamp = UA_DateTime_now();
+    r->requestedMaxReferencesPerNode = 100;
+    r->nodesToBrowse = UA_Array_new(nodes, &UA_TYPES[UA_TYPES_BROWSEDESCRIPTION]);
+    r->nodesToBrowseSize = nodes;
+    for(size_t i = 0; i < nodes; i++) {
+        UA_BrowseDescription *bd = &r->nodesToBrowse[i];
+        bd->nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        bd->browseDirection = UA_BROWSEDIRECTION_FORWARD;
+        bd->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+        bd->includeSubtypes = true;
+        bd->resultMask = UA_BROWSERESULTMASK_ALL;
+    }
+    return r;
+}
+
+static void *
+newBrowseResponse(size_t nodes, size_t references) {
+    UA_BrowseResponse *r = UA_BrowseResponse_new();
+    r->responseHeader.timestamp = UA_DateTime_now();
+    r->results = UA_Array_new(nodes, &UA_TYPES[UA_TYPES_BROWSERESULT]);
+    r->resultsSize = nodes;
+    for(size_t i = 0; i < nodes; i++) {
+        UA_BrowseResult *br = &r->results[i];
+        br->references = UA_Array_new(references, &UA_TYPES[UA_TYPES_REFERENCEDESCRIPTION]);
+        br->referencesSize = references;
+        for(size_t j = 0; j < references; j++) {
+            UA_ReferenceDescription *rd = &br->references[j];
+            rd->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+            rd->isForward = true;
+            rd->nodeId = UA_EXPANDEDNODEID_NUMERIC(1, (UA_UInt32)(i * references + j));
+            rd->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Temperature");
+            rd->displayName = UA_LOCALIZEDTEXT_ALLOC("en-US", "Temperature");
+            rd->nodeClass = UA_NODECLASS_VARIABLE;
+            rd->typeDefinition = UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
+        }
+    }
+    return r;
+}
+
+static void *
+newPublishResponse(size_t values) {
+    UA_PublishResponse *pr = UA_PublishResponse_new();
+    pr->responseHeader.timestamp = UA_DateTime_now();
+    pr->subscriptionId = 1;
+    pr->notificationMessage.sequenceNumber = 1;
+    pr->notificationMessage.publishTime = UA_DateTime_now();
+#ifdef UA_TYPES_DATACHANGENOTIFICATION
+    UA_DataChangeNotification *dcn = UA_DataChangeNotification_new();
+    dcn->monitoredItems = UA_Array_new(values, &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
+    dcn->monitoredItemsSize = values;
+    for(size_t i = 0; i < values; i++) {
+        dcn->monitoredItems[i].clientHandle = (UA_UInt32)i;
+        setDataValue(&dcn->monitoredItems[i].value, i);
+    }
+    UA_ExtensionObject *eo = UA_ExtensionObject_new();
+    eo->encoding = UA_EXTENSIONOBJECT_DECODED;
+    eo->content.decoded.type = &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION];
+    eo->content.decoded.data = dcn;
+    pr->notificationMessage.notificationData = eo;
+    pr->notificationMessage.notificationDataSize = 1;
+#else
+    /* Without subscriptions, the DataChangeNotification type is not generated.
+     * Every DataValue is wrapped in a WriteValue instead. */
+    UA_ExtensionObject *eo = UA_Array_new(values, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]);
+    for(size_t i = 0; i < values; i++) {
+        UA_WriteValue *wv = UA_WriteValue_new();
+        wv->nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        wv->attributeId = UA_ATTRIBUTEID_VALUE;
+        setDataValue(&wv->value, i);
+        eo[i].encoding = UA_EXTENSIONOBJECT_DECODED;
+        eo[i].content.decoded.type = &UA_TYPES[UA_TYPES_WRITEVALUE];
+        eo[i].content.decoded.data = wv;
+    }
+    pr->notificationMessage.notificationData = eo;
+    pr->notificationMessage.notificationDataSize = values;
+#endif
+    return pr;
+}
+
+/* Adds the builtin types with typical values */
+static size_t
+builtinCases(BenchCase *cases) {
+    size_t n = 0;
+#define ADD(NAME, TYPE, VALUE) do {                                     \
+        cases[n].name = NAME;                                           \
+        cases[n].type = &UA_TYPES[TYPE];                                \
+        cases[n].value = newCopy(VALUE, &UA_TYPES[TYPE]);               \
+        n++; } while(0)
+
+    UA_Boolean b = true;
+    ADD("Boolean", UA_TYPES_BOOLEAN, &b);
+    UA_SByte sb = -5;
+    ADD("SByte", UA_TYPES_SBYTE, &sb);
+    UA_Byte by = 200;
+    ADD("Byte", UA_TYPES_BYTE, &by);
+    UA_Int16 i16 = -1234;
+    ADD("Int16", UA_TYPES_INT16, &i16);
+    UA_UInt16 u16 = 1234;
+    ADD("UInt16", UA_TYPES_UINT16, &u16);
+    UA_Int32 i32 = -123456;
+    ADD("Int32", UA_TYPES_INT32, &i32);
+    UA_UInt32 u32 = 123456;
+    ADD("UInt32", UA_TYPES_UINT32, &u32);
+    UA_Int64 i64 = -1234567890123LL;
+    ADD("Int64", UA_TYPES_INT64, &i64);
+    UA_UInt64 u64 = 1234567890123ULL;
+    ADD("UInt64", UA_TYPES_UINT64, &u64);
+    UA_Float f = 3.25f;
+    ADD("Float", UA_TYPES_FLOAT, &f);
+    UA_Double d = 3.25;
+    ADD("Double", UA_TYPES_DOUBLE, &d);
+    UA_String s = UA_STRING("the quick brown fox jumps over the lazy dog");
+    ADD("String", UA_TYPES_STRING, &s);
+    UA_DateTime dt = UA_DateTime_now();
+    ADD("DateTime", UA_TYPES_DATETIME, &dt);
+    UA_Guid g = {0x72962B91, 0xFA75, 0x4AE6, {0x8D, 0x28, 0xB4, 0x04, 0xDC, 0x7D, 0xAF, 0x63}};
+    ADD("Guid", UA_TYPES_GUID, &g);
+    UA_Byte bytes[64];
+    for(size_t i = 0; i < sizeof(bytes); i++)
+        bytes[i] = (UA_Byte)i;
+    UA_ByteString bs = {sizeof(bytes), bytes};
+    ADD("ByteString", UA_TYPES_BYTESTRING, &bs);
+    UA_XmlElement xml = UA_STRING("<value>42</value>");
+    ADD("XmlElement", UA_TYPES_XMLELEMENT, &xml);
+    UA_NodeId nn = UA_NODEID_NUMERIC(1, 123456);
+    ADD("NodeId.numeric", UA_TYPES_NODEID, &nn);
+    UA_NodeId ns = UA_NODEID_STRING(1, "the.answer.node");
+    ADD("NodeId.string", UA_TYPES_NODEID, &ns);
+    UA_ExpandedNodeId en = UA_EXPANDEDNODEID_NUMERIC(1, 123456);
+    en.namespaceUri = UA_STRING("urn:open62541.server.application");
+    en.serverIndex = 1;
+    ADD("ExpandedNodeId", UA_TYPES_EXPANDEDNODEID, &en);
+    UA_StatusCode sc = UA_STATUSCODE_BADNODEIDUNKNOWN;
+    ADD("StatusCode", UA_TYPES_STATUSCODE, &sc);
+    UA_QualifiedName qn = UA_QUALIFIEDNAME(1, "Temperature");
+    ADD("QualifiedName", UA_TYPES_QUALIFIEDNAME, &qn);
+    UA_LocalizedText lt = UA_LOCALIZEDTEXT("en-US", "Temperature");
+    ADD("LocalizedText", UA_TYPES_LOCALIZEDTEXT, &lt);
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = nn;
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ExtensionObject eo;
+    eo.encoding = UA_EXTENSIONOBJECT_DECODED;
+    eo.content.decoded.type = &UA_TYPES[UA_TYPES_READVALUEID];
+    eo.content.decoded.data = &rvi;
+    ADD("ExtensionObject", UA_TYPES_EXTENSIONOBJECT, &eo);
+    UA_DataValue dv;
+    setDataValue(&dv, 0);
+    ADD("DataValue", UA_TYPES_DATAVALUE, &dv);
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    ADD("Variant", UA_TYPES_VARIANT, &v);
+    UA_DiagnosticInfo di;
+    UA_DiagnosticInfo_init(&di);
+    di.hasSymbolicId = true;
+    di.symbolicId = 1;
+    di.hasAdditionalInfo = true;
+    di.additionalInfo = UA_STRING("additional info");
+    di.hasInnerStatusCode = true;
+    di.innerStatusCode = UA_STATUSCODE_BADINTERNALERROR;
+    ADD("DiagnosticInfo", UA_TYPES_DIAGNOSTICINFO, &di);
+#undef ADD
+
+    UA_DataValue_deleteMembers(&dv);
+    return n;
+}
+
+#define CASES_MAX 64
+
+int main(int argc, char **argv) {
+    const char *filter = NULL;
+    const char *outfile = NULL;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outfile = argv[++i];
+        else
+            filter = argv[i];
+    }
+    FILE *out = stdout;
+    if(outfile) {
+        out = fopen(outfile, "w");
+        if(!out) {
+            fprintf(stderr, "cannot open %s\n", outfile);
+            return EXIT_FAILURE;
+        }
+    }
+
+    BenchCase cases[CASES_MAX];
+    size_t n = builtinCases(cases);
+    cases[n++] = (BenchCase){"Variant.Int32[1000]", &UA_TYPES[UA_TYPES_VARIANT],
+                             newVariantArray(&UA_TYPES[UA_TYPES_INT32], 1000)};
+    cases[n++] = (BenchCase){"Variant.Double[1000]", &UA_TYPES[UA_TYPES_VARIANT],
+                             newVariantArray(&UA_TYPES[UA_TYPES_DOUBLE], 1000)};
+    cases[n++] = (BenchCase){"Variant.String[100]", &UA_TYPES[UA_TYPES_VARIANT],
+                             newVariantArray(&UA_TYPES[UA_TYPES_STRING], 100)};
+    cases[n++] = (BenchCase){"ReadRequest[100]", &UA_TYPES[UA_TYPES_READREQUEST], newReadRequest(100)};
+    cases[n++] = (BenchCase){"ReadResponse[100]", &UA_TYPES[UA_TYPES_READRESPONSE], newReadResponse(100)};
+    cases[n++] = (BenchCase){"BrowseRequest[10]", &UA_TYPES[UA_TYPES_BROWSEREQUEST], newBrowseRequest(10)};
+    cases[n++] = (BenchCase){"BrowseResponse[10x10]", &UA_TYPES[UA_TYPES_BROWSERESPONSE],
+                             newBrowseResponse(10, 10)};
+    cases[n++] = (BenchCase){"PublishResponse[100]", &UA_TYPES[UA_TYPES_PUBLISHRESPONSE],
+                             newPublishResponse(100)};
+
+    fprintf(out, "{\n  \"version\": \"%s\",\n  \"kernels\": \"%s\",\n  \"batch\": %d,\n  \"results\": [",
+#ifdef VERSION
+            TOSTRING(VERSION),
+#else
+            "unknown",
+#endif
+            UA_kernelsName(), BATCH);
+    UA_Boolean first = true;
+    for(size_t i = 0; i < n; i++) {
+        if(!cases[i].value)
+            continue;
+        if(!filter || strstr(cases[i].name, filter))
+            runCase(out, &cases[i], &first);
+        UA_delete(cases[i].value, cases[i].type);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if(outfile)
+        fclose(out);
+    return EXIT_SUCCESS;
+}
@@ -22,7 +22,7 @@ int main(int argc , char *argv[]) {
 	message.length = 1000;
 	//UA_UInt32 messageEncodedLength = 0;
 	UA_Byte server_reply[2000];
-	unsigned int messagepos = 0;
+	size_t messagepos = 0;
 
 	//Create socket
 #ifdef UA_ENABLE_NONSTANDARD_UDP
@@ -94,7 +94,7 @@ int main(int argc , char *argv[]) {
 	UA_SequenceHeader_encodeBinary(&reqSequenceHeader, &message, &messagepos);
 	UA_NodeId_encodeBinary(&reqRequestType, &message, &messagepos);
 	UA_ReadRequest_encodeBinary(&req, &message, &messagepos);
-    reqTcpHeader.messageSize = messagepos;
+    reqTcpHeader.messageSize = (UA_UInt32)messagepos;
     messagepos=0;
 
     UA_TcpMessageHeader_encodeBinary(&reqTcpHeader, &message, &messagepos);
@@ -111,14 +111,14 @@ int main(int argc , char *argv[]) {
 	}
 
 	//Receive a reply from the server
-	int received = recv(sock , server_reply , 2000 , 0);
+	ssize_t received = recv(sock , server_reply , 2000 , 0);
 	if(received < 0) {
 		puts("recv failed");
 		return 1;
 	}
 
 
-	for(int i=0;i<received;i++) {
+	for(ssize_t i=0;i<received;i++) {
 		  //show only printable ascii
 		  if(server_reply[i] >= 32 && server_reply[i]<= 126)
 			  printf("%c",server_reply[i]);
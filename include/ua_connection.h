@@ -59,7 +59,8 @@ struct UA_Connection {
                                         socket id here simplifies the design. */
     void *handle;                    /* A pointer to the networklayer */
     UA_ByteString incompleteMessage; /* A half-received message (TCP is a streaming protocol) is
-                                        stored here */
+                                        stored here. Allocated for the full length once the
+                                        header is received. */
 
     /* Get a buffer for sending */
     UA_StatusCode (*getSendBuffer)(UA_Connection *connection, size_t length, UA_ByteString *buf);
@@ -75,6 +76,15 @@ struct UA_Connection {
      * @return Returns an error code or UA_STATUSCODE_GOOD. */
     UA_StatusCode (*send)(UA_Connection *connection, UA_ByteString *buf);
 
+    /* Wait until the sent messages are handed to the network. Called between
+     * the chunks of a large message so that they do not pile up in memory when
+     * the remote side reads slowly. Optional, may be NULL.
+     *
+     * @param connection The connection
+     * @return Returns UA_STATUSCODE_GOOD or an error code if the message shall
+     *         be aborted. */
+    UA_StatusCode (*waitSendable)(UA_Connection *connection);
+
     /* Receive a message from the remote connection
      *
 	 * @param connection The connection
@@ -91,6 +91,21 @@ typedef struct {
 
 typedef struct {
     UA_UInt16 nThreads; // only if multithreading is enabled
+
+    /* Only if multithreading is enabled: Every networklayer gets a thread of
+     * its own that waits on the network and processes the received messages
+     * right away, instead of dispatching them from the main loop to the worker
+     * threads. Combine with several TCP networklayers listening on the same
+     * port (reusePort) to scale the message processing over the cores. */
+    UA_Boolean networkLayerThreads;
+
+    /* Only if multithreading is enabled: The requests of services that may run
+     * on a worker thread (see UA_ServiceEntry) are dispatched to the worker
+     * threads one by one. Pipelined requests on a SecureChannel are then
+     * executed in parallel and answered in the order of completion. Leave this
+     * disabled if clients depend on the order of pipelined requests, e.g. a
+     * write followed by a read of the same node. */
+    UA_Boolean parallelRequests;
     UA_Logger logger;
 
     UA_BuildInfo buildInfo;
@@ -107,6 +122,12 @@ typedef struct {
     size_t usernamePasswordLoginsSize;
     UA_UsernamePasswordLogin* usernamePasswordLogins;
 
+    /* Limits for the reassembly of chunked requests per SecureChannel (0 ->
+     * unlimited). The size of a single request is limited by the
+     * maxMessageSize of the connection config. */
+    size_t maxChunkedRequests; // concurrent chunked requests
+    size_t maxChunkedRequestsBytes; // buffered bytes of all chunked requests
+
     /* Limits for subscription settings */
     UA_BoundedUInt32 publishingIntervalLimits;
     UA_BoundedUInt32 lifeTimeCountLimits;
@@ -175,6 +196,77 @@ UA_StatusCode UA_EXPORT UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid j
 /* Add a new namespace to the server. Returns the index of the new namespace */
 UA_UInt16 UA_EXPORT UA_Server_addNamespace(UA_Server *server, const char* name);
 
+/**
+ * Service Handlers
+ * ----------------
+ * Requests are dispatched to the services in a table that is indexed by the
+ * request type. Applications can add services that are not built into the
+ * server or replace the built-in handlers, e.g. with a Read service that
+ * answers the requests for their own namespace directly. The replaced entry is
+ * returned so that a new handler can forward the requests it does not handle
+ * itself. */
+struct UA_Session;
+
+/* The response header is initialized before the handler is called. Errors are
+ * returned in the response. */
+typedef void (*UA_ServiceHandler)(UA_Server *server, struct UA_Session *session,
+                                  const void *request, void *response);
+
+typedef struct {
+    const UA_DataType *requestType;
+    const UA_DataType *responseType;
+    UA_ServiceHandler handler;
+    /* With multithreading and the parallelRequests option, the request is
+     * dispatched to a worker thread and runs in parallel to other requests of
+     * the same session. Services that change the session are run in the order
+     * of the requests. */
+    UA_Boolean workerThread;
+    /* With UA_ENABLE_REQUEST_ARENA, the request is decoded in an arena of the
+     * thread that is reset after the response was sent. The service itself
+     * and the callbacks it calls allocate on the heap. Only for services that
+     * copy what they keep from the request. */
+    UA_Boolean requestArena;
+    /* Strings, bytestrings and string NodeIds of the request point into the
+     * received message instead of being copied out. The server deletes the
+     * request without freeing them. Only for services that copy what they keep
+     * beyond the call. */
+    UA_Boolean borrowStrings;
+    /* ExtensionObjects in the Variants of the request keep their body in the
+     * binary encoding until a consumer decodes them with
+     * UA_ExtensionObject_decodeBinaryContent. The handler receives the
+     * encoded ExtensionObjects. The built-in Write service decodes a value
+     * only once the write was accepted, before it is stored in the node or
+     * handed to onWrite or a datasource. */
+    UA_Boolean lazyExtensionObjects;
+    UA_UInt32 calls; // number of requests dispatched to the service
+} UA_ServiceEntry;
+
+/* Adds the service or replaces the entry for the request type. The request
+ * type must be a structure from namespace zero with a numeric type id that
+ * starts with a RequestHeader. Its binary encoding id is the type id +
+ * UA_ENCODINGOFFSET_BINARY. The calls counter is kept when an entry is
+ * replaced. Change the services only while the server is not running.
+ *
+ * @param server The server object.
+ * @param service The new entry.
+ * @param previous If not null, set to the replaced entry. The requestType is
+ *        null if there was no entry.
+ * @return Returns UA_STATUSCODE_GOOD or an error code. */
+UA_StatusCode UA_EXPORT
+UA_Server_setService(UA_Server *server, const UA_ServiceEntry *service,
+                     UA_ServiceEntry *previous);
+
+/* Removes the service for the request type. Clients get a
+ * BadServiceUnsupported response. */
+UA_StatusCode UA_EXPORT
+UA_Server_removeService(UA_Server *server, const UA_DataType *requestType);
+
+/* Copies the entry for the request type, e.g. to read the calls counter.
+ * Returns UA_STATUSCODE_BADSERVICEUNSUPPORTED if there is no entry. */
+UA_StatusCode UA_EXPORT
+UA_Server_getService(UA_Server *server, const UA_DataType *requestType,
+                     UA_ServiceEntry *service);
+
 /**
  * Node Management
  * ---------------
@@ -479,8 +479,8 @@ UA_LOCALIZEDTEXT_ALLOC(const char *locale, const char *text) {
  * ExtensionObjects may contain scalars of any data type. Even those that are
  * unknown to the receiver. See the Section `Generic Type Handling`_ on how
  * types are described. An ExtensionObject always contains the NodeId of the
- * Data Type. If the data cannot be decoded, we keep the encoded string and the
- * NodeId. */
+ * Data Type. If the data cannot be decoded (or the decoding is deferred), we
+ * keep the encoded string and the NodeId of the encoding. */
 typedef struct {
     enum {
         UA_EXTENSIONOBJECT_ENCODED_NOBODY     = 0,
@@ -492,7 +492,7 @@ typedef struct {
     } encoding;
     union {
         struct {
-            UA_NodeId typeId;   /* The nodeid of the datatype */
+            UA_NodeId typeId;   /* The nodeid of the datatype encoding */
             UA_ByteString body; /* The bytestring of the encoded data */
         } encoded;
         struct {
@@ -502,6 +502,11 @@ typedef struct {
     } content;
 } UA_ExtensionObject;
 
+/* Decodes a body in the binary encoding if the data type is known. Otherwise,
+ * and if the content is decoded already, the ExtensionObject is unchanged. */
+UA_StatusCode UA_EXPORT
+UA_ExtensionObject_decodeBinaryContent(UA_ExtensionObject *eo);
+
 /**
  * Variant
  * ^^^^^^^
@@ -0,0 +1,610 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+#include "networklayer_loopback.h" // before the libc headers that redefine the endianness macros
+#include "queue.h"
+#include <stdlib.h> // malloc, free
+#include <string.h> // memset, memcpy, strlen
+#include <stddef.h> // offsetof
+
+/* with a space so amalgamation does not remove the includes */
+# include <errno.h>
+# include <pthread.h>
+# include <time.h>
+
+/**
+ * The client and the server end of a connection share a pipe. The send buffers are allocated
+ * together with a queue entry in front of the data. Sending appends the entry to the queue of the
+ * receiving end, so a message is never copied. The receiver hands the buffer back with
+ * releaseRecvBuffer, which frees the whole block.
+ *
+ * The messages to the server are collected in a single queue of the networklayer, so that getJobs
+ * does not have to look at every pipe. The messages to a client are queued in its pipe.
+ *
+ * Locking: Every pipe has a mutex for its state and the messages to the client. The networklayer
+ * has a mutex for its queue, its list of pipes and the pipes that wait to be detached. When both
+ * are needed, the mutex of the pipe is taken first. The networklayer can be stopped while clients
+ * still hold their end. A pipe therefore lives until both ends have let go of it.
+ */
+
+#define LOOPBACKURLPREFIX "opc.loopback://"
+
+#if defined(__APPLE__)
+# define LOOPBACK_CLOCK CLOCK_REALTIME /* no pthread_condattr_setclock */
+#else
+# define LOOPBACK_CLOCK CLOCK_MONOTONIC
+#endif
+
+typedef struct LoopbackPipe LoopbackPipe;
+typedef struct LoopbackLayer LoopbackLayer;
+
+typedef struct LoopbackMessage {
+    SIMPLEQ_ENTRY(LoopbackMessage) next;
+    LoopbackPipe *pipe; /* the sender */
+    UA_ByteString buf; /* points into data */
+    UA_Byte data[];
+} LoopbackMessage;
+
+typedef SIMPLEQ_HEAD(, LoopbackMessage) LoopbackQueue;
+typedef SIMPLEQ_HEAD(, LoopbackPipe) LoopbackPipeQueue;
+
+struct LoopbackPipe {
+    UA_Connection connection; /* the server end */
+    LoopbackLayer *layer;
+    LIST_ENTRY(LoopbackPipe) pointers; /* open pipes of the layer */
+    SIMPLEQ_ENTRY(LoopbackPipe) detachNext; /* pipes to be detached by the layer */
+    pthread_mutex_t lock;
+    pthread_cond_t ready; /* signaled for the client */
+    LoopbackQueue toClient;
+    UA_Boolean clientWaiting;
+    UA_Boolean clientClosed;
+    UA_Boolean serverClosed;
+    UA_Boolean detachPending;
+    UA_UInt16 refs; /* the client end and the server end */
+};
+
+struct LoopbackLayer {
+    LIST_ENTRY(LoopbackLayer) pointers; /* in the registry */
+    UA_ConnectionConfig conf;
+    UA_Logger logger;
+    char *name;
+    pthread_mutex_t lock;
+    pthread_cond_t ready; /* signaled for the server */
+    UA_Boolean serverWaiting;
+    UA_Boolean started;
+    UA_Boolean stopped;
+    LoopbackQueue toServer;
+    size_t toServerSize;
+    LIST_HEAD(, LoopbackPipe) pipes;
+    size_t pipesSize;
+    LoopbackPipeQueue detach;
+    size_t detachSize;
+};
+
+/* The started networklayers, so that clients can find them by name */
+static LIST_HEAD(, LoopbackLayer) registry = LIST_HEAD_INITIALIZER(registry);
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*********************/
+/* Messages and Pipe */
+/*********************/
+
+static LoopbackMessage *
+LoopbackMessage_fromBuffer(const UA_ByteString *buf) {
+    return (LoopbackMessage*)(uintptr_t)(buf->data - offsetof(LoopbackMessage, data));
+}
+
+static UA_StatusCode
+Loopback_getSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    if(connection->state == UA_CONNECTION_CLOSED)
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    LoopbackMessage *msg = malloc(sizeof(LoopbackMessage) + length);
+    if(!msg)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    buf->data = msg->data;
+    buf->length = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Both the send buffers and the received messages */
+static void
+Loopback_releaseBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    if(!buf->data)
+        return;
+    free(LoopbackMessage_fromBuffer(buf));
+    buf->data = NULL;
+    buf->length = 0;
+}
+
+static void
+LoopbackQueue_clear(LoopbackQueue *queue) {
+    LoopbackMessage *msg;
+    while((msg = SIMPLEQ_FIRST(queue))) {
+        SIMPLEQ_REMOVE_HEAD(queue, next);
+        free(msg);
+    }
+}
+
+static void
+LoopbackPipe_release(LoopbackPipe *pipe) {
+    pthread_mutex_lock(&pipe->lock);
+    UA_Boolean last = (--pipe->refs == 0);
+    pthread_mutex_unlock(&pipe->lock);
+    if(!last)
+        return;
+    LoopbackQueue_clear(&pipe->toClient);
+    pthread_cond_destroy(&pipe->ready);
+    pthread_mutex_destroy(&pipe->lock);
+    UA_Connection_deleteMembers(&pipe->connection);
+    free(pipe);
+}
+
+/* Lets the layer detach the server end in the next getJobs. Called with the
+ * lock of the pipe. */
+static void
+LoopbackPipe_scheduleDetach(LoopbackPipe *pipe) {
+    if(pipe->detachPending)
+        return;
+    pipe->detachPending = true;
+    LoopbackLayer *layer = pipe->layer;
+    pthread_mutex_lock(&layer->lock);
+    if(!layer->stopped) {
+        SIMPLEQ_INSERT_TAIL(&layer->detach, pipe, detachNext);
+        layer->detachSize++;
+        if(layer->serverWaiting)
+            pthread_cond_signal(&layer->ready);
+    }
+    pthread_mutex_unlock(&layer->lock);
+}
+
+static UA_StatusCode
+initCondition(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    if(pthread_condattr_init(&attr) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+#if !defined(__APPLE__)
+    pthread_condattr_setclock(&attr, LOOPBACK_CLOCK);
+#endif
+    int ret = pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return (ret == 0) ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADINTERNALERROR;
+}
+
+static struct timespec
+deadlineIn(UA_UInt64 usec) {
+    struct timespec ts;
+    clock_gettime(LOOPBACK_CLOCK, &ts);
+    ts.tv_sec += (time_t)(usec / 1000000);
+    ts.tv_nsec += (long)(usec % 1000000) * 1000;
+    if(ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+/*****************************/
+/* Server Network Layer Ends */
+/*****************************/
+
+static UA_StatusCode
+ServerNetworkLayerLoopback_send(UA_Connection *connection, UA_ByteString *buf) {
+    LoopbackPipe *pipe = (LoopbackPipe*)connection;
+    LoopbackMessage *msg = LoopbackMessage_fromBuffer(buf);
+    msg->pipe = pipe;
+    msg->buf = *buf;
+    buf->data = NULL;
+    buf->length = 0;
+    pthread_mutex_lock(&pipe->lock);
+    if(pipe->clientClosed || pipe->serverClosed) {
+        pthread_mutex_unlock(&pipe->lock);
+        free(msg);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+    SIMPLEQ_INSERT_TAIL(&pipe->toClient, msg, next);
+    if(pipe->clientWaiting)
+        pthread_cond_signal(&pipe->ready);
+    pthread_mutex_unlock(&pipe->lock);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerLoopback_close(UA_Connection *connection) {
+    LoopbackPipe *pipe = (LoopbackPipe*)connection;
+    connection->state = UA_CONNECTION_CLOSED;
+    pthread_mutex_lock(&pipe->lock);
+    if(!pipe->serverClosed) {
+        pipe->serverClosed = true;
+        pthread_cond_signal(&pipe->ready);
+        LoopbackPipe_scheduleDetach(pipe);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+static void
+ServerNetworkLayerLoopback_freeConnection(UA_Server *server, void *ptr) {
+    LoopbackPipe_release(ptr);
+}
+
+static void
+ServerNetworkLayerLoopback_detach(LoopbackPipe *pipe, UA_Job *js, size_t *j) {
+    js[*j].type = UA_JOBTYPE_DETACHCONNECTION;
+    js[*j].job.closeConnection = &pipe->connection;
+    js[*j+1].type = UA_JOBTYPE_METHODCALL_DELAYED;
+    js[*j+1].job.methodCall.method = ServerNetworkLayerLoopback_freeConnection;
+    js[*j+1].job.methodCall.data = pipe;
+    *j += 2;
+}
+
+/************************/
+/* Server Network Layer */
+/************************/
+
+static UA_StatusCode
+ServerNetworkLayerLoopback_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    LoopbackLayer *layer = nl->handle;
+    layer->logger = logger;
+    size_t prefixLength = strlen(LOOPBACKURLPREFIX);
+    size_t nameLength = strlen(layer->name);
+    if(UA_ByteString_allocBuffer(&nl->discoveryUrl, prefixLength + nameLength) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    memcpy(nl->discoveryUrl.data, LOOPBACKURLPREFIX, prefixLength);
+    memcpy(&nl->discoveryUrl.data[prefixLength], layer->name, nameLength);
+
+    pthread_mutex_lock(&registryLock);
+    LoopbackLayer *other;
+    LIST_FOREACH(other, &registry, pointers) {
+        if(strcmp(other->name, layer->name) == 0)
+            break;
+    }
+    if(!other)
+        LIST_INSERT_HEAD(&registry, layer, pointers);
+    pthread_mutex_unlock(&registryLock);
+    if(other) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "A loopback network layer with the name %s is already started", layer->name);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    layer->started = true;
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Loopback network layer listening on %.*s",
+                nl->discoveryUrl.length, nl->discoveryUrl.data);
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t
+ServerNetworkLayerLoopback_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
+    LoopbackLayer *layer = nl->handle;
+    pthread_mutex_lock(&layer->lock);
+    if(timeout > 0 && SIMPLEQ_EMPTY(&layer->toServer) && SIMPLEQ_EMPTY(&layer->detach)) {
+        struct timespec deadline = deadlineIn(timeout);
+        layer->serverWaiting = true;
+        while(SIMPLEQ_EMPTY(&layer->toServer) && SIMPLEQ_EMPTY(&layer->detach)) {
+            if(pthread_cond_timedwait(&layer->ready, &layer->lock, &deadline) == ETIMEDOUT)
+                break;
+        }
+        layer->serverWaiting = false;
+    }
+
+    /* take everything that is queued */
+    LoopbackQueue messages;
+    SIMPLEQ_INIT(&messages);
+    if(!SIMPLEQ_EMPTY(&layer->toServer)) {
+        messages = layer->toServer;
+        SIMPLEQ_INIT(&layer->toServer);
+    }
+    size_t messagesSize = layer->toServerSize;
+    layer->toServerSize = 0;
+    LoopbackPipeQueue detach;
+    SIMPLEQ_INIT(&detach);
+    if(!SIMPLEQ_EMPTY(&layer->detach)) {
+        detach = layer->detach;
+        SIMPLEQ_INIT(&layer->detach);
+    }
+    size_t detachSize = layer->detachSize;
+    layer->detachSize = 0;
+    LoopbackPipe *pipe;
+    SIMPLEQ_FOREACH(pipe, &detach, detachNext) {
+        LIST_REMOVE(pipe, pointers);
+        layer->pipesSize--;
+    }
+    pthread_mutex_unlock(&layer->lock);
+
+    *jobs = NULL;
+    size_t jobsSize = messagesSize + (detachSize * 2);
+    if(jobsSize == 0)
+        return 0;
+    UA_Job *js = malloc(sizeof(UA_Job) * jobsSize);
+    if(!js) {
+        /* drop the messages, the pipes are detached in the next iteration */
+        LoopbackQueue_clear(&messages);
+        if(detachSize > 0) {
+            pthread_mutex_lock(&layer->lock);
+            while((pipe = SIMPLEQ_FIRST(&detach))) {
+                SIMPLEQ_REMOVE_HEAD(&detach, detachNext);
+                LIST_INSERT_HEAD(&layer->pipes, pipe, pointers);
+                layer->pipesSize++;
+                SIMPLEQ_INSERT_TAIL(&layer->detach, pipe, detachNext);
+                layer->detachSize++;
+            }
+            pthread_mutex_unlock(&layer->lock);
+        }
+        return 0;
+    }
+
+    /* the messages before the detach jobs, they were sent before the close */
+    size_t j = 0;
+    LoopbackMessage *msg;
+    while((msg = SIMPLEQ_FIRST(&messages))) {
+        SIMPLEQ_REMOVE_HEAD(&messages, next);
+        js[j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
+        js[j].job.binaryMessage.connection = &msg->pipe->connection;
+        js[j].job.binaryMessage.message = msg->buf;
+        j++;
+    }
+    while((pipe = SIMPLEQ_FIRST(&detach))) {
+        SIMPLEQ_REMOVE_HEAD(&detach, detachNext);
+        ServerNetworkLayerLoopback_detach(pipe, js, &j);
+    }
+    *jobs = js;
+    return j;
+}
+
+static size_t
+ServerNetworkLayerLoopback_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
+    LoopbackLayer *layer = nl->handle;
+    *jobs = NULL;
+    if(!layer->started)
+        return 0;
+    layer->started = false;
+
+    /* clients no longer find the layer */
+    pthread_mutex_lock(&registryLock);
+    LIST_REMOVE(layer, pointers);
+    pthread_mutex_unlock(&registryLock);
+
+    /* take all pipes. afterwards, the pipes no longer touch the layer. */
+    pthread_mutex_lock(&layer->lock);
+    layer->stopped = true;
+    LoopbackQueue_clear(&layer->toServer);
+    layer->toServerSize = 0;
+    SIMPLEQ_INIT(&layer->detach);
+    layer->detachSize = 0;
+    LoopbackPipeQueue pipes;
+    SIMPLEQ_INIT(&pipes);
+    LoopbackPipe *pipe;
+    while((pipe = LIST_FIRST(&layer->pipes))) {
+        LIST_REMOVE(pipe, pointers);
+        SIMPLEQ_INSERT_TAIL(&pipes, pipe, detachNext);
+    }
+    size_t pipesSize = layer->pipesSize;
+    layer->pipesSize = 0;
+    pthread_mutex_unlock(&layer->lock);
+
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "Shutting down the loopback network layer with %d open connection(s)", (int)pipesSize);
+    if(pipesSize == 0)
+        return 0;
+
+    UA_Job *items = malloc(sizeof(UA_Job) * pipesSize * 2);
+    size_t j = 0;
+    while((pipe = SIMPLEQ_FIRST(&pipes))) {
+        SIMPLEQ_REMOVE_HEAD(&pipes, detachNext);
+        pipe->connection.state = UA_CONNECTION_CLOSED;
+        pthread_mutex_lock(&pipe->lock);
+        pipe->serverClosed = true;
+        pipe->detachPending = true;
+        pthread_cond_signal(&pipe->ready);
+        pthread_mutex_unlock(&pipe->lock);
+        if(items)
+            ServerNetworkLayerLoopback_detach(pipe, items, &j);
+        else
+            LoopbackPipe_release(pipe); /* the channel cannot be detached */
+    }
+    *jobs = items;
+    return j;
+}
+
+/* run only when the server is stopped */
+static void
+ServerNetworkLayerLoopback_deleteMembers(UA_ServerNetworkLayer *nl) {
+    LoopbackLayer *layer = nl->handle;
+    pthread_cond_destroy(&layer->ready);
+    pthread_mutex_destroy(&layer->lock);
+    free(layer->name);
+    free(layer);
+    UA_String_deleteMembers(&nl->discoveryUrl);
+}
+
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerLoopback(UA_ConnectionConfig conf, const char *name) {
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
+    LoopbackLayer *layer = calloc(1, sizeof(LoopbackLayer));
+    if(!layer)
+        return nl;
+    size_t nameLength = strlen(name);
+    layer->name = malloc(nameLength + 1);
+    if(!layer->name || initCondition(&layer->ready) != UA_STATUSCODE_GOOD) {
+        free(layer->name);
+        free(layer);
+        return nl;
+    }
+    memcpy(layer->name, name, nameLength + 1);
+    pthread_mutex_init(&layer->lock, NULL);
+    layer->conf = conf;
+    SIMPLEQ_INIT(&layer->toServer);
+    LIST_INIT(&layer->pipes);
+    SIMPLEQ_INIT(&layer->detach);
+
+    nl.handle = layer;
+    nl.start = ServerNetworkLayerLoopback_start;
+    nl.getJobs = ServerNetworkLayerLoopback_getJobs;
+    nl.stop = ServerNetworkLayerLoopback_stop;
+    nl.deleteMembers = ServerNetworkLayerLoopback_deleteMembers;
+    return nl;
+}
+
+/***************************/
+/* Client Connection Setup */
+/***************************/
+
+static UA_StatusCode
+ClientConnectionLoopback_send(UA_Connection *connection, UA_ByteString *buf) {
+    LoopbackPipe *pipe = connection->handle;
+    if(!pipe) {
+        Loopback_releaseBuffer(connection, buf);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+    LoopbackMessage *msg = LoopbackMessage_fromBuffer(buf);
+    msg->pipe = pipe;
+    msg->buf = *buf;
+    buf->data = NULL;
+    buf->length = 0;
+    pthread_mutex_lock(&pipe->lock);
+    UA_Boolean closed = pipe->serverClosed;
+    if(!closed) {
+        LoopbackLayer *layer = pipe->layer;
+        pthread_mutex_lock(&layer->lock);
+        closed = layer->stopped;
+        if(!closed) {
+            SIMPLEQ_INSERT_TAIL(&layer->toServer, msg, next);
+            layer->toServerSize++;
+            if(layer->serverWaiting)
+                pthread_cond_signal(&layer->ready);
+        }
+        pthread_mutex_unlock(&layer->lock);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    if(!closed)
+        return UA_STATUSCODE_GOOD;
+    free(msg);
+    return UA_STATUSCODE_BADCONNECTIONCLOSED;
+}
+
+/* as with TCP, the connection is closed when the timeout expires */
+static UA_StatusCode
+ClientConnectionLoopback_recv(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeout) {
+    LoopbackPipe *pipe = connection->handle;
+    if(!pipe)
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    pthread_mutex_lock(&pipe->lock);
+    if(SIMPLEQ_EMPTY(&pipe->toClient) && !pipe->serverClosed) {
+        struct timespec deadline = deadlineIn((UA_UInt64)timeout * 1000);
+        pipe->clientWaiting = true;
+        while(SIMPLEQ_EMPTY(&pipe->toClient) && !pipe->serverClosed) {
+            if(timeout == 0)
+                pthread_cond_wait(&pipe->ready, &pipe->lock);
+            else if(pthread_cond_timedwait(&pipe->ready, &pipe->lock, &deadline) == ETIMEDOUT)
+                break;
+        }
+        pipe->clientWaiting = false;
+    }
+    LoopbackMessage *msg = SIMPLEQ_FIRST(&pipe->toClient);
+    if(msg)
+        SIMPLEQ_REMOVE_HEAD(&pipe->toClient, next);
+    pthread_mutex_unlock(&pipe->lock);
+    if(msg) {
+        *response = msg->buf;
+        return UA_STATUSCODE_GOOD;
+    }
+    connection->close(connection);
+    return UA_STATUSCODE_BADCONNECTIONCLOSED;
+}
+
+static void
+ClientConnectionLoopback_close(UA_Connection *connection) {
+    connection->state = UA_CONNECTION_CLOSED;
+    LoopbackPipe *pipe = connection->handle;
+    if(!pipe)
+        return;
+    connection->handle = NULL;
+    pthread_mutex_lock(&pipe->lock);
+    pipe->clientClosed = true;
+    LoopbackQueue_clear(&pipe->toClient);
+    LoopbackPipe_scheduleDetach(pipe);
+    pthread_mutex_unlock(&pipe->lock);
+    LoopbackPipe_release(pipe);
+}
+
+static LoopbackPipe *
+LoopbackPipe_new(LoopbackLayer *layer) {
+    LoopbackPipe *pipe = calloc(1, sizeof(LoopbackPipe));
+    if(!pipe)
+        return NULL;
+    if(initCondition(&pipe->ready) != UA_STATUSCODE_GOOD) {
+        free(pipe);
+        return NULL;
+    }
+    pthread_mutex_init(&pipe->lock, NULL);
+    SIMPLEQ_INIT(&pipe->toClient);
+    pipe->layer = layer;
+    pipe->refs = 2;
+
+    UA_Connection *c = &pipe->connection;
+    UA_Connection_init(c);
+    c->sockfd = -1;
+    c->handle = layer;
+    c->localConf = layer->conf;
+    c->send = ServerNetworkLayerLoopback_send;
+    c->close = ServerNetworkLayerLoopback_close;
+    c->getSendBuffer = Loopback_getSendBuffer;
+    c->releaseSendBuffer = Loopback_releaseBuffer;
+    c->releaseRecvBuffer = Loopback_releaseBuffer;
+    c->state = UA_CONNECTION_OPENING;
+    return pipe;
+}
+
+UA_Connection
+UA_ClientConnectionLoopback(UA_ConnectionConfig localConf, const char *endpointUrl, UA_Logger logger) {
+    UA_Connection connection;
+    UA_Connection_init(&connection);
+    connection.localConf = localConf;
+    connection.sockfd = -1;
+
+    size_t prefixLength = strlen(LOOPBACKURLPREFIX);
+    if(strncmp(endpointUrl, LOOPBACKURLPREFIX, prefixLength) != 0) {
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK, "Loopback urls start with %s", LOOPBACKURLPREFIX);
+        return connection;
+    }
+    const char *name = &endpointUrl[prefixLength];
+
+    /* register the pipe with the layer while the registry holds on to it */
+    LoopbackPipe *pipe = NULL;
+    pthread_mutex_lock(&registryLock);
+    LoopbackLayer *layer;
+    LIST_FOREACH(layer, &registry, pointers) {
+        if(strcmp(layer->name, name) == 0)
+            break;
+    }
+    if(layer)
+        pipe = LoopbackPipe_new(layer);
+    if(pipe) {
+        pthread_mutex_lock(&layer->lock);
+        LIST_INSERT_HEAD(&layer->pipes, pipe, pointers);
+        layer->pipesSize++;
+        pthread_mutex_unlock(&layer->lock);
+    }
+    pthread_mutex_unlock(&registryLock);
+    if(!layer) {
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK, "No loopback network layer with the name %s", name);
+        return connection;
+    }
+    if(!pipe) {
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK, "No memory for a new Connection");
+        return connection;
+    }
+
+    connection.handle = pipe;
+    connection.state = UA_CONNECTION_OPENING;
+    connection.send = ClientConnectionLoopback_send;
+    connection.recv = ClientConnectionLoopback_recv;
+    connection.close = ClientConnectionLoopback_close;
+    connection.getSendBuffer = Loopback_getSendBuffer;
+    connection.releaseSendBuffer = Loopback_releaseBuffer;
+    connection.releaseRecvBuffer = Loopback_releaseBuffer;
+    return connection;
+}
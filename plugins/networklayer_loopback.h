@@ -0,0 +1,35 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+#ifndef NETWORKLAYERLOOPBACK_H_
+#define NETWORKLAYERLOOPBACK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_server.h"
+#include "ua_client.h"
+
+/** @brief Create a networklayer for clients in the same process. The
+ * discovery url is opc.loopback://<name>. The messages are handed over in
+ * memory without being copied.
+ *
+ * The server has to run in its own thread (e.g. with UA_Server_run). Clients
+ * in any number of other threads can connect once the networklayer is started.
+ * The name must be unique among the started loopback networklayers. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerLoopback(UA_ConnectionConfig conf, const char *name);
+
+/** @brief Connect to a server in the same process at an
+ * opc.loopback://<name> endpoint url */
+UA_Connection UA_EXPORT
+UA_ClientConnectionLoopback(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* NETWORKLAYERLOOPBACK_H_ */
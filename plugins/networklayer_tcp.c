@@ -4,9 +4,11 @@
  */
 
 #include "networklayer_tcp.h"
+#include "queue.h"
 
 #include <stdlib.h> // malloc, free
 #include <stdio.h> // snprintf
+#include <stddef.h> // offsetof
 #include <string.h> // memset
 #include <errno.h>
 
@@ -24,12 +26,16 @@
 #  include <netinet/tcp.h>
 # endif
 # include <sys/ioctl.h>
+# include <sys/uio.h> // struct iovec
 # include <netdb.h> //gethostbyname for the client
 # include <unistd.h> // read, write, close
 # include <arpa/inet.h>
 # ifdef __QNX__
 #  include <sys/socket.h>
 # endif
+# ifdef UA_ENABLE_EPOLL
+#  include <sys/epoll.h>
+# endif
 # define CLOSESOCKET(S) close(S)
 #endif
 
@@ -48,6 +54,7 @@
 #endif
 
 #ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
 # include <urcu/uatomic.h>
 #endif
 
@@ -191,11 +198,6 @@ static UA_StatusCode socket_set_nonblocking(UA_Int32 sockfd) {
     return UA_STATUSCODE_GOOD;
 }
 
-static void FreeConnectionCallback(UA_Server *server, void *ptr) {
-    UA_Connection_deleteMembers((UA_Connection*)ptr);
-    free(ptr);
- }
-
 /***************************/
 /* Server NetworkLayer TCP */
 /***************************/
@@ -205,11 +207,11 @@ static void FreeConnectionCallback(UA_Server *server, void *ptr) {
  * layer. In addition, several worker threads are asynchronously calling into the callbacks of the
  * UA_Connection that holds a single connection.
  *
- * Creating a connection: When "GetWork" encounters a new connection, it creates a UA_Connection
- * with the socket information. This is added to the mappings array that links sockets to
- * UA_Connection structs.
+ * Creating a connection: When "GetWork" encounters new connections, it accepts all that are
+ * pending (up to the accept rate limit) and creates a UA_Connection with the socket information for
+ * each. The connections are stored in a table indexed by their socket.
  *
- * Reading data: In "GetWork", we listen on the sockets in the mappings array. If data arrives (or
+ * Reading data: In "GetWork", we listen on the sockets in the connection table. If data arrives (or
  * the connection closes), a WorkItem is created that carries the work and a pointer to the
  * connection.
  *
@@ -223,29 +225,110 @@ static void FreeConnectionCallback(UA_Server *server, void *ptr) {
  *   the connection to a linked list from which it is deleted later. The connection cannot be freed
  *   right away since other threads might still be using it.
  *
- * - GetWork: We remove the connection from the mappings array. In the non-multithreaded case, the
+ * - GetWork: We remove the connection from the connection table. In the non-multithreaded case, the
  *   connection is freed. For multithreading, we return a workitem that is delayed, i.e. that is
  *   called only after all workitems created before are finished in all threads. This workitems
  *   contains a callback that goes through the linked list of connections to be freed.
  *
+ * Sending: The sockets are non-blocking. What the kernel does not take right away is parked in a
+ * per-connection queue (without copying the buffer) and sent from "GetWork" once the socket becomes
+ * writable. Later messages are appended to the queue to keep the order. If the queue grows beyond
+ * the configured limit (a stalled client), the connection is closed. With the coalesceSends option,
+ * the messages sent while the jobs are processed are always queued. "GetWork" then sends the queue
+ * of every such connection with a single gather write before it waits for the sockets. Once the
+ * collected messages fill a gather write (MAXIOV buffers or MAXCOALESCE bytes), they are written
+ * right away. So large responses do not pile up until the next iteration. Between the chunks of a
+ * large response, "waitSendable" blocks until the queue is empty. So a slow client holds at most
+ * one chunk per response in the queue.
+ *
+ * Receiving: Buffers are taken from a pool of slabs with the size of the receive buffer. The slabs
+ * are returned to the pool in the releaseRecvBuffer callback (which may be called from worker
+ * threads) until the configured pool size is reached. Small messages, as reported by FIONREAD,
+ * get an exactly sized buffer instead of pinning a full slab.
+ *
+ * With UA_ENABLE_EPOLL, the sockets are registered with an epoll instance when they are opened and
+ * "GetWork" only visits the sockets that are reported ready. The listening socket is registered
+ * with a NULL pointer, the connection sockets with a pointer to their UA_Connection. Closed sockets
+ * drop out of the epoll set automatically.
+ *
+ * With the reusePort option, several networklayers open their own listening socket on the same
+ * port. The kernel balances new connections across them. When the server runs every networklayer
+ * in a thread of its own (networkLayerThreads), each layer only sees "its" connections.
  */
 
 #define MAXBACKLOG 100
+#define MAXEPOLLEVENTS 256
+#define SMALLRECVSIZE 4096 /* below this size, messages are not read into a pooled slab */
+#define MAXIOV 64 /* queued buffers per gather write */
+#define MAXCOALESCE 65536 /* coalesced bytes that are written right away */
+
+const UA_ServerNetworkLayerTCPConfig UA_ServerNetworkLayerTCPConfig_standard =
+    {.recvBufferPoolSize = 16, .maxSendQueueSize = 1048576, .reusePort = false,
+     .listenBacklog = MAXBACKLOG, .maxAcceptRate = 0, .coalesceSends = false,
+     .sendTimeout = 5000};
+
+/* Header in front of every receive buffer handed out by the server */
+typedef struct RecvBuffer {
+    struct RecvBuffer *next; /* in the pool */
+    size_t capacity;
+    UA_Byte data[];
+} RecvBuffer;
 
 typedef struct {
     UA_ConnectionConfig conf;
+    UA_ServerNetworkLayerTCPConfig tcpConf;
     UA_UInt16 port;
     UA_Logger logger; // Set during start
-    
-    /* open sockets and connections */
+
+    /* pool of unused receive buffers */
+    RecvBuffer *recvBuffers;
+    size_t recvBuffersSize;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t recvBuffersLock;
+#endif
+
+    /* open sockets and connections. the connections are indexed by their
+       socket. */
     UA_Int32 serversockfd;
-    size_t mappingsSize;
-    struct ConnectionMapping {
-        UA_Connection *connection;
-        UA_Int32 sockfd;
-    } *mappings;
+    UA_Connection **connections;
+    size_t connectionsCapacity; /* highest indexable socket + 1 */
+    size_t connectionsSize; /* open connections */
+
+    /* accept rate limit */
+    UA_Double acceptTokens; /* connections that may be accepted */
+    UA_DateTime acceptRefill; /* last update of the tokens */
+
+    /* connections with coalesced messages to be sent in the next iteration */
+    LIST_HEAD(, TCPConnection) flushConnections;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_t networkThread;
+#endif
+#ifdef UA_ENABLE_EPOLL
+    UA_Int32 epollfd;
+    UA_Boolean accepting; /* the listening socket is watched */
+#endif
 } ServerNetworkLayerTCP;
 
+/* Outbound data that could not be sent right away */
+typedef struct QueuedSend {
+    SIMPLEQ_ENTRY(QueuedSend) next;
+    UA_ByteString buf;
+    size_t sent;
+} QueuedSend;
+
+typedef struct TCPConnection {
+    UA_Connection connection;
+    SIMPLEQ_HEAD(SendQueue, QueuedSend) sendQueue;
+    size_t sendQueueSize; /* unsent bytes in the queue */
+    size_t sendQueueLength; /* buffers in the queue */
+    UA_Boolean watchWritable; /* waiting until the socket is writable */
+    UA_Boolean flushPending; /* in the list of connections to flush */
+    LIST_ENTRY(TCPConnection) flushPointers;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t sendQueueLock;
+#endif
+} TCPConnection;
+
 static UA_StatusCode
 ServerNetworkLayerGetSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
     if(length > connection->remoteConf.recvBufferSize)
@@ -258,23 +341,376 @@ ServerNetworkLayerReleaseSendBuffer(UA_Connection *connection, UA_ByteString *bu
     UA_ByteString_deleteMembers(buf);
 }
 
+static UA_StatusCode
+ServerNetworkLayerGetRecvBuffer(ServerNetworkLayerTCP *layer, size_t length, UA_ByteString *buf) {
+    RecvBuffer *rb = NULL;
+    size_t capacity = layer->conf.recvBufferSize;
+    if(length <= SMALLRECVSIZE && length < capacity) {
+        capacity = length;
+    } else {
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_lock(&layer->recvBuffersLock);
+#endif
+        rb = layer->recvBuffers;
+        if(rb) {
+            layer->recvBuffers = rb->next;
+            layer->recvBuffersSize--;
+        }
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_unlock(&layer->recvBuffersLock);
+#endif
+    }
+    if(!rb) {
+        rb = malloc(sizeof(RecvBuffer) + capacity);
+        if(!rb)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        rb->capacity = capacity;
+    }
+    buf->data = rb->data;
+    buf->length = rb->capacity;
+    return UA_STATUSCODE_GOOD;
+}
+
 static void
 ServerNetworkLayerReleaseRecvBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    if(!buf->data)
+        return;
+    ServerNetworkLayerTCP *layer = connection->handle;
+    RecvBuffer *rb = (RecvBuffer*)(void*)(buf->data - offsetof(RecvBuffer, data));
+    buf->data = NULL;
+    buf->length = 0;
+    if(rb->capacity == layer->conf.recvBufferSize) {
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_lock(&layer->recvBuffersLock);
+#endif
+        UA_Boolean pooled = (layer->recvBuffersSize < layer->tcpConf.recvBufferPoolSize);
+        if(pooled) {
+            rb->next = layer->recvBuffers;
+            layer->recvBuffers = rb;
+            layer->recvBuffersSize++;
+        }
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_unlock(&layer->recvBuffersLock);
+#endif
+        if(pooled)
+            return;
+    }
+    free(rb);
+}
+
+/* Receive into a buffer from the pool. The connection is non-blocking. */
+static UA_StatusCode
+ServerNetworkLayerTCP_recv(ServerNetworkLayerTCP *layer, UA_Connection *connection,
+                           UA_ByteString *response) {
+    /* size the buffer by the amount of pending data */
+    size_t length = layer->conf.recvBufferSize;
+#ifdef _WIN32
+    u_long pending = 0;
+    if(ioctlsocket(connection->sockfd, FIONREAD, &pending) == 0 &&
+       pending > 0 && (size_t)pending < length)
+        length = (size_t)pending;
+#else
+    int pending = 0;
+    if(ioctl(connection->sockfd, FIONREAD, &pending) == 0 &&
+       pending > 0 && (size_t)pending < length)
+        length = (size_t)pending;
+#endif
+
+    if(ServerNetworkLayerGetRecvBuffer(layer, length, response) != UA_STATUSCODE_GOOD) {
+        response->length = 0;
+        return UA_STATUSCODE_BADOUTOFMEMORY; /* not enough memory retry */
+    }
+
+    ssize_t ret = recv(connection->sockfd, (char*)response->data, response->length, 0);
+    if(ret > 0) {
+        response->length = (size_t)ret;
+        return UA_STATUSCODE_GOOD;
+    }
+    ServerNetworkLayerReleaseRecvBuffer(connection, response);
+    if(ret < 0) {
+#ifdef _WIN32
+        const int last_error = WSAGetLastError();
+        if(last_error == WSAEINTR || last_error == WSAEWOULDBLOCK)
+            return UA_STATUSCODE_GOOD; /* retry */
+#else
+        if(errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            return UA_STATUSCODE_GOOD; /* retry */
+#endif
+    }
+    /* the client has closed the connection */
+    socket_close(connection);
+    return UA_STATUSCODE_BADCONNECTIONCLOSED;
+}
+
+
+/* Writes as much as the non-blocking socket takes. Returns the number of
+ * written bytes or -1 if the connection is broken. */
+static ssize_t
+socket_send(UA_Int32 sockfd, const UA_Byte *data, size_t length) {
+    size_t nWritten = 0;
+    while(nWritten < length) {
+#ifdef _WIN32
+        ssize_t n = send((SOCKET)sockfd, (const char*)&data[nWritten], (int)(length - nWritten), 0);
+        if(n < 0) {
+            const int last_error = WSAGetLastError();
+            if(last_error == WSAEINTR)
+                continue;
+            if(last_error == WSAEWOULDBLOCK)
+                break;
+            return -1;
+        }
+#else
+        ssize_t n = send(sockfd, (const char*)&data[nWritten], length - nWritten, MSG_NOSIGNAL);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+#endif
+        nWritten += (size_t)n;
+    }
+    return (ssize_t)nWritten;
+}
+
+/* Call with the send queue locked. Returns false if the connection is broken. */
+static UA_Boolean
+TCPConnection_flushSendQueue(TCPConnection *c) {
+    QueuedSend *qs;
+#ifndef _WIN32
+    /* gather the queued buffers into a single system call */
+    while(!SIMPLEQ_EMPTY(&c->sendQueue)) {
+        struct iovec iov[MAXIOV];
+        size_t iovlen = 0;
+        SIMPLEQ_FOREACH(qs, &c->sendQueue, next) {
+            if(iovlen == MAXIOV)
+                break;
+            iov[iovlen].iov_base = &qs->buf.data[qs->sent];
+            iov[iovlen].iov_len = qs->buf.length - qs->sent;
+            iovlen++;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovlen;
+        ssize_t n = sendmsg(c->connection.sockfd, &msg, MSG_NOSIGNAL);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;
+            return false;
+        }
+        size_t written = (size_t)n;
+        c->sendQueueSize -= written;
+        while((qs = SIMPLEQ_FIRST(&c->sendQueue))) {
+            size_t length = qs->buf.length - qs->sent;
+            if(written < length) {
+                qs->sent += written;
+                return true; /* the socket is full */
+            }
+            written -= length;
+            SIMPLEQ_REMOVE_HEAD(&c->sendQueue, next);
+            c->sendQueueLength--;
+            UA_ByteString_deleteMembers(&qs->buf);
+            free(qs);
+            if(written == 0)
+                break;
+        }
+    }
+#else
+    while((qs = SIMPLEQ_FIRST(&c->sendQueue))) {
+        size_t length = qs->buf.length - qs->sent;
+        ssize_t n = socket_send(c->connection.sockfd, &qs->buf.data[qs->sent], length);
+        if(n < 0)
+            return false;
+        qs->sent += (size_t)n;
+        c->sendQueueSize -= (size_t)n;
+        if((size_t)n < length)
+            return true; /* the socket is full */
+        SIMPLEQ_REMOVE_HEAD(&c->sendQueue, next);
+        c->sendQueueLength--;
+        UA_ByteString_deleteMembers(&qs->buf);
+        free(qs);
+    }
+#endif
+    return true;
+}
+
+/* Call with the send queue locked. With select, the queue size is inspected
+ * before every select call instead. */
+static void
+TCPConnection_watchWritable(TCPConnection *c, UA_Boolean writable) {
+    if(c->watchWritable == writable)
+        return;
+    c->watchWritable = writable;
+#ifdef UA_ENABLE_EPOLL
+    ServerNetworkLayerTCP *layer = c->connection.handle;
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+    if(writable)
+        ev.events |= EPOLLOUT;
+    epoll_ctl(layer->epollfd, EPOLL_CTL_MOD, c->connection.sockfd, &ev);
+#endif
+}
+
+/* Can be called from parallel worker threads */
+static UA_StatusCode
+ServerNetworkLayerTCP_send(UA_Connection *connection, UA_ByteString *buf) {
+    TCPConnection *c = (TCPConnection*)connection;
+    ServerNetworkLayerTCP *layer = connection->handle;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&c->sendQueueLock);
+#endif
+
+    /* collect the messages of the networking thread until the next iteration.
+       worker threads send right away. */
+    UA_Boolean coalesce = layer->tcpConf.coalesceSends;
+#ifdef UA_ENABLE_MULTITHREADING
+    coalesce = coalesce && pthread_equal(pthread_self(), layer->networkThread);
+#endif
+
+    /* do not collect more than a gather write takes. write out the collected
+       messages and send the large ones right away. */
+    if(coalesce && (c->sendQueueLength + 1 >= MAXIOV ||
+                    c->sendQueueSize + buf->length >= MAXCOALESCE)) {
+        if(!TCPConnection_flushSendQueue(c)) {
+            retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+            goto finish;
+        }
+        coalesce = false;
+    }
+
+    /* send right away if nothing is pending */
+    size_t sent = 0;
+    if(!coalesce && SIMPLEQ_EMPTY(&c->sendQueue)) {
+        ssize_t n = socket_send(connection->sockfd, buf->data, buf->length);
+        if(n < 0) {
+            retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+            goto finish;
+        }
+        sent = (size_t)n;
+        if(sent == buf->length)
+            goto finish;
+    }
+
+    /* queue the remainder */
+    if(c->sendQueueSize + buf->length - sent > layer->tcpConf.maxSendQueueSize) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Connection %i exceeds the send queue limit", connection->sockfd);
+        retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+        goto finish;
+    }
+    QueuedSend *qs = malloc(sizeof(QueuedSend));
+    if(!qs) {
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+        goto finish;
+    }
+    if(coalesce) {
+        if(!c->flushPending) {
+            c->flushPending = true;
+            LIST_INSERT_HEAD(&layer->flushConnections, c, flushPointers);
+        }
+    } else
+        TCPConnection_watchWritable(c, true);
+    qs->buf = *buf;
+    qs->sent = sent;
+    SIMPLEQ_INSERT_TAIL(&c->sendQueue, qs, next);
+    c->sendQueueSize += buf->length - sent;
+    c->sendQueueLength++;
+    *buf = UA_BYTESTRING_NULL;
+
+ finish:
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&c->sendQueueLock);
+#endif
     UA_ByteString_deleteMembers(buf);
+    if(retval == UA_STATUSCODE_BADCONNECTIONCLOSED)
+        connection->close(connection);
+    return retval;
 }
 
-/* after every select, we need to reset the sockets we want to listen on */
-static UA_Int32
-setFDSet(ServerNetworkLayerTCP *layer, fd_set *fdset) {
-    FD_ZERO(fdset);
-    UA_fd_set(layer->serversockfd, fdset);
-    UA_Int32 highestfd = layer->serversockfd;
-    for(size_t i = 0; i < layer->mappingsSize; i++) {
-        UA_fd_set(layer->mappings[i].sockfd, fdset);
-        if(layer->mappings[i].sockfd > highestfd)
-            highestfd = layer->mappings[i].sockfd;
+/* Blocks until the send queue is written to the socket or the send timeout
+   is reached. Can be called from parallel worker threads. */
+static UA_StatusCode
+ServerNetworkLayerTCP_waitSendable(UA_Connection *connection) {
+    TCPConnection *c = (TCPConnection*)connection;
+    ServerNetworkLayerTCP *layer = connection->handle;
+    UA_DateTime deadline = UA_DateTime_nowMonotonic() +
+        (UA_DateTime)layer->tcpConf.sendTimeout * UA_MSEC_TO_DATETIME;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&c->sendQueueLock);
+#endif
+    while(true) {
+        if(!TCPConnection_flushSendQueue(c)) {
+            retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+            break;
+        }
+        if(SIMPLEQ_EMPTY(&c->sendQueue)) {
+            TCPConnection_watchWritable(c, false);
+            break;
+        }
+        UA_DateTime remaining = deadline - UA_DateTime_nowMonotonic();
+        if(remaining <= 0) {
+            retval = UA_STATUSCODE_BADTIMEOUT;
+            break;
+        }
+
+        /* the networking thread may flush the queue in the meantime */
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_unlock(&c->sendQueueLock);
+#endif
+        struct timeval tmptv;
+        tmptv.tv_sec = (long int)(remaining / UA_SEC_TO_DATETIME);
+        tmptv.tv_usec = (int)((remaining % UA_SEC_TO_DATETIME) / UA_USEC_TO_DATETIME);
+        fd_set writeset;
+        FD_ZERO(&writeset);
+        UA_fd_set(connection->sockfd, &writeset);
+        select(connection->sockfd+1, NULL, &writeset, NULL, &tmptv);
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_lock(&c->sendQueueLock);
+#endif
     }
-    return highestfd;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&c->sendQueueLock);
+#endif
+    if(retval == UA_STATUSCODE_BADCONNECTIONCLOSED)
+        connection->close(connection);
+    return retval;
+}
+
+/* Sends pending data once the socket is writable. Call only from the
+ * networking thread. */
+static void
+ServerNetworkLayerTCP_flush(TCPConnection *c) {
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&c->sendQueueLock);
+#endif
+    UA_Boolean ok = TCPConnection_flushSendQueue(c);
+    if(ok)
+        TCPConnection_watchWritable(c, !SIMPLEQ_EMPTY(&c->sendQueue));
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&c->sendQueueLock);
+#endif
+    if(!ok)
+        c->connection.close(&c->connection);
+}
+
+static void
+ServerNetworkLayerTCP_freeConnection(UA_Server *server, void *ptr) {
+    TCPConnection *c = ptr;
+    QueuedSend *qs, *qs_tmp;
+    SIMPLEQ_FOREACH_SAFE(qs, &c->sendQueue, next, qs_tmp) {
+        UA_ByteString_deleteMembers(&qs->buf);
+        free(qs);
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&c->sendQueueLock);
+#endif
+    UA_Connection_deleteMembers(&c->connection);
+    free(c);
 }
 
 /* callback triggered from the server */
@@ -299,9 +735,15 @@ ServerNetworkLayerTCP_closeConnection(UA_Connection *connection) {
 /* call only from the single networking thread */
 static UA_StatusCode
 ServerNetworkLayerTCP_add(ServerNetworkLayerTCP *layer, UA_Int32 newsockfd) {
-    UA_Connection *c = malloc(sizeof(UA_Connection));
-    if(!c)
+    TCPConnection *tc = malloc(sizeof(TCPConnection));
+    if(!tc)
         return UA_STATUSCODE_BADINTERNALERROR;
+    SIMPLEQ_INIT(&tc->sendQueue);
+    tc->sendQueueSize = 0;
+    tc->sendQueueLength = 0;
+    tc->watchWritable = false;
+    tc->flushPending = false;
+    UA_Connection *c = &tc->connection;
 
     struct sockaddr_in addr;
     socklen_t addrlen = sizeof(struct sockaddr_in);
@@ -312,25 +754,142 @@ ServerNetworkLayerTCP_add(ServerNetworkLayerTCP *layer, UA_Int32 newsockfd) {
     c->sockfd = newsockfd;
     c->handle = layer;
     c->localConf = layer->conf;
-    c->send = socket_write;
+    c->send = ServerNetworkLayerTCP_send;
+    c->waitSendable = ServerNetworkLayerTCP_waitSendable;
     c->close = ServerNetworkLayerTCP_closeConnection;
     c->getSendBuffer = ServerNetworkLayerGetSendBuffer;
     c->releaseSendBuffer = ServerNetworkLayerReleaseSendBuffer;
     c->releaseRecvBuffer = ServerNetworkLayerReleaseRecvBuffer;
     c->state = UA_CONNECTION_OPENING;
-    struct ConnectionMapping *nm;
-    nm = realloc(layer->mappings, sizeof(struct ConnectionMapping)*(layer->mappingsSize+1));
-    if(!nm) {
-        UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK, "No memory for a new Connection");
-        free(c);
+    if((size_t)newsockfd >= layer->connectionsCapacity) {
+        size_t capacity = layer->connectionsCapacity * 2;
+        if(capacity <= (size_t)newsockfd)
+            capacity = (size_t)newsockfd + 64;
+        UA_Connection **nc = realloc(layer->connections, sizeof(UA_Connection*) * capacity);
+        if(!nc) {
+            UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK, "No memory for a new Connection");
+            free(tc);
+            return UA_STATUSCODE_BADINTERNALERROR;
+        }
+        memset(&nc[layer->connectionsCapacity], 0,
+               sizeof(UA_Connection*) * (capacity - layer->connectionsCapacity));
+        layer->connections = nc;
+        layer->connectionsCapacity = capacity;
+    }
+#ifdef UA_ENABLE_EPOLL
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+    if(epoll_ctl(layer->epollfd, EPOLL_CTL_ADD, newsockfd, &ev) != 0) {
+        UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK,
+                     "Could not register the Connection %i with epoll", newsockfd);
+        free(tc);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
-    layer->mappings = nm;
-    layer->mappings[layer->mappingsSize] = (struct ConnectionMapping){c, newsockfd};
-    layer->mappingsSize++;
+#endif
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&tc->sendQueueLock, NULL);
+#endif
+    layer->connections[newsockfd] = c;
+    layer->connectionsSize++;
     return UA_STATUSCODE_GOOD;
 }
 
+/* Sends the messages that were collected since the last iteration. Call only
+ * from the networking thread. */
+static void
+ServerNetworkLayerTCP_flushCoalesced(ServerNetworkLayerTCP *layer) {
+    TCPConnection *c;
+    while((c = LIST_FIRST(&layer->flushConnections))) {
+        LIST_REMOVE(c, flushPointers);
+        c->flushPending = false;
+        ServerNetworkLayerTCP_flush(c);
+    }
+}
+
+/* call only from the single networking thread */
+static void
+ServerNetworkLayerTCP_remove(ServerNetworkLayerTCP *layer, UA_Connection *c) {
+    TCPConnection *tc = (TCPConnection*)c;
+    if(tc->flushPending) {
+        LIST_REMOVE(tc, flushPointers);
+        tc->flushPending = false;
+    }
+    layer->connections[c->sockfd] = NULL;
+    layer->connectionsSize--;
+}
+
+/* Returns the number of connections that may be accepted now */
+static size_t
+ServerNetworkLayerTCP_acceptBudget(ServerNetworkLayerTCP *layer) {
+    UA_UInt32 rate = layer->tcpConf.maxAcceptRate;
+    if(rate == 0)
+        return (size_t)-1;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    layer->acceptTokens += (UA_Double)(now - layer->acceptRefill) * rate / UA_SEC_TO_DATETIME;
+    if(layer->acceptTokens > rate)
+        layer->acceptTokens = rate;
+    layer->acceptRefill = now;
+    return (size_t)layer->acceptTokens;
+}
+
+/* accept the pending connections from the listening socket */
+static void
+ServerNetworkLayerTCP_accept(ServerNetworkLayerTCP *layer) {
+    size_t budget = ServerNetworkLayerTCP_acceptBudget(layer);
+    size_t accepted = 0;
+    while(accepted < budget) {
+        struct sockaddr_in cli_addr;
+        socklen_t cli_len = sizeof(cli_addr);
+        int newsockfd = accept(layer->serversockfd, (struct sockaddr *) &cli_addr, &cli_len);
+        if(newsockfd < 0)
+            break; /* the backlog is drained */
+        accepted++;
+#if !defined(_WIN32) && !defined(UA_ENABLE_EPOLL)
+        if(newsockfd >= FD_SETSIZE) {
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Connection %i exceeds the sockets that select can handle", newsockfd);
+            CLOSESOCKET(newsockfd);
+            continue;
+        }
+#endif
+        int i = 1;
+        setsockopt(newsockfd, IPPROTO_TCP, TCP_NODELAY, (void *)&i, sizeof(i));
+        socket_set_nonblocking(newsockfd);
+        if(ServerNetworkLayerTCP_add(layer, newsockfd) != UA_STATUSCODE_GOOD)
+            CLOSESOCKET(newsockfd);
+    }
+    if(layer->tcpConf.maxAcceptRate > 0)
+        layer->acceptTokens -= (UA_Double)accepted;
+}
+
+/* Reads from a connection that was reported readable and appends the
+ * resulting jobs. Returns false if the connection was closed from remote and
+ * needs to be removed from the connection table. */
+static UA_Boolean
+ServerNetworkLayerTCP_read(ServerNetworkLayerTCP *layer, UA_Connection *c, UA_Job *js, size_t *j) {
+    UA_ByteString buf = UA_BYTESTRING_NULL;
+    UA_StatusCode retval = ServerNetworkLayerTCP_recv(layer, c, &buf);
+    if(retval == UA_STATUSCODE_GOOD) {
+        if(buf.length == 0)
+            return true; /* retry later */
+        js[*j].job.binaryMessage.connection = c;
+        js[*j].job.binaryMessage.message = buf;
+        js[*j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
+        (*j)++;
+        return true;
+    }
+    if(retval != UA_STATUSCODE_BADCONNECTIONCLOSED)
+        return true;
+    /* the socket was closed from remote */
+    js[*j].type = UA_JOBTYPE_DETACHCONNECTION;
+    js[*j].job.closeConnection = c;
+    (*j)++;
+    js[*j].type = UA_JOBTYPE_METHODCALL_DELAYED;
+    js[*j].job.methodCall.method = ServerNetworkLayerTCP_freeConnection;
+    js[*j].job.methodCall.data = c;
+    (*j)++;
+    return false;
+}
+
 static UA_StatusCode
 ServerNetworkLayerTCP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
     ServerNetworkLayerTCP *layer = nl->handle;
@@ -374,6 +933,20 @@ ServerNetworkLayerTCP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
         CLOSESOCKET(layer->serversockfd);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
+    if(layer->tcpConf.reusePort) {
+#ifdef SO_REUSEPORT
+        if(setsockopt(layer->serversockfd, SOL_SOCKET,
+                      SO_REUSEPORT, (const char *)&optval, sizeof(optval)) == -1) {
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Error during setting of SO_REUSEPORT");
+            CLOSESOCKET(layer->serversockfd);
+            return UA_STATUSCODE_BADINTERNALERROR;
+        }
+#else
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "SO_REUSEPORT is not supported on this platform");
+#endif
+    }
     if(bind(layer->serversockfd, (const struct sockaddr *)&serv_addr,
             sizeof(serv_addr)) < 0) {
         UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error during socket binding");
@@ -381,37 +954,147 @@ ServerNetworkLayerTCP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
         return UA_STATUSCODE_BADINTERNALERROR;
     }
     socket_set_nonblocking(layer->serversockfd);
-    listen(layer->serversockfd, MAXBACKLOG);
+    listen(layer->serversockfd, layer->tcpConf.listenBacklog);
+    layer->acceptTokens = layer->tcpConf.maxAcceptRate;
+    layer->acceptRefill = UA_DateTime_nowMonotonic();
+#ifdef UA_ENABLE_EPOLL
+    layer->epollfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    layer->accepting = true;
+    if(layer->epollfd < 0 ||
+       epoll_ctl(layer->epollfd, EPOLL_CTL_ADD, layer->serversockfd, &ev) != 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error during epoll setup");
+        if(layer->epollfd >= 0)
+            close(layer->epollfd);
+        CLOSESOCKET(layer->serversockfd);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+#endif
     UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "TCP network layer listening on %.*s",
                 nl->discoveryUrl.length, nl->discoveryUrl.data);
     return UA_STATUSCODE_GOOD;
 }
 
+#ifdef UA_ENABLE_EPOLL
+
+static size_t
+ServerNetworkLayerTCP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
+    ServerNetworkLayerTCP *layer = nl->handle;
+#ifdef UA_ENABLE_MULTITHREADING
+    layer->networkThread = pthread_self();
+#endif
+    ServerNetworkLayerTCP_flushCoalesced(layer);
+
+    /* don't wake up for the listening socket while the accept rate is exceeded */
+    UA_Boolean accepting = (ServerNetworkLayerTCP_acceptBudget(layer) > 0);
+    if(accepting != layer->accepting) {
+        struct epoll_event ev = {.events = accepting ? EPOLLIN : 0, .data.ptr = NULL};
+        epoll_ctl(layer->epollfd, EPOLL_CTL_MOD, layer->serversockfd, &ev);
+        layer->accepting = accepting;
+    }
+
+    struct epoll_event events[MAXEPOLLEVENTS];
+    /* the timeout is given in microseconds, epoll takes milliseconds */
+    int resultsize = epoll_wait(layer->epollfd, events, MAXEPOLLEVENTS, (timeout + 999) / 1000);
+    if(resultsize <= 0) {
+        *jobs = NULL;
+        return 0;
+    }
+
+    /* alloc enough space for a cleanup-connection and free-connection job per resulted socket */
+    UA_Job *js = malloc(sizeof(UA_Job) * (size_t)resultsize * 2);
+    if(!js) {
+        *jobs = NULL;
+        return 0;
+    }
+
+    size_t j = 0;
+    for(int i = 0; i < resultsize; i++) {
+        UA_Connection *c = events[i].data.ptr;
+        if(!c) {
+            ServerNetworkLayerTCP_accept(layer);
+            continue;
+        }
+        if(events[i].events & EPOLLOUT)
+            ServerNetworkLayerTCP_flush((TCPConnection*)c);
+        if(!(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+            continue;
+        if(!ServerNetworkLayerTCP_read(layer, c, js, &j))
+            ServerNetworkLayerTCP_remove(layer, c);
+    }
+
+    if(j == 0) {
+        free(js);
+        js = NULL;
+    }
+
+    *jobs = js;
+    return j;
+}
+
+#else
+
+/* after every select, we need to reset the sockets we want to listen on. wait
+   for writability only where data is queued. */
+static UA_Int32
+setFDSet(ServerNetworkLayerTCP *layer, fd_set *fdset, fd_set *writeset, UA_Boolean accepting) {
+    FD_ZERO(fdset);
+    FD_ZERO(writeset);
+    UA_Int32 highestfd = 0;
+    if(accepting) {
+        UA_fd_set(layer->serversockfd, fdset);
+        highestfd = layer->serversockfd;
+    }
+    for(size_t i = 0; i < layer->connectionsCapacity; i++) {
+        TCPConnection *c = (TCPConnection*)layer->connections[i];
+        if(!c)
+            continue;
+        UA_fd_set(c->connection.sockfd, fdset);
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_lock(&c->sendQueueLock);
+#endif
+        if(!SIMPLEQ_EMPTY(&c->sendQueue))
+            UA_fd_set(c->connection.sockfd, writeset);
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_unlock(&c->sendQueueLock);
+#endif
+        if(c->connection.sockfd > highestfd)
+            highestfd = c->connection.sockfd;
+    }
+    return highestfd;
+}
+
 static size_t
 ServerNetworkLayerTCP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
     ServerNetworkLayerTCP *layer = nl->handle;
-    fd_set fdset;
-    UA_Int32 highestfd = setFDSet(layer, &fdset);
+#ifdef UA_ENABLE_MULTITHREADING
+    layer->networkThread = pthread_self();
+#endif
+    ServerNetworkLayerTCP_flushCoalesced(layer);
+    fd_set fdset, writeset;
+    /* don't wake up for the listening socket while the accept rate is exceeded */
+    UA_Boolean accepting = (ServerNetworkLayerTCP_acceptBudget(layer) > 0);
+    UA_Int32 highestfd = setFDSet(layer, &fdset, &writeset, accepting);
     struct timeval tmptv = {0, timeout};
     UA_Int32 resultsize;
-    resultsize = select(highestfd+1, &fdset, NULL, NULL, &tmptv);
+    resultsize = select(highestfd+1, &fdset, &writeset, NULL, &tmptv);
     if(resultsize < 0) {
         *jobs = NULL;
         return 0;
     }
 
-    /* accept new connections (can only be a single one) */
-    if(UA_fd_isset(layer->serversockfd, &fdset)) {
+    /* send queued data */
+    for(UA_Int32 fd = 0; fd <= highestfd; fd++) {
+        if(!UA_fd_isset(fd, &writeset))
+            continue;
         resultsize--;
-        struct sockaddr_in cli_addr;
-        socklen_t cli_len = sizeof(cli_addr);
-        int newsockfd = accept(layer->serversockfd, (struct sockaddr *) &cli_addr, &cli_len);
-        int i = 1;
-        setsockopt(newsockfd, IPPROTO_TCP, TCP_NODELAY, (void *)&i, sizeof(i));
-        if(newsockfd >= 0) {
-            socket_set_nonblocking(newsockfd);
-            ServerNetworkLayerTCP_add(layer, newsockfd);
-        }
+        ServerNetworkLayerTCP_flush((TCPConnection*)layer->connections[fd]);
+    }
+
+    /* accept new connections */
+    if(accepting && UA_fd_isset(layer->serversockfd, &fdset)) {
+        resultsize--;
+        ServerNetworkLayerTCP_accept(layer);
     }
 
     /* alloc enough space for a cleanup-connection and free-connection job per resulted socket */
@@ -421,31 +1104,15 @@ ServerNetworkLayerTCP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt1
     if(!js)
         return 0;
 
-    /* read from established sockets */
+    /* read from established sockets. connections accepted in this iteration
+       are not in the fdset. */
     size_t j = 0;
-    UA_ByteString buf = UA_BYTESTRING_NULL;
-    for(size_t i = 0; i < layer->mappingsSize && j < (size_t)resultsize; i++) {
-        if(!UA_fd_isset(layer->mappings[i].sockfd, &fdset))
+    for(UA_Int32 fd = 0; fd <= highestfd && j < (size_t)resultsize; fd++) {
+        if(fd == layer->serversockfd || !UA_fd_isset(fd, &fdset))
             continue;
-        UA_StatusCode retval = socket_recv(layer->mappings[i].connection, &buf, 0);
-        if(retval == UA_STATUSCODE_GOOD) {
-            js[j].job.binaryMessage.connection = layer->mappings[i].connection;
-            js[j].job.binaryMessage.message = buf;
-            js[j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
-            j++;
-        } else if (retval == UA_STATUSCODE_BADCONNECTIONCLOSED) {
-            UA_Connection *c = layer->mappings[i].connection;
-            /* the socket was closed from remote */
-            js[j].type = UA_JOBTYPE_DETACHCONNECTION;
-            js[j].job.closeConnection = layer->mappings[i].connection;
-            layer->mappings[i] = layer->mappings[layer->mappingsSize-1];
-            layer->mappingsSize--;
-            j++;
-            js[j].type = UA_JOBTYPE_METHODCALL_DELAYED;
-            js[j].job.methodCall.method = FreeConnectionCallback;
-            js[j].job.methodCall.data = c;
-            j++;
-        }
+        UA_Connection *c = layer->connections[fd];
+        if(!ServerNetworkLayerTCP_read(layer, c, js, &j))
+            ServerNetworkLayerTCP_remove(layer, c);
     }
 
     if(j == 0) {
@@ -457,41 +1124,64 @@ ServerNetworkLayerTCP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt1
     return j;
 }
 
+#endif
+
 static size_t
 ServerNetworkLayerTCP_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
     ServerNetworkLayerTCP *layer = nl->handle;
     UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
-                "Shutting down the TCP network layer with %d open connection(s)", layer->mappingsSize);
+                "Shutting down the TCP network layer with %d open connection(s)",
+                (int)layer->connectionsSize);
+    ServerNetworkLayerTCP_flushCoalesced(layer);
     shutdown(layer->serversockfd,2);
     CLOSESOCKET(layer->serversockfd);
-    UA_Job *items = malloc(sizeof(UA_Job) * layer->mappingsSize * 2);
+#ifdef UA_ENABLE_EPOLL
+    close(layer->epollfd);
+#endif
+    UA_Job *items = malloc(sizeof(UA_Job) * layer->connectionsSize * 2);
     if(!items)
         return 0;
-    for(size_t i = 0; i < layer->mappingsSize; i++) {
-        socket_close(layer->mappings[i].connection);
-        items[i*2].type = UA_JOBTYPE_DETACHCONNECTION;
-        items[i*2].job.closeConnection = layer->mappings[i].connection;
-        items[(i*2)+1].type = UA_JOBTYPE_METHODCALL_DELAYED;
-        items[(i*2)+1].job.methodCall.method = FreeConnectionCallback;
-        items[(i*2)+1].job.methodCall.data = layer->mappings[i].connection;
+    size_t j = 0;
+    for(size_t i = 0; i < layer->connectionsCapacity; i++) {
+        UA_Connection *c = layer->connections[i];
+        if(!c)
+            continue;
+        socket_close(c);
+        items[j].type = UA_JOBTYPE_DETACHCONNECTION;
+        items[j].job.closeConnection = c;
+        items[j+1].type = UA_JOBTYPE_METHODCALL_DELAYED;
+        items[j+1].job.methodCall.method = ServerNetworkLayerTCP_freeConnection;
+        items[j+1].job.methodCall.data = c;
+        layer->connections[i] = NULL;
+        j += 2;
     }
+    layer->connectionsSize = 0;
 #ifdef _WIN32
     WSACleanup();
 #endif
     *jobs = items;
-    return layer->mappingsSize*2;
+    return j;
 }
 
 /* run only when the server is stopped */
 static void ServerNetworkLayerTCP_deleteMembers(UA_ServerNetworkLayer *nl) {
     ServerNetworkLayerTCP *layer = nl->handle;
-    free(layer->mappings);
+    free(layer->connections);
+    while(layer->recvBuffers) {
+        RecvBuffer *rb = layer->recvBuffers;
+        layer->recvBuffers = rb->next;
+        free(rb);
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&layer->recvBuffersLock);
+#endif
     free(layer);
     UA_String_deleteMembers(&nl->discoveryUrl);
 }
 
 UA_ServerNetworkLayer
-UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port) {
+UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig conf, UA_UInt16 port,
+                                   const UA_ServerNetworkLayerTCPConfig *tcpConf) {
 #ifdef _WIN32
     WORD wVersionRequested;
     WSADATA wsaData;
@@ -506,7 +1196,13 @@ UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port) {
         return nl;
     
     layer->conf = conf;
+    layer->tcpConf = *tcpConf;
     layer->port = port;
+    LIST_INIT(&layer->flushConnections);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&layer->recvBuffersLock, NULL);
+    layer->networkThread = pthread_self();
+#endif
 
     nl.handle = layer;
     nl.start = ServerNetworkLayerTCP_start;
@@ -516,6 +1212,11 @@ UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port) {
     return nl;
 }
 
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port) {
+    return UA_ServerNetworkLayerTCPWithConfig(conf, port, &UA_ServerNetworkLayerTCPConfig_standard);
+}
+
 /***************************/
 /* Client NetworkLayer TCP */
 /***************************/
@@ -13,10 +13,61 @@ extern "C" {
 #include "ua_server.h"
 #include "ua_client.h"
 
+/** @brief Additional settings of the TCP server networklayer */
+typedef struct {
+    /* Maximum number of receive buffers (of size conf.recvBufferSize) that are
+     * kept for reuse. Set to zero to free every buffer after use. */
+    size_t recvBufferPoolSize;
+
+    /* Maximum number of bytes that are queued per connection when the client
+     * does not read fast enough. The connection is closed when the limit is
+     * exceeded. */
+    size_t maxSendQueueSize;
+
+    /* Set SO_REUSEPORT on the listening socket. Several networklayers can then
+     * listen on the same port and the kernel distributes the incoming
+     * connections among them. Use together with the networkLayerThreads option
+     * of the server to process each networklayer in its own thread. */
+    UA_Boolean reusePort;
+
+    /* Length of the queue of pending connections on the listening socket (the
+     * backlog argument of listen). Raise it when many clients (re)connect at
+     * the same time. */
+    UA_Int32 listenBacklog;
+
+    /* Maximum number of connections accepted per second (with bursts of up to
+     * one second's worth). Further connections wait in the backlog. Set to zero
+     * to accept all pending connections right away. */
+    UA_UInt32 maxAcceptRate;
+
+    /* Collect the messages that are sent while the jobs of an iteration are
+     * processed and write them with a single gather write per connection at
+     * the beginning of the next iteration. Saves system calls and packets for
+     * clients that pipeline requests. With multithreading, only the messages
+     * sent from the networking thread are collected. The collected messages
+     * count against maxSendQueueSize. They are written right away once they
+     * fill a gather write (64 buffers or 64 KiB), so responses larger than
+     * maxSendQueueSize are not held back until the queue limit is hit. */
+    UA_Boolean coalesceSends;
+
+    /* The chunks of a large response are written one after the other. The
+     * sending thread blocks while the client does not read, for at most this
+     * many milliseconds per chunk. On timeout, the response is aborted and the
+     * client receives an abort chunk. */
+    UA_UInt32 sendTimeout;
+} UA_ServerNetworkLayerTCPConfig;
+
+extern UA_EXPORT const UA_ServerNetworkLayerTCPConfig UA_ServerNetworkLayerTCPConfig_standard;
+
 /** @brief Create the TCP networklayer and listen to the specified port */
 UA_ServerNetworkLayer UA_EXPORT
 UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port);
 
+/** @brief Create the TCP networklayer with additional settings */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig conf, UA_UInt16 port,
+                                   const UA_ServerNetworkLayerTCPConfig *tcpConf);
+
 UA_Connection UA_EXPORT
 UA_ClientConnectionTCP(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger);
 
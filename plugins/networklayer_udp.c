@@ -3,38 +3,56 @@
  * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
  */
 
-#define _XOPEN_SOURCE 500 //some users need this for some reason
-#define __USE_BSD
+#define _GNU_SOURCE // recvmmsg, sendmmsg
+#include "networklayer_udp.h" // before the libc headers that redefine the endianness macros
+#include "queue.h"
 #include <stdlib.h> // malloc, free
 #include <stdio.h>
 #include <string.h> // memset
-#include "networklayer_udp.h"
 #ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
 # include <urcu/uatomic.h>
 #endif
 
 /* with a space so amalgamation does not remove the includes */
 # include <errno.h> // errno, EINTR
 # include <fcntl.h> // fcntl
-# include <strings.h> //bzero
-# include <sys/select.h> 
+# include <sys/select.h>
+# include <sys/socket.h>
 # include <netinet/in.h>
-# include <netinet/tcp.h>
-# include <sys/socketvar.h>
-# include <sys/ioctl.h>
 # include <unistd.h> // read, write, close
 # include <arpa/inet.h>
-#ifdef __QNX__
-#include <sys/socket.h>
-#endif
 # define CLOSESOCKET(S) close(S)
 
-#define MAXBACKLOG 100
-
 #ifdef _WIN32
 # error udp not yet implemented for windows
 #endif
 
+/**
+ * Receiving: The datagrams are read with recvmmsg into a ring of preallocated buffers (of size
+ * recvBufferSize). The server gets the buffers without a copy and hands them back in the
+ * releaseRecvBuffer callback. When all buffers are in use, the datagrams wait in the socket until
+ * some are released.
+ *
+ * Peers: The connection of a peer is looked up in a hash table by its address and reused for all
+ * of its datagrams. The connections are also kept in least-recently-used order. Connections that
+ * were idle for UDPPEERTIMEOUT, or the oldest connection when there are more than UDPMAXPEERS, are
+ * detached from the server and freed (delayed). So are connections that the server has closed,
+ * once the next datagram of the peer arrives.
+ *
+ * Sending: Replies are collected and sent with a single sendmmsg at the beginning of the next
+ * "GetWork" (or earlier, when UDPSENDBATCH replies are waiting). With multithreading, replies from
+ * the worker threads are sent right away, as the networking thread might wait in "GetWork".
+ */
+
+#define UDPRECVBUFFERS 64 /* buffers in the receive ring */
+#define UDPRECVBATCH 32 /* datagrams received per recvmmsg call */
+#define UDPSENDBATCH 64 /* replies sent per sendmmsg call */
+#define UDPPEERBUCKETS 256 /* buckets of the peer hash table, a power of two */
+#define UDPMAXPEERS 1024
+#define UDPPEERTIMEOUT (60 * UA_SEC_TO_DATETIME)
+#define UDPSWEEPMAX 16 /* idle connections removed per "GetWork" */
+
 /*****************************/
 /* Generic Buffer Management */
 /*****************************/
@@ -42,7 +60,7 @@
 static UA_StatusCode GetMallocedBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
     if(length > connection->remoteConf.recvBufferSize)
         return UA_STATUSCODE_BADCOMMUNICATIONERROR;
-    return UA_ByteString_newMembers(buf, connection->remoteConf.recvBufferSize);
+    return UA_ByteString_allocBuffer(buf, length);
 }
 
 static void ReleaseMallocedBuffer(UA_Connection *connection, UA_ByteString *buf) {
@@ -55,52 +73,117 @@ static void ReleaseMallocedBuffer(UA_Connection *connection, UA_ByteString *buf)
 
 /* Forwarded to the server as a (UA_Connection) and used for callbacks back into
    the networklayer */
-typedef struct {
-	UA_Connection connection;
-	struct sockaddr from;
-	socklen_t fromlen;
+typedef struct UDPConnection {
+    UA_Connection connection;
+    struct sockaddr_in from;
+    UA_DateTime lastSeen;
+    LIST_ENTRY(UDPConnection) hashPointers;
+    TAILQ_ENTRY(UDPConnection) lruPointers;
 } UDPConnection;
 
 typedef struct {
-    UA_ServerNetworkLayer layer;
-	UA_ConnectionConfig conf;
-	fd_set fdset;
-	UA_Int32 serversockfd;
-    UA_UInt32 port;
-} ServerNetworkLayerUDP;
+    UA_ConnectionConfig conf;
+    UA_UInt16 port;
+    UA_Logger logger; // Set during start
+    UA_Int32 serversockfd;
 
-/** Accesses only the sockfd in the handle. Can be run from parallel threads. */
-static UA_StatusCode sendUDP(UA_Connection *connection, UA_ByteString *buf) {
-    UDPConnection *udpc = (UDPConnection*)connection;
-    ServerNetworkLayerUDP *layer = (ServerNetworkLayerUDP*)connection->handle;
-	size_t nWritten = 0;
-	struct sockaddr_in *sin = NULL;
+    /* ring of receive buffers. the indices of the free buffers are on a stack. */
+    UA_Byte *recvBuffers;
+    UA_UInt16 freeBuffers[UDPRECVBUFFERS];
+    size_t freeBuffersSize;
 
-	if (udpc->from.sa_family == AF_INET) {
-#if ((__GNUC__ == 4 && __GNUC_MINOR__ >= 6) || __GNUC__ > 4 || defined(__clang__))
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-align"
+    /* connections by peer address and in least-recently-used order */
+    LIST_HEAD(, UDPConnection) peers[UDPPEERBUCKETS];
+    TAILQ_HEAD(, UDPConnection) lru;
+    size_t peersSize;
+
+    /* replies waiting for sendmmsg */
+    struct UDPSend {
+        UA_ByteString buf;
+        struct sockaddr_in to;
+    } sends[UDPSENDBATCH];
+    size_t sendsSize;
+
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t lock; /* free buffers and the send batch */
+    pthread_t networkThread;
 #endif
-	    sin = (struct sockaddr_in *) &udpc->from;
-#if ((__GNUC__ == 4 && __GNUC_MINOR__ >= 6) || __GNUC__ > 4 || defined(__clang__))
-#pragma GCC diagnostic pop
+} ServerNetworkLayerUDP;
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define UDP_LOCK(layer) pthread_mutex_lock(&(layer)->lock)
+# define UDP_UNLOCK(layer) pthread_mutex_unlock(&(layer)->lock)
+#else
+# define UDP_LOCK(layer)
+# define UDP_UNLOCK(layer)
 #endif
-	} else {
-        UA_ByteString_deleteMembers(buf);
-		return UA_STATUSCODE_BADINTERNALERROR;
+
+static void ReleaseRingBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    if(!buf->data)
+        return;
+    ServerNetworkLayerUDP *layer = connection->handle;
+    size_t index = (size_t)(buf->data - layer->recvBuffers) / layer->conf.recvBufferSize;
+    buf->data = NULL;
+    buf->length = 0;
+    UDP_LOCK(layer);
+    layer->freeBuffers[layer->freeBuffersSize++] = (UA_UInt16)index;
+    UDP_UNLOCK(layer);
+}
+
+/* Sends the collected replies. Call with the lock held. */
+static void flushSends(ServerNetworkLayerUDP *layer) {
+    struct mmsghdr msgs[UDPSENDBATCH];
+    struct iovec iovs[UDPSENDBATCH];
+    memset(msgs, 0, sizeof(struct mmsghdr) * layer->sendsSize);
+    for(size_t i = 0; i < layer->sendsSize; i++) {
+        iovs[i].iov_base = layer->sends[i].buf.data;
+        iovs[i].iov_len = layer->sends[i].buf.length;
+        msgs[i].msg_hdr.msg_name = &layer->sends[i].to;
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
     }
+    size_t sent = 0;
+    while(sent < layer->sendsSize) {
+        int n = sendmmsg(layer->serversockfd, &msgs[sent], (unsigned int)(layer->sendsSize - sent), 0);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            /* skip the datagram that failed */
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "UDP send error %i", errno);
+            n = 1;
+        }
+        sent += (size_t)n;
+    }
+    for(size_t i = 0; i < layer->sendsSize; i++)
+        UA_ByteString_deleteMembers(&layer->sends[i].buf);
+    layer->sendsSize = 0;
+}
 
-	while (nWritten < (size_t)buf->length) {
-		UA_Int32 n = sendto(layer->serversockfd, buf->data, buf->length, 0,
-                            (struct sockaddr*)sin, sizeof(struct sockaddr_in));
-        if(n == -1L) {
-            UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "UDP send error %i", errno);
-            UA_ByteString_deleteMembers(buf);
+static UA_StatusCode sendUDP(UA_Connection *connection, UA_ByteString *buf) {
+    UDPConnection *udpc = (UDPConnection*)connection;
+    ServerNetworkLayerUDP *layer = (ServerNetworkLayerUDP*)connection->handle;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* the networking thread might wait in GetWork. send right away. */
+    if(!pthread_equal(pthread_self(), layer->networkThread)) {
+        ssize_t n = sendto(layer->serversockfd, buf->data, buf->length, 0,
+                           (struct sockaddr*)&udpc->from, sizeof(struct sockaddr_in));
+        UA_ByteString_deleteMembers(buf);
+        if(n < 0) {
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "UDP send error %i", errno);
             return UA_STATUSCODE_BADINTERNALERROR;
         }
-        nWritten += n;
-	}
-    UA_ByteString_deleteMembers(buf);
+        return UA_STATUSCODE_GOOD;
+    }
+#endif
+    UDP_LOCK(layer);
+    if(layer->sendsSize == UDPSENDBATCH)
+        flushSends(layer);
+    layer->sends[layer->sendsSize].buf = *buf;
+    layer->sends[layer->sendsSize].to = udpc->from;
+    layer->sendsSize++;
+    UDP_UNLOCK(layer);
+    UA_ByteString_init(buf);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -111,121 +194,263 @@ static UA_StatusCode socket_set_nonblocking(UA_Int32 sockfd) {
     return UA_STATUSCODE_GOOD;
 }
 
-static void setFDSet(ServerNetworkLayerUDP *layer) {
-	FD_ZERO(&layer->fdset);
-	FD_SET(layer->serversockfd, &layer->fdset);
+/* The connection is removed from the peers when the next datagram arrives or
+   when it times out */
+static void closeConnectionUDP(UA_Connection *connection) {
+#ifdef UA_ENABLE_MULTITHREADING
+    uatomic_set(&connection->state, UA_CONNECTION_CLOSED);
+#else
+    connection->state = UA_CONNECTION_CLOSED;
+#endif
+}
+
+static void freeConnectionUDP(UA_Server *server, void *ptr) {
+    UA_Connection_deleteMembers((UA_Connection*)ptr);
+    free(ptr);
+}
+
+static size_t peerHash(const struct sockaddr_in *addr) {
+    UA_UInt32 h = (UA_UInt32)addr->sin_addr.s_addr * 2654435761u;
+    h ^= (UA_UInt32)addr->sin_port * 40503u;
+    return (h ^ (h >> 16)) & (UDPPEERBUCKETS - 1);
+}
+
+/* Detaches the connection from the server and frees it (delayed) */
+static void removePeer(ServerNetworkLayerUDP *layer, UDPConnection *c, UA_Job *js, size_t *j) {
+    LIST_REMOVE(c, hashPointers);
+    TAILQ_REMOVE(&layer->lru, c, lruPointers);
+    layer->peersSize--;
+    c->connection.state = UA_CONNECTION_CLOSED;
+    js[*j].type = UA_JOBTYPE_DETACHCONNECTION;
+    js[*j].job.closeConnection = &c->connection;
+    js[*j+1].type = UA_JOBTYPE_METHODCALL_DELAYED;
+    js[*j+1].job.methodCall.method = freeConnectionUDP;
+    js[*j+1].job.methodCall.data = c;
+    *j += 2;
 }
 
-static void closeConnectionUDP(UA_Connection *handle) {
-	free(handle);
+/* Returns the connection of the peer. Creates a new connection if required.
+   Adds at most two jobs to remove an old connection. */
+static UDPConnection *
+getPeer(ServerNetworkLayerUDP *layer, const struct sockaddr_in *from, UA_DateTime now,
+        UA_Job *js, size_t *j) {
+    size_t bucket = peerHash(from);
+    UDPConnection *c;
+    LIST_FOREACH(c, &layer->peers[bucket], hashPointers) {
+        if(c->from.sin_addr.s_addr == from->sin_addr.s_addr && c->from.sin_port == from->sin_port)
+            break;
+    }
+    if(c) {
+        if(c->connection.state != UA_CONNECTION_CLOSED) {
+            c->lastSeen = now;
+            TAILQ_REMOVE(&layer->lru, c, lruPointers);
+            TAILQ_INSERT_TAIL(&layer->lru, c, lruPointers);
+            return c;
+        }
+        /* closed by the server. start over. */
+        removePeer(layer, c, js, j);
+    } else if(layer->peersSize >= UDPMAXPEERS) {
+        removePeer(layer, TAILQ_FIRST(&layer->lru), js, j);
+    }
+
+    c = malloc(sizeof(UDPConnection));
+    if(!c)
+        return NULL;
+    UA_Connection_init(&c->connection);
+    c->from = *from;
+    c->lastSeen = now;
+    c->connection.getSendBuffer = GetMallocedBuffer;
+    c->connection.releaseSendBuffer = ReleaseMallocedBuffer;
+    c->connection.releaseRecvBuffer = ReleaseRingBuffer;
+    c->connection.handle = layer;
+    c->connection.send = sendUDP;
+    c->connection.close = closeConnectionUDP;
+    c->connection.localConf = layer->conf;
+    c->connection.state = UA_CONNECTION_OPENING;
+    LIST_INSERT_HEAD(&layer->peers[bucket], c, hashPointers);
+    TAILQ_INSERT_TAIL(&layer->lru, c, lruPointers);
+    layer->peersSize++;
+    return c;
 }
 
-static UA_StatusCode ServerNetworkLayerUDP_start(ServerNetworkLayerUDP *layer, UA_Logger logger) {
-    layer->layer.logger = logger;
+static UA_StatusCode ServerNetworkLayerUDP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    layer->logger = logger;
+    layer->recvBuffers = malloc((size_t)UDPRECVBUFFERS * layer->conf.recvBufferSize);
+    if(!layer->recvBuffers)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(UA_UInt16 i = 0; i < UDPRECVBUFFERS; i++)
+        layer->freeBuffers[i] = i;
+    layer->freeBuffersSize = UDPRECVBUFFERS;
+
     layer->serversockfd = socket(PF_INET, SOCK_DGRAM, 0);
     if(layer->serversockfd < 0) {
-		UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "Error opening socket");
-		return UA_STATUSCODE_BADINTERNALERROR;
-	} 
-	const struct sockaddr_in serv_addr =
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error opening socket");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    const struct sockaddr_in serv_addr =
         {.sin_family = AF_INET, .sin_addr.s_addr = INADDR_ANY,
          .sin_port = htons(layer->port), .sin_zero = {0}};
-	int optval = 1;
-	if(setsockopt(layer->serversockfd, SOL_SOCKET,
+    int optval = 1;
+    if(setsockopt(layer->serversockfd, SOL_SOCKET,
                   SO_REUSEADDR, (const char *)&optval, sizeof(optval)) == -1) {
-        UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "Could not setsockopt");
-		CLOSESOCKET(layer->serversockfd);
-		return UA_STATUSCODE_BADINTERNALERROR;
-	}
-	if(bind(layer->serversockfd, (const struct sockaddr *)&serv_addr,
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Could not setsockopt");
+        CLOSESOCKET(layer->serversockfd);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    if(bind(layer->serversockfd, (const struct sockaddr *)&serv_addr,
             sizeof(serv_addr)) < 0) {
-        UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "Could not bind the socket");
-		CLOSESOCKET(layer->serversockfd);
-		return UA_STATUSCODE_BADINTERNALERROR;
-	}
-	socket_set_nonblocking(layer->serversockfd);
-    UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "Listening for UDP connections on %s:%d",
-                   inet_ntoa(serv_addr.sin_addr), ntohs(serv_addr.sin_port));
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Could not bind the socket");
+        CLOSESOCKET(layer->serversockfd);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    socket_set_nonblocking(layer->serversockfd);
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Listening for UDP connections on %s:%d",
+                inet_ntoa(serv_addr.sin_addr), ntohs(serv_addr.sin_port));
     return UA_STATUSCODE_GOOD;
 }
 
-static size_t ServerNetworkLayerUDP_getJobs(ServerNetworkLayerUDP *layer, UA_Job **jobs, UA_UInt16 timeout) {
-    UA_Job *items = NULL;
-    setFDSet(layer);
-    struct timeval tmptv = {0, timeout};
-    UA_Int32 resultsize = select(layer->serversockfd+1, &layer->fdset, NULL, NULL, &tmptv);
-    if(resultsize <= 0 || !FD_ISSET(layer->serversockfd, &layer->fdset)) {
-        *jobs = items;
+static size_t ServerNetworkLayerUDP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    *jobs = NULL;
+
+    /* a datagram can remove a connection and adds a message */
+    UA_Job *items = malloc(sizeof(UA_Job) * (UDPSWEEPMAX * 2 + UDPRECVBATCH * 3));
+    if(!items)
         return 0;
-    }
-    items = malloc(sizeof(UA_Job)*resultsize);
-	// read from established sockets
-    UA_Int32 j = 0;
-	UA_ByteString buf = {-1, NULL};
-    if(!buf.data) {
-        buf.data = malloc(sizeof(UA_Byte) * layer->conf.recvBufferSize);
-        if(!buf.data)
-            UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "malloc failed");
-    }
-    struct sockaddr sender;
-    socklen_t sendsize = sizeof(sender);
-    bzero(&sender, sizeof(sender));
-    buf.length = recvfrom(layer->serversockfd, buf.data, layer->conf.recvBufferSize, 0, &sender, &sendsize);
-    if (buf.length <= 0) {
-    } else {
-        UDPConnection *c = malloc(sizeof(UDPConnection));
-        if(!c){
-       	    free(items);
-            return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* send the replies from the last iteration and take the free buffers */
+    UA_UInt16 indices[UDPRECVBATCH];
+    size_t batch = 0;
+    UDP_LOCK(layer);
+#ifdef UA_ENABLE_MULTITHREADING
+    layer->networkThread = pthread_self();
+#endif
+    if(layer->sendsSize > 0)
+        flushSends(layer);
+    while(batch < UDPRECVBATCH && layer->freeBuffersSize > 0)
+        indices[batch++] = layer->freeBuffers[--layer->freeBuffersSize];
+    UDP_UNLOCK(layer);
+
+    size_t j = 0;
+
+    /* remove idle connections */
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UDPConnection *c;
+    while(j < UDPSWEEPMAX * 2 && (c = TAILQ_FIRST(&layer->lru)) &&
+          now - c->lastSeen > UDPPEERTIMEOUT)
+        removePeer(layer, c, items, &j);
+
+    /* wait for datagrams. don't wait when all buffers are in use. */
+    size_t received = 0;
+    struct mmsghdr msgs[UDPRECVBATCH];
+    struct iovec iovs[UDPRECVBATCH];
+    struct sockaddr_in senders[UDPRECVBATCH];
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(layer->serversockfd, &fdset);
+    struct timeval tmptv = {0, (batch > 0 && j == 0) ? timeout : 0};
+    if(select(layer->serversockfd+1, &fdset, NULL, NULL, &tmptv) > 0 && batch > 0) {
+        memset(msgs, 0, sizeof(struct mmsghdr) * batch);
+        for(size_t i = 0; i < batch; i++) {
+            iovs[i].iov_base = &layer->recvBuffers[(size_t)indices[i] * layer->conf.recvBufferSize];
+            iovs[i].iov_len = layer->conf.recvBufferSize;
+            msgs[i].msg_hdr.msg_name = &senders[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
         }
-        UA_Connection_init(&c->connection);
-        c->from = sender;
-        c->fromlen = sendsize;
-        // c->sockfd = newsockfd;
-        c->connection.getSendBuffer = GetMallocedBuffer;
-        c->connection.releaseSendBuffer = ReleaseMallocedBuffer;
-        c->connection.releaseRecvBuffer = ReleaseMallocedBuffer;
-        c->connection.handle = layer;
-        c->connection.send = sendUDP;
-        c->connection.close = closeConnectionUDP;
-        c->connection.localConf = layer->conf;
-        c->connection.state = UA_CONNECTION_OPENING;
+        int n = recvmmsg(layer->serversockfd, msgs, (unsigned int)batch, MSG_DONTWAIT, NULL);
+        if(n > 0)
+            received = (size_t)n;
+    }
 
+    for(size_t i = 0; i < received; i++) {
+        UA_ByteString buf = {msgs[i].msg_len, iovs[i].iov_base};
+        if(buf.length == 0 || senders[i].sin_family != AF_INET ||
+           !(c = getPeer(layer, &senders[i], now, items, &j))) {
+            indices[i] = UA_UINT16_MAX; /* give back below */
+            continue;
+        }
         items[j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
         items[j].job.binaryMessage.message = buf;
-        items[j].job.binaryMessage.connection = (UA_Connection*)c;
-        buf.data = NULL;
+        items[j].job.binaryMessage.connection = &c->connection;
         j++;
     }
-    if(buf.data)
-        free(buf.data);
+
+    /* give back the unused buffers */
+    UDP_LOCK(layer);
+    for(size_t i = 0; i < batch; i++) {
+        if(i >= received || indices[i] == UA_UINT16_MAX)
+            layer->freeBuffers[layer->freeBuffersSize++] = indices[i];
+    }
+    UDP_UNLOCK(layer);
+
     if(j == 0) {
         free(items);
-        *jobs = NULL;
-    } else
-        *jobs = items;
+        return 0;
+    }
+    *jobs = items;
     return j;
 }
 
-static UA_Int32 ServerNetworkLayerUDP_stop(ServerNetworkLayerUDP * layer, UA_Job **jobs) {
-	CLOSESOCKET(layer->serversockfd);
-	return 0;
+static size_t ServerNetworkLayerUDP_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    UDP_LOCK(layer);
+    flushSends(layer);
+    UDP_UNLOCK(layer);
+    CLOSESOCKET(layer->serversockfd);
+
+    *jobs = NULL;
+    if(layer->peersSize == 0)
+        return 0;
+    UA_Job *items = malloc(sizeof(UA_Job) * layer->peersSize * 2);
+    if(!items)
+        return 0;
+    size_t j = 0;
+    UDPConnection *c;
+    while((c = TAILQ_FIRST(&layer->lru)))
+        removePeer(layer, c, items, &j);
+    *jobs = items;
+    return j;
 }
 
-static void ServerNetworkLayerUDP_deleteMembers(ServerNetworkLayerUDP *layer) {
+/* run only when the server is stopped */
+static void ServerNetworkLayerUDP_deleteMembers(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    for(size_t i = 0; i < layer->sendsSize; i++)
+        UA_ByteString_deleteMembers(&layer->sends[i].buf);
+    free(layer->recvBuffers);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&layer->lock);
+#endif
+    free(layer);
+    UA_String_deleteMembers(&nl->discoveryUrl);
 }
 
-UA_ServerNetworkLayer * ServerNetworkLayerUDP_new(UA_ConnectionConfig conf, UA_UInt32 port) {
+UA_ServerNetworkLayer UA_ServerNetworkLayerUDP(UA_ConnectionConfig conf, UA_UInt16 port) {
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
     ServerNetworkLayerUDP *layer = malloc(sizeof(ServerNetworkLayerUDP));
     if(!layer)
-        return NULL;
+        return nl;
     memset(layer, 0, sizeof(ServerNetworkLayerUDP));
 
-	layer->conf = conf;
+    layer->conf = conf;
     layer->port = port;
-    layer->layer.start = (UA_StatusCode(*)(UA_ServerNetworkLayer*,UA_Logger))ServerNetworkLayerUDP_start;
-    layer->layer.getJobs = (size_t(*)(UA_ServerNetworkLayer*,UA_Job**,UA_UInt16))ServerNetworkLayerUDP_getJobs;
-    layer->layer.stop = (size_t(*)(UA_ServerNetworkLayer*, UA_Job**))ServerNetworkLayerUDP_stop;
-    layer->layer.deleteMembers = (void(*)(UA_ServerNetworkLayer*))ServerNetworkLayerUDP_deleteMembers;
-    return &layer->layer;
+    layer->serversockfd = -1;
+    for(size_t i = 0; i < UDPPEERBUCKETS; i++)
+        LIST_INIT(&layer->peers[i]);
+    TAILQ_INIT(&layer->lru);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&layer->lock, NULL);
+    layer->networkThread = pthread_self();
+#endif
+
+    nl.handle = layer;
+    nl.start = ServerNetworkLayerUDP_start;
+    nl.getJobs = ServerNetworkLayerUDP_getJobs;
+    nl.stop = ServerNetworkLayerUDP_stop;
+    nl.deleteMembers = ServerNetworkLayerUDP_deleteMembers;
+    return nl;
 }
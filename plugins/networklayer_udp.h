@@ -13,8 +13,11 @@ extern "C" {
 #include "ua_server.h"
 #include "ua_client.h"
 
-/** @brief Create the UDP networklayer and listen to the specified port */
-UA_ServerNetworkLayer UA_EXPORT * ServerNetworkLayerUDP_new(UA_ConnectionConfig conf, UA_UInt32 port);
+/** @brief Create the UDP networklayer and listen to the specified port. The
+ * datagrams of a peer share a connection that is kept until the peer falls
+ * silent. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerUDP(UA_ConnectionConfig conf, UA_UInt16 port);
 
 UA_Connection UA_EXPORT
 ClientNetworkLayerUDP_connect(UA_ConnectionConfig conf, char endpointUrl[], UA_Logger logger);
@@ -0,0 +1,1135 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+#define _GNU_SOURCE // memfd_create, file seals
+#include "networklayer_unix.h" // before the libc headers that redefine the endianness macros
+#include "queue.h"
+#include <stdlib.h> // malloc, free
+#include <string.h> // memset, memcpy
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+# include <urcu/uatomic.h>
+#endif
+
+/* with a space so amalgamation does not remove the includes */
+# include <errno.h>
+# include <fcntl.h> // fcntl
+# include <poll.h>
+# include <unistd.h> // close, unlink
+# include <sys/select.h>
+# include <sys/socket.h>
+# include <sys/stat.h> // fstat
+# include <sys/un.h>
+#ifdef __linux__
+# include <sys/mman.h> // mmap, memfd_create
+# define UA_UNIX_SHAREDMEMORY
+#endif
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+#ifndef MSG_CMSG_CLOEXEC
+# define MSG_CMSG_CLOEXEC 0
+#endif
+
+/**
+ * Sockets: The server listens on a Unix domain stream socket. The messages are exchanged exactly
+ * as over TCP, so everything above the connection is unchanged.
+ *
+ * Shared memory (Linux only): Right after connecting, a client can send SHMHELLO together with the
+ * descriptor of a memfd that is sealed against shrinking. If the server accepts (a single 'Y' byte
+ * in reply), both directions use a single-producer single-consumer byte ring in the shared segment.
+ * A side that finds its ring empty (or full) sets a flag in the segment before it sleeps. The other
+ * side then writes a single wakeup byte to the socket. The socket also tells when the peer has
+ * disconnected. The peer can write anything into the segment, so the ring positions it publishes
+ * are checked before they are used.
+ *
+ * Sending: The server never waits for a slow client. What the socket or the ring does not take
+ * right away is queued per connection (without copying the buffer) and sent from "GetWork" once
+ * the socket becomes writable or the client has read from the ring. Later messages are appended to
+ * the queue to keep the order. If the queue grows beyond the configured limit, the connection is
+ * closed. Clients wait until their message was sent, for up to SENDTIMEOUT with shared memory.
+ */
+
+#define MAXBACKLOG 100
+#define SENDTIMEOUT 5000 /* ms until the client gives up on a server that does not read */
+#define UNIXURLPREFIX "opc.unix://"
+#define SHMHELLO "UASM"
+#define SHMHELLOSIZE 8 /* SHMHELLO and the ring size */
+#define SHMRINGSIZE (1u << 20) /* bytes per direction in the segments of the client */
+#define SHMMINRINGSIZE (1u << 12)
+#define SHMMAXRINGSIZE (1u << 30)
+
+/****************************/
+/* Generic Socket Functions */
+/****************************/
+
+static UA_Boolean
+socket_setPath(struct sockaddr_un *addr, const char *path) {
+    size_t pathLength = strlen(path);
+    if(pathLength == 0 || pathLength >= sizeof(addr->sun_path))
+        return false;
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, pathLength);
+    return true;
+}
+
+/* Writes what the socket takes without blocking. Returns the number of written
+ * bytes or -1 if the connection is broken. */
+static ssize_t
+socket_send(UA_Int32 sockfd, const UA_Byte *data, size_t length) {
+    size_t nWritten = 0;
+    while(nWritten < length) {
+        ssize_t n = send(sockfd, &data[nWritten], length - nWritten, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        nWritten += (size_t)n;
+    }
+    return (ssize_t)nWritten;
+}
+
+/* Writes the entire message. Returns false if the connection is broken. */
+static UA_Boolean
+socket_sendAll(UA_Int32 sockfd, const UA_ByteString *buf) {
+    size_t nWritten = 0;
+    while(nWritten < buf->length) {
+        ssize_t n = send(sockfd, &buf->data[nWritten], buf->length - nWritten, MSG_NOSIGNAL);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        nWritten += (size_t)n;
+    }
+    return true;
+}
+
+/***********************/
+/* Shared Memory Rings */
+/***********************/
+
+#ifdef UA_UNIX_SHAREDMEMORY
+
+/* Waits up to timeout ms (forever if negative) until the socket is readable.
+ * Returns false on timeout. */
+static UA_Boolean
+socket_waitReadable(UA_Int32 sockfd, int timeout) {
+    struct pollfd pfd = {.fd = sockfd, .events = POLLIN, .revents = 0};
+    int ret = poll(&pfd, 1, timeout);
+    return ret > 0 || (ret < 0 && errno == EINTR);
+}
+
+/* Returns the wait time in ms until the deadline or zero if it has passed */
+static int
+remainingMs(UA_DateTime deadline) {
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    if(now >= deadline)
+        return 0;
+    return (int)((deadline - now) / UA_MSEC_TO_DATETIME) + 1;
+}
+
+/* The positions run freely and are masked with the ring size (a power of two).
+   The fields written by the consumer and the producer are on separate cache
+   lines. */
+typedef struct {
+    UA_UInt32 head; /* read position, written by the consumer */
+    UA_UInt32 readerWaiting; /* set by the consumer before it sleeps */
+    UA_Byte pad1[56];
+    UA_UInt32 tail; /* write position, written by the producer */
+    UA_UInt32 writerWaiting; /* set by the producer before it sleeps */
+    UA_Byte pad2[56];
+} ShmRing;
+
+/* The rings are followed by their data in the segment */
+typedef struct {
+    ShmRing toServer;
+    ShmRing toClient;
+} ShmSegment;
+
+/* One side's view of the segment */
+typedef struct {
+    void *segment;
+    size_t segmentSize;
+    ShmRing *rx;
+    ShmRing *tx;
+    UA_Byte *rxData;
+    UA_Byte *txData;
+    UA_UInt32 ringSize;
+    UA_UInt32 rxHead; /* own positions. the copies in the segment are only published */
+    UA_UInt32 txTail;
+} ShmChannel;
+
+static size_t
+ShmSegment_size(UA_UInt32 ringSize) {
+    return sizeof(ShmSegment) + 2 * (size_t)ringSize;
+}
+
+static ShmChannel *
+ShmChannel_map(int fd, UA_UInt32 ringSize, UA_Boolean server) {
+    if(ringSize < SHMMINRINGSIZE || ringSize > SHMMAXRINGSIZE || (ringSize & (ringSize - 1)) != 0)
+        return NULL;
+    /* the peer must not be able to shrink the mapped segment */
+    int seals = fcntl(fd, F_GET_SEALS);
+    if(seals < 0 || !(seals & F_SEAL_SHRINK))
+        return NULL;
+    size_t segmentSize = ShmSegment_size(ringSize);
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)segmentSize)
+        return NULL;
+    void *segment = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(segment == MAP_FAILED)
+        return NULL;
+    ShmChannel *ch = malloc(sizeof(ShmChannel));
+    if(!ch) {
+        munmap(segment, segmentSize);
+        return NULL;
+    }
+    ShmSegment *s = segment;
+    UA_Byte *toServerData = (UA_Byte*)segment + sizeof(ShmSegment);
+    UA_Byte *toClientData = toServerData + ringSize;
+    ch->segment = segment;
+    ch->segmentSize = segmentSize;
+    if(server) {
+        ch->rx = &s->toServer;
+        ch->rxData = toServerData;
+        ch->tx = &s->toClient;
+        ch->txData = toClientData;
+    } else {
+        ch->rx = &s->toClient;
+        ch->rxData = toClientData;
+        ch->tx = &s->toServer;
+        ch->txData = toServerData;
+    }
+    ch->ringSize = ringSize;
+    ch->rxHead = 0;
+    ch->txTail = 0;
+    return ch;
+}
+
+static void
+ShmChannel_unmap(ShmChannel *ch) {
+    munmap(ch->segment, ch->segmentSize);
+    free(ch);
+}
+
+static UA_Boolean
+ShmChannel_readable(ShmChannel *ch) {
+    return __atomic_load_n(&ch->rx->tail, __ATOMIC_SEQ_CST) != ch->rxHead;
+}
+
+static UA_Boolean
+ShmChannel_writable(ShmChannel *ch) {
+    return ch->txTail - __atomic_load_n(&ch->tx->head, __ATOMIC_SEQ_CST) != ch->ringSize;
+}
+
+/* Returns the number of bytes read or -1 if the peer has corrupted the ring */
+static ssize_t
+ShmChannel_read(ShmChannel *ch, UA_Byte *dst, size_t length) {
+    UA_UInt32 available = __atomic_load_n(&ch->rx->tail, __ATOMIC_SEQ_CST) - ch->rxHead;
+    if(available > ch->ringSize)
+        return -1;
+    if(available > length)
+        available = (UA_UInt32)length;
+    UA_UInt32 pos = ch->rxHead & (ch->ringSize - 1);
+    UA_UInt32 first = ch->ringSize - pos;
+    if(first > available)
+        first = available;
+    memcpy(dst, &ch->rxData[pos], first);
+    memcpy(&dst[first], ch->rxData, available - first);
+    ch->rxHead += available;
+    __atomic_store_n(&ch->rx->head, ch->rxHead, __ATOMIC_SEQ_CST);
+    return (ssize_t)available;
+}
+
+/* Returns the number of bytes written or -1 if the peer has corrupted the ring */
+static ssize_t
+ShmChannel_write(ShmChannel *ch, const UA_Byte *src, size_t length) {
+    UA_UInt32 used = ch->txTail - __atomic_load_n(&ch->tx->head, __ATOMIC_SEQ_CST);
+    if(used > ch->ringSize)
+        return -1;
+    UA_UInt32 space = ch->ringSize - used;
+    if(space > length)
+        space = (UA_UInt32)length;
+    UA_UInt32 pos = ch->txTail & (ch->ringSize - 1);
+    UA_UInt32 first = ch->ringSize - pos;
+    if(first > space)
+        first = space;
+    memcpy(&ch->txData[pos], src, first);
+    memcpy(ch->txData, &src[first], space - first);
+    ch->txTail += space;
+    __atomic_store_n(&ch->tx->tail, ch->txTail, __ATOMIC_SEQ_CST);
+    return (ssize_t)space;
+}
+
+/* Wakes up the peer if it sleeps on the ring */
+static void
+ShmChannel_wakeup(UA_Int32 sockfd, UA_UInt32 *waiting) {
+    if(__atomic_exchange_n(waiting, 0, __ATOMIC_SEQ_CST) != 0)
+        send(sockfd, "w", 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+/* Consumes the wakeup bytes. Returns false if the peer has disconnected. */
+static UA_Boolean
+ShmChannel_drainWakeups(UA_Int32 sockfd) {
+    char buf[64];
+    while(true) {
+        ssize_t n = recv(sockfd, buf, sizeof(buf), MSG_DONTWAIT);
+        if(n == (ssize_t)sizeof(buf))
+            continue;
+        if(n > 0)
+            return true;
+        if(n == 0)
+            return false;
+        if(errno != EINTR)
+            return (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+/* Copies the message into the ring. When the ring is full, the client sleeps
+ * until the server wakes it up. */
+static UA_StatusCode
+ShmChannel_send(ShmChannel *ch, UA_Int32 sockfd, const UA_ByteString *buf) {
+    UA_DateTime deadline = UA_DateTime_nowMonotonic() + SENDTIMEOUT * UA_MSEC_TO_DATETIME;
+    size_t nWritten = 0;
+    while(nWritten < buf->length) {
+        ssize_t n = ShmChannel_write(ch, &buf->data[nWritten], buf->length - nWritten);
+        if(n < 0)
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+        if(n > 0) {
+            nWritten += (size_t)n;
+            ShmChannel_wakeup(sockfd, &ch->tx->readerWaiting);
+            continue;
+        }
+        int wait = remainingMs(deadline);
+        if(wait == 0)
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+        /* announce the wait, then check again to not miss the wakeup */
+        __atomic_store_n(&ch->tx->writerWaiting, 1, __ATOMIC_SEQ_CST);
+        if(ShmChannel_writable(ch))
+            continue;
+        if(socket_waitReadable(sockfd, wait) && !ShmChannel_drainWakeups(sockfd))
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+#endif /* UA_UNIX_SHAREDMEMORY */
+
+/****************************/
+/* Unix Server NetworkLayer */
+/****************************/
+
+const UA_ServerNetworkLayerUnixConfig UA_ServerNetworkLayerUnixConfig_standard =
+    {.allowSharedMemory = true, .maxSendQueueSize = 1048576};
+
+/* Outbound data that could not be sent right away */
+typedef struct QueuedSend {
+    SIMPLEQ_ENTRY(QueuedSend) next;
+    UA_ByteString buf;
+    size_t sent;
+} QueuedSend;
+
+typedef struct UnixConnection {
+    UA_Connection connection;
+    LIST_ENTRY(UnixConnection) pointers;
+    UA_Boolean handshake; /* the first message was not yet received */
+#ifdef UA_UNIX_SHAREDMEMORY
+    ShmChannel *shm; /* NULL if the messages go through the socket */
+#endif
+    SIMPLEQ_HEAD(SendQueue, QueuedSend) sendQueue;
+    size_t sendQueueSize; /* unsent bytes in the queue */
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t sendLock; /* guards the queue. the ring has a single producer. */
+#endif
+} UnixConnection;
+
+typedef struct {
+    UA_ConnectionConfig conf;
+    UA_ServerNetworkLayerUnixConfig unixConf;
+    UA_Logger logger;
+    char *path;
+    UA_Int32 serversockfd;
+    LIST_HEAD(, UnixConnection) connections;
+    size_t connectionsSize;
+} ServerNetworkLayerUnix;
+
+static UA_StatusCode
+ServerNetworkLayerUnix_getSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    return UA_ByteString_allocBuffer(buf, length);
+}
+
+static void
+ServerNetworkLayerUnix_releaseBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_deleteMembers(buf);
+}
+
+/* Writes what the socket or the ring takes right away. Returns the number of
+ * written bytes or -1 if the connection is broken. Call with the send lock
+ * held. */
+static ssize_t
+UnixConnection_write(UnixConnection *c, const UA_Byte *data, size_t length) {
+#ifdef UA_UNIX_SHAREDMEMORY
+    if(c->shm) {
+        ssize_t n = ShmChannel_write(c->shm, data, length);
+        if(n > 0)
+            ShmChannel_wakeup(c->connection.sockfd, &c->shm->tx->readerWaiting);
+        return n;
+    }
+#endif
+    return socket_send(c->connection.sockfd, data, length);
+}
+
+/* Call with the send lock held. Returns false if the connection is broken. */
+static UA_Boolean
+UnixConnection_flushSendQueue(UnixConnection *c) {
+    QueuedSend *qs;
+    while((qs = SIMPLEQ_FIRST(&c->sendQueue))) {
+        size_t length = qs->buf.length - qs->sent;
+        ssize_t n = UnixConnection_write(c, &qs->buf.data[qs->sent], length);
+        if(n < 0)
+            return false;
+        qs->sent += (size_t)n;
+        c->sendQueueSize -= (size_t)n;
+        if((size_t)n < length)
+            return true; /* the socket or the ring is full */
+        SIMPLEQ_REMOVE_HEAD(&c->sendQueue, next);
+        UA_ByteString_deleteMembers(&qs->buf);
+        free(qs);
+    }
+    return true;
+}
+
+/* Can be called from parallel worker threads */
+static UA_StatusCode
+ServerNetworkLayerUnix_send(UA_Connection *connection, UA_ByteString *buf) {
+    UnixConnection *c = (UnixConnection*)connection;
+    ServerNetworkLayerUnix *layer = connection->handle;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&c->sendLock);
+#endif
+
+    /* send right away if nothing is pending */
+    size_t sent = 0;
+    if(SIMPLEQ_EMPTY(&c->sendQueue)) {
+        ssize_t n = UnixConnection_write(c, buf->data, buf->length);
+        if(n < 0) {
+            retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+            goto finish;
+        }
+        sent = (size_t)n;
+        if(sent == buf->length)
+            goto finish;
+    }
+
+    /* queue the remainder */
+    if(c->sendQueueSize + buf->length - sent > layer->unixConf.maxSendQueueSize) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Connection %i exceeds the send queue limit", connection->sockfd);
+        retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+        goto finish;
+    }
+    QueuedSend *qs = malloc(sizeof(QueuedSend));
+    if(!qs) {
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+        goto finish;
+    }
+    qs->buf = *buf;
+    qs->sent = sent;
+    SIMPLEQ_INSERT_TAIL(&c->sendQueue, qs, next);
+    c->sendQueueSize += buf->length - sent;
+    *buf = UA_BYTESTRING_NULL;
+#ifdef UA_UNIX_SHAREDMEMORY
+    /* the client wakes up the networking thread once it has read from the ring */
+    if(c->shm)
+        __atomic_store_n(&c->shm->tx->writerWaiting, 1, __ATOMIC_SEQ_CST);
+#endif
+
+ finish:
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&c->sendLock);
+#endif
+    UA_ByteString_deleteMembers(buf);
+    if(retval == UA_STATUSCODE_BADCONNECTIONCLOSED)
+        connection->close(connection);
+    return retval;
+}
+
+/* Returns whether data waits in the send queue */
+static UA_Boolean
+UnixConnection_sendPending(UnixConnection *c) {
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&c->sendLock);
+#endif
+    UA_Boolean pending = !SIMPLEQ_EMPTY(&c->sendQueue);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&c->sendLock);
+#endif
+    return pending;
+}
+
+/* Sends pending data once the socket or the ring is writable. Call only from
+ * the networking thread. */
+static void
+ServerNetworkLayerUnix_flush(UnixConnection *c) {
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&c->sendLock);
+#endif
+    UA_Boolean ok = UnixConnection_flushSendQueue(c);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&c->sendLock);
+#endif
+    if(!ok)
+        c->connection.close(&c->connection);
+}
+
+static void
+ServerNetworkLayerUnix_close(UA_Connection *connection) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(uatomic_xchg(&connection->state, UA_CONNECTION_CLOSED) == UA_CONNECTION_CLOSED)
+        return;
+#else
+    if(connection->state == UA_CONNECTION_CLOSED)
+        return;
+    connection->state = UA_CONNECTION_CLOSED;
+#endif
+    /* only shut down. the socket becomes readable and the networklayer detaches
+       the connection in the next "GetWork". */
+    shutdown(connection->sockfd, SHUT_RDWR);
+}
+
+static void
+ServerNetworkLayerUnix_freeConnection(UA_Server *server, void *ptr) {
+    UnixConnection *c = ptr;
+    QueuedSend *qs, *qs_tmp;
+    SIMPLEQ_FOREACH_SAFE(qs, &c->sendQueue, next, qs_tmp) {
+        UA_ByteString_deleteMembers(&qs->buf);
+        free(qs);
+    }
+#ifdef UA_UNIX_SHAREDMEMORY
+    if(c->shm)
+        ShmChannel_unmap(c->shm);
+#endif
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&c->sendLock);
+#endif
+    UA_Connection_deleteMembers(&c->connection);
+    free(c);
+}
+
+/* Removes the connection and appends the jobs to detach and free it. Call only
+ * from the networking thread. */
+static void
+ServerNetworkLayerUnix_remove(ServerNetworkLayerUnix *layer, UnixConnection *c, UA_Job *js, size_t *j) {
+    LIST_REMOVE(c, pointers);
+    layer->connectionsSize--;
+    c->connection.state = UA_CONNECTION_CLOSED;
+    shutdown(c->connection.sockfd, SHUT_RDWR);
+    close(c->connection.sockfd);
+    js[*j].type = UA_JOBTYPE_DETACHCONNECTION;
+    js[*j].job.closeConnection = &c->connection;
+    js[*j+1].type = UA_JOBTYPE_METHODCALL_DELAYED;
+    js[*j+1].job.methodCall.method = ServerNetworkLayerUnix_freeConnection;
+    js[*j+1].job.methodCall.data = c;
+    *j += 2;
+}
+
+static void
+ServerNetworkLayerUnix_accept(ServerNetworkLayerUnix *layer) {
+    while(true) {
+        int newsockfd = accept(layer->serversockfd, NULL, NULL);
+        if(newsockfd < 0) {
+            if(errno == EINTR)
+                continue;
+            return; /* the backlog is empty */
+        }
+        if(newsockfd >= FD_SETSIZE) {
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Rejecting a connection, the socket cannot be used with select");
+            close(newsockfd);
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        int val = 1;
+        setsockopt(newsockfd, SOL_SOCKET, SO_NOSIGPIPE, &val, sizeof(val));
+#endif
+        UnixConnection *c = malloc(sizeof(UnixConnection));
+        if(!c) {
+            UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK, "No memory for a new Connection");
+            close(newsockfd);
+            return;
+        }
+        UA_Connection_init(&c->connection);
+        c->connection.sockfd = newsockfd;
+        c->connection.handle = layer;
+        c->connection.localConf = layer->conf;
+        c->connection.send = ServerNetworkLayerUnix_send;
+        c->connection.close = ServerNetworkLayerUnix_close;
+        c->connection.getSendBuffer = ServerNetworkLayerUnix_getSendBuffer;
+        c->connection.releaseSendBuffer = ServerNetworkLayerUnix_releaseBuffer;
+        c->connection.releaseRecvBuffer = ServerNetworkLayerUnix_releaseBuffer;
+        c->connection.state = UA_CONNECTION_OPENING;
+        c->handshake = true;
+#ifdef UA_UNIX_SHAREDMEMORY
+        c->shm = NULL;
+#endif
+        SIMPLEQ_INIT(&c->sendQueue);
+        c->sendQueueSize = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_init(&c->sendLock, NULL);
+#endif
+        LIST_INSERT_HEAD(&layer->connections, c, pointers);
+        layer->connectionsSize++;
+        UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                    "New Connection %i over a Unix domain socket", newsockfd);
+    }
+}
+
+/* The first message either offers a shared memory segment or is already part
+ * of the binary protocol. */
+static UA_StatusCode
+ServerNetworkLayerUnix_handshake(ServerNetworkLayerUnix *layer, UnixConnection *c,
+                                 UA_ByteString *buf) {
+    if(UA_ByteString_allocBuffer(buf, layer->conf.recvBufferSize) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    struct iovec iov = {.iov_base = buf->data, .iov_len = buf->length};
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    ssize_t n = recvmsg(c->connection.sockfd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if(n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+        buf->length = 0;
+        return UA_STATUSCODE_GOOD; /* retry */
+    }
+    if(n <= 0)
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    c->handshake = false;
+    buf->length = (size_t)n;
+
+    int shmfd = -1;
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if(cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+       cm->cmsg_len == CMSG_LEN(sizeof(int)))
+        memcpy(&shmfd, CMSG_DATA(cm), sizeof(int));
+    if(shmfd < 0)
+        return UA_STATUSCODE_GOOD; /* the client uses the socket */
+
+    /* the client offers a shared memory segment */
+    char reply = 'N';
+#ifdef UA_UNIX_SHAREDMEMORY
+    if(layer->unixConf.allowSharedMemory && n == SHMHELLOSIZE &&
+       memcmp(buf->data, SHMHELLO, 4) == 0) {
+        UA_UInt32 ringSize;
+        memcpy(&ringSize, &buf->data[4], sizeof(UA_UInt32));
+        c->shm = ShmChannel_map(shmfd, ringSize, true);
+        if(c->shm)
+            reply = 'Y';
+        else
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Connection %i offers an unusable shared memory segment",
+                           c->connection.sockfd);
+    }
+#endif
+    close(shmfd);
+    buf->length = 0;
+    if(send(c->connection.sockfd, &reply, 1, MSG_NOSIGNAL) != 1)
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+ServerNetworkLayerUnix_recv(ServerNetworkLayerUnix *layer, UnixConnection *c, UA_Boolean socketReadable,
+                            UA_ByteString *buf) {
+#ifdef UA_UNIX_SHAREDMEMORY
+    if(c->shm) {
+        if(socketReadable && !ShmChannel_drainWakeups(c->connection.sockfd))
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+        if(!ShmChannel_readable(c->shm))
+            return UA_STATUSCODE_GOOD;
+        if(UA_ByteString_allocBuffer(buf, layer->conf.recvBufferSize) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        ssize_t n = ShmChannel_read(c->shm, buf->data, buf->length);
+        if(n < 0) {
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Connection %i has corrupted the shared memory", c->connection.sockfd);
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+        }
+        buf->length = (size_t)n;
+        ShmChannel_wakeup(c->connection.sockfd, &c->shm->rx->writerWaiting);
+        return UA_STATUSCODE_GOOD;
+    }
+#endif
+    if(UA_ByteString_allocBuffer(buf, layer->conf.recvBufferSize) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    ssize_t n = recv(c->connection.sockfd, buf->data, buf->length, MSG_DONTWAIT);
+    if(n > 0) {
+        buf->length = (size_t)n;
+        return UA_STATUSCODE_GOOD;
+    }
+    buf->length = 0;
+    if(n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        return UA_STATUSCODE_GOOD; /* retry */
+    return UA_STATUSCODE_BADCONNECTIONCLOSED;
+}
+
+static void
+ServerNetworkLayerUnix_read(ServerNetworkLayerUnix *layer, UnixConnection *c, UA_Boolean socketReadable,
+                            UA_Job *js, size_t *j) {
+    UA_ByteString buf = UA_BYTESTRING_NULL;
+    UA_StatusCode retval;
+    if(c->handshake)
+        retval = ServerNetworkLayerUnix_handshake(layer, c, &buf);
+    else
+        retval = ServerNetworkLayerUnix_recv(layer, c, socketReadable, &buf);
+    if(retval == UA_STATUSCODE_GOOD && buf.length > 0) {
+        js[*j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
+        js[*j].job.binaryMessage.connection = &c->connection;
+        js[*j].job.binaryMessage.message = buf;
+        (*j)++;
+        return;
+    }
+    UA_ByteString_deleteMembers(&buf);
+    if(retval == UA_STATUSCODE_BADCONNECTIONCLOSED)
+        ServerNetworkLayerUnix_remove(layer, c, js, j);
+}
+
+static UA_StatusCode
+ServerNetworkLayerUnix_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    ServerNetworkLayerUnix *layer = nl->handle;
+    layer->logger = logger;
+
+    struct sockaddr_un addr;
+    if(!socket_setPath(&addr, layer->path)) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Invalid socket path %s", layer->path);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    size_t prefixLength = strlen(UNIXURLPREFIX);
+    size_t pathLength = strlen(layer->path);
+    if(UA_ByteString_allocBuffer(&nl->discoveryUrl, prefixLength + pathLength) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    memcpy(nl->discoveryUrl.data, UNIXURLPREFIX, prefixLength);
+    memcpy(&nl->discoveryUrl.data[prefixLength], layer->path, pathLength);
+
+    if((layer->serversockfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error opening socket");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    unlink(layer->path); /* replace a leftover socket file */
+    if(bind(layer->serversockfd, (const struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error during socket binding");
+        close(layer->serversockfd);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    int opts = fcntl(layer->serversockfd, F_GETFL);
+    if(opts < 0 || fcntl(layer->serversockfd, F_SETFL, opts | O_NONBLOCK) < 0 ||
+       listen(layer->serversockfd, MAXBACKLOG) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error listening on the socket");
+        close(layer->serversockfd);
+        unlink(layer->path);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Unix domain socket network layer listening on %.*s",
+                nl->discoveryUrl.length, nl->discoveryUrl.data);
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t
+ServerNetworkLayerUnix_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
+    ServerNetworkLayerUnix *layer = nl->handle;
+    fd_set fdset, writeset;
+    FD_ZERO(&fdset);
+    FD_ZERO(&writeset);
+    FD_SET(layer->serversockfd, &fdset);
+    UA_Int32 highestfd = layer->serversockfd;
+    struct timeval tmptv = {0, timeout};
+    UnixConnection *c, *c_next;
+    LIST_FOREACH(c, &layer->connections, pointers) {
+        FD_SET(c->connection.sockfd, &fdset);
+        if(c->connection.sockfd > highestfd)
+            highestfd = c->connection.sockfd;
+        UA_Boolean sendPending = UnixConnection_sendPending(c);
+#ifdef UA_UNIX_SHAREDMEMORY
+        /* announce the wait. don't sleep if a message arrived or the client
+           has read from the ring in the meantime. */
+        if(c->shm) {
+            __atomic_store_n(&c->shm->rx->readerWaiting, 1, __ATOMIC_SEQ_CST);
+            if(ShmChannel_readable(c->shm))
+                tmptv.tv_usec = 0;
+            if(sendPending) {
+                __atomic_store_n(&c->shm->tx->writerWaiting, 1, __ATOMIC_SEQ_CST);
+                if(ShmChannel_writable(c->shm))
+                    tmptv.tv_usec = 0;
+            }
+            continue;
+        }
+#endif
+        if(sendPending)
+            FD_SET(c->connection.sockfd, &writeset);
+    }
+    if(select(highestfd + 1, &fdset, &writeset, NULL, &tmptv) < 0) {
+        *jobs = NULL;
+        return 0;
+    }
+
+    /* send queued data */
+    LIST_FOREACH(c, &layer->connections, pointers) {
+        UA_Boolean writable = FD_ISSET(c->connection.sockfd, &writeset);
+#ifdef UA_UNIX_SHAREDMEMORY
+        writable = writable || (c->shm && ShmChannel_writable(c->shm));
+#endif
+        if(writable && UnixConnection_sendPending(c))
+            ServerNetworkLayerUnix_flush(c);
+    }
+
+    /* alloc enough space for a cleanup-connection and free-connection job per connection */
+    UA_Job *js = NULL;
+    size_t j = 0;
+    if(layer->connectionsSize > 0)
+        js = malloc(sizeof(UA_Job) * layer->connectionsSize * 2);
+    if(js) {
+        for(c = LIST_FIRST(&layer->connections); c; c = c_next) {
+            c_next = LIST_NEXT(c, pointers);
+            UA_Boolean socketReadable = FD_ISSET(c->connection.sockfd, &fdset);
+            UA_Boolean pending = socketReadable;
+#ifdef UA_UNIX_SHAREDMEMORY
+            pending = pending || (c->shm && ShmChannel_readable(c->shm));
+#endif
+            if(pending)
+                ServerNetworkLayerUnix_read(layer, c, socketReadable, js, &j);
+        }
+    }
+
+    /* new connections are read from in the next iteration */
+    if(FD_ISSET(layer->serversockfd, &fdset))
+        ServerNetworkLayerUnix_accept(layer);
+
+    if(j == 0) {
+        free(js);
+        js = NULL;
+    }
+    *jobs = js;
+    return j;
+}
+
+static size_t
+ServerNetworkLayerUnix_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
+    ServerNetworkLayerUnix *layer = nl->handle;
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "Shutting down the Unix domain socket network layer with %d open connection(s)",
+                (int)layer->connectionsSize);
+    close(layer->serversockfd);
+    unlink(layer->path);
+    *jobs = NULL;
+    if(layer->connectionsSize == 0)
+        return 0;
+    UA_Job *items = malloc(sizeof(UA_Job) * layer->connectionsSize * 2);
+    if(!items)
+        return 0;
+    size_t j = 0;
+    UnixConnection *c;
+    while((c = LIST_FIRST(&layer->connections)))
+        ServerNetworkLayerUnix_remove(layer, c, items, &j);
+    *jobs = items;
+    return j;
+}
+
+/* run only when the server is stopped */
+static void
+ServerNetworkLayerUnix_deleteMembers(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerUnix *layer = nl->handle;
+    free(layer->path);
+    free(layer);
+    UA_String_deleteMembers(&nl->discoveryUrl);
+}
+
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerUnixWithConfig(UA_ConnectionConfig conf, const char *path,
+                                    const UA_ServerNetworkLayerUnixConfig *unixConf) {
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
+    ServerNetworkLayerUnix *layer = calloc(1, sizeof(ServerNetworkLayerUnix));
+    if(!layer)
+        return nl;
+    size_t pathLength = strlen(path);
+    layer->path = malloc(pathLength + 1);
+    if(!layer->path) {
+        free(layer);
+        return nl;
+    }
+    memcpy(layer->path, path, pathLength + 1);
+    layer->conf = conf;
+    layer->unixConf = *unixConf;
+    layer->serversockfd = -1;
+    LIST_INIT(&layer->connections);
+
+    nl.handle = layer;
+    nl.start = ServerNetworkLayerUnix_start;
+    nl.getJobs = ServerNetworkLayerUnix_getJobs;
+    nl.stop = ServerNetworkLayerUnix_stop;
+    nl.deleteMembers = ServerNetworkLayerUnix_deleteMembers;
+    return nl;
+}
+
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerUnix(UA_ConnectionConfig conf, const char *path) {
+    return UA_ServerNetworkLayerUnixWithConfig(conf, path, &UA_ServerNetworkLayerUnixConfig_standard);
+}
+
+/****************************/
+/* Unix Client NetworkLayer */
+/****************************/
+
+static UA_StatusCode
+ClientConnectionUnix_getBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    if(connection->state == UA_CONNECTION_CLOSED)
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    return UA_ByteString_allocBuffer(buf, connection->remoteConf.recvBufferSize);
+}
+
+static void
+ClientConnectionUnix_releaseBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_deleteMembers(buf);
+}
+
+static void
+ClientConnectionUnix_close(UA_Connection *connection) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(uatomic_xchg(&connection->state, UA_CONNECTION_CLOSED) == UA_CONNECTION_CLOSED)
+        return;
+#else
+    if(connection->state == UA_CONNECTION_CLOSED)
+        return;
+    connection->state = UA_CONNECTION_CLOSED;
+#endif
+    shutdown(connection->sockfd, SHUT_RDWR);
+    close(connection->sockfd);
+#ifdef UA_UNIX_SHAREDMEMORY
+    if(connection->handle) {
+        ShmChannel_unmap(connection->handle);
+        connection->handle = NULL;
+    }
+#endif
+}
+
+static UA_StatusCode
+ClientConnectionUnix_send(UA_Connection *connection, UA_ByteString *buf) {
+    UA_Boolean ok = socket_sendAll(connection->sockfd, buf);
+    UA_ByteString_deleteMembers(buf);
+    if(ok)
+        return UA_STATUSCODE_GOOD;
+    ClientConnectionUnix_close(connection);
+    return UA_STATUSCODE_BADCONNECTIONCLOSED;
+}
+
+/* as with TCP, the connection is closed when the timeout expires */
+static UA_StatusCode
+ClientConnectionUnix_recv(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeout) {
+    if(UA_ByteString_allocBuffer(response, connection->localConf.recvBufferSize) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    ssize_t n = -1;
+    int ret = 1;
+    if(timeout > 0) {
+        struct pollfd pfd = {.fd = connection->sockfd, .events = POLLIN, .revents = 0};
+        ret = poll(&pfd, 1, (int)timeout);
+    }
+    if(ret > 0)
+        n = recv(connection->sockfd, response->data, response->length, 0);
+    if(n > 0) {
+        response->length = (size_t)n;
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_ByteString_deleteMembers(response);
+    if((ret < 0 || n < 0) && errno == EINTR)
+        return UA_STATUSCODE_GOOD; /* retry */
+    ClientConnectionUnix_close(connection);
+    return UA_STATUSCODE_BADCONNECTIONCLOSED;
+}
+
+#ifdef UA_UNIX_SHAREDMEMORY
+
+static UA_StatusCode
+ClientConnectionUnix_sendShm(UA_Connection *connection, UA_ByteString *buf) {
+    UA_StatusCode retval = ShmChannel_send(connection->handle, connection->sockfd, buf);
+    UA_ByteString_deleteMembers(buf);
+    if(retval != UA_STATUSCODE_GOOD)
+        ClientConnectionUnix_close(connection);
+    return retval;
+}
+
+static UA_StatusCode
+ClientConnectionUnix_recvShm(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeout) {
+    ShmChannel *ch = connection->handle;
+    if(UA_ByteString_allocBuffer(response, connection->localConf.recvBufferSize) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_DateTime deadline = UA_DateTime_nowMonotonic() + (UA_DateTime)timeout * UA_MSEC_TO_DATETIME;
+    while(true) {
+        ssize_t n = ShmChannel_read(ch, response->data, response->length);
+        if(n < 0)
+            break; /* corrupted */
+        if(n > 0) {
+            response->length = (size_t)n;
+            ShmChannel_wakeup(connection->sockfd, &ch->rx->writerWaiting);
+            return UA_STATUSCODE_GOOD;
+        }
+        /* announce the wait, then check again to not miss the wakeup */
+        __atomic_store_n(&ch->rx->readerWaiting, 1, __ATOMIC_SEQ_CST);
+        if(ShmChannel_readable(ch))
+            continue;
+        int wait = -1;
+        if(timeout > 0) {
+            wait = remainingMs(deadline);
+            if(wait == 0)
+                break; /* timeout */
+        }
+        if(socket_waitReadable(connection->sockfd, wait) &&
+           !ShmChannel_drainWakeups(connection->sockfd))
+            break; /* disconnected */
+    }
+    UA_ByteString_deleteMembers(response);
+    ClientConnectionUnix_close(connection);
+    return UA_STATUSCODE_BADCONNECTIONCLOSED;
+}
+
+static UA_Boolean
+ClientConnectionUnix_sendHello(UA_Int32 sockfd, int shmfd, UA_UInt32 ringSize) {
+    UA_Byte hello[SHMHELLOSIZE];
+    memcpy(hello, SHMHELLO, 4);
+    memcpy(&hello[4], &ringSize, sizeof(UA_UInt32));
+    struct iovec iov = {.iov_base = hello, .iov_len = SHMHELLOSIZE};
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &shmfd, sizeof(int));
+    return sendmsg(sockfd, &msg, MSG_NOSIGNAL) == SHMHELLOSIZE;
+}
+
+/* Offers a shared memory segment to the server. Keeps the socket if the
+ * segment cannot be created or the server declines. */
+static void
+ClientConnectionUnix_offerSharedMemory(UA_Connection *connection, UA_Logger logger) {
+    int shmfd = memfd_create("open62541", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(shmfd < 0) {
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK, "Could not create the shared memory segment");
+        return;
+    }
+    ShmChannel *ch = NULL;
+    if(ftruncate(shmfd, (off_t)ShmSegment_size(SHMRINGSIZE)) == 0 &&
+       fcntl(shmfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) == 0)
+        ch = ShmChannel_map(shmfd, SHMRINGSIZE, false);
+    if(!ch) {
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK, "Could not create the shared memory segment");
+        close(shmfd);
+        return;
+    }
+
+    /* the server replies with a single byte */
+    char reply = 0;
+    if(ClientConnectionUnix_sendHello(connection->sockfd, shmfd, SHMRINGSIZE) &&
+       socket_waitReadable(connection->sockfd, SENDTIMEOUT))
+        recv(connection->sockfd, &reply, 1, MSG_DONTWAIT);
+    close(shmfd);
+    if(reply == 'Y') {
+        connection->handle = ch;
+        connection->send = ClientConnectionUnix_sendShm;
+        connection->recv = ClientConnectionUnix_recvShm;
+        return;
+    }
+    ShmChannel_unmap(ch);
+    if(reply == 'N') {
+        UA_LOG_INFO(logger, UA_LOGCATEGORY_NETWORK,
+                    "The server declined shared memory, the messages go through the socket");
+        return;
+    }
+    UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK, "No reply to the shared memory offer");
+    ClientConnectionUnix_close(connection);
+}
+
+#endif /* UA_UNIX_SHAREDMEMORY */
+
+static UA_Connection
+ClientConnectionUnix_connect(UA_ConnectionConfig localConf, const char *endpointUrl,
+                             UA_Logger logger, UA_Boolean sharedMemory) {
+    UA_Connection connection;
+    UA_Connection_init(&connection);
+    connection.localConf = localConf;
+    connection.send = ClientConnectionUnix_send;
+    connection.recv = ClientConnectionUnix_recv;
+    connection.close = ClientConnectionUnix_close;
+    connection.getSendBuffer = ClientConnectionUnix_getBuffer;
+    connection.releaseSendBuffer = ClientConnectionUnix_releaseBuffer;
+    connection.releaseRecvBuffer = ClientConnectionUnix_releaseBuffer;
+
+    size_t prefixLength = strlen(UNIXURLPREFIX);
+    struct sockaddr_un addr;
+    if(strncmp(endpointUrl, UNIXURLPREFIX, prefixLength) != 0 ||
+       !socket_setPath(&addr, &endpointUrl[prefixLength])) {
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK,
+                       "Server url is not opc.unix:// followed by a valid socket path");
+        return connection;
+    }
+    if((connection.sockfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK, "Could not create socket");
+        return connection;
+    }
+    connection.state = UA_CONNECTION_OPENING;
+    if(connect(connection.sockfd, (const struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ClientConnectionUnix_close(&connection);
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK, "Connection failed");
+        return connection;
+    }
+#ifdef SO_NOSIGPIPE
+    int val = 1;
+    setsockopt(connection.sockfd, SOL_SOCKET, SO_NOSIGPIPE, &val, sizeof(val));
+#endif
+
+    if(sharedMemory) {
+#ifdef UA_UNIX_SHAREDMEMORY
+        ClientConnectionUnix_offerSharedMemory(&connection, logger);
+#else
+        UA_LOG_WARNING(logger, UA_LOGCATEGORY_NETWORK,
+                       "Shared memory is not available, the messages go through the socket");
+#endif
+    }
+    return connection;
+}
+
+UA_Connection
+UA_ClientConnectionUnix(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger) {
+    return ClientConnectionUnix_connect(conf, endpointUrl, logger, false);
+}
+
+UA_Connection
+UA_ClientConnectionUnixSharedMemory(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger) {
+    return ClientConnectionUnix_connect(conf, endpointUrl, logger, true);
+}
@@ -0,0 +1,56 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+#ifndef NETWORKLAYERUNIX_H_
+#define NETWORKLAYERUNIX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_server.h"
+#include "ua_client.h"
+
+/** @brief Additional settings of the Unix domain socket server networklayer */
+typedef struct {
+    /* Accept the offer of clients to exchange the messages through rings in a
+     * shared memory segment. The socket then only carries the wakeups. Only
+     * available on Linux. */
+    UA_Boolean allowSharedMemory;
+
+    /* Maximum number of bytes that are queued per connection when the client
+     * does not read fast enough. The connection is closed when the limit is
+     * exceeded. */
+    size_t maxSendQueueSize;
+} UA_ServerNetworkLayerUnixConfig;
+
+extern UA_EXPORT const UA_ServerNetworkLayerUnixConfig UA_ServerNetworkLayerUnixConfig_standard;
+
+/** @brief Create a networklayer that listens on a Unix domain socket at the
+ * given path. The discovery url is opc.unix://<path>. An existing socket file
+ * at the path is replaced. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerUnix(UA_ConnectionConfig conf, const char *path);
+
+/** @brief Create the Unix domain socket networklayer with additional settings */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerUnixWithConfig(UA_ConnectionConfig conf, const char *path,
+                                    const UA_ServerNetworkLayerUnixConfig *unixConf);
+
+/** @brief Connect to a server at an opc.unix://<path> endpoint url */
+UA_Connection UA_EXPORT
+UA_ClientConnectionUnix(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger);
+
+/** @brief Connect to a server at an opc.unix://<path> endpoint url and offer
+ * to exchange the messages through shared memory. Uses the socket if the
+ * server declines or shared memory is not available. */
+UA_Connection UA_EXPORT
+UA_ClientConnectionUnixSharedMemory(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* NETWORKLAYERUNIX_H_ */
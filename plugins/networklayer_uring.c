@@ -0,0 +1,980 @@
+ /*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+#include "networklayer_uring.h"
+#include "networklayer_tcp.h"
+#include "queue.h"
+
+#include <stdlib.h> // malloc, free
+#include <stdio.h> // snprintf
+#include <string.h> // memset
+#include <errno.h>
+#include <unistd.h> // close, syscall
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+# include <urcu/uatomic.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * The io_uring networklayer replaces the readiness notification of select/epoll with a completion
+ * queue. In every call to "GetWork", a single io_uring_enter submits all operations that were
+ * queued since the last call and waits for completions.
+ *
+ * Accepting: A multishot accept on the listening socket produces a completion for every new
+ * connection. It is re-armed if the kernel terminates it.
+ *
+ * Receiving: Every connection has a multishot receive armed that picks its buffers from a ring of
+ * provided buffers (of size recvBufferSize). The completion carries the index of the buffer that
+ * was filled. The buffer goes to the server and back to the ring in the releaseRecvBuffer callback.
+ * When the ring runs empty, the kernel terminates the receive (ENOBUFS) and it is re-armed once
+ * buffers are back. Kernels without multishot receives get a single receive re-armed after every
+ * completion.
+ *
+ * Sending: The send callback only queues a send operation. It is submitted together with
+ * everything else in the next "GetWork". A single send per connection is in flight to keep the
+ * stream in order; further buffers wait in a per-connection queue. Sends from other threads than
+ * the networking thread are submitted right away instead of waiting for the next iteration.
+ *
+ * Closing: The close callback only shuts the socket down. The pending receive then completes with
+ * EOF and the connection is detached from the server. The socket is closed and the connection freed
+ * (delayed) only when none of its operations is left in flight. So no queued operation can hit a
+ * recycled descriptor number.
+ */
+
+#define MAXBACKLOG 100
+#define URINGENTRIES 256 /* size of the submission queue */
+#define URINGRECVBUFFERS 64 /* number of provided receive buffers, a power of two */
+#define URINGBUFFERGROUP 0
+
+/* the operation is tagged in the lower bits of the user_data (pointers are aligned) */
+#define URING_ACCEPT 0
+#define URING_RECV 1
+#define URING_SEND 2
+#define URING_TAGMASK 3
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define URING_LOCK(layer) pthread_mutex_lock(&(layer)->lock)
+# define URING_UNLOCK(layer) pthread_mutex_unlock(&(layer)->lock)
+#else
+# define URING_LOCK(layer)
+# define URING_UNLOCK(layer)
+#endif
+
+/**********************/
+/* io_uring Functions */
+/**********************/
+
+typedef struct {
+    int fd;
+    UA_Byte *rings; /* the submission and completion queue share a mapping */
+    size_t ringsSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned sqEntries;
+    unsigned *sqHead, *sqTail, *sqMask;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+} Uring;
+
+static int
+uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argsz);
+}
+
+static int
+uring_register(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+static void
+Uring_deleteMembers(Uring *ring) {
+    if(ring->sqes)
+        munmap(ring->sqes, ring->sqesSize);
+    if(ring->rings)
+        munmap(ring->rings, ring->ringsSize);
+    if(ring->fd >= 0)
+        close(ring->fd);
+    memset(ring, 0, sizeof(Uring));
+    ring->fd = -1;
+}
+
+static UA_StatusCode
+Uring_init(Uring *ring, unsigned entries) {
+    memset(ring, 0, sizeof(Uring));
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring->fd = uring_setup(entries, &p);
+    if(ring->fd < 0)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    /* waiting with a timeout requires the extended arguments (Linux 5.11) */
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        Uring_deleteMembers(ring);
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    }
+
+    size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ringsSize = (sqSize > cqSize) ? sqSize : cqSize;
+    void *rings = mmap(NULL, ring->ringsSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(rings == MAP_FAILED) {
+        Uring_deleteMembers(ring);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    ring->rings = rings;
+    ring->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        Uring_deleteMembers(ring);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    ring->sqes = sqes;
+
+    ring->sqEntries = p.sq_entries;
+    ring->sqHead = (unsigned*)(void*)&ring->rings[p.sq_off.head];
+    ring->sqTail = (unsigned*)(void*)&ring->rings[p.sq_off.tail];
+    ring->sqMask = (unsigned*)(void*)&ring->rings[p.sq_off.ring_mask];
+    ring->cqHead = (unsigned*)(void*)&ring->rings[p.cq_off.head];
+    ring->cqTail = (unsigned*)(void*)&ring->rings[p.cq_off.tail];
+    ring->cqMask = (unsigned*)(void*)&ring->rings[p.cq_off.ring_mask];
+    ring->cqes = (struct io_uring_cqe*)(void*)&ring->rings[p.cq_off.cqes];
+
+    /* the entries are always submitted in order */
+    unsigned *array = (unsigned*)(void*)&ring->rings[p.sq_off.array];
+    for(unsigned i = 0; i < p.sq_entries; i++)
+        array[i] = i;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns a zeroed submission queue entry or NULL if the queue is full. The
+ * entry is handed to the kernel with Uring_push. */
+static struct io_uring_sqe *
+Uring_getSqe(Uring *ring) {
+    unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sqTail;
+    if(tail - head >= ring->sqEntries)
+        return NULL;
+    struct io_uring_sqe *sqe = &ring->sqes[tail & *ring->sqMask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+static void
+Uring_push(Uring *ring) {
+    __atomic_store_n(ring->sqTail, *ring->sqTail + 1, __ATOMIC_RELEASE);
+}
+
+/* Submits the pushed entries. If minComplete > 0, waits up to timeout
+ * microseconds until so many completions are available. */
+static int
+Uring_enter(Uring *ring, unsigned minComplete, UA_UInt32 timeout) {
+    unsigned toSubmit = __atomic_load_n(ring->sqTail, __ATOMIC_ACQUIRE) -
+        __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    if(minComplete == 0) {
+        if(toSubmit == 0)
+            return 0;
+        return uring_enter(ring->fd, toSubmit, 0, 0, NULL, 0);
+    }
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000000;
+    ts.tv_nsec = (long long)(timeout % 1000000) * 1000;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (UA_UInt64)(uintptr_t)&ts;
+    return uring_enter(ring->fd, toSubmit, minComplete,
+                       IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+/***********************************/
+/* Server NetworkLayer io_uring    */
+/***********************************/
+
+typedef struct UringSend {
+    SIMPLEQ_ENTRY(UringSend) next;
+    UA_ByteString buf;
+    size_t sent;
+} UringSend;
+
+typedef struct UringConnection {
+    UA_Connection connection;
+    LIST_ENTRY(UringConnection) pointers; /* all connections of the layer */
+    LIST_ENTRY(UringConnection) rearmPointers; /* connections waiting for a receive */
+    SIMPLEQ_HEAD(UringSendQueue, UringSend) sendQueue; /* the first entry is in flight */
+    UA_Boolean sending; /* a send operation is in flight */
+    UA_Boolean receiving; /* a receive operation is armed */
+    UA_Boolean rearm; /* in the rearm list */
+    UA_Boolean detached; /* closed and detached from the server */
+} UringConnection;
+
+typedef struct {
+    UA_ConnectionConfig conf;
+    UA_UInt16 port;
+    UA_Logger logger; // Set during start
+
+    Uring ring;
+    UA_Int32 serversockfd;
+    UA_Boolean accepting; /* the multishot accept is armed */
+    UA_Boolean multishotRecv; /* cleared if the kernel does not support it */
+
+    /* provided receive buffers */
+    struct io_uring_buf_ring *bufRing;
+    size_t bufRingSize;
+    UA_Byte *buffers; /* URINGRECVBUFFERS buffers of recvBufferSize */
+    size_t freeBuffers; /* buffers that are currently in the ring */
+
+    size_t connectionsSize;
+    LIST_HEAD(, UringConnection) connections;
+    LIST_HEAD(, UringConnection) rearmConnections;
+    size_t rearmConnectionsSize;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t lock; /* submission queue, buffer ring and send queues */
+    pthread_t networkThread;
+#endif
+} ServerNetworkLayerUring;
+
+static UA_StatusCode
+ServerNetworkLayerUring_getSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    return UA_ByteString_allocBuffer(buf, length);
+}
+
+static void
+ServerNetworkLayerUring_releaseSendBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_deleteMembers(buf);
+}
+
+/* Gets a submission queue entry. Submits the queue first if it is full. Call
+ * with the lock held. */
+static struct io_uring_sqe *
+ServerNetworkLayerUring_getSqe(ServerNetworkLayerUring *layer) {
+    struct io_uring_sqe *sqe = Uring_getSqe(&layer->ring);
+    if(!sqe) {
+        Uring_enter(&layer->ring, 0, 0);
+        sqe = Uring_getSqe(&layer->ring);
+    }
+    if(!sqe)
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "The io_uring submission queue is full");
+    return sqe;
+}
+
+/* Hands a receive buffer (back) to the kernel. Call with the lock held. */
+static void
+ServerNetworkLayerUring_provideBuffer(ServerNetworkLayerUring *layer, UA_UInt16 bid) {
+    struct io_uring_buf_ring *br = layer->bufRing;
+    UA_UInt16 tail = br->tail;
+    /* the tail overlaps with the first entry. set the fields one by one. */
+    struct io_uring_buf *buf = &br->bufs[tail & (URINGRECVBUFFERS - 1)];
+    buf->addr = (UA_UInt64)(uintptr_t)&layer->buffers[(size_t)bid * layer->conf.recvBufferSize];
+    buf->len = layer->conf.recvBufferSize;
+    buf->bid = bid;
+    __atomic_store_n(&br->tail, (UA_UInt16)(tail + 1), __ATOMIC_RELEASE);
+    layer->freeBuffers++;
+}
+
+static void
+ServerNetworkLayerUring_releaseRecvBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    if(!buf->data)
+        return;
+    ServerNetworkLayerUring *layer = connection->handle;
+    size_t bid = (size_t)(buf->data - layer->buffers) / layer->conf.recvBufferSize;
+    buf->data = NULL;
+    buf->length = 0;
+    URING_LOCK(layer);
+    if(layer->bufRing) /* not after the layer was stopped */
+        ServerNetworkLayerUring_provideBuffer(layer, (UA_UInt16)bid);
+    URING_UNLOCK(layer);
+}
+
+/* Call with the lock held */
+static void
+ServerNetworkLayerUring_armAccept(ServerNetworkLayerUring *layer) {
+    struct io_uring_sqe *sqe = ServerNetworkLayerUring_getSqe(layer);
+    if(!sqe)
+        return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = layer->serversockfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = URING_ACCEPT;
+    Uring_push(&layer->ring);
+    layer->accepting = true;
+}
+
+/* Call with the lock held */
+static void
+ServerNetworkLayerUring_queueRearm(ServerNetworkLayerUring *layer, UringConnection *c) {
+    if(c->rearm)
+        return;
+    c->rearm = true;
+    LIST_INSERT_HEAD(&layer->rearmConnections, c, rearmPointers);
+    layer->rearmConnectionsSize++;
+}
+
+/* Call with the lock held */
+static void
+ServerNetworkLayerUring_armRecv(ServerNetworkLayerUring *layer, UringConnection *c) {
+    struct io_uring_sqe *sqe = ServerNetworkLayerUring_getSqe(layer);
+    if(!sqe) {
+        ServerNetworkLayerUring_queueRearm(layer, c);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->connection.sockfd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URINGBUFFERGROUP;
+    if(layer->multishotRecv)
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    else
+        sqe->len = layer->conf.recvBufferSize;
+    sqe->user_data = (UA_UInt64)(uintptr_t)c | URING_RECV;
+    Uring_push(&layer->ring);
+    c->receiving = true;
+}
+
+/* Sends the first queued buffer. Call with the lock held. */
+static void
+UringConnection_sendFirst(ServerNetworkLayerUring *layer, UringConnection *c) {
+    UringSend *s = SIMPLEQ_FIRST(&c->sendQueue);
+    struct io_uring_sqe *sqe = ServerNetworkLayerUring_getSqe(layer);
+    if(!sqe) {
+        /* the receive side notices the shutdown and cleans up */
+        shutdown(c->connection.sockfd, SHUT_RDWR);
+        return;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c->connection.sockfd;
+    sqe->addr = (UA_UInt64)(uintptr_t)&s->buf.data[s->sent];
+    sqe->len = (UA_UInt32)(s->buf.length - s->sent);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (UA_UInt64)(uintptr_t)c | URING_SEND;
+    Uring_push(&layer->ring);
+    c->sending = true;
+}
+
+static void
+UringConnection_clearSendQueue(UringConnection *c) {
+    UringSend *s;
+    while((s = SIMPLEQ_FIRST(&c->sendQueue))) {
+        SIMPLEQ_REMOVE_HEAD(&c->sendQueue, next);
+        UA_ByteString_deleteMembers(&s->buf);
+        free(s);
+    }
+}
+
+static UA_StatusCode
+ServerNetworkLayerUring_send(UA_Connection *connection, UA_ByteString *buf) {
+    if(connection->state == UA_CONNECTION_CLOSED) {
+        UA_ByteString_deleteMembers(buf);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+    if(buf->length == 0) {
+        UA_ByteString_deleteMembers(buf);
+        return UA_STATUSCODE_GOOD;
+    }
+    UringSend *s = malloc(sizeof(UringSend));
+    if(!s) {
+        UA_ByteString_deleteMembers(buf);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    s->buf = *buf;
+    s->sent = 0;
+    UA_ByteString_init(buf);
+
+    ServerNetworkLayerUring *layer = connection->handle;
+    UringConnection *c = (UringConnection*)connection;
+    URING_LOCK(layer);
+    SIMPLEQ_INSERT_TAIL(&c->sendQueue, s, next);
+    if(!c->sending)
+        UringConnection_sendFirst(layer, c);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* the networking thread might wait in GetWork for a while */
+    if(!pthread_equal(pthread_self(), layer->networkThread))
+        Uring_enter(&layer->ring, 0, 0);
+#endif
+    URING_UNLOCK(layer);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* callback triggered from the server */
+static void
+ServerNetworkLayerUring_closeConnection(UA_Connection *connection) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(uatomic_xchg(&connection->state, UA_CONNECTION_CLOSED) == UA_CONNECTION_CLOSED)
+        return;
+#else
+    if(connection->state == UA_CONNECTION_CLOSED)
+        return;
+    connection->state = UA_CONNECTION_CLOSED;
+#endif
+    ServerNetworkLayerUring *layer = connection->handle;
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Closing the Connection %i",
+                connection->sockfd);
+    /* only "shutdown" here. the pending receive completes and the connection
+       is cleaned up in GetWork */
+    shutdown(connection->sockfd, SHUT_RDWR);
+}
+
+static void
+ServerNetworkLayerUring_freeConnection(UA_Server *server, void *ptr) {
+    UringConnection *c = ptr;
+    close(c->connection.sockfd);
+    UringConnection_clearSendQueue(c);
+    UA_Connection_deleteMembers(&c->connection);
+    free(c);
+}
+
+/* The connection was closed from either side. Detach it from the server. Call
+ * with the lock held. */
+static void
+ServerNetworkLayerUring_detach(ServerNetworkLayerUring *layer, UringConnection *c,
+                               UA_Job *js, size_t *j) {
+    if(c->detached)
+        return;
+    c->detached = true;
+    c->connection.state = UA_CONNECTION_CLOSED;
+    shutdown(c->connection.sockfd, SHUT_RDWR);
+    js[*j].type = UA_JOBTYPE_DETACHCONNECTION;
+    js[*j].job.closeConnection = &c->connection;
+    (*j)++;
+}
+
+/* Frees a detached connection (delayed) once no operation is in flight. Call
+ * with the lock held. */
+static void
+ServerNetworkLayerUring_retire(ServerNetworkLayerUring *layer, UringConnection *c,
+                               UA_Job *js, size_t *j) {
+    if(!c->detached || c->sending || c->receiving)
+        return;
+    LIST_REMOVE(c, pointers);
+    layer->connectionsSize--;
+    if(c->rearm) {
+        LIST_REMOVE(c, rearmPointers);
+        layer->rearmConnectionsSize--;
+        c->rearm = false;
+    }
+    js[*j].type = UA_JOBTYPE_METHODCALL_DELAYED;
+    js[*j].job.methodCall.method = ServerNetworkLayerUring_freeConnection;
+    js[*j].job.methodCall.data = c;
+    (*j)++;
+}
+
+/* Call with the lock held */
+static void
+ServerNetworkLayerUring_add(ServerNetworkLayerUring *layer, UA_Int32 newsockfd) {
+    UringConnection *c = malloc(sizeof(UringConnection));
+    if(!c) {
+        UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK, "No memory for a new Connection");
+        close(newsockfd);
+        return;
+    }
+    int i = 1;
+    setsockopt(newsockfd, IPPROTO_TCP, TCP_NODELAY, (void *)&i, sizeof(i));
+
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(struct sockaddr_in);
+    getpeername(newsockfd, (struct sockaddr*)&addr, &addrlen);
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "New Connection %i over io_uring from %s:%d",
+                newsockfd, inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+
+    UA_Connection_init(&c->connection);
+    c->connection.sockfd = newsockfd;
+    c->connection.handle = layer;
+    c->connection.localConf = layer->conf;
+    c->connection.send = ServerNetworkLayerUring_send;
+    c->connection.close = ServerNetworkLayerUring_closeConnection;
+    c->connection.getSendBuffer = ServerNetworkLayerUring_getSendBuffer;
+    c->connection.releaseSendBuffer = ServerNetworkLayerUring_releaseSendBuffer;
+    c->connection.releaseRecvBuffer = ServerNetworkLayerUring_releaseRecvBuffer;
+    c->connection.state = UA_CONNECTION_OPENING;
+    SIMPLEQ_INIT(&c->sendQueue);
+    c->sending = false;
+    c->receiving = false;
+    c->rearm = false;
+    c->detached = false;
+    LIST_INSERT_HEAD(&layer->connections, c, pointers);
+    layer->connectionsSize++;
+    ServerNetworkLayerUring_armRecv(layer, c);
+}
+
+static void
+ServerNetworkLayerUring_accepted(ServerNetworkLayerUring *layer, int res, unsigned flags) {
+    if(!(flags & IORING_CQE_F_MORE))
+        layer->accepting = false; /* re-armed in the next GetWork */
+    if(res >= 0)
+        ServerNetworkLayerUring_add(layer, res);
+    else if(res != -ECANCELED)
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Accepting a connection failed with error %i", -res);
+}
+
+static void
+ServerNetworkLayerUring_received(ServerNetworkLayerUring *layer, UringConnection *c,
+                                 int res, unsigned flags, UA_Job *js, size_t *j) {
+    if(!(flags & IORING_CQE_F_MORE))
+        c->receiving = false;
+    if(flags & IORING_CQE_F_BUFFER) {
+        layer->freeBuffers--;
+        UA_UInt16 bid = (UA_UInt16)(flags >> IORING_CQE_BUFFER_SHIFT);
+        if(res <= 0 || c->detached) {
+            /* nothing for the server */
+            ServerNetworkLayerUring_provideBuffer(layer, bid);
+        } else {
+            js[*j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
+            js[*j].job.binaryMessage.connection = &c->connection;
+            js[*j].job.binaryMessage.message.data =
+                &layer->buffers[(size_t)bid * layer->conf.recvBufferSize];
+            js[*j].job.binaryMessage.message.length = (size_t)res;
+            (*j)++;
+        }
+    }
+
+    if(c->detached) {
+        ServerNetworkLayerUring_retire(layer, c, js, j);
+        return;
+    }
+    if(res > 0) {
+        if(!c->receiving)
+            ServerNetworkLayerUring_armRecv(layer, c);
+        return;
+    }
+    if(res == -ENOBUFS) {
+        /* wait until the server returns buffers */
+        ServerNetworkLayerUring_queueRearm(layer, c);
+        return;
+    }
+    if(res == -EINVAL && layer->multishotRecv) {
+        UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                    "The kernel does not support multishot receives with io_uring");
+        layer->multishotRecv = false;
+        ServerNetworkLayerUring_armRecv(layer, c);
+        return;
+    }
+
+    /* the connection was closed */
+    ServerNetworkLayerUring_detach(layer, c, js, j);
+    ServerNetworkLayerUring_retire(layer, c, js, j);
+}
+
+static void
+ServerNetworkLayerUring_sent(ServerNetworkLayerUring *layer, UringConnection *c,
+                             int res, UA_Job *js, size_t *j) {
+    c->sending = false;
+    UringSend *s = SIMPLEQ_FIRST(&c->sendQueue);
+    if(res <= 0) {
+        ServerNetworkLayerUring_detach(layer, c, js, j);
+    } else if(s) {
+        s->sent += (size_t)res;
+        if(s->sent >= s->buf.length) {
+            SIMPLEQ_REMOVE_HEAD(&c->sendQueue, next);
+            UA_ByteString_deleteMembers(&s->buf);
+            free(s);
+        }
+    }
+
+    if(c->detached) {
+        UringConnection_clearSendQueue(c);
+        ServerNetworkLayerUring_retire(layer, c, js, j);
+        return;
+    }
+    if(!SIMPLEQ_EMPTY(&c->sendQueue))
+        UringConnection_sendFirst(layer, c);
+}
+
+static size_t
+ServerNetworkLayerUring_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
+    ServerNetworkLayerUring *layer = nl->handle;
+    *jobs = NULL;
+
+    /* arm what has been terminated */
+    URING_LOCK(layer);
+#ifdef UA_ENABLE_MULTITHREADING
+    layer->networkThread = pthread_self();
+#endif
+    if(!layer->accepting)
+        ServerNetworkLayerUring_armAccept(layer);
+    if(layer->freeBuffers > 0) {
+        UringConnection *c;
+        while((c = LIST_FIRST(&layer->rearmConnections))) {
+            LIST_REMOVE(c, rearmPointers);
+            layer->rearmConnectionsSize--;
+            c->rearm = false;
+            ServerNetworkLayerUring_armRecv(layer, c);
+            if(c->rearm)
+                break; /* the submission queue is full */
+        }
+    }
+    URING_UNLOCK(layer);
+
+    /* submit everything and wait for completions (the timeout is in microseconds) */
+    Uring_enter(&layer->ring, 1, timeout);
+
+    URING_LOCK(layer);
+    unsigned head = *layer->ring.cqHead;
+    unsigned tail = __atomic_load_n(layer->ring.cqTail, __ATOMIC_ACQUIRE);
+    if(head == tail) {
+        URING_UNLOCK(layer);
+        return 0;
+    }
+
+    /* every completion results in at most a detach and a free job */
+    UA_Job *js = malloc(sizeof(UA_Job) * (size_t)(tail - head) * 2);
+    if(!js) {
+        URING_UNLOCK(layer);
+        return 0;
+    }
+
+    size_t j = 0;
+    for(; head != tail; head++) {
+        struct io_uring_cqe *cqe = &layer->ring.cqes[head & *layer->ring.cqMask];
+        UringConnection *c = (UringConnection*)(uintptr_t)(cqe->user_data & ~(UA_UInt64)URING_TAGMASK);
+        switch(cqe->user_data & URING_TAGMASK) {
+        case URING_ACCEPT:
+            ServerNetworkLayerUring_accepted(layer, cqe->res, cqe->flags);
+            break;
+        case URING_RECV:
+            ServerNetworkLayerUring_received(layer, c, cqe->res, cqe->flags, js, &j);
+            break;
+        case URING_SEND:
+            ServerNetworkLayerUring_sent(layer, c, cqe->res, js, &j);
+            break;
+        default:
+            break;
+        }
+    }
+    __atomic_store_n(layer->ring.cqHead, head, __ATOMIC_RELEASE);
+    URING_UNLOCK(layer);
+
+    if(j == 0) {
+        free(js);
+        return 0;
+    }
+    *jobs = js;
+    return j;
+}
+
+/* Sets up the ring and registers the provided receive buffers */
+static UA_StatusCode
+ServerNetworkLayerUring_setupRing(ServerNetworkLayerUring *layer) {
+    UA_StatusCode retval = Uring_init(&layer->ring, URINGENTRIES);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    layer->bufRingSize = URINGRECVBUFFERS * sizeof(struct io_uring_buf);
+    void *br = mmap(NULL, layer->bufRingSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(br == MAP_FAILED)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    layer->bufRing = br;
+
+    /* provided buffer rings require Linux 5.19 */
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (UA_UInt64)(uintptr_t)br;
+    reg.ring_entries = URINGRECVBUFFERS;
+    reg.bgid = URINGBUFFERGROUP;
+    if(uring_register(layer->ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    layer->buffers = malloc((size_t)URINGRECVBUFFERS * layer->conf.recvBufferSize);
+    if(!layer->buffers)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(UA_UInt16 i = 0; i < URINGRECVBUFFERS; i++)
+        ServerNetworkLayerUring_provideBuffer(layer, i);
+    layer->multishotRecv = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void ServerNetworkLayerUring_deleteMembers(UA_ServerNetworkLayer *nl);
+
+static UA_StatusCode
+ServerNetworkLayerUring_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    ServerNetworkLayerUring *layer = nl->handle;
+    layer->logger = logger;
+
+    /* replace this networklayer with the TCP networklayer if io_uring cannot
+       be used */
+    if(ServerNetworkLayerUring_setupRing(layer) != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "io_uring is not available, falling back to the TCP network layer");
+        UA_ConnectionConfig conf = layer->conf;
+        UA_UInt16 port = layer->port;
+        ServerNetworkLayerUring_deleteMembers(nl);
+        *nl = UA_ServerNetworkLayerTCP(conf, port);
+        return nl->start(nl, logger);
+    }
+
+    /* get the discovery url from the hostname */
+    UA_String du = UA_STRING_NULL;
+    char hostname[256];
+    char discoveryUrl[256];
+    if(gethostname(hostname, 255) == 0) {
+        du.length = (size_t)snprintf(discoveryUrl, 255, "opc.tcp://%s:%d", hostname, layer->port);
+        du.data = (UA_Byte*)discoveryUrl;
+    }
+    UA_String_copy(&du, &nl->discoveryUrl);
+
+    /* open the server socket */
+    if((layer->serversockfd = socket(PF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error opening socket");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    const struct sockaddr_in serv_addr =
+        {.sin_family = AF_INET, .sin_addr.s_addr = INADDR_ANY,
+         .sin_port = htons(layer->port), .sin_zero = {0}};
+    int optval = 1;
+    if(setsockopt(layer->serversockfd, SOL_SOCKET,
+                  SO_REUSEADDR, (const char *)&optval, sizeof(optval)) == -1) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Error during setting of socket options");
+        close(layer->serversockfd);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    if(bind(layer->serversockfd, (const struct sockaddr *)&serv_addr,
+            sizeof(serv_addr)) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error during socket binding");
+        close(layer->serversockfd);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    listen(layer->serversockfd, MAXBACKLOG);
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "io_uring network layer listening on %.*s",
+                nl->discoveryUrl.length, nl->discoveryUrl.data);
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t
+ServerNetworkLayerUring_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
+    ServerNetworkLayerUring *layer = nl->handle;
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "Shutting down the io_uring network layer with %d open connection(s)",
+                (int)layer->connectionsSize);
+    shutdown(layer->serversockfd, SHUT_RDWR);
+    close(layer->serversockfd);
+
+    /* closing the ring cancels all operations in flight. the buffers stay
+       allocated until deleteMembers as the server may still hold some. */
+    URING_LOCK(layer);
+    Uring_deleteMembers(&layer->ring);
+    munmap(layer->bufRing, layer->bufRingSize);
+    layer->bufRing = NULL;
+    URING_UNLOCK(layer);
+
+    UA_Job *items = malloc(sizeof(UA_Job) * layer->connectionsSize * 2);
+    if(!items)
+        return 0;
+    size_t j = 0;
+    UringConnection *c, *c_tmp;
+    LIST_FOREACH_SAFE(c, &layer->connections, pointers, c_tmp) {
+        c->sending = false;
+        c->receiving = false;
+        ServerNetworkLayerUring_detach(layer, c, items, &j);
+        ServerNetworkLayerUring_retire(layer, c, items, &j);
+    }
+    *jobs = items;
+    return j;
+}
+
+/* run only when the server is stopped */
+static void
+ServerNetworkLayerUring_deleteMembers(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerUring *layer = nl->handle;
+    Uring_deleteMembers(&layer->ring);
+    if(layer->bufRing)
+        munmap(layer->bufRing, layer->bufRingSize);
+    free(layer->buffers);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&layer->lock);
+#endif
+    free(layer);
+    UA_String_deleteMembers(&nl->discoveryUrl);
+}
+
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerIOUring(UA_ConnectionConfig conf, UA_UInt16 port) {
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
+    ServerNetworkLayerUring *layer = calloc(1, sizeof(ServerNetworkLayerUring));
+    if(!layer)
+        return nl;
+
+    layer->conf = conf;
+    layer->port = port;
+    layer->ring.fd = -1;
+    layer->serversockfd = -1;
+    LIST_INIT(&layer->connections);
+    LIST_INIT(&layer->rearmConnections);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&layer->lock, NULL);
+    layer->networkThread = pthread_self();
+#endif
+
+    nl.handle = layer;
+    nl.start = ServerNetworkLayerUring_start;
+    nl.getJobs = ServerNetworkLayerUring_getJobs;
+    nl.stop = ServerNetworkLayerUring_stop;
+    nl.deleteMembers = ServerNetworkLayerUring_deleteMembers;
+    return nl;
+}
+
+/*******************************/
+/* Client Connection io_uring  */
+/*******************************/
+
+/* Submits the pushed entries and waits until count operations have completed.
+ * The result of the operation with user_data i is stored in results[i]. */
+static UA_StatusCode
+Uring_collect(Uring *ring, int *results, unsigned count) {
+    unsigned done = 0;
+    while(done < count) {
+        unsigned toSubmit = *ring->sqTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+        if(uring_enter(ring->fd, toSubmit, count - done, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+           errno != EINTR)
+            return UA_STATUSCODE_BADINTERNALERROR;
+        unsigned head = *ring->cqHead;
+        unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        for(; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+            if(cqe->user_data < count)
+                results[cqe->user_data] = cqe->res;
+            done++;
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ClientConnectionUring_close(UA_Connection *connection) {
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_Boolean closed = (uatomic_xchg(&connection->state, UA_CONNECTION_CLOSED) == UA_CONNECTION_CLOSED);
+#else
+    UA_Boolean closed = (connection->state == UA_CONNECTION_CLOSED);
+    connection->state = UA_CONNECTION_CLOSED;
+#endif
+    if(!closed) {
+        shutdown(connection->sockfd, SHUT_RDWR);
+        close(connection->sockfd);
+    }
+    Uring *ring = connection->handle;
+    if(ring) {
+        Uring_deleteMembers(ring);
+        free(ring);
+        connection->handle = NULL;
+    }
+}
+
+static UA_StatusCode
+ClientConnectionUring_send(UA_Connection *connection, UA_ByteString *buf) {
+    Uring *ring = connection->handle;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    size_t sent = 0;
+    while(sent < buf->length) {
+        struct io_uring_sqe *sqe = Uring_getSqe(ring);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = connection->sockfd;
+        sqe->addr = (UA_UInt64)(uintptr_t)&buf->data[sent];
+        sqe->len = (UA_UInt32)(buf->length - sent);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = 0;
+        Uring_push(ring);
+        int res = 0;
+        if(Uring_collect(ring, &res, 1) != UA_STATUSCODE_GOOD || res <= 0) {
+            connection->close(connection);
+            retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+            break;
+        }
+        sent += (size_t)res;
+    }
+    UA_ByteString_deleteMembers(buf);
+    return retval;
+}
+
+static UA_StatusCode
+ClientConnectionUring_recv(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeout) {
+    Uring *ring = connection->handle;
+    response->data = malloc(connection->localConf.recvBufferSize);
+    if(!response->data) {
+        response->length = 0;
+        return UA_STATUSCODE_BADOUTOFMEMORY; /* not enough memory retry */
+    }
+
+    /* the receive is linked with a timeout (given in milliseconds) */
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (long long)(timeout % 1000) * 1000000;
+    struct io_uring_sqe *sqe = Uring_getSqe(ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = connection->sockfd;
+    sqe->addr = (UA_UInt64)(uintptr_t)response->data;
+    sqe->len = connection->localConf.recvBufferSize;
+    sqe->user_data = 0;
+    unsigned count = 1;
+    if(timeout > 0) {
+        sqe->flags = IOSQE_IO_LINK;
+        Uring_push(ring);
+        sqe = Uring_getSqe(ring);
+        sqe->opcode = IORING_OP_LINK_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = (UA_UInt64)(uintptr_t)&ts;
+        sqe->len = 1;
+        sqe->user_data = 1;
+        count = 2;
+    }
+    Uring_push(ring);
+
+    int results[2] = {0, 0};
+    UA_StatusCode retval = Uring_collect(ring, results, count);
+    if(retval == UA_STATUSCODE_GOOD && results[0] > 0) {
+        response->length = (size_t)results[0];
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_ByteString_deleteMembers(response);
+    if(retval == UA_STATUSCODE_GOOD && (results[0] == -EINTR || results[0] == -EAGAIN))
+        return UA_STATUSCODE_GOOD; /* retry */
+    /* closed from remote or timed out (canceled) */
+    connection->close(connection);
+    return UA_STATUSCODE_BADCONNECTIONCLOSED;
+}
+
+UA_Connection
+UA_ClientConnectionIOUring(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger) {
+    UA_Connection connection = UA_ClientConnectionTCP(conf, endpointUrl, logger);
+    if(connection.state != UA_CONNECTION_OPENING)
+        return connection;
+
+    /* keep the TCP connection if io_uring cannot be used */
+    Uring *ring = malloc(sizeof(Uring));
+    if(!ring || Uring_init(ring, 4) != UA_STATUSCODE_GOOD) {
+        free(ring);
+        UA_LOG_INFO(logger, UA_LOGCATEGORY_NETWORK,
+                    "io_uring is not available, using the TCP connection");
+        return connection;
+    }
+    connection.handle = ring;
+    connection.send = ClientConnectionUring_send;
+    connection.recv = ClientConnectionUring_recv;
+    connection.close = ClientConnectionUring_close;
+    return connection;
+}
@@ -0,0 +1,36 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+#ifndef NETWORKLAYERURING_H_
+#define NETWORKLAYERURING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_server.h"
+#include "ua_client.h"
+
+/** @brief Create a TCP networklayer that is driven by io_uring (Linux only).
+ *
+ * Connections are accepted with a multishot accept and received into a ring
+ * of provided buffers. Responses are collected and submitted together once per
+ * call to getJobs. If the kernel does not support the required io_uring
+ * features, the networklayer turns into the ordinary TCP networklayer when it
+ * is started. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerIOUring(UA_ConnectionConfig conf, UA_UInt16 port);
+
+/** @brief Open a client connection whose sends and receives go through
+ * io_uring. Falls back to the ordinary TCP connection if io_uring is not
+ * available. */
+UA_Connection UA_EXPORT
+UA_ClientConnectionIOUring(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* NETWORKLAYERURING_H_ */
@@ -13,7 +13,7 @@
 const UA_EXPORT UA_ClientConfig UA_ClientConfig_standard =
     { .timeout = 5000 /* ms receive timout */, .secureChannelLifeTime = 600000,
       {.protocolVersion = 0, .sendBufferSize = 65536, .recvBufferSize  = 65536,
-       .maxMessageSize = 65536, .maxChunkCount = 1}};
+       .maxMessageSize = 16777216, .maxChunkCount = 0 /* no limit */}};
 
 /*********************/
 /* Create and Delete */
@@ -56,6 +56,8 @@ UA_Client * UA_Client_new(UA_ClientConfig config, UA_Logger logger) {
 
 static void UA_Client_deleteMembers(UA_Client* client) {
     UA_Client_disconnect(client);
+    if(client->connection.close)
+        client->connection.close(&client->connection);
     UA_Connection_deleteMembers(&client->connection);
     UA_SecureChannel_deleteMembersCleanup(&client->channel);
     if(client->endpointUrl.data)
@@ -99,6 +101,142 @@ void UA_Client_delete(UA_Client* client){
 /* Manage the Connection */
 /*************************/
 
+/* A response in several MSG chunks is reassembled behind the headers of the
+ * first chunk */
+typedef struct {
+    UA_ByteString bytes;
+    size_t allocated;
+    size_t chunksSize;
+} ReplyChunks;
+
+static UA_StatusCode
+appendReplyChunk(UA_Client *client, ReplyChunks *rc, const UA_ByteString *msg) {
+    const UA_ConnectionConfig *localConf = &client->connection.localConf;
+    if(localConf->maxChunkCount > 0 && rc->chunksSize >= localConf->maxChunkCount)
+        return UA_STATUSCODE_BADRESPONSETOOLARGE;
+    size_t offset = (rc->chunksSize > 0) ? UA_SECURECHANNEL_MESSAGE_HEADERSIZE : 0;
+    size_t length = msg->length - offset;
+    size_t needed = rc->bytes.length + length;
+    if(localConf->maxMessageSize > 0 &&
+       needed - UA_SECURECHANNEL_MESSAGE_HEADERSIZE > localConf->maxMessageSize)
+        return UA_STATUSCODE_BADRESPONSETOOLARGE;
+    if(needed > rc->allocated) {
+        size_t size = rc->allocated * 2;
+        if(size < needed)
+            size = needed * 2;
+        UA_Byte *data = UA_realloc(rc->bytes.data, size);
+        if(!data)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        rc->bytes.data = data;
+        rc->allocated = size;
+    }
+    memcpy(&rc->bytes.data[rc->bytes.length], &msg->data[offset], length);
+    rc->bytes.length = needed;
+    rc->chunksSize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Sets the reply once it is complete */
+static UA_StatusCode
+processReplyMessage(UA_Client *client, ReplyChunks *rc, const UA_ByteString *msg,
+                    UA_ByteString *reply) {
+    size_t offset = 0;
+    UA_TcpMessageHeader header;
+    UA_StatusCode retval = UA_TcpMessageHeader_decodeBinary(msg, &offset, &header);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Not chunked */
+    if((header.messageTypeAndFinal & 0xffffff) != (UA_MESSAGETYPEANDFINAL_MSGF & 0xffffff) ||
+       (header.messageTypeAndFinal == UA_MESSAGETYPEANDFINAL_MSGF && rc->chunksSize == 0)) {
+        *reply = *msg;
+        return UA_STATUSCODE_GOOD;
+    }
+    if(msg->length < UA_SECURECHANNEL_MESSAGE_HEADERSIZE)
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+    switch(header.messageTypeAndFinal) {
+    case UA_MESSAGETYPEANDFINAL_MSGC:
+        return appendReplyChunk(client, rc, msg);
+    case UA_MESSAGETYPEANDFINAL_MSGF:
+        retval = appendReplyChunk(client, rc, msg);
+        if(retval == UA_STATUSCODE_GOOD)
+            *reply = rc->bytes;
+        return retval;
+    case UA_MESSAGETYPEANDFINAL_MSGA:
+        /* The server aborted the response with an error */
+        offset = UA_SECURECHANNEL_MESSAGE_HEADERSIZE;
+        retval = UA_STATUSCODE_BADCOMMUNICATIONERROR;
+        UA_StatusCode_decodeBinary(msg, &offset, &retval);
+        UA_LOG_INFO(client->logger, UA_LOGCATEGORY_CLIENT,
+                    "The server aborted the response with the error 0x%08x", retval);
+        return (retval != UA_STATUSCODE_GOOD) ? retval : UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    default:
+        return UA_STATUSCODE_BADTCPMESSAGETYPEINVALID;
+    }
+}
+
+/* Receives until a complete reply has arrived. A reply in a single message
+ * points into the received buffer or into the completed message that straddled
+ * several buffers. A reply in several MSG chunks is reassembled and returned in
+ * completed. Further messages in the buffer are dropped, the client waits for a
+ * single response. Release the buffers with releaseReply. */
+static UA_StatusCode
+receiveReply(UA_Client *client, UA_ByteString *buffer, UA_ByteString *completed, UA_ByteString *reply) {
+    UA_Connection *c = &client->connection;
+    ReplyChunks rc = {UA_BYTESTRING_NULL, 0, 0};
+    UA_ByteString_init(reply);
+    UA_StatusCode retval;
+    do {
+        UA_ByteString messages;
+        UA_ByteString_init(buffer);
+        retval = c->recv(c, buffer, client->config.timeout);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
+        retval = UA_Connection_completeMessages(c, buffer, completed, &messages);
+        if(retval != UA_STATUSCODE_GOOD) {
+            c->releaseRecvBuffer(c, buffer);
+            break;
+        }
+
+        /* Go over the received messages in order */
+        UA_ByteString *received[2] = {completed, &messages};
+        for(size_t i = 0; i < 2 && !reply->data && retval == UA_STATUSCODE_GOOD; i++) {
+            size_t pos = 0;
+            while(pos < received[i]->length && !reply->data && retval == UA_STATUSCODE_GOOD) {
+                UA_ByteString msg = {received[i]->length - pos, &received[i]->data[pos]};
+                size_t lengthPos = 4;
+                UA_UInt32 length = 0;
+                UA_UInt32_decodeBinary(&msg, &lengthPos, &length);
+                msg.length = length;
+                pos += length;
+                retval = processReplyMessage(client, &rc, &msg, reply);
+            }
+        }
+
+        /* The reply is not in the received buffers */
+        if(!reply->data || reply->data == rc.bytes.data) {
+            c->releaseRecvBuffer(c, buffer);
+            UA_ByteString_deleteMembers(completed);
+        }
+    } while(!reply->data && retval == UA_STATUSCODE_GOOD);
+
+    if(reply->data && reply->data == rc.bytes.data) {
+        UA_ByteString_init(buffer);
+        *completed = rc.bytes;
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_ByteString_deleteMembers(&rc.bytes);
+    return retval;
+}
+
+static void
+releaseReply(UA_Client *client, UA_ByteString *buffer, UA_ByteString *completed) {
+    if(buffer->data)
+        client->connection.releaseRecvBuffer(&client->connection, buffer);
+    UA_ByteString_deleteMembers(completed);
+}
+
 static UA_StatusCode HelAckHandshake(UA_Client *c) {
     UA_TcpMessageHeader messageHeader;
     messageHeader.messageTypeAndFinal = UA_MESSAGETYPEANDFINAL_HELF;
@@ -138,26 +276,18 @@ static UA_StatusCode HelAckHandshake(UA_Client *c) {
     }
     UA_LOG_DEBUG(c->logger, UA_LOGCATEGORY_NETWORK, "Sent HEL message");
 
-    UA_ByteString reply;
-    UA_ByteString_init(&reply);
-    UA_Boolean realloced = false;
-    do {
-        retval = c->connection.recv(&c->connection, &reply, c->config.timeout);
-        retval |= UA_Connection_completeMessages(&c->connection, &reply, &realloced);
-        if(retval != UA_STATUSCODE_GOOD) {
-            UA_LOG_INFO(c->logger, UA_LOGCATEGORY_NETWORK, "Receiving ACK message failed");
-            return retval;
-        }
-    } while(reply.length == 0);
+    UA_ByteString buffer, completed, reply;
+    retval = receiveReply(c, &buffer, &completed, &reply);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_INFO(c->logger, UA_LOGCATEGORY_NETWORK, "Receiving ACK message failed");
+        return retval;
+    }
 
     offset = 0;
     UA_TcpMessageHeader_decodeBinary(&reply, &offset, &messageHeader);
     UA_TcpAcknowledgeMessage ackMessage;
     retval = UA_TcpAcknowledgeMessage_decodeBinary(&reply, &offset, &ackMessage);
-    if(!realloced)
-        c->connection.releaseRecvBuffer(&c->connection, &reply);
-    else
-        UA_ByteString_deleteMembers(&reply);
+    releaseReply(c, &buffer, &completed);
 
     if(retval != UA_STATUSCODE_GOOD) {
         UA_LOG_INFO(c->logger, UA_LOGCATEGORY_NETWORK, "Decoding ACK message failed");
@@ -246,18 +376,13 @@ static UA_StatusCode SecureChannelHandshake(UA_Client *client, UA_Boolean renew)
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
 
-    UA_ByteString reply;
-    UA_ByteString_init(&reply);
-    UA_Boolean realloced = false;
-    do {
-        retval = c->recv(c, &reply, client->config.timeout);
-        retval |= UA_Connection_completeMessages(c, &reply, &realloced);
-        if(retval != UA_STATUSCODE_GOOD) {
-            UA_LOG_DEBUG(client->logger, UA_LOGCATEGORY_SECURECHANNEL,
-                         "Receiving OpenSecureChannelResponse failed");
-            return retval;
-        }
-    } while(reply.length == 0);
+    UA_ByteString buffer, completed, reply;
+    retval = receiveReply(client, &buffer, &completed, &reply);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_DEBUG(client->logger, UA_LOGCATEGORY_SECURECHANNEL,
+                     "Receiving OpenSecureChannelResponse failed");
+        return retval;
+    }
 
     offset = 0;
     UA_SecureConversationMessageHeader_decodeBinary(&reply, &offset, &messageHeader);
@@ -267,7 +392,7 @@ static UA_StatusCode SecureChannelHandshake(UA_Client *client, UA_Boolean renew)
     UA_NodeId expectedRequest = UA_NODEID_NUMERIC(0, UA_NS0ID_OPENSECURECHANNELRESPONSE +
                                                   UA_ENCODINGOFFSET_BINARY);
     if(!UA_NodeId_equal(&requestType, &expectedRequest)) {
-        UA_ByteString_deleteMembers(&reply);
+        releaseReply(client, &buffer, &completed);
         UA_AsymmetricAlgorithmSecurityHeader_deleteMembers(&asymHeader);
         UA_NodeId_deleteMembers(&requestType);
         UA_LOG_DEBUG(client->logger, UA_LOGCATEGORY_CLIENT,
@@ -278,10 +403,7 @@ static UA_StatusCode SecureChannelHandshake(UA_Client *client, UA_Boolean renew)
     UA_OpenSecureChannelResponse response;
     UA_OpenSecureChannelResponse_init(&response);
     retval = UA_OpenSecureChannelResponse_decodeBinary(&reply, &offset, &response);
-    if(!realloced)
-        c->releaseRecvBuffer(c, &reply);
-    else
-        UA_ByteString_deleteMembers(&reply);
+    releaseReply(client, &buffer, &completed);
         
     if(retval != UA_STATUSCODE_GOOD) {
         UA_LOG_DEBUG(client->logger, UA_LOGCATEGORY_SECURECHANNEL, "Decoding OpenSecureChannelResponse failed");
@@ -673,18 +795,13 @@ void __UA_Client_Service(UA_Client *client, const void *r, const UA_DataType *re
 
     /* Retrieve the response */
     // Todo: push this into the generic securechannel implementation for client and server
-    UA_ByteString reply;
-    UA_ByteString_init(&reply);
-    UA_Boolean realloced = false;
-    do {
-        retval = client->connection.recv(&client->connection, &reply, client->config.timeout);
-        retval |= UA_Connection_completeMessages(&client->connection, &reply, &realloced);
-        if(retval != UA_STATUSCODE_GOOD) {
-            respHeader->serviceResult = retval;
-            client->state = UA_CLIENTSTATE_ERRORED;
-            return;
-        }
-    } while(!reply.data);
+    UA_ByteString buffer, completed, reply;
+    retval = receiveReply(client, &buffer, &completed, &reply);
+    if(retval != UA_STATUSCODE_GOOD) {
+        respHeader->serviceResult = retval;
+        client->state = UA_CLIENTSTATE_ERRORED;
+        return;
+    }
 
     size_t offset = 0;
     UA_SecureConversationMessageHeader msgHeader;
@@ -720,10 +837,7 @@ void __UA_Client_Service(UA_Client *client, const void *r, const UA_DataType *re
 
  finish:
     UA_SymmetricAlgorithmSecurityHeader_deleteMembers(&symHeader);
-    if(!realloced)
-        client->connection.releaseRecvBuffer(&client->connection, &reply);
-    else
-        UA_ByteString_deleteMembers(&reply);
+    releaseReply(client, &buffer, &completed);
     if(retval != UA_STATUSCODE_GOOD){
         UA_LOG_INFO(client->logger, UA_LOGCATEGORY_CLIENT, "Error receiving the response");
         client->state = UA_CLIENTSTATE_ERRORED;
@@ -22,6 +22,8 @@ UA_UsernamePasswordLogin usernamePasswords[2] =
 
 const UA_ServerConfig UA_ServerConfig_standard = {
     .nThreads = 1,
+    .networkLayerThreads = false,
+    .parallelRequests = false,
     .logger = NULL,
 
     .buildInfo = {
@@ -49,7 +51,10 @@ const UA_ServerConfig UA_ServerConfig_standard = {
     .enableUsernamePasswordLogin = true,
     .usernamePasswordLogins = usernamePasswords,
     .usernamePasswordLoginsSize = 2,
-    
+
+    .maxChunkedRequests = 16,
+    .maxChunkedRequestsBytes = 4 * 1024 * 1024,
+
     .publishingIntervalLimits = { .max = 10000, .min = 0, .current = 0 },
     .lifeTimeCountLimits = { .max = 15000, .min = 0, .current = 0 },
     .keepAliveCountLimits = { .max = 100, .min = 0, .current = 0 },
@@ -277,6 +282,7 @@ void UA_Server_delete(UA_Server *server) {
     // Delete all internal data
     UA_SecureChannelManager_deleteMembers(&server->secureChannelManager);
     UA_SessionManager_deleteMembers(&server->sessionManager);
+    UA_Server_deleteServices(server);
     UA_RCU_LOCK();
     UA_NodeStore_delete(server->nodestore);
     UA_RCU_UNLOCK();
@@ -291,6 +297,7 @@ void UA_Server_delete(UA_Server *server) {
     pthread_cond_destroy(&server->dispatchQueue_condition);
 #endif
     UA_free(server);
+    UA_Arena_deleteMembers();
 }
 
 /* Recurring cleanup. Removing unused and timed-out channels and sessions */
@@ -500,6 +507,8 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_SessionManager_init(&server->sessionManager, MAXSESSIONCOUNT, MAXSESSIONLIFETIME,
                            STARTSESSIONID, server);
 
+    UA_Server_initServices(server);
+
     UA_Job cleanup = {.type = UA_JOBTYPE_METHODCALL,
                       .job.methodCall = {.method = UA_Server_cleanup, .data = NULL} };
     UA_Server_addRepeatedJob(server, cleanup, 10000, NULL);
@@ -107,12 +107,13 @@ static void processOPN(UA_Connection *connection, UA_Server *server, const UA_By
         return;
     }
 
-    /* send the response with an asymmetric security header */
-#ifndef UA_ENABLE_MULTITHREADING
-    seqHeader.sequenceNumber = ++channel->sequenceNumber;
-#else
-    seqHeader.sequenceNumber = uatomic_add_return(&channel->sequenceNumber, 1);
+    /* send the response with an asymmetric security header. Responses of
+     * worker threads are sent under the same lock. So the sequence numbers
+     * go out in order also when the channel is renewed. */
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&channel->sendLock);
 #endif
+    seqHeader.sequenceNumber = ++channel->sequenceNumber;
 
     UA_SecureConversationMessageHeader respHeader;
     respHeader.messageHeader.messageTypeAndFinal = UA_MESSAGETYPEANDFINAL_OPNF;
@@ -125,6 +126,9 @@ static void processOPN(UA_Connection *connection, UA_Server *server, const UA_By
     UA_ByteString resp_msg;
     retval = connection->getSendBuffer(connection, connection->remoteConf.recvBufferSize, &resp_msg);
     if(retval != UA_STATUSCODE_GOOD) {
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_unlock(&channel->sendLock);
+#endif
         UA_OpenSecureChannelResponse_deleteMembers(&p);
         UA_AsymmetricAlgorithmSecurityHeader_deleteMembers(&asymHeader);
         return;
@@ -146,6 +150,9 @@ static void processOPN(UA_Connection *connection, UA_Server *server, const UA_By
         resp_msg.length = respHeader.messageHeader.messageSize;
         connection->send(connection, &resp_msg);
     }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&channel->sendLock);
+#endif
 
     UA_OpenSecureChannelResponse_deleteMembers(&p);
     UA_AsymmetricAlgorithmSecurityHeader_deleteMembers(&asymHeader);
@@ -156,293 +163,627 @@ static void init_response_header(const UA_RequestHeader *p, UA_ResponseHeader *r
     r->timestamp = UA_DateTime_now();
 }
 
-static void
-getServicePointers(UA_UInt32 requestTypeId, const UA_DataType **requestType,
-                   const UA_DataType **responseType, UA_Service *service) {
-    switch(requestTypeId - UA_ENCODINGOFFSET_BINARY) {
-    case UA_NS0ID_GETENDPOINTSREQUEST:
-        *service = (UA_Service)Service_GetEndpoints;
-        *requestType = &UA_TYPES[UA_TYPES_GETENDPOINTSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_GETENDPOINTSRESPONSE];
-        break;
-    case UA_NS0ID_FINDSERVERSREQUEST:
-        *service = (UA_Service)Service_FindServers;
-        *requestType = &UA_TYPES[UA_TYPES_FINDSERVERSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_FINDSERVERSRESPONSE];
-        break;
-    case UA_NS0ID_CREATESESSIONREQUEST:
-        *service = (UA_Service)Service_CreateSession;
-        *requestType = &UA_TYPES[UA_TYPES_CREATESESSIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CREATESESSIONRESPONSE];
-        break;
-    case UA_NS0ID_ACTIVATESESSIONREQUEST:
-        *service = (UA_Service)Service_ActivateSession;
-        *requestType = &UA_TYPES[UA_TYPES_ACTIVATESESSIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_ACTIVATESESSIONRESPONSE];
-        break;
-    case UA_NS0ID_CLOSESESSIONREQUEST:
-        *service = (UA_Service)Service_CloseSession;
-        *requestType = &UA_TYPES[UA_TYPES_CLOSESESSIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CLOSESESSIONRESPONSE];
-        break;
-    case UA_NS0ID_READREQUEST:
-        *service = (UA_Service)Service_Read;
-        *requestType = &UA_TYPES[UA_TYPES_READREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_READRESPONSE];
-        break;
-    case UA_NS0ID_WRITEREQUEST:
-        *service = (UA_Service)Service_Write;
-        *requestType = &UA_TYPES[UA_TYPES_WRITEREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_WRITERESPONSE];
-        break;
-    case UA_NS0ID_BROWSEREQUEST:
-        *service = (UA_Service)Service_Browse;
-        *requestType = &UA_TYPES[UA_TYPES_BROWSEREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_BROWSERESPONSE];
-        break;
-    case UA_NS0ID_BROWSENEXTREQUEST:
-        *service = (UA_Service)Service_BrowseNext;
-        *requestType = &UA_TYPES[UA_TYPES_BROWSENEXTREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_BROWSENEXTRESPONSE];
-        break;
-    case UA_NS0ID_REGISTERNODESREQUEST:
-        *service = (UA_Service)Service_RegisterNodes;
-        *requestType = &UA_TYPES[UA_TYPES_REGISTERNODESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_REGISTERNODESRESPONSE];
-        break;
-    case UA_NS0ID_UNREGISTERNODESREQUEST:
-        *service = (UA_Service)Service_UnregisterNodes;
-        *requestType = &UA_TYPES[UA_TYPES_UNREGISTERNODESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_UNREGISTERNODESRESPONSE];
-        break;
-    case UA_NS0ID_TRANSLATEBROWSEPATHSTONODEIDSREQUEST:
-        *service = (UA_Service)Service_TranslateBrowsePathsToNodeIds;
-        *requestType = &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSRESPONSE];
-        break;
+/*****************/
+/* Service Table */
+/*****************/
 
+/* The built-in services. Services that change the session (or its continuation
+ * points and subscriptions) are not run on worker threads. Services that only
+ * build a response decode the request in the arena. Services that copy what
+ * they keep from the request borrow its strings from the message. The subscription
+ * services keep parts of their requests and do not. The written values are
+ * mostly stored as they are. So their ExtensionObjects are decoded only when
+ * needed. The publish request has no handler since it is answered with a
+ * delay. */
+static const UA_ServiceEntry defaultServices[] = {
+    {&UA_TYPES[UA_TYPES_GETENDPOINTSREQUEST], &UA_TYPES[UA_TYPES_GETENDPOINTSRESPONSE],
+     (UA_ServiceHandler)Service_GetEndpoints, true, true, true, false, 0},
+    {&UA_TYPES[UA_TYPES_FINDSERVERSREQUEST], &UA_TYPES[UA_TYPES_FINDSERVERSRESPONSE],
+     (UA_ServiceHandler)Service_FindServers, true, true, true, false, 0},
+    {&UA_TYPES[UA_TYPES_CREATESESSIONREQUEST], &UA_TYPES[UA_TYPES_CREATESESSIONRESPONSE],
+     (UA_ServiceHandler)Service_CreateSession, false, false, true, false, 0},
+    {&UA_TYPES[UA_TYPES_ACTIVATESESSIONREQUEST], &UA_TYPES[UA_TYPES_ACTIVATESESSIONRESPONSE],
+     (UA_ServiceHandler)Service_ActivateSession, false, false, true, false, 0},
+    {&UA_TYPES[UA_TYPES_CLOSESESSIONREQUEST], &UA_TYPES[UA_TYPES_CLOSESESSIONRESPONSE],
+     (UA_ServiceHandler)Service_CloseSession, false, false, true, false, 0},
+    {&UA_TYPES[UA_TYPES_READREQUEST], &UA_TYPES[UA_TYPES_READRESPONSE],
+     (UA_ServiceHandler)Service_Read, true, true, true, false, 0},
+    {&UA_TYPES[UA_TYPES_WRITEREQUEST], &UA_TYPES[UA_TYPES_WRITERESPONSE],
+     (UA_ServiceHandler)Service_Write, true, false, true, true, 0},
+    {&UA_TYPES[UA_TYPES_BROWSEREQUEST], &UA_TYPES[UA_TYPES_BROWSERESPONSE],
+     (UA_ServiceHandler)Service_Browse, false, false, true, false, 0},
+    {&UA_TYPES[UA_TYPES_BROWSENEXTREQUEST], &UA_TYPES[UA_TYPES_BROWSENEXTRESPONSE],
+     (UA_ServiceHandler)Service_BrowseNext, false, false, true, false, 0},
+    {&UA_TYPES[UA_TYPES_REGISTERNODESREQUEST], &UA_TYPES[UA_TYPES_REGISTERNODESRESPONSE],
+     (UA_ServiceHandler)Service_RegisterNodes, true, true, true, false, 0},
+    {&UA_TYPES[UA_TYPES_UNREGISTERNODESREQUEST], &UA_TYPES[UA_TYPES_UNREGISTERNODESRESPONSE],
+     (UA_ServiceHandler)Service_UnregisterNodes, true, true, true, false, 0},
+    {&UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSREQUEST],
+     &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSRESPONSE],
+     (UA_ServiceHandler)Service_TranslateBrowsePathsToNodeIds, true, true, true, false, 0},
 #ifdef UA_ENABLE_SUBSCRIPTIONS
-    case UA_NS0ID_CREATESUBSCRIPTIONREQUEST:
-        *service = (UA_Service)Service_CreateSubscription;
-        *requestType = &UA_TYPES[UA_TYPES_CREATESUBSCRIPTIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CREATESUBSCRIPTIONRESPONSE];
-        break;
-    case UA_NS0ID_PUBLISHREQUEST:
-        *requestType = &UA_TYPES[UA_TYPES_PUBLISHREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_PUBLISHRESPONSE];
-        break;
-    case UA_NS0ID_REPUBLISHREQUEST:
-        *service = (UA_Service)Service_Republish;
-        *requestType = &UA_TYPES[UA_TYPES_REPUBLISHREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE];
-        break;
-    case UA_NS0ID_MODIFYSUBSCRIPTIONREQUEST:
-        *service = (UA_Service)Service_ModifySubscription;
-        *requestType = &UA_TYPES[UA_TYPES_MODIFYSUBSCRIPTIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_MODIFYSUBSCRIPTIONRESPONSE];
-        break;
-    case UA_NS0ID_DELETESUBSCRIPTIONSREQUEST:
-        *service = (UA_Service)Service_DeleteSubscriptions;
-        *requestType = &UA_TYPES[UA_TYPES_DELETESUBSCRIPTIONSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_DELETESUBSCRIPTIONSRESPONSE];
-        break;
-    case UA_NS0ID_CREATEMONITOREDITEMSREQUEST:
-        *service = (UA_Service)Service_CreateMonitoredItems;
-        *requestType = &UA_TYPES[UA_TYPES_CREATEMONITOREDITEMSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CREATEMONITOREDITEMSRESPONSE];
-        break;
-    case UA_NS0ID_DELETEMONITOREDITEMSREQUEST:
-        *service = (UA_Service)Service_DeleteMonitoredItems;
-        *requestType = &UA_TYPES[UA_TYPES_DELETEMONITOREDITEMSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_DELETEMONITOREDITEMSRESPONSE];
-        break;
+    {&UA_TYPES[UA_TYPES_CREATESUBSCRIPTIONREQUEST], &UA_TYPES[UA_TYPES_CREATESUBSCRIPTIONRESPONSE],
+     (UA_ServiceHandler)Service_CreateSubscription, false, false, false, false, 0},
+    {&UA_TYPES[UA_TYPES_PUBLISHREQUEST], &UA_TYPES[UA_TYPES_PUBLISHRESPONSE],
+     NULL, false, false, false, false, 0},
+    {&UA_TYPES[UA_TYPES_REPUBLISHREQUEST], &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE],
+     (UA_ServiceHandler)Service_Republish, false, false, false, false, 0},
+    {&UA_TYPES[UA_TYPES_MODIFYSUBSCRIPTIONREQUEST], &UA_TYPES[UA_TYPES_MODIFYSUBSCRIPTIONRESPONSE],
+     (UA_ServiceHandler)Service_ModifySubscription, false, false, false, false, 0},
+    {&UA_TYPES[UA_TYPES_DELETESUBSCRIPTIONSREQUEST], &UA_TYPES[UA_TYPES_DELETESUBSCRIPTIONSRESPONSE],
+     (UA_ServiceHandler)Service_DeleteSubscriptions, false, false, false, false, 0},
+    {&UA_TYPES[UA_TYPES_CREATEMONITOREDITEMSREQUEST], &UA_TYPES[UA_TYPES_CREATEMONITOREDITEMSRESPONSE],
+     (UA_ServiceHandler)Service_CreateMonitoredItems, false, false, false, false, 0},
+    {&UA_TYPES[UA_TYPES_DELETEMONITOREDITEMSREQUEST], &UA_TYPES[UA_TYPES_DELETEMONITOREDITEMSRESPONSE],
+     (UA_ServiceHandler)Service_DeleteMonitoredItems, false, false, false, false, 0},
 #endif
-
 #ifdef UA_ENABLE_METHODCALLS
-    case UA_NS0ID_CALLREQUEST:
-        *service = (UA_Service)Service_Call;
-        *requestType = &UA_TYPES[UA_TYPES_CALLREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CALLRESPONSE];
-	break;
+    {&UA_TYPES[UA_TYPES_CALLREQUEST], &UA_TYPES[UA_TYPES_CALLRESPONSE],
+     (UA_ServiceHandler)Service_Call, true, false, true, false, 0},
 #endif
-
 #ifdef UA_ENABLE_NODEMANAGEMENT
-    case UA_NS0ID_ADDNODESREQUEST:
-        *service = (UA_Service)Service_AddNodes;
-        *requestType = &UA_TYPES[UA_TYPES_ADDNODESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_ADDNODESRESPONSE];
-        break;
-    case UA_NS0ID_ADDREFERENCESREQUEST:
-        *service = (UA_Service)Service_AddReferences;
-        *requestType = &UA_TYPES[UA_TYPES_ADDREFERENCESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_ADDREFERENCESRESPONSE];
-        break;
-    case UA_NS0ID_DELETENODESREQUEST:
-        *service = (UA_Service)Service_DeleteNodes;
-        *requestType = &UA_TYPES[UA_TYPES_DELETENODESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_DELETENODESRESPONSE];
-        break;
-    case UA_NS0ID_DELETEREFERENCESREQUEST:
-        *service = (UA_Service)Service_DeleteReferences;
-        *requestType = &UA_TYPES[UA_TYPES_DELETEREFERENCESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_DELETEREFERENCESRESPONSE];
-        break;
+    {&UA_TYPES[UA_TYPES_ADDNODESREQUEST], &UA_TYPES[UA_TYPES_ADDNODESRESPONSE],
+     (UA_ServiceHandler)Service_AddNodes, true, false, true, false, 0},
+    {&UA_TYPES[UA_TYPES_ADDREFERENCESREQUEST], &UA_TYPES[UA_TYPES_ADDREFERENCESRESPONSE],
+     (UA_ServiceHandler)Service_AddReferences, true, false, true, false, 0},
+    {&UA_TYPES[UA_TYPES_DELETENODESREQUEST], &UA_TYPES[UA_TYPES_DELETENODESRESPONSE],
+     (UA_ServiceHandler)Service_DeleteNodes, true, false, true, false, 0},
+    {&UA_TYPES[UA_TYPES_DELETEREFERENCESREQUEST], &UA_TYPES[UA_TYPES_DELETEREFERENCESRESPONSE],
+     (UA_ServiceHandler)Service_DeleteReferences, true, false, true, false, 0},
 #endif
+};
 
-    default:
-        break;
+/* Returns UA_SERVER_SERVICEINDEX_SIZE if the type id is not in the index range */
+static UA_UInt32
+serviceIndex(const UA_NodeId *requestTypeId) {
+    if(requestTypeId->namespaceIndex != 0 ||
+       requestTypeId->identifierType != UA_NODEIDTYPE_NUMERIC)
+        return UA_SERVER_SERVICEINDEX_SIZE;
+    UA_UInt32 index = requestTypeId->identifier.numeric - UA_SERVER_SERVICEINDEX_FIRST;
+    if(index >= UA_SERVER_SERVICEINDEX_SIZE)
+        return UA_SERVER_SERVICEINDEX_SIZE;
+    return index;
+}
+
+/* Returns the service for the id of the request type or NULL */
+static UA_ServiceEntry *
+getService(UA_Server *server, const UA_NodeId *requestTypeId) {
+    UA_UInt32 index = serviceIndex(requestTypeId);
+    if(index < UA_SERVER_SERVICEINDEX_SIZE) {
+        if(server->serviceIndex[index] == 0)
+            return NULL;
+        return &server->services[server->serviceIndex[index] - 1];
+    }
+    /* Not indexed */
+    for(size_t i = 0; i < server->servicesSize; i++) {
+        UA_ServiceEntry *service = &server->services[i];
+        if(service->requestType && UA_NodeId_equal(&service->requestType->typeId, requestTypeId))
+            return service;
+    }
+    return NULL;
+}
+
+/* Service requests are structures from namespace zero that start with a
+ * RequestHeader. The binary encoding id is derived from the type id. */
+static UA_Boolean
+isServiceRequest(const UA_DataType *type) {
+    if(type->typeId.namespaceIndex != 0 ||
+       type->typeId.identifierType != UA_NODEIDTYPE_NUMERIC)
+        return false;
+    if(type->builtin || type->membersSize == 0)
+        return false;
+    return type->members[0].namespaceZero &&
+        type->members[0].memberTypeIndex == UA_TYPES_REQUESTHEADER;
+}
+
+void UA_Server_initServices(UA_Server *server) {
+    memset(server->serviceIndex, 0, sizeof(server->serviceIndex));
+    server->servicesSize = 0;
+    server->services = NULL;
+    for(size_t i = 0; i < sizeof(defaultServices) / sizeof(UA_ServiceEntry); i++)
+        UA_Server_setService(server, &defaultServices[i], NULL);
+}
+
+void UA_Server_deleteServices(UA_Server *server) {
+    UA_free(server->services);
+    server->services = NULL;
+    server->servicesSize = 0;
+    memset(server->serviceIndex, 0, sizeof(server->serviceIndex));
+}
+
+UA_StatusCode
+UA_Server_setService(UA_Server *server, const UA_ServiceEntry *service,
+                     UA_ServiceEntry *previous) {
+    if(!service->requestType || !service->responseType ||
+       !isServiceRequest(service->requestType))
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    UA_ServiceEntry *entry = getService(server, &service->requestType->typeId);
+    if(previous) {
+        if(entry)
+            *previous = *entry;
+        else
+            memset(previous, 0, sizeof(UA_ServiceEntry));
+    }
+
+    /* Replace the service */
+    if(entry) {
+        UA_UInt32 calls = entry->calls;
+        *entry = *service;
+        entry->calls = calls;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Add the service in a free slot. The entries move when the table grows.
+     * That is why the services are changed only while the server is stopped. */
+    size_t slot = 0;
+    while(slot < server->servicesSize && server->services[slot].requestType)
+        slot++;
+    if(slot == server->servicesSize) {
+        if(slot >= UA_UINT16_MAX)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_ServiceEntry *services =
+            UA_realloc(server->services, sizeof(UA_ServiceEntry) * (slot + 1));
+        if(!services)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        server->services = services;
+        server->servicesSize++;
     }
+    server->services[slot] = *service;
+    server->services[slot].calls = 0;
+    UA_UInt32 index = serviceIndex(&service->requestType->typeId);
+    if(index < UA_SERVER_SERVICEINDEX_SIZE)
+        server->serviceIndex[index] = (UA_UInt16)(slot + 1);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_removeService(UA_Server *server, const UA_DataType *requestType) {
+    UA_ServiceEntry *entry = getService(server, &requestType->typeId);
+    if(!entry)
+        return UA_STATUSCODE_BADSERVICEUNSUPPORTED;
+    /* The slot is reused by the next added service */
+    memset(entry, 0, sizeof(UA_ServiceEntry));
+    UA_UInt32 index = serviceIndex(&requestType->typeId);
+    if(index < UA_SERVER_SERVICEINDEX_SIZE)
+        server->serviceIndex[index] = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_getService(UA_Server *server, const UA_DataType *requestType,
+                     UA_ServiceEntry *service) {
+    UA_ServiceEntry *entry = getService(server, &requestType->typeId);
+    if(!entry)
+        return UA_STATUSCODE_BADSERVICEUNSUPPORTED;
+    *service = *entry;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Discovery services can be called without a SecureChannel */
+static UA_Boolean
+isDiscoveryService(const UA_DataType *requestType) {
+    return requestType == &UA_TYPES[UA_TYPES_FINDSERVERSREQUEST] ||
+        requestType == &UA_TYPES[UA_TYPES_GETENDPOINTSREQUEST];
+}
+
+/* Services that can be called without an activated Session */
+static UA_Boolean
+isSessionlessService(const UA_DataType *requestType) {
+    return isDiscoveryService(requestType) ||
+        requestType == &UA_TYPES[UA_TYPES_CREATESESSIONREQUEST] ||
+        requestType == &UA_TYPES[UA_TYPES_ACTIVATESESSIONREQUEST];
 }
 
+/**
+ * Error Responses
+ * ---------------
+ * Rejected requests are answered with a ServiceFault that is copied from a
+ * template of its binary encoding. Only the timestamp, the request handle and
+ * the service result are set. Of the request, only the request handle is
+ * decoded. */
+
+#define UA_SERVICEFAULT_TIMESTAMP 4
+#define UA_SERVICEFAULT_REQUESTHANDLE 12
+#define UA_SERVICEFAULT_SERVICERESULT 16
+
+static const UA_Byte serviceFaultTemplate[28] = {
+    0x01, 0x00, 0x8d, 0x01, /* type id (four byte nodeid i=397) */
+    0, 0, 0, 0, 0, 0, 0, 0, /* timestamp */
+    0, 0, 0, 0, /* requestHandle */
+    0, 0, 0, 0, /* serviceResult */
+    0x00, /* serviceDiagnostics (empty) */
+    0xff, 0xff, 0xff, 0xff, /* stringTable (null array) */
+    0x00, 0x00, 0x00 /* additionalHeader (null extensionobject) */
+};
+
+static void
+sendServiceFault(UA_SecureChannel *channel, UA_UInt32 requestId,
+                 UA_UInt32 requestHandle, UA_StatusCode error) {
+    UA_Byte body[sizeof(serviceFaultTemplate)];
+    memcpy(body, serviceFaultTemplate, sizeof(serviceFaultTemplate));
+    UA_ByteString fault = {sizeof(body), body};
+    UA_DateTime timestamp = UA_DateTime_now();
+    size_t pos = UA_SERVICEFAULT_TIMESTAMP;
+    UA_DateTime_encodeBinary(&timestamp, &fault, &pos);
+    pos = UA_SERVICEFAULT_REQUESTHANDLE;
+    UA_UInt32_encodeBinary(&requestHandle, &fault, &pos);
+    pos = UA_SERVICEFAULT_SERVICERESULT;
+    UA_StatusCode_encodeBinary(&error, &fault, &pos);
+    UA_SecureChannel_sendEncodedMessage(channel, requestId, &fault);
+}
+
+/* The request handle is the third field of the request header */
 static void
 sendError(UA_SecureChannel *channel, const UA_ByteString *msg, size_t pos,
           UA_UInt32 requestId, UA_StatusCode error) {
-    UA_RequestHeader p;
-    if(UA_RequestHeader_decodeBinary(msg, &pos, &p) != UA_STATUSCODE_GOOD)
+    UA_NodeId authenticationToken;
+    if(UA_NodeId_decodeBinary(msg, &pos, &authenticationToken) != UA_STATUSCODE_GOOD)
         return;
-    UA_ResponseHeader r;
-    UA_ResponseHeader_init(&r);
-    init_response_header(&p, &r);
-    r.serviceResult = error;
-    UA_SecureChannel_sendBinaryMessage(channel, requestId, &r,
-                                       &UA_TYPES[UA_TYPES_SERVICEFAULT]);
-    UA_RequestHeader_deleteMembers(&p);
-    UA_ResponseHeader_deleteMembers(&r);
+    UA_NodeId_deleteMembers(&authenticationToken);
+    UA_DateTime timestamp;
+    UA_UInt32 requestHandle;
+    if(UA_DateTime_decodeBinary(msg, &pos, &timestamp) != UA_STATUSCODE_GOOD ||
+       UA_UInt32_decodeBinary(msg, &pos, &requestHandle) != UA_STATUSCODE_GOOD)
+        return;
+    sendServiceFault(channel, requestId, requestHandle, error);
 }
 
-static void
-appendChunkedMessage(struct ChunkEntry *ch, const UA_ByteString *msg, size_t *pos) {
-    if (ch->invalid_message) {
-        return;
-    }
+/* Rejected requests are logged at most once per interval. The number of
+ * suppressed messages is added to the next message. */
+#define UA_REJECTEDLOG_INTERVAL UA_SEC_TO_DATETIME
 
-    UA_UInt32 len;
-    *pos -= 20;
-    UA_UInt32_decodeBinary(msg, pos, &len);
-    if (len > msg->length) {
-        UA_ByteString_deleteMembers(&ch->bytes);
-        ch->invalid_message = true;
-        return;
+static UA_Boolean
+logRejected(UA_Server *server, UA_UInt32 *suppressed) {
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UA_DateTime next = server->rejectedLogNext;
+#ifndef UA_ENABLE_MULTITHREADING
+    if(now < next) {
+        server->rejectedLogSuppressed++;
+        return false;
     }
-    len -= 24;
-    *pos += 16; // 4 bytes consumed by decode above
-
-    UA_Byte* new_bytes = UA_realloc(ch->bytes.data, ch->bytes.length + len);
-    if (! new_bytes) {
-        UA_ByteString_deleteMembers(&ch->bytes);
-        ch->invalid_message = true;
-        return;
+    server->rejectedLogNext = now + UA_REJECTEDLOG_INTERVAL;
+    *suppressed = server->rejectedLogSuppressed;
+    server->rejectedLogSuppressed = 0;
+#else
+    if(now < next ||
+       uatomic_cmpxchg(&server->rejectedLogNext, next, now + UA_REJECTEDLOG_INTERVAL) != next) {
+        uatomic_inc(&server->rejectedLogSuppressed);
+        return false;
     }
-    ch->bytes.data = new_bytes;
-
-    memcpy(&ch->bytes.data[ch->bytes.length], &msg->data[*pos], len);
-    ch->bytes.length += len;
-    *pos += len;
+    *suppressed = uatomic_xchg(&server->rejectedLogSuppressed, 0);
+#endif
+    return true;
 }
 
-static struct ChunkEntry*
+/**
+ * Chunked Requests
+ * ----------------
+ * The chunk bodies are copied into a ChunkEntry of the SecureChannel until the
+ * final chunk arrives. The buffer is allocated for the maximum message size of
+ * the connection with the first chunk, so that every chunk is copied once and
+ * the buffer is not moved. Without a maximum message size, the buffer grows
+ * geometrically.
+ *
+ * A request that exceeds the maximum message size or the buffer limit of the
+ * SecureChannel is discarded and answered with a ServiceFault once the final
+ * chunk arrives. Too many concurrent chunked requests close the connection. */
+
+static struct ChunkEntry *
 chunkEntryFromRequestId(UA_SecureChannel *channel, UA_UInt32 requestId) {
     struct ChunkEntry *ch;
-    LIST_FOREACH(ch, &channel->chunks, pointers) {
-        if (ch->requestId == requestId) {
+    LIST_FOREACH(ch, &channel->chunks[requestId % UA_SECURECHANNEL_CHUNKBUCKETS], pointers) {
+        if(ch->requestId == requestId)
             return ch;
-        }
     }
-
     return NULL;
 }
 
 static void
-processMSG(UA_Connection *connection, UA_Server *server, const UA_ByteString *msg, size_t *pos) {
-    /* If we cannot decode these, don't respond */
-    UA_UInt32 secureChannelId = 0;
-    UA_UInt32 tokenId = 0;
-    UA_SequenceHeader sequenceHeader;
-    UA_NodeId requestTypeId;
-    UA_StatusCode retval = UA_UInt32_decodeBinary(msg, pos, &secureChannelId);
-    retval |= UA_UInt32_decodeBinary(msg, pos, &tokenId);
-    retval |= UA_SequenceHeader_decodeBinary(msg, pos, &sequenceHeader);
-    if(retval != UA_STATUSCODE_GOOD)
+freeChunkBuffer(UA_SecureChannel *channel, struct ChunkEntry *ch) {
+    UA_ByteString_deleteMembers(&ch->bytes);
+    channel->chunksAllocated -= ch->allocated;
+    ch->allocated = 0;
+}
+
+static void
+removeChunkEntry(UA_SecureChannel *channel, struct ChunkEntry *ch) {
+    freeChunkBuffer(channel, ch);
+    LIST_REMOVE(ch, pointers);
+    channel->chunksSize--;
+    UA_free(ch);
+}
+
+static void
+invalidateChunkEntry(UA_Server *server, UA_SecureChannel *channel,
+                     struct ChunkEntry *ch, UA_StatusCode error) {
+    UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
+                "Discard the chunked request %u on SecureChannel %i",
+                ch->requestId, channel->securityToken.channelId);
+    freeChunkBuffer(channel, ch);
+    ch->invalid = error;
+}
+
+static void
+appendChunk(UA_Server *server, UA_SecureChannel *channel, struct ChunkEntry *ch,
+            const UA_Byte *body, size_t length) {
+    if(ch->invalid != UA_STATUSCODE_GOOD)
         return;
 
-    UA_SecureChannel *channel = connection->channel;
-    UA_SecureChannel anonymousChannel;
-    if(!channel) {
-        UA_SecureChannel_init(&anonymousChannel);
-        anonymousChannel.connection = connection;
-        channel = &anonymousChannel;
+    const UA_ConnectionConfig *conf = &channel->connection->localConf;
+    size_t needed = ch->bytes.length + length;
+    if(conf->maxMessageSize > 0 && needed > conf->maxMessageSize) {
+        invalidateChunkEntry(server, channel, ch, UA_STATUSCODE_BADREQUESTTOOLARGE);
+        return;
     }
 
-    /* Test if the secure channel is ok */
-    if(secureChannelId != channel->securityToken.channelId)
-        return;
-    if(tokenId != channel->securityToken.tokenId) {
-        if(tokenId != channel->nextSecurityToken.tokenId) {
-            /* close the securechannel but keep the connection open */
-            UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
-                        "Request with a wrong security token. Closing the SecureChannel %i.",
-                        channel->securityToken.channelId);
-            Service_CloseSecureChannel(server, channel->securityToken.channelId);
+    if(needed > ch->allocated) {
+        /* Size of the buffer */
+        size_t size = ch->allocated * 2;
+        if(ch->allocated == 0) {
+            if(conf->maxMessageSize > 0)
+                size = conf->maxMessageSize;
+            else if(conf->maxChunkCount > 0)
+                size = (size_t)conf->maxChunkCount * conf->recvBufferSize;
+        }
+        if(size < needed)
+            size = needed;
+        if(conf->maxMessageSize > 0 && size > conf->maxMessageSize)
+            size = conf->maxMessageSize;
+
+        /* Stay within the limit of the SecureChannel */
+        size_t limit = server->config.maxChunkedRequestsBytes;
+        if(limit > 0) {
+            size_t others = channel->chunksAllocated - ch->allocated;
+            if(others >= limit || limit - others < needed) {
+                invalidateChunkEntry(server, channel, ch, UA_STATUSCODE_BADTCPNOTENOUGHRESOURCES);
+                return;
+            }
+            if(size > limit - others)
+                size = limit - others;
+        }
+
+        UA_Byte *data = UA_realloc(ch->bytes.data, size);
+        if(!data) {
+            invalidateChunkEntry(server, channel, ch, UA_STATUSCODE_BADOUTOFMEMORY);
             return;
         }
-        UA_SecureChannel_revolveTokens(channel);
+        ch->bytes.data = data;
+        channel->chunksAllocated += size - ch->allocated;
+        ch->allocated = size;
     }
 
-    size_t final_chunked_pos = 0;
-    UA_ByteString bytes;
-    struct ChunkEntry *ch;
-    switch (msg->data[*pos - 24 + 3]) {
+    memcpy(&ch->bytes.data[ch->bytes.length], body, length);
+    ch->bytes.length = needed;
+}
+
+/* Returns the reassembled request after the final chunk. Otherwise, the data
+ * of the returned bytestring is NULL. */
+static UA_ByteString
+processChunk(UA_Connection *connection, UA_Server *server, UA_SecureChannel *channel,
+             UA_Byte chunkType, UA_UInt32 requestId, const UA_ByteString *msg,
+             size_t *pos, size_t chunkEnd) {
+    UA_ByteString request = UA_BYTESTRING_NULL;
+    const UA_Byte *body = &msg->data[*pos];
+    size_t length = chunkEnd - *pos;
+    *pos = chunkEnd;
+
+    struct ChunkEntry *ch = chunkEntryFromRequestId(channel, requestId);
+    switch(chunkType) {
     case 'C':
         UA_LOG_TRACE(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL, "Chunk message");
-        ch = chunkEntryFromRequestId(channel, sequenceHeader.requestId);
-        if (! ch) {
+        if(!ch) {
+            if(server->config.maxChunkedRequests > 0 &&
+               channel->chunksSize >= server->config.maxChunkedRequests) {
+                UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
+                            "Too many chunked requests on SecureChannel %i. Closing the connection.",
+                            channel->securityToken.channelId);
+                connection->close(connection);
+                return request;
+            }
             ch = UA_calloc(1, sizeof(struct ChunkEntry));
-            ch->invalid_message = false;
-            ch->requestId = sequenceHeader.requestId;
-            UA_ByteString_init(&ch->bytes);
-            LIST_INSERT_HEAD(&channel->chunks, ch, pointers);
-        }
+            if(!ch)
+                return request;
+            ch->requestId = requestId;
+            LIST_INSERT_HEAD(&channel->chunks[requestId % UA_SECURECHANNEL_CHUNKBUCKETS],
+                             ch, pointers);
+            channel->chunksSize++;
 
-        appendChunkedMessage(ch, msg, pos);
-        return;
-    case 'F':
-        ch = chunkEntryFromRequestId(channel, sequenceHeader.requestId);
-        if (ch) {
-            UA_LOG_TRACE(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL, "Final chunk message");
-            appendChunkedMessage(ch, msg, pos);
-
-            bytes = ch->bytes;
-            LIST_REMOVE(ch, pointers);
-            UA_free(ch);
-
-            final_chunked_pos = *pos;
-            *pos = 0;
-
-            // if the chunks have failed decoding
-            // message is invalid => return early
-            if (bytes.length == 0) {
-                *pos = final_chunked_pos;
-                return;
+            /* Keep the request handle to answer a discarded request */
+            UA_ByteString first = {length, (UA_Byte*)(uintptr_t)body};
+            size_t firstPos = 0;
+            UA_NodeId requestTypeId;
+            UA_RequestHeader requestHeader;
+            if(UA_NodeId_decodeBinary(&first, &firstPos, &requestTypeId) == UA_STATUSCODE_GOOD) {
+                if(UA_RequestHeader_decodeBinary(&first, &firstPos, &requestHeader) == UA_STATUSCODE_GOOD) {
+                    ch->requestHandle = requestHeader.requestHandle;
+                    UA_RequestHeader_deleteMembers(&requestHeader);
+                }
+                UA_NodeId_deleteMembers(&requestTypeId);
             }
-        } else {
-            bytes = *msg;
         }
+        appendChunk(server, channel, ch, body, length);
+        break;
+    case 'F':
+        UA_LOG_TRACE(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL, "Final chunk message");
+        if(!ch)
+            break;
+        appendChunk(server, channel, ch, body, length);
+        if(ch->invalid != UA_STATUSCODE_GOOD)
+            sendServiceFault(channel, requestId, ch->requestHandle, ch->invalid);
+        else {
+            request = ch->bytes;
+            channel->chunksAllocated -= ch->allocated;
+            ch->allocated = 0;
+            UA_ByteString_init(&ch->bytes);
+        }
+        removeChunkEntry(channel, ch);
         break;
     case 'A':
-        ch = chunkEntryFromRequestId(channel, sequenceHeader.requestId);
-        if (ch) {
-            UA_ByteString_deleteMembers(&ch->bytes);
-            LIST_REMOVE(ch, pointers);
-            UA_free(ch);
-        } else {
+        if(ch)
+            removeChunkEntry(channel, ch);
+        else
             UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
                         "Received MSGA on an unknown request");
+        break;
+    default:
+        break;
+    }
+    return request;
+}
+
+/* Calls the service and sends the response */
+static void
+callService(UA_Server *server, UA_SecureChannel *channel, UA_Session *session,
+            const UA_ServiceEntry *service, UA_UInt32 requestId, const void *request) {
+    const UA_DataType *responseType = service->responseType;
+    void *response = UA_alloca(responseType->memSize);
+    UA_init(response, responseType);
+    init_response_header(request, response);
+    service->handler(server, session, request, response);
+
+    /* Send the response */
+    UA_StatusCode retval = UA_SecureChannel_sendBinaryMessage(channel, requestId,
+                                                              response, responseType);
+    if(retval != UA_STATUSCODE_GOOD) {
+        /* The response exceeds the limits of the client */
+        if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
+            retval = UA_STATUSCODE_BADRESPONSETOOLARGE;
+        sendServiceFault(channel, requestId,
+                         ((const UA_RequestHeader*)request)->requestHandle, retval);
+    }
+
+    UA_deleteMembers(response, responseType);
+}
+
+/* Decodes the request with the options of the service. Borrowed strings point
+ * into the message. So the message must outlive the request. */
+static UA_StatusCode
+decodeRequest(const UA_ServiceEntry *service, const UA_ByteString *msg, size_t *pos,
+              void *request, UA_Boolean arena) {
+    UA_DecodeBinaryOptions options = {service->lazyExtensionObjects,
+                                      service->borrowStrings};
+    if(arena)
+        UA_Arena_begin();
+    UA_StatusCode retval = UA_decodeBinaryWithOptions(msg, pos, request,
+                                                      service->requestType, &options);
+    if(arena)
+        UA_Arena_end();
+    return retval;
+}
+
+/* Deletes the request the way it was decoded. The request in the arena is
+ * released with the reset. */
+static void
+deleteRequest(const UA_ServiceEntry *service, void *request, UA_Boolean arena) {
+    if(arena)
+        UA_Arena_reset();
+    else if(service->borrowStrings)
+        UA_deleteMembersBorrowed(request, service->requestType);
+    else
+        UA_deleteMembers(request, service->requestType);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+/**
+ * Parallel Requests
+ * -----------------
+ * With the parallelRequests option, the requests of services that may run on a
+ * worker thread are dispatched to the workers one by one. Only the request
+ * header is decoded in the receiving thread to find the session. The request
+ * body is copied, as the received buffer is released once the message was
+ * processed. The worker decodes the request and sends the response right away.
+ * So the responses are sent in the order of completion.
+ *
+ * SecureChannels and sessions are freed with a delay after all jobs that were
+ * dispatched before have finished. But the job can find them closed. */
+
+struct ParallelRequest {
+    UA_SecureChannel *channel;
+    UA_Session *session;
+    const UA_ServiceEntry *service;
+    UA_UInt32 requestId;
+    UA_ByteString body; // the request without the type id
+};
+
+static void
+processParallelRequest(UA_Server *server, struct ParallelRequest *pr) {
+    const UA_DataType *requestType = pr->service->requestType;
+#ifdef UA_REQUEST_ARENA
+    UA_Boolean arena = pr->service->requestArena;
+#else
+    UA_Boolean arena = false;
+#endif
+    void *request = UA_alloca(requestType->memSize);
+    size_t pos = 0;
+    UA_StatusCode retval = decodeRequest(pr->service, &pr->body, &pos, request, arena);
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(arena)
+            UA_Arena_reset();
+        sendError(pr->channel, &pr->body, 0, pr->requestId, retval);
+    } else {
+        if(pr->session->channel != pr->channel) {
+            /* The session was closed in the meantime */
+            sendServiceFault(pr->channel, pr->requestId,
+                             ((UA_RequestHeader*)request)->requestHandle,
+                             UA_STATUSCODE_BADSESSIONIDINVALID);
+        } else {
+            callService(server, pr->channel, pr->session, pr->service,
+                        pr->requestId, request);
         }
+        deleteRequest(pr->service, request, arena);
+    }
+    UA_ByteString_deleteMembers(&pr->body);
+    UA_free(pr);
+}
 
-        return;
+/* Returns true if the request was dispatched to a worker thread. Otherwise,
+ * the request is processed in order, which also answers the errors. */
+static UA_Boolean
+dispatchRequest(UA_Server *server, UA_SecureChannel *channel, UA_ServiceEntry *service,
+                UA_UInt32 requestId, const UA_ByteString *msg, size_t pos) {
+    UA_RequestHeader header;
+    size_t headerPos = pos;
+    if(UA_RequestHeader_decodeBinary(msg, &headerPos, &header) != UA_STATUSCODE_GOOD)
+        return false;
+    UA_Session *session = UA_SecureChannel_getSession(channel, &header.authenticationToken);
+    UA_RequestHeader_deleteMembers(&header);
+    if(!session || !session->activated)
+        return false;
+
+    struct ParallelRequest *pr = UA_malloc(sizeof(struct ParallelRequest));
+    if(!pr)
+        return false;
+    if(UA_ByteString_allocBuffer(&pr->body, msg->length - pos) != UA_STATUSCODE_GOOD) {
+        UA_free(pr);
+        return false;
     }
+    memcpy(pr->body.data, &msg->data[pos], msg->length - pos);
+    pr->channel = channel;
+    pr->session = session;
+    pr->service = service;
+    pr->requestId = requestId;
 
-    retval |= UA_NodeId_decodeBinary(&bytes, pos, &requestTypeId);
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
+                  {.method = (UA_ServerCallback)processParallelRequest, .data = pr}};
+    if(UA_Server_dispatchJob(server, &job) != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(&pr->body);
+        UA_free(pr);
+        return false;
+    }
+    UA_Session_updateLifetime(session);
+    uatomic_inc(&service->calls);
+    return true;
+}
+
+#endif
+
+static void
+processRequest(UA_Server *server, UA_SecureChannel *channel, UA_Boolean anonymousChannel,
+               UA_UInt32 requestId, const UA_ByteString *msg, size_t *pos) {
+    UA_NodeId requestTypeId;
+    UA_StatusCode retval = UA_NodeId_decodeBinary(msg, pos, &requestTypeId);
     if(retval != UA_STATUSCODE_GOOD)
         return;
 
@@ -450,48 +791,69 @@ processMSG(UA_Connection *connection, UA_Server *server, const UA_ByteString *ms
     if(requestTypeId.identifierType != UA_NODEIDTYPE_NUMERIC ||
        requestTypeId.namespaceIndex != 0) {
         UA_NodeId_deleteMembers(&requestTypeId);
-        sendError(channel, &bytes, *pos, sequenceHeader.requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+        sendError(channel, msg, *pos, requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
         return;
     }
 
-    /* Get the service pointers */
-    UA_Service service = NULL;
-    const UA_DataType *requestType = NULL;
-    const UA_DataType *responseType = NULL;
-    getServicePointers(requestTypeId.identifier.numeric, &requestType, &responseType, &service);
-    if(!requestType) {
+    /* Look up the service */
+    UA_NodeId typeId =
+        UA_NODEID_NUMERIC(0, requestTypeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY);
+    UA_ServiceEntry *service = getService(server, &typeId);
+    UA_UInt32 suppressed;
+    if(!service) {
         /* The service is not supported */
-        if(requestTypeId.identifier.numeric==787)
-            UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
-                        "Client requested a subscription, but those are not enabled "
-                        "in the build. The message will be skipped");
-        else
-            UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
-                        "Unknown request: NodeId(ns=%d, i=%d)",
-                        requestTypeId.namespaceIndex, requestTypeId.identifier.numeric);
-        sendError(channel, &bytes, *pos, sequenceHeader.requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+        if(logRejected(server, &suppressed)) {
+            if(requestTypeId.identifier.numeric==787)
+                UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
+                            "Client requested a subscription, but those are not enabled "
+                            "in the build. The message will be skipped (%u similar "
+                            "messages suppressed)", suppressed);
+            else
+                UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
+                            "Unknown request: NodeId(ns=%d, i=%d) (%u similar messages "
+                            "suppressed)", requestTypeId.namespaceIndex,
+                            requestTypeId.identifier.numeric, suppressed);
+        }
+        sendError(channel, msg, *pos, requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
         return;
     }
+    const UA_DataType *requestType = service->requestType;
 
     /* Most services can only be called with a valid securechannel */
 #ifndef UA_ENABLE_NONSTANDARD_STATELESS
-    if(channel == &anonymousChannel &&
-       requestType->typeIndex > UA_TYPES_OPENSECURECHANNELREQUEST) {
-        sendError(channel, &bytes, *pos, sequenceHeader.requestId, UA_STATUSCODE_BADSECURECHANNELIDINVALID);
+    if(anonymousChannel && !isDiscoveryService(requestType)) {
+        sendError(channel, msg, *pos, requestId, UA_STATUSCODE_BADSECURECHANNELIDINVALID);
+        return;
+    }
+#endif
+
+#ifdef UA_ENABLE_MULTITHREADING
+    if(server->config.parallelRequests && service->workerThread && service->handler &&
+       !anonymousChannel && dispatchRequest(server, channel, service, requestId, msg, *pos)) {
+        *pos = msg->length;
         return;
     }
 #endif
 
-    /* Decode the request */
+    /* Decode the request. The message outlives the processing of the request.
+     * So borrowed strings can point into it until the request is deleted. */
+#ifdef UA_REQUEST_ARENA
+    UA_Boolean arena = service->requestArena;
+#else
+    UA_Boolean arena = false;
+#endif
     void *request = UA_alloca(requestType->memSize);
     size_t oldpos = *pos;
-    retval = UA_decodeBinary(&bytes, pos, request, requestType);
+    retval = decodeRequest(service, msg, pos, request, arena);
     if(retval != UA_STATUSCODE_GOOD) {
-        sendError(channel, &bytes, oldpos, sequenceHeader.requestId, retval);
+        if(arena)
+            UA_Arena_reset();
+        sendError(channel, msg, oldpos, requestId, retval);
         return;
     }
 
     /* Find the matching session */
+    const UA_RequestHeader *requestHeader = request;
     UA_Session *session =
         UA_SecureChannel_getSession(channel, &((UA_RequestHeader*)request)->authenticationToken);
     UA_Session anonymousSession;
@@ -505,56 +867,123 @@ processMSG(UA_Connection *connection, UA_Server *server, const UA_ByteString *ms
     }
 
     /* Test if the session is valid */
-    if(!session->activated && requestType->typeIndex != UA_TYPES_ACTIVATESESSIONREQUEST) {
-        UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
-                    "Client tries to call a service with a non-activated session");
-        sendError(channel, &bytes, *pos, sequenceHeader.requestId, UA_STATUSCODE_BADSESSIONNOTACTIVATED);
-        return;
+    if(!session->activated && requestType != &UA_TYPES[UA_TYPES_ACTIVATESESSIONREQUEST]) {
+        if(logRejected(server, &suppressed))
+            UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
+                        "Client tries to call a service with a non-activated session "
+                        "(%u similar messages suppressed)", suppressed);
+        sendServiceFault(channel, requestId, requestHeader->requestHandle,
+                         UA_STATUSCODE_BADSESSIONNOTACTIVATED);
+        goto cleanup;
     }
 #ifndef UA_ENABLE_NONSTANDARD_STATELESS
-    if(session == &anonymousSession &&
-       requestType->typeIndex > UA_TYPES_ACTIVATESESSIONREQUEST) {
-        UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
-                    "Client tries to call a service without a session");
-        sendError(channel, &bytes, *pos, sequenceHeader.requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
-        return;
+    if(session == &anonymousSession && !isSessionlessService(requestType)) {
+        if(logRejected(server, &suppressed))
+            UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
+                        "Client tries to call a service without a session "
+                        "(%u similar messages suppressed)", suppressed);
+        sendServiceFault(channel, requestId, requestHeader->requestHandle,
+                         UA_STATUSCODE_BADSESSIONIDINVALID);
+        goto cleanup;
     }
 #endif
 
     UA_Session_updateLifetime(session);
+#ifndef UA_ENABLE_MULTITHREADING
+    service->calls++;
+#else
+    uatomic_inc(&service->calls);
+#endif
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     /* The publish request is answered with a delay */
-    if(requestTypeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY == UA_NS0ID_PUBLISHREQUEST) {
-        Service_Publish(server, session, request, sequenceHeader.requestId);
-        UA_deleteMembers(request, requestType);
-        return;
+    if(!service->handler && requestType == &UA_TYPES[UA_TYPES_PUBLISHREQUEST]) {
+        Service_Publish(server, session, request, requestId);
+        goto cleanup;
     }
 #endif
         
-    /* Call the service */
-    void *response = UA_alloca(responseType->memSize);
-    UA_init(response, responseType);
-    init_response_header(request, response);
-    service(server, session, request, response);
+    if(!service->handler) {
+        sendServiceFault(channel, requestId, requestHeader->requestHandle,
+                         UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+        goto cleanup;
+    }
 
-    /* Send the response */
-    retval = UA_SecureChannel_sendBinaryMessage(channel, sequenceHeader.requestId,
-                                                response, responseType);
-    if(retval != UA_STATUSCODE_GOOD) {
-        /* e.g. UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED */
-        sendError(channel, &bytes, oldpos, sequenceHeader.requestId, retval);
+    callService(server, channel, session, service, requestId, request);
+
+ cleanup:
+    deleteRequest(service, request, arena);
+}
+
+static void
+processMSG(UA_Connection *connection, UA_Server *server, const UA_ByteString *msg,
+           size_t *pos, size_t chunkEnd) {
+    /* If we cannot decode these, don't respond */
+    UA_Byte chunkType = msg->data[*pos - 8 + 3];
+    UA_UInt32 secureChannelId = 0;
+    UA_UInt32 tokenId = 0;
+    UA_SequenceHeader sequenceHeader;
+    UA_StatusCode retval = UA_UInt32_decodeBinary(msg, pos, &secureChannelId);
+    retval |= UA_UInt32_decodeBinary(msg, pos, &tokenId);
+    retval |= UA_SequenceHeader_decodeBinary(msg, pos, &sequenceHeader);
+    if(retval != UA_STATUSCODE_GOOD || *pos > chunkEnd)
+        return;
+
+    UA_SecureChannel *channel = connection->channel;
+    UA_SecureChannel anonymousChannel;
+    if(!channel) {
+        UA_SecureChannel_init(&anonymousChannel);
+        anonymousChannel.connection = connection;
+        channel = &anonymousChannel;
     }
 
-    /* Clean up */
-    if (final_chunked_pos) {
-        *pos = final_chunked_pos;
-        UA_ByteString_deleteMembers(&bytes);
+    /* Test if the secure channel is ok */
+    if(secureChannelId != channel->securityToken.channelId)
+        goto cleanup;
+    if(tokenId != channel->securityToken.tokenId) {
+        if(tokenId != channel->nextSecurityToken.tokenId) {
+            /* close the securechannel but keep the connection open */
+            UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
+                        "Request with a wrong security token. Closing the SecureChannel %i.",
+                        channel->securityToken.channelId);
+            Service_CloseSecureChannel(server, channel->securityToken.channelId);
+            goto cleanup;
+        }
+        UA_SecureChannel_revolveTokens(channel);
     }
 
-    UA_deleteMembers(request, requestType);
-    UA_deleteMembers(response, responseType);
+    /* A request in a single chunk is processed in place */
+    if(chunkType == 'F' && !chunkEntryFromRequestId(channel, sequenceHeader.requestId)) {
+        UA_ByteString request = {chunkEnd - *pos, &msg->data[*pos]};
+        size_t requestPos = 0;
+        processRequest(server, channel, channel == &anonymousChannel,
+                       sequenceHeader.requestId, &request, &requestPos);
+        *pos += requestPos;
+        goto cleanup;
+    }
+
+    /* The anonymous channel does not outlive the message */
+    if(channel == &anonymousChannel) {
+        UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
+                    "Chunked requests require a SecureChannel");
+        *pos = chunkEnd;
+        goto cleanup;
+    }
+
+    UA_ByteString request = processChunk(connection, server, channel, chunkType,
+                                         sequenceHeader.requestId, msg, pos, chunkEnd);
+    if(!request.data)
+        return;
+    size_t requestPos = 0;
+    processRequest(server, channel, false, sequenceHeader.requestId, &request, &requestPos);
+    UA_ByteString_deleteMembers(&request);
     return;
+
+ cleanup:
+#ifdef UA_ENABLE_MULTITHREADING
+    if(channel == &anonymousChannel)
+        pthread_mutex_destroy(&anonymousChannel.sendLock);
+#endif
 }
 
 static void
@@ -614,7 +1043,7 @@ void UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection
 #endif
             UA_LOG_DEBUG(server->config.logger, UA_LOGCATEGORY_NETWORK,
                          "Process a MSG on Connection %i", connection->sockfd);
-            processMSG(connection, server, msg, &pos);
+            processMSG(connection, server, msg, &pos, targetpos);
             break;
         case UA_MESSAGETYPEANDFINAL_CLOF & 0xffffff:
             UA_LOG_DEBUG(server->config.logger, UA_LOGCATEGORY_NETWORK,
@@ -25,14 +25,22 @@ typedef struct UA_ExternalNamespace {
 #ifdef UA_ENABLE_MULTITHREADING
 typedef struct {
     UA_Server *server;
+    UA_ServerNetworkLayer *networkLayer; // NULL for the ordinary worker threads
     pthread_t thr;
     UA_UInt32 counter;
     volatile UA_Boolean running;
-    char padding[64 - sizeof(void*) - sizeof(pthread_t) -
+    char padding[64 - 2 * sizeof(void*) - sizeof(pthread_t) -
                  sizeof(UA_UInt32) - sizeof(UA_Boolean)]; // separate cache lines
 } UA_Worker;
 #endif
 
+/* The service index covers the request types from FindServers to
+ * DeleteSubscriptions. It points behind the entry of the service (0 -> no
+ * service). Services for other request types are found by their type id. */
+#define UA_SERVER_SERVICEINDEX_FIRST UA_NS0ID_FINDSERVERSREQUEST
+#define UA_SERVER_SERVICEINDEX_SIZE \
+    (UA_NS0ID_DELETESUBSCRIPTIONSREQUEST - UA_NS0ID_FINDSERVERSREQUEST + 1)
+
 struct UA_Server {
     /* Meta */
     UA_DateTime startTime;
@@ -43,6 +51,11 @@ struct UA_Server {
     UA_SecureChannelManager secureChannelManager;
     UA_SessionManager sessionManager;
 
+    /* Services */
+    UA_UInt16 serviceIndex[UA_SERVER_SERVICEINDEX_SIZE];
+    size_t servicesSize;
+    UA_ServiceEntry *services;
+
     /* Address Space */
     UA_NodeStore *nodestore;
 
@@ -54,13 +67,19 @@ struct UA_Server {
     UA_ExternalNamespace *externalNamespaces;
 #endif
      
+    /* Rate limit for logging rejected requests */
+    UA_DateTime rejectedLogNext;
+    UA_UInt32 rejectedLogSuppressed;
+
     /* Jobs with a repetition interval */
     LIST_HEAD(RepeatedJobsList, RepeatedJobs) repeatedJobs;
     
 #ifdef UA_ENABLE_MULTITHREADING
     /* Dispatch queue head for the worker threads (the tail should not be in the same cache line) */
 	struct cds_wfcq_head dispatchQueue_head;
-    UA_Worker *workers; /* there are nThread workers in a running server */
+    UA_Worker *workers; /* there are nThread workers in a running server, followed by
+                           the networklayer threads (if enabled) */
+    size_t workersSize; /* number of all threads with a counter for the delayed jobs */
     struct cds_lfs_stack mainLoopJobs; /* Work that shall be executed only in the main loop and not
                                           by worker threads */
     struct DelayedJobs *delayedJobs;
@@ -80,10 +99,19 @@ typedef UA_StatusCode (*UA_EditNodeCallback)(UA_Server*, UA_Session*, UA_Node*,
 UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
                                  UA_EditNodeCallback callback, const void *data);
 
+/* Fills the service table with the built-in services */
+void UA_Server_initServices(UA_Server *server);
+void UA_Server_deleteServices(UA_Server *server);
+
 void UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection, const UA_ByteString *msg);
 
 UA_StatusCode UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback, void *data);
 UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data);
+#ifdef UA_ENABLE_MULTITHREADING
+/* Dispatches the job to the worker threads from any thread of the running
+ * server. Fails if there are no worker threads. */
+UA_StatusCode UA_Server_dispatchJob(UA_Server *server, const UA_Job *job);
+#endif
 void UA_Server_deleteAllRepeatedJobs(UA_Server *server);
 
 #ifdef UA_BUILD_UNIT_TESTS
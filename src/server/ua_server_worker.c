@@ -1,5 +1,8 @@
 #include "ua_util.h"
 #include "ua_server_internal.h"
+#ifdef UA_ENABLE_MULTITHREADING
+# include <unistd.h> // usleep
+#endif
 
 /**
  * There are four types of job execution:
@@ -31,12 +34,62 @@
  * [2] Hart, T. E., McKenney, P. E., Brown, A. D., & Walpole, J. (2007). Performance of memory reclamation
  *     for lockless synchronization. Journal of Parallel and Distributed Computing, 67(12), 1270-1285.
  * 
- * 
+ * With the networkLayerThreads option, every networklayer is served by a thread of its own. It
+ * waits on the network and processes the received messages right away. These threads take part in
+ * the epoch counting for delayed jobs just like the worker threads.
  */
 
 #define MAXTIMEOUT 50 // max timeout in millisec until the next main loop iteration
 #define BATCHSIZE 20 // max number of jobs that are dispatched at once to workers
 
+/* The messages in the buffer of a binary message job of a networklayer. The
+ * completion keeps the beginning of a message in the connection. So it is done
+ * in the thread that receives from the networklayer. */
+typedef struct {
+    UA_Connection *connection;
+    UA_ByteString message; // the buffer of the networklayer
+    UA_ByteString completed; // message completed with the beginning of the buffer (allocated)
+    UA_ByteString messages; // the complete messages in the buffer (points into the buffer)
+} CompletedMessages;
+
+/* Returns false if there is nothing to process. The buffer is then released. */
+static UA_Boolean
+completeMessages(UA_Server *server, UA_Connection *connection,
+                 UA_ByteString *message, CompletedMessages *cm) {
+    cm->connection = connection;
+    cm->message = *message;
+    UA_StatusCode retval = UA_Connection_completeMessages(connection, &cm->message,
+                                                          &cm->completed, &cm->messages);
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(retval == UA_STATUSCODE_BADOUTOFMEMORY)
+            UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_NETWORK,
+                           "Lost message(s) from Connection %i as memory could not be allocated",
+                           connection->sockfd);
+        else if(retval != UA_STATUSCODE_GOOD)
+            UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_NETWORK,
+                        "Could not merge half-received messages on Connection %i with error 0x%08x",
+                        connection->sockfd, retval);
+    }
+    /* nothing to process, the buffer was only the beginning of a message */
+    if(cm->completed.length == 0 && cm->messages.length == 0) {
+        connection->releaseRecvBuffer(connection, &cm->message);
+        return false;
+    }
+    return true;
+}
+
+static void
+processCompletedMessages(UA_Server *server, CompletedMessages *cm) {
+    /* the message completed from the previous buffers comes first */
+    if(cm->completed.length > 0) {
+        UA_Server_processBinaryMessage(server, cm->connection, &cm->completed);
+        UA_ByteString_deleteMembers(&cm->completed);
+    }
+    if(cm->messages.length > 0)
+        UA_Server_processBinaryMessage(server, cm->connection, &cm->messages);
+    cm->connection->releaseRecvBuffer(cm->connection, &cm->message);
+}
+
 static void processJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
     UA_ASSERT_RCU_UNLOCKED();
     UA_RCU_LOCK();
@@ -48,12 +101,13 @@ static void processJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
         case UA_JOBTYPE_DETACHCONNECTION:
             UA_Connection_detachSecureChannel(job->job.closeConnection);
             break;
-        case UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER:
-            UA_Server_processBinaryMessage(server, job->job.binaryMessage.connection,
-                                           &job->job.binaryMessage.message);
-            UA_Connection *connection = job->job.binaryMessage.connection;
-            connection->releaseRecvBuffer(connection, &job->job.binaryMessage.message);
+        case UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER: {
+            CompletedMessages cm;
+            if(completeMessages(server, job->job.binaryMessage.connection,
+                                &job->job.binaryMessage.message, &cm))
+                processCompletedMessages(server, &cm);
             break;
+        }
         case UA_JOBTYPE_BINARYMESSAGE_ALLOCATED:
             UA_Server_processBinaryMessage(server, job->job.binaryMessage.connection,
                                            &job->job.binaryMessage.message);
@@ -120,6 +174,7 @@ static void * workerLoop(UA_Worker *worker) {
 
     pthread_mutex_unlock(&mutex);
     pthread_mutex_destroy(&mutex);
+    UA_Arena_deleteMembers();
     UA_ASSERT_RCU_UNLOCKED();
     rcu_barrier(); // wait for all scheduled call_rcu work to complete
    	rcu_unregister_thread();
@@ -151,6 +206,18 @@ static void dispatchJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
     }
 }
 
+UA_StatusCode UA_Server_dispatchJob(UA_Server *server, const UA_Job *job) {
+    if(!server->workers || server->config.nThreads == 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Job *j = UA_malloc(sizeof(UA_Job));
+    if(!j)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    *j = *job;
+    dispatchJobs(server, j, 1);
+    pthread_cond_broadcast(&server->dispatchQueue_condition);
+    return UA_STATUSCODE_GOOD;
+}
+
 static void
 emptyDispatchQueue(UA_Server *server) {
     while(!cds_wfcq_empty(&server->dispatchQueue_head, &server->dispatchQueue_tail)) {
@@ -409,8 +476,8 @@ struct DelayedJobs {
 
 /* Dispatched as an ordinary job when the DelayedJobs list is full */
 static void getCounters(UA_Server *server, struct DelayedJobs *delayed) {
-    UA_UInt32 *counters = UA_malloc(server->config.nThreads * sizeof(UA_UInt32));
-    for(UA_UInt16 i = 0; i < server->config.nThreads; i++)
+    UA_UInt32 *counters = UA_malloc(server->workersSize * sizeof(UA_UInt32));
+    for(size_t i = 0; i < server->workersSize; i++)
         counters[i] = server->workers[i].counter;
     delayed->workerCounters = counters;
 }
@@ -499,7 +566,7 @@ dispatchDelayedJobs(UA_Server *server, void *_) {
             continue;
         }
         UA_Boolean allMoved = true;
-        for(size_t i = 0; i < server->config.nThreads; i++) {
+        for(size_t i = 0; i < server->workersSize; i++) {
             if(dw->workerCounters[i] == server->workers[i].counter) {
                 allMoved = false;
                 break;
@@ -552,6 +619,72 @@ static void processMainLoopJobs(UA_Server *server) {
     } while((mlw = next));
     //UA_free(head);
 }
+
+static void processCompletedMessagesJob(UA_Server *server, void *data) {
+    processCompletedMessages(server, (CompletedMessages*)data);
+    UA_free(data);
+}
+
+/* The messages are completed in the main loop before the job is dispatched to a
+ * worker thread. The worker processes them from an allocated copy. */
+static void dispatchCompletedMessages(UA_Server *server, UA_Job *job) {
+    UA_Connection *connection = job->job.binaryMessage.connection;
+    CompletedMessages cm;
+    job->type = UA_JOBTYPE_NOTHING;
+    if(!completeMessages(server, connection, &job->job.binaryMessage.message, &cm))
+        return;
+    CompletedMessages *data = UA_malloc(sizeof(CompletedMessages));
+    if(!data) {
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_NETWORK,
+                       "Lost message(s) from Connection %i as memory could not be allocated",
+                       connection->sockfd);
+        UA_ByteString_deleteMembers(&cm.completed);
+        connection->releaseRecvBuffer(connection, &cm.message);
+        return;
+    }
+    *data = cm;
+    job->type = UA_JOBTYPE_METHODCALL;
+    job->job.methodCall.method = processCompletedMessagesJob;
+    job->job.methodCall.data = data;
+}
+#endif
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* Serves a single networklayer with the networkLayerThreads option. The
+ * messages are processed in this thread. Only the delayed jobs go through the
+ * main loop. */
+static void * networkLoop(UA_Worker *worker) {
+    UA_Server *server = worker->server;
+    UA_ServerNetworkLayer *nl = worker->networkLayer;
+    UA_UInt32 *counter = &worker->counter;
+    volatile UA_Boolean *running = &worker->running;
+
+    UA_random_seed((uintptr_t)worker);
+    rcu_register_thread();
+
+    while(*running) {
+        UA_Job *jobs;
+        size_t jobsSize = nl->getJobs(nl, &jobs, MAXTIMEOUT * 1000);
+        for(size_t k = 0; k < jobsSize; k++) {
+            if(jobs[k].type == UA_JOBTYPE_METHODCALL_DELAYED) {
+                UA_Server_delayedCallback(server, jobs[k].job.methodCall.method,
+                                          jobs[k].job.methodCall.data);
+                jobs[k].type = UA_JOBTYPE_NOTHING;
+                continue;
+            }
+        }
+        processJobs(server, jobs, jobsSize);
+        if(jobsSize > 0)
+            UA_free(jobs);
+        uatomic_inc(counter);
+    }
+
+    UA_Arena_deleteMembers();
+    UA_ASSERT_RCU_UNLOCKED();
+    rcu_barrier(); // wait for all scheduled call_rcu work to complete
+    rcu_unregister_thread();
+    return NULL;
+}
 #endif
 
 UA_StatusCode UA_Server_run_startup(UA_Server *server) {
@@ -560,12 +693,16 @@ UA_StatusCode UA_Server_run_startup(UA_Server *server) {
     UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
                 "Spinning up %u worker thread(s)", server->config.nThreads);
     pthread_cond_init(&server->dispatchQueue_condition, 0);
-    server->workers = UA_malloc(server->config.nThreads * sizeof(UA_Worker));
+    server->workersSize = server->config.nThreads;
+    if(server->config.networkLayerThreads)
+        server->workersSize += server->config.networkLayersSize;
+    server->workers = UA_malloc(server->workersSize * sizeof(UA_Worker));
     if(!server->workers)
         return UA_STATUSCODE_BADOUTOFMEMORY;
     for(size_t i = 0; i < server->config.nThreads; i++) {
         UA_Worker *worker = &server->workers[i];
         worker->server = server;
+        worker->networkLayer = NULL;
         worker->counter = 0;
         worker->running = true;
         pthread_create(&worker->thr, NULL, (void* (*)(void*))workerLoop, worker);
@@ -587,27 +724,24 @@ UA_StatusCode UA_Server_run_startup(UA_Server *server) {
         }
     }
 
-    return result;
-}
-
-static void completeMessages(UA_Server *server, UA_Job *job) {
-    UA_Boolean realloced = UA_FALSE;
-    UA_StatusCode retval = UA_Connection_completeMessages(job->job.binaryMessage.connection,
-                                                          &job->job.binaryMessage.message, &realloced);
-    if(retval != UA_STATUSCODE_GOOD) {
-        if(retval == UA_STATUSCODE_BADOUTOFMEMORY)
-            UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_NETWORK,
-                           "Lost message(s) from Connection %i as memory could not be allocated",
-                           job->job.binaryMessage.connection->sockfd);
-        else if(retval != UA_STATUSCODE_GOOD)
-            UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_NETWORK,
-                        "Could not merge half-received messages on Connection %i with error 0x%08x",
-                        job->job.binaryMessage.connection->sockfd, retval);
-        job->type = UA_JOBTYPE_NOTHING;
-        return;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Spin up the networklayer threads */
+    if(server->config.networkLayerThreads) {
+        UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
+                    "Spinning up %u networklayer thread(s)",
+                    (unsigned int)server->config.networkLayersSize);
+        for(size_t i = 0; i < server->config.networkLayersSize; i++) {
+            UA_Worker *worker = &server->workers[server->config.nThreads + i];
+            worker->server = server;
+            worker->networkLayer = &server->config.networkLayers[i];
+            worker->counter = 0;
+            worker->running = true;
+            pthread_create(&worker->thr, NULL, (void* (*)(void*))networkLoop, worker);
+        }
     }
-    if(realloced)
-        job->type = UA_JOBTYPE_BINARYMESSAGE_ALLOCATED;
+#endif
+
+    return result;
 }
 
 UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
@@ -623,6 +757,20 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
     if(waitInternal)
         timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
 
+#ifdef UA_ENABLE_MULTITHREADING
+    /* The networklayers are served by their own threads. Wait until the next
+     * repeated job is due. */
+    if(server->config.networkLayerThreads) {
+        if(timeout > 0)
+            usleep((useconds_t)timeout * 1000);
+        now = UA_DateTime_nowMonotonic();
+        timeout = 0;
+        if(nextRepeated > now)
+            timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
+        return timeout;
+    }
+#endif
+
     /* Get work from the networklayer */
     for(size_t i = 0; i < server->config.networkLayersSize; i++) {
         UA_ServerNetworkLayer *nl = &server->config.networkLayers[i];
@@ -642,10 +790,10 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
                 jobs[k].type = UA_JOBTYPE_NOTHING;
                 continue;
             }
-#endif
-            /* Merge half-received messages */
+            /* Merge half-received messages before the job is dispatched */
             if(jobs[k].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
-                completeMessages(server, &jobs[k]);
+                dispatchCompletedMessages(server, &jobs[k]);
+#endif
         }
 
 #ifdef UA_ENABLE_MULTITHREADING
@@ -668,6 +816,19 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
 }
 
 UA_StatusCode UA_Server_run_shutdown(UA_Server *server) {
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Stop the networklayer threads before the networklayers are stopped */
+    if(server->config.networkLayerThreads) {
+        UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
+                    "Shutting down %u networklayer thread(s)",
+                    (unsigned int)server->config.networkLayersSize);
+        for(size_t i = server->config.nThreads; i < server->workersSize; i++)
+            server->workers[i].running = false;
+        for(size_t i = server->config.nThreads; i < server->workersSize; i++)
+            pthread_join(server->workers[i].thr, NULL);
+    }
+#endif
+
     for(size_t i = 0; i < server->config.networkLayersSize; i++) {
         UA_ServerNetworkLayer *nl = &server->config.networkLayers[i];
         UA_Job *stopJobs;
@@ -685,14 +846,19 @@ UA_StatusCode UA_Server_run_shutdown(UA_Server *server) {
     pthread_cond_broadcast(&server->dispatchQueue_condition);
     for(size_t i = 0; i < server->config.nThreads; i++)
         pthread_join(server->workers[i].thr, NULL);
-    UA_free(server->workers);
 
     /* Manually finish the work still enqueued.
        This especially contains delayed frees */
     emptyDispatchQueue(server);
+    UA_free(server->workers); // the queue may still contain a getCounters job
+    server->workers = NULL;
+    server->workersSize = 0;
     UA_ASSERT_RCU_UNLOCKED();
     rcu_barrier(); // wait for all scheduled call_rcu work to complete
 #endif
+
+    /* The arena of the thread that ran the main loop */
+    UA_Arena_deleteMembers();
     return UA_STATUSCODE_GOOD;
 }
 
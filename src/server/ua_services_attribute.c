@@ -470,6 +470,33 @@ UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const U
         break;                                                          \
     }
 
+/* The ExtensionObjects of written values keep their body in the binary encoding
+ * (see lazyExtensionObjects in the service table). They are decoded before the
+ * value is stored or handed to a callback. The result is the same as if the
+ * request had been decoded at once. A scalar structure is unwrapped from the
+ * ExtensionObject. The decoded variant is empty if nothing was to be done. */
+static UA_StatusCode
+decodeWrittenValue(const UA_Variant *value, UA_Variant *decoded) {
+    UA_Variant_init(decoded);
+    if(value->type != &UA_TYPES[UA_TYPES_EXTENSIONOBJECT])
+        return UA_STATUSCODE_GOOD;
+    UA_StatusCode retval = UA_Variant_copy(value, decoded);
+    size_t length = UA_Variant_isScalar(decoded) ? 1 : decoded->arrayLength;
+    UA_ExtensionObject *eo = decoded->data;
+    for(size_t i = 0; i < length && retval == UA_STATUSCODE_GOOD; i++)
+        retval = UA_ExtensionObject_decodeBinaryContent(&eo[i]);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_Variant_deleteMembers(decoded);
+        return retval;
+    }
+    if(UA_Variant_isScalar(decoded) && eo->encoding == UA_EXTENSIONOBJECT_DECODED) {
+        decoded->type = eo->content.decoded.type;
+        decoded->data = eo->content.decoded.data;
+        UA_free(eo);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
 static UA_StatusCode
 Service_Write_single_ValueDataSource(UA_Server *server, UA_Session *session, const UA_VariableNode *node,
                                      const UA_WriteValue *wvalue) {
@@ -480,19 +507,25 @@ Service_Write_single_ValueDataSource(UA_Server *server, UA_Session *session, con
     if(node->value.dataSource.write == NULL)
         return UA_STATUSCODE_BADWRITENOTSUPPORTED;
 
-    UA_StatusCode retval;
+    UA_Variant decoded;
+    UA_StatusCode retval = decodeWrittenValue(&wvalue->value.value, &decoded);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    const UA_Variant *value = decoded.type ? &decoded : &wvalue->value.value;
+
     if(wvalue->indexRange.length <= 0) {
         retval = node->value.dataSource.write(node->value.dataSource.handle, node->nodeId,
-                                              &wvalue->value.value, NULL);
+                                              value, NULL);
     } else {
         UA_NumericRange range;
         retval = parse_numericrange(&wvalue->indexRange, &range);
-        if(retval != UA_STATUSCODE_GOOD)
-            return retval;
-        retval = node->value.dataSource.write(node->value.dataSource.handle, node->nodeId,
-                                              &wvalue->value.value, &range);
-        UA_free(range.dimensions);
+        if(retval == UA_STATUSCODE_GOOD) {
+            retval = node->value.dataSource.write(node->value.dataSource.handle, node->nodeId,
+                                                  value, &range);
+            UA_free(range.dimensions);
+        }
     }
+    UA_Variant_deleteMembers(&decoded);
     return retval;
 }
 
@@ -529,14 +562,23 @@ CopyValueIntoNode(UA_VariableNode *node, const UA_WriteValue *wvalue) {
         rangeptr = &range;
     }
 
+    UA_Variant decoded;
+    retval = decodeWrittenValue(&wvalue->value.value, &decoded);
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(rangeptr)
+            UA_free(range.dimensions);
+        return retval;
+    }
+    const UA_Variant *written = decoded.type ? &decoded : &wvalue->value.value;
+
     /* The nodeid on the wire may be != the nodeid in the node: opaque types, enums and bytestrings.
        nodeV contains the correct type definition. */
-    const UA_Variant *newV = &wvalue->value.value;
+    const UA_Variant *newV = written;
     UA_Variant *oldV = &node->value.variant.value;
     UA_Variant cast_v;
     if (oldV->type != NULL) { // Don't run NodeId_equal on a NULL pointer (happens if the variable never held a variant)
       if(!UA_NodeId_equal(&oldV->type->typeId, &newV->type->typeId)) {
-          cast_v = wvalue->value.value;
+          cast_v = *written;
           newV = &cast_v;
           enum type_equivalence te1 = typeEquivalence(oldV->type);
           enum type_equivalence te2 = typeEquivalence(newV->type);
@@ -554,6 +596,7 @@ CopyValueIntoNode(UA_VariableNode *node, const UA_WriteValue *wvalue) {
           } else {
               if(rangeptr)
                   UA_free(range.dimensions);
+              UA_Variant_deleteMembers(&decoded);
               return UA_STATUSCODE_BADTYPEMISMATCH;
           }
       }
@@ -569,6 +612,7 @@ CopyValueIntoNode(UA_VariableNode *node, const UA_WriteValue *wvalue) {
                                              &node->value.variant.value, rangeptr);
     if(rangeptr)
         UA_free(range.dimensions);
+    UA_Variant_deleteMembers(&decoded);
     return retval;
 }
 
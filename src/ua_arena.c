@@ -0,0 +1,163 @@
+#include <string.h>
+#include "ua_util.h"
+#include "ua_types.h"
+
+#ifdef UA_REQUEST_ARENA
+
+/* The arena is a list of blocks. Allocations are taken from the current block
+ * at the head of the list. Every allocation is prefixed with its size so that
+ * realloc can copy the content. */
+
+#define UA_ARENA_ALIGN 16
+#define UA_ARENA_BLOCKSIZE 65536
+#define UA_ARENA_ROUND(size) (((size) + UA_ARENA_ALIGN - 1) & ~(size_t)(UA_ARENA_ALIGN - 1))
+
+typedef struct UA_ArenaBlock {
+    struct UA_ArenaBlock *next;
+    size_t size; /* usable bytes after the header */
+    size_t used;
+} UA_ArenaBlock;
+
+#define UA_ARENA_HEADERSIZE UA_ARENA_ROUND(sizeof(UA_ArenaBlock))
+
+typedef struct {
+    UA_ArenaBlock *blocks;
+    UA_Boolean active;
+} UA_Arena;
+
+/* The arena is thread-local also without multithreading. Allocations in other
+ * threads of the application (e.g. a client) never go to the arena of the
+ * server thread. */
+static UA_ARENA_THREAD_LOCAL UA_Arena arena;
+
+static UA_Byte *
+blockData(UA_ArenaBlock *block) {
+    return (UA_Byte*)block + UA_ARENA_HEADERSIZE;
+}
+
+static UA_Boolean
+arenaContains(const void *ptr) {
+    for(UA_ArenaBlock *block = arena.blocks; block; block = block->next) {
+        const UA_Byte *data = blockData(block);
+        if((const UA_Byte*)ptr >= data && (const UA_Byte*)ptr < &data[block->size])
+            return true;
+    }
+    return false;
+}
+
+static void *
+arenaAlloc(size_t size) {
+    if(size > SIZE_MAX - 2 * UA_ARENA_ALIGN)
+        return NULL;
+    size_t needed = UA_ARENA_ALIGN + UA_ARENA_ROUND(size);
+    UA_ArenaBlock *block = arena.blocks;
+    if(!block || block->used + needed > block->size) {
+        /* The blocks grow so that the arena fits into a single block after a
+         * few resets */
+        size_t blockSize = UA_ARENA_BLOCKSIZE;
+        if(block && block->size <= (SIZE_MAX - UA_ARENA_HEADERSIZE) / 2)
+            blockSize = block->size * 2;
+        if(blockSize < needed)
+            blockSize = needed;
+        block = UA_Heap_malloc(UA_ARENA_HEADERSIZE + blockSize);
+        if(!block)
+            return NULL;
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena.blocks;
+        arena.blocks = block;
+    }
+    UA_Byte *p = &blockData(block)[block->used];
+    block->used += needed;
+    *(size_t*)p = size;
+    return p + UA_ARENA_ALIGN;
+}
+
+void * UA_Arena_malloc(size_t size) {
+    if(!arena.active)
+        return UA_Heap_malloc(size);
+    return arenaAlloc(size);
+}
+
+void * UA_Arena_calloc(size_t num, size_t size) {
+    if(!arena.active)
+        return UA_Heap_calloc(num, size);
+    if(size > 0 && num > SIZE_MAX / size)
+        return NULL;
+    void *p = arenaAlloc(num * size);
+    if(p)
+        memset(p, 0, num * size);
+    return p;
+}
+
+void * UA_Arena_realloc(void *ptr, size_t size) {
+    /* Only memory allocated during the decoding can be in the arena */
+    if(!arena.active)
+        return UA_Heap_realloc(ptr, size);
+    if(!ptr)
+        return arenaAlloc(size);
+    if(!arenaContains(ptr))
+        return UA_Heap_realloc(ptr, size);
+
+    /* The last allocation in the current block grows in place */
+    size_t oldSize = *(size_t*)((UA_Byte*)ptr - UA_ARENA_ALIGN);
+    UA_ArenaBlock *block = arena.blocks;
+    UA_Byte *end = &blockData(block)[block->used];
+    if((UA_Byte*)ptr + UA_ARENA_ROUND(oldSize) == end && size <= SIZE_MAX - UA_ARENA_ALIGN) {
+        size_t used = block->used - UA_ARENA_ROUND(oldSize) + UA_ARENA_ROUND(size);
+        if(used <= block->size) {
+            block->used = used;
+            *(size_t*)((UA_Byte*)ptr - UA_ARENA_ALIGN) = size;
+            return ptr;
+        }
+    }
+
+    void *p = arenaAlloc(size);
+    if(p)
+        memcpy(p, ptr, oldSize < size ? oldSize : size);
+    return p;
+}
+
+/* The memory in the arena is released with the reset. Outside of the decoding,
+ * no pointers into the arena are freed. */
+void UA_Arena_free(void *ptr) {
+    if(arena.active && arenaContains(ptr))
+        return;
+    UA_Heap_free(ptr);
+}
+
+void UA_Arena_begin(void) {
+    arena.active = true;
+}
+
+void UA_Arena_end(void) {
+    arena.active = false;
+}
+
+void UA_Arena_reset(void) {
+    UA_ArenaBlock *block = arena.blocks;
+    if(!block)
+        return;
+    /* The head is the largest block */
+    UA_ArenaBlock *next = block->next;
+    while(next) {
+        UA_ArenaBlock *n = next->next;
+        UA_Heap_free(next);
+        next = n;
+    }
+    block->next = NULL;
+    block->used = 0;
+}
+
+void UA_Arena_deleteMembers(void) {
+    UA_ArenaBlock *block = arena.blocks;
+    while(block) {
+        UA_ArenaBlock *next = block->next;
+        UA_Heap_free(block);
+        block = next;
+    }
+    arena.blocks = NULL;
+    arena.active = false;
+}
+
+#endif /* UA_REQUEST_ARENA */
@@ -9,6 +9,9 @@ const UA_ConnectionConfig UA_ConnectionConfig_standard =
     {.protocolVersion = 0, .sendBufferSize = 65536, .recvBufferSize  = 65536,
      .maxMessageSize = 65536, .maxChunkCount   = 1};
 
+#define UA_MESSAGE_HEADERSIZE 8 /* message type and length */
+#define UA_MESSAGE_MINSIZE 16
+
 void UA_Connection_init(UA_Connection *connection) {
     connection->state = UA_CONNECTION_CLOSED;
     connection->localConf = UA_ConnectionConfig_standard;
@@ -18,6 +21,7 @@ void UA_Connection_init(UA_Connection *connection) {
     connection->handle = NULL;
     UA_ByteString_init(&connection->incompleteMessage);
     connection->send = NULL;
+    connection->waitSendable = NULL;
     connection->close = NULL;
     connection->recv = NULL;
     connection->getSendBuffer = NULL;
@@ -29,106 +33,122 @@ void UA_Connection_deleteMembers(UA_Connection *connection) {
     UA_ByteString_deleteMembers(&connection->incompleteMessage);
 }
 
-UA_StatusCode
-UA_Connection_completeMessages(UA_Connection *connection, UA_ByteString * UA_RESTRICT message,
-                              UA_Boolean * UA_RESTRICT realloced) {
-    UA_ByteString *current = message;
-    *realloced = false;
-    if(connection->incompleteMessage.length > 0) {
-        /* concat the existing incomplete message with the new message */
-        UA_Byte *data = UA_realloc(connection->incompleteMessage.data,
-                                   connection->incompleteMessage.length + message->length);
-        if(!data) {
-            /* not enough memory */
-            UA_ByteString_deleteMembers(&connection->incompleteMessage);
-            connection->releaseRecvBuffer(connection, message);
+/* Checks the message type and reads the length from the first 8 bytes of a
+ * message. Returns false if the stream does not start with a valid message. */
+static UA_Boolean
+readMessageLength(const UA_Connection *connection, const UA_Byte *header, UA_UInt32 *length) {
+    UA_UInt32 msgtype = (UA_UInt32)header[0] + ((UA_UInt32)header[1] << 8) + ((UA_UInt32)header[2] << 16);
+    if(msgtype != ('M' + ('S' << 8) + ('G' << 16)) &&
+       msgtype != ('O' + ('P' << 8) + ('N' << 16)) &&
+       msgtype != ('H' + ('E' << 8) + ('L' << 16)) &&
+       msgtype != ('A' + ('C' << 8) + ('K' << 16)) &&
+       msgtype != ('C' + ('L' << 8) + ('O' << 16)))
+        return false; /* the message type is not recognized */
+    *length = (UA_UInt32)header[4] + ((UA_UInt32)header[5] << 8) +
+        ((UA_UInt32)header[6] << 16) + ((UA_UInt32)header[7] << 24);
+    return (*length >= UA_MESSAGE_MINSIZE && *length <= connection->localConf.recvBufferSize);
+}
+
+/* Moves bytes from the buffer into the incomplete message. The incomplete
+ * message is allocated with the full length once its header has arrived. Until
+ * then, only the header is collected. */
+static UA_StatusCode
+continueIncompleteMessage(UA_Connection *connection, const UA_ByteString *buffer, size_t *pos,
+                          UA_Boolean *complete) {
+    UA_ByteString *incomplete = &connection->incompleteMessage;
+    *complete = false;
+    if(incomplete->length < UA_MESSAGE_HEADERSIZE) {
+        size_t n = UA_MESSAGE_HEADERSIZE - incomplete->length;
+        if(n > buffer->length - *pos)
+            n = buffer->length - *pos;
+        memcpy(&incomplete->data[incomplete->length], &buffer->data[*pos], n);
+        incomplete->length += n;
+        *pos += n;
+        if(incomplete->length < UA_MESSAGE_HEADERSIZE)
+            return UA_STATUSCODE_GOOD;
+        UA_UInt32 length;
+        if(!readMessageLength(connection, incomplete->data, &length))
+            return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+        UA_Byte *data = UA_realloc(incomplete->data, length);
+        if(!data)
             return UA_STATUSCODE_BADOUTOFMEMORY;
-        }
-        memcpy(&data[connection->incompleteMessage.length], message->data, message->length);
-        connection->incompleteMessage.data = data;
-        connection->incompleteMessage.length += message->length;
-        connection->releaseRecvBuffer(connection, message);
-        current = &connection->incompleteMessage;
-        *realloced = true;
+        incomplete->data = data;
     }
 
-    /* the while loop sets pos to the first element after the last complete message. if a message
-       contains garbage, the buffer length is set to contain only the "good" messages before. */
+    UA_UInt32 length;
+    readMessageLength(connection, incomplete->data, &length);
+    size_t n = length - incomplete->length;
+    if(n > buffer->length - *pos)
+        n = buffer->length - *pos;
+    memcpy(&incomplete->data[incomplete->length], &buffer->data[*pos], n);
+    incomplete->length += n;
+    *pos += n;
+    *complete = (incomplete->length == length);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Connection_completeMessages(UA_Connection *connection, const UA_ByteString * UA_RESTRICT buffer,
+                               UA_ByteString * UA_RESTRICT completed, UA_ByteString * UA_RESTRICT messages) {
+    UA_ByteString_init(completed);
+    UA_ByteString_init(messages);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+
+    /* continue the message that straddles the previous buffers */
     size_t pos = 0;
-    size_t delete_at = current->length-1; // garbled message after this point
-    while(current->length - pos >= 16) {
-        UA_UInt32 msgtype = (UA_UInt32)current->data[pos] +
-            ((UA_UInt32)current->data[pos+1] << 8) +
-            ((UA_UInt32)current->data[pos+2] << 16);
-        if(msgtype != ('M' + ('S' << 8) + ('G' << 16)) &&
-           msgtype != ('O' + ('P' << 8) + ('N' << 16)) &&
-           msgtype != ('H' + ('E' << 8) + ('L' << 16)) &&
-           msgtype != ('A' + ('C' << 8) + ('K' << 16)) &&
-           msgtype != ('C' + ('L' << 8) + ('O' << 16))) {
-            /* the message type is not recognized */
-            delete_at = pos; // throw the remaining message away
-            break;
-        }
-        UA_UInt32 length = 0;
-        size_t length_pos = pos + 4;
-        UA_StatusCode retval = UA_UInt32_decodeBinary(current, &length_pos, &length);
-        if(retval != UA_STATUSCODE_GOOD || length < 16 || length > connection->localConf.recvBufferSize) {
-            /* the message size is not allowed. throw the remaining bytestring away */
-            delete_at = pos;
+    if(connection->incompleteMessage.length > 0) {
+        UA_Boolean complete;
+        retval = continueIncompleteMessage(connection, buffer, &pos, &complete);
+        if(retval != UA_STATUSCODE_GOOD)
+            goto error;
+        if(!complete)
+            return UA_STATUSCODE_GOOD;
+        *completed = connection->incompleteMessage;
+        UA_ByteString_init(&connection->incompleteMessage);
+    }
+
+    /* frame the complete messages in place. if a message contains garbage,
+       only the "good" messages before are returned. */
+    size_t start = pos;
+    UA_Boolean garbage = false;
+    while(buffer->length - pos >= UA_MESSAGE_HEADERSIZE) {
+        UA_UInt32 length;
+        if(!readMessageLength(connection, &buffer->data[pos], &length)) {
+            garbage = true; /* throw the remaining bytestring away */
             break;
         }
-        if(length + pos > current->length)
+        if(length > buffer->length - pos)
             break; /* the message is incomplete. keep the beginning */
         pos += length;
     }
-
-    /* throw the message away */
-    if(delete_at == 0) {
-        if(!*realloced) {
-            connection->releaseRecvBuffer(connection, message);
-            *realloced = true;
-        } else
-            UA_ByteString_deleteMembers(current);
-        return UA_STATUSCODE_GOOD;
+    if(pos > start) {
+        messages->data = &buffer->data[start];
+        messages->length = pos - start;
     }
-
-    /* no complete message at all */
-    if(pos == 0) {
-        if(!*realloced) {
-            /* store the buffer in the connection */
-            UA_ByteString_copy(current, &connection->incompleteMessage);
-            connection->releaseRecvBuffer(connection, message);
-            *realloced = true;
-        } 
+    if(garbage || pos == buffer->length)
         return UA_STATUSCODE_GOOD;
-    }
 
-    /* there remains an incomplete message at the end */
-    if(current->length != pos) {
-        UA_Byte *data = UA_malloc(current->length - pos);
-        if(!data) {
-            UA_ByteString_deleteMembers(&connection->incompleteMessage);
-            if(!*realloced) {
-                connection->releaseRecvBuffer(connection, message);
-                *realloced = true;
-            }
-            return UA_STATUSCODE_BADOUTOFMEMORY;
-        }
-        size_t newlength = current->length - pos;
-        memcpy(data, &current->data[pos], newlength);
-        current->length = pos;
-        if(*realloced)
-            *message = *current;
-        connection->incompleteMessage.data = data;
-        connection->incompleteMessage.length = newlength;
-        return UA_STATUSCODE_GOOD;
-    }
-
-    if(current == &connection->incompleteMessage) {
-        *message = *current;
-        connection->incompleteMessage = UA_BYTESTRING_NULL;
+    /* copy the beginning of the last message. allocate the full length right
+       away if the header is known. */
+    size_t remaining = buffer->length - pos;
+    size_t size = UA_MESSAGE_HEADERSIZE;
+    UA_UInt32 length;
+    if(remaining >= UA_MESSAGE_HEADERSIZE && readMessageLength(connection, &buffer->data[pos], &length))
+        size = length;
+    connection->incompleteMessage.data = UA_malloc(size);
+    if(!connection->incompleteMessage.data) {
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+        goto error;
     }
+    memcpy(connection->incompleteMessage.data, &buffer->data[pos], remaining);
+    connection->incompleteMessage.length = remaining;
     return UA_STATUSCODE_GOOD;
+
+ error:
+    UA_ByteString_deleteMembers(&connection->incompleteMessage);
+    UA_ByteString_deleteMembers(completed);
+    UA_ByteString_init(messages);
+    return retval;
 }
 
 #if (__GNUC__ >= 4 && __GNUC_MINOR__ >= 6)
@@ -8,22 +8,27 @@
  * protocol. Furthermore, the networklayer may operate on ringbuffers or
  * statically assigned memory.
  *
- * If an entire message is received, it is forwarded directly. But the memory
- * needs to be freed with the networklayer-specific mechanism. If a half message
- * is received, we copy it into a local buffer. Then, the stack-specific free
- * needs to be used.
+ * The complete messages in a received buffer are framed in place and never
+ * copied. Only a message that straddles the boundary between two buffers is
+ * copied into the connection. The copy is allocated with the full message
+ * length as soon as the header has arrived, so every byte is copied once.
  *
  * @param connection The connection
- * @param message The received message. The content may be overwritten when a
- *        previsouly received buffer is completed.
- * @param realloced The Boolean value is set to true if the outgoing message has
- *        been reallocated from the network layer.
- * @return Returns UA_STATUSCODE_GOOD or an error code. When an error occurs, the ingoing message
- *         and the current buffer in the connection are freed.
+ * @param buffer The received buffer. It stays with the caller and has to be
+ *        released with the networklayer-specific mechanism after the messages
+ *        have been processed.
+ * @param completed Set to the straddling message that the buffer completes, or
+ *        to an empty bytestring. It has to be processed before the messages in
+ *        the buffer and freed with UA_ByteString_deleteMembers.
+ * @param messages Set to the complete messages in the buffer, or to an empty
+ *        bytestring. Points into the buffer.
+ * @return Returns UA_STATUSCODE_GOOD or an error code. When an error occurs, no
+ *         messages are returned and the incomplete message in the connection is
+ *         freed.
  */
 UA_StatusCode
-UA_Connection_completeMessages(UA_Connection *connection, UA_ByteString * UA_RESTRICT message,
-                               UA_Boolean * UA_RESTRICT realloced);
+UA_Connection_completeMessages(UA_Connection *connection, const UA_ByteString * UA_RESTRICT buffer,
+                               UA_ByteString * UA_RESTRICT completed, UA_ByteString * UA_RESTRICT messages);
 
 void UA_EXPORT UA_Connection_detachSecureChannel(UA_Connection *connection);
 void UA_EXPORT UA_Connection_attachSecureChannel(UA_Connection *connection, UA_SecureChannel *channel);
@@ -14,9 +14,15 @@ void UA_SecureChannel_init(UA_SecureChannel *channel) {
     UA_ByteString_init(&channel->clientNonce);
     UA_ByteString_init(&channel->serverNonce);
     channel->sequenceNumber = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&channel->sendLock, NULL);
+#endif
     channel->connection = NULL;
     LIST_INIT(&channel->sessions);
-    LIST_INIT(&channel->chunks);
+    for(size_t i = 0; i < UA_SECURECHANNEL_CHUNKBUCKETS; i++)
+        LIST_INIT(&channel->chunks[i]);
+    channel->chunksSize = 0;
+    channel->chunksAllocated = 0;
 }
 
 void UA_SecureChannel_deleteMembersCleanup(UA_SecureChannel *channel) {
@@ -42,11 +48,18 @@ void UA_SecureChannel_deleteMembersCleanup(UA_SecureChannel *channel) {
     }
 
     struct ChunkEntry *ch, *temp_ch;
-    LIST_FOREACH_SAFE(ch, &channel->chunks, pointers, temp_ch) {
-        UA_ByteString_deleteMembers(&ch->bytes);
-        LIST_REMOVE(ch, pointers);
-        UA_free(ch);
+    for(size_t i = 0; i < UA_SECURECHANNEL_CHUNKBUCKETS; i++) {
+        LIST_FOREACH_SAFE(ch, &channel->chunks[i], pointers, temp_ch) {
+            UA_ByteString_deleteMembers(&ch->bytes);
+            LIST_REMOVE(ch, pointers);
+            UA_free(ch);
+        }
     }
+    channel->chunksSize = 0;
+    channel->chunksAllocated = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&channel->sendLock);
+#endif
 }
 
 //TODO implement real nonce generator - DUMMY function
@@ -123,6 +136,105 @@ void UA_SecureChannel_revolveTokens(UA_SecureChannel *channel){
     UA_ChannelSecurityToken_init(&channel->nextSecurityToken);
 }
 
+/* Messages larger than the receive buffer of the remote side are sent in
+ * chunks. The content is encoded into a buffer of one chunk. When the buffer is
+ * full, the chunk is sent and the encoding continues in a new buffer.
+ *
+ * With multithreading, responses are sent concurrently from the worker
+ * threads. The send lock of the channel is taken before the first chunk is
+ * sent and released after the last chunk. So a message in a single chunk is
+ * encoded without the lock.
+ *
+ * After each intermediate chunk, the encoding waits until the connection has
+ * handed the chunk to the network. A slow client then holds back the encoding
+ * instead of the response piling up in the send queue.
+ *
+ * The limits of the remote side are checked as the chunks are sent. A message
+ * beyond the limits is cut off with an abort chunk. */
+typedef struct {
+    UA_SecureChannel *channel;
+    UA_UInt32 requestId;
+    size_t messageSize; // body bytes including the current chunk
+    size_t chunksSize; // sent chunks
+    UA_StatusCode error; // the buffer is gone after a failed exchange
+} ChunkInfo;
+
+static UA_StatusCode
+sendChunk(ChunkInfo *ci, UA_MessageTypeAndFinal chunkType, UA_ByteString *buf, size_t length) {
+    UA_SecureChannel *channel = ci->channel;
+    UA_Connection *connection = channel->connection;
+    UA_SecureConversationMessageHeader respHeader;
+    respHeader.messageHeader.messageTypeAndFinal = chunkType;
+    respHeader.messageHeader.messageSize = (UA_UInt32)length;
+    respHeader.secureChannelId = channel->securityToken.channelId;
+
+    UA_SymmetricAlgorithmSecurityHeader symSecHeader;
+    symSecHeader.tokenId = channel->securityToken.tokenId;
+
+    UA_SequenceHeader seqHeader;
+    seqHeader.requestId = ci->requestId;
+#ifdef UA_ENABLE_MULTITHREADING
+    if(ci->chunksSize == 0)
+        pthread_mutex_lock(&channel->sendLock);
+#endif
+    seqHeader.sequenceNumber = ++channel->sequenceNumber;
+
+    size_t pos = 0;
+    UA_SecureConversationMessageHeader_encodeBinary(&respHeader, buf, &pos);
+    UA_SymmetricAlgorithmSecurityHeader_encodeBinary(&symSecHeader, buf, &pos);
+    UA_SequenceHeader_encodeBinary(&seqHeader, buf, &pos);
+    buf->length = length;
+    ci->chunksSize++;
+    UA_StatusCode retval = connection->send(connection, buf);
+    UA_ByteString_init(buf); // the buffer is released by send
+    return retval;
+}
+
+/* Sends the full buffer as an intermediate chunk and continues in a new buffer */
+static UA_StatusCode
+sendChunkAndExchange(void *handle, UA_ByteString *buf, size_t *offset) {
+    ChunkInfo *ci = handle;
+    if(ci->error != UA_STATUSCODE_GOOD)
+        return ci->error;
+    UA_Connection *connection = ci->channel->connection;
+    const UA_ConnectionConfig *remoteConf = &connection->remoteConf;
+    ci->messageSize += *offset - UA_SECURECHANNEL_MESSAGE_HEADERSIZE;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(remoteConf->maxMessageSize > 0 && ci->messageSize > remoteConf->maxMessageSize)
+        retval = UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    /* Keep room for the final chunk */
+    if(remoteConf->maxChunkCount > 0 && ci->chunksSize + 1 >= remoteConf->maxChunkCount)
+        retval = UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = sendChunk(ci, UA_MESSAGETYPEANDFINAL_MSGC, buf, *offset);
+    if(retval == UA_STATUSCODE_GOOD && connection->waitSendable)
+        retval = connection->waitSendable(connection);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = connection->getSendBuffer(connection, remoteConf->recvBufferSize, buf);
+    if(retval != UA_STATUSCODE_GOOD) {
+        ci->error = retval;
+        return retval;
+    }
+    *offset = UA_SECURECHANNEL_MESSAGE_HEADERSIZE;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The receiver discards the chunks that were already sent */
+static void
+sendAbortChunk(ChunkInfo *ci, UA_StatusCode error) {
+    UA_Connection *connection = ci->channel->connection;
+    UA_ByteString buf;
+    if(connection->getSendBuffer(connection, connection->remoteConf.recvBufferSize,
+                                 &buf) != UA_STATUSCODE_GOOD)
+        return;
+    size_t pos = UA_SECURECHANNEL_MESSAGE_HEADERSIZE;
+    UA_String reason = UA_STRING_NULL;
+    UA_StatusCode_encodeBinary(&error, &buf, &pos);
+    UA_String_encodeBinary(&reason, &buf, &pos);
+    sendChunk(ci, UA_MESSAGETYPEANDFINAL_MSGA, &buf, pos);
+}
+
 UA_StatusCode UA_SecureChannel_sendBinaryMessage(UA_SecureChannel *channel, UA_UInt32 requestId,
                                                   const void *content,
                                                   const UA_DataType *contentType) {
@@ -135,46 +247,60 @@ UA_StatusCode UA_SecureChannel_sendBinaryMessage(UA_SecureChannel *channel, UA_U
         return UA_STATUSCODE_BADINTERNALERROR;
     typeId.identifier.numeric += UA_ENCODINGOFFSET_BINARY;
 
-    UA_SecureConversationMessageHeader respHeader;
-    respHeader.messageHeader.messageTypeAndFinal = UA_MESSAGETYPEANDFINAL_MSGF;
-    respHeader.messageHeader.messageSize = 0;
-    respHeader.secureChannelId = channel->securityToken.channelId;
-
-    UA_SymmetricAlgorithmSecurityHeader symSecHeader;
-    symSecHeader.tokenId = channel->securityToken.tokenId;
-
-    UA_SequenceHeader seqHeader;
-    seqHeader.requestId = requestId;
-
     UA_ByteString message;
     UA_StatusCode retval = connection->getSendBuffer(connection, connection->remoteConf.recvBufferSize,
                                                      &message);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
 
-    size_t messagePos = 24; // after the headers
-    retval |= UA_NodeId_encodeBinary(&typeId, &message, &messagePos);
-    retval |= UA_encodeBinary(content, contentType, &message, &messagePos);
-
+    ChunkInfo ci = {channel, requestId, 0, 0, UA_STATUSCODE_GOOD};
+    size_t messagePos = UA_SECURECHANNEL_MESSAGE_HEADERSIZE;
+    retval = UA_encodeBinaryExchange(&typeId, &UA_TYPES[UA_TYPES_NODEID], sendChunkAndExchange,
+                                     &ci, &message, &messagePos);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_encodeBinaryExchange(content, contentType, sendChunkAndExchange,
+                                         &ci, &message, &messagePos);
+    if(retval == UA_STATUSCODE_GOOD) {
+        ci.messageSize += messagePos - UA_SECURECHANNEL_MESSAGE_HEADERSIZE;
+        if(connection->remoteConf.maxMessageSize > 0 &&
+           ci.messageSize > connection->remoteConf.maxMessageSize)
+            retval = UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    }
     if(retval != UA_STATUSCODE_GOOD) {
-        connection->releaseSendBuffer(connection, &message);
-        return retval;
+        if(message.data)
+            connection->releaseSendBuffer(connection, &message);
+        if(ci.chunksSize == 0)
+            return retval;
+        /* The message is answered with the abort chunk */
+        sendAbortChunk(&ci, retval);
+        retval = UA_STATUSCODE_GOOD;
+    } else {
+        retval = sendChunk(&ci, UA_MESSAGETYPEANDFINAL_MSGF, &message, messagePos);
     }
-
-    /* now write the header with the size */
-    respHeader.messageHeader.messageSize = (UA_UInt32)messagePos;
-#ifndef UA_ENABLE_MULTITHREADING
-    seqHeader.sequenceNumber = ++channel->sequenceNumber;
-#else
-    seqHeader.sequenceNumber = uatomic_add_return(&channel->sequenceNumber, 1);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&channel->sendLock);
 #endif
+    return retval;
+}
 
-    messagePos = 0;
-    UA_SecureConversationMessageHeader_encodeBinary(&respHeader, &message, &messagePos);
-    UA_SymmetricAlgorithmSecurityHeader_encodeBinary(&symSecHeader, &message, &messagePos);
-    UA_SequenceHeader_encodeBinary(&seqHeader, &message, &messagePos);
-    message.length = respHeader.messageHeader.messageSize;
+UA_StatusCode UA_SecureChannel_sendEncodedMessage(UA_SecureChannel *channel, UA_UInt32 requestId,
+                                                   const UA_ByteString *body) {
+    UA_Connection *connection = channel->connection;
+    if(!connection)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    size_t length = UA_SECURECHANNEL_MESSAGE_HEADERSIZE + body->length;
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
 
-    retval = connection->send(connection, &message);
+    UA_ByteString message;
+    UA_StatusCode retval = connection->getSendBuffer(connection, length, &message);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    memcpy(&message.data[UA_SECURECHANNEL_MESSAGE_HEADERSIZE], body->data, body->length);
+    ChunkInfo ci = {channel, requestId, 0, 0, UA_STATUSCODE_GOOD};
+    retval = sendChunk(&ci, UA_MESSAGETYPEANDFINAL_MSGF, &message, length);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&channel->sendLock);
+#endif
     return retval;
 }
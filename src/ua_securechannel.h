@@ -5,6 +5,9 @@
 #include "ua_types.h"
 #include "ua_transport_generated.h"
 #include "ua_connection_internal.h"
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
 
 struct UA_Session;
 typedef struct UA_Session UA_Session;
@@ -14,13 +17,23 @@ struct SessionEntry {
     UA_Session *session; // Just a pointer. The session is held in the session manager or the client
 };
 
+/* The chunks of a request are appended to a buffer until the final chunk
+ * arrives. The buffer is allocated at the expected message size up front. */
 struct ChunkEntry {
     LIST_ENTRY(ChunkEntry) pointers;
     UA_UInt32 requestId;
-    UA_Boolean invalid_message;
-    UA_ByteString bytes;
+    UA_UInt32 requestHandle; // from the first chunk, to answer with a ServiceFault
+    UA_StatusCode invalid; // the chunks are discarded if this is set
+    UA_ByteString bytes; // the length is the size of the received chunk bodies
+    size_t allocated;
 };
 
+/* The headers of a MSG chunk up to the end of the sequence header */
+#define UA_SECURECHANNEL_MESSAGE_HEADERSIZE 24
+
+/* The chunk entries are hashed by the requestId */
+#define UA_SECURECHANNEL_CHUNKBUCKETS 16
+
 struct UA_SecureChannel {
     UA_MessageSecurityMode  securityMode;
     UA_ChannelSecurityToken securityToken; // the channelId is contained in the securityToken
@@ -30,9 +43,16 @@ struct UA_SecureChannel {
     UA_ByteString  clientNonce;
     UA_ByteString  serverNonce;
     UA_UInt32      sequenceNumber;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Held while the chunks of a message are sent. The sequence numbers are
+     * sent in order and chunks of concurrent messages do not interleave. */
+    pthread_mutex_t sendLock;
+#endif
     UA_Connection *connection;
     LIST_HEAD(session_pointerlist, SessionEntry) sessions;
-    LIST_HEAD(chunk_pointerlist, ChunkEntry) chunks;
+    LIST_HEAD(chunk_pointerlist, ChunkEntry) chunks[UA_SECURECHANNEL_CHUNKBUCKETS];
+    size_t chunksSize; // number of chunked requests in reassembly
+    size_t chunksAllocated; // bytes allocated for the chunked requests
 };
 
 void UA_SecureChannel_init(UA_SecureChannel *channel);
@@ -44,9 +64,19 @@ void UA_SecureChannel_attachSession(UA_SecureChannel *channel, UA_Session *sessi
 void UA_SecureChannel_detachSession(UA_SecureChannel *channel, UA_Session *session);
 UA_Session * UA_SecureChannel_getSession(UA_SecureChannel *channel, UA_NodeId *token);
 
+/* Sends the message in chunks of the receive buffer size of the remote side.
+ * Returns an error if the message exceeds the negotiated maximum message size
+ * or chunk count, before anything is sent. If the encoding fails after the
+ * first chunk was sent, the message is aborted with an abort chunk carrying the
+ * error, which answers the request. */
 UA_StatusCode UA_SecureChannel_sendBinaryMessage(UA_SecureChannel *channel, UA_UInt32 requestId,
                                                   const void *content, const UA_DataType *contentType);
 
+/* Sends a message that is already encoded (starting with the type id) in a
+ * single chunk */
+UA_StatusCode UA_SecureChannel_sendEncodedMessage(UA_SecureChannel *channel, UA_UInt32 requestId,
+                                                   const UA_ByteString *body);
+
 void UA_SecureChannel_revolveTokens(UA_SecureChannel *channel);
 
 #endif /* UA_SECURECHANNEL_H_ */
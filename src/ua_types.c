@@ -1,6 +1,7 @@
 #include "ua_util.h"
 #include "ua_types.h"
 #include "ua_types_generated.h"
+#include "ua_types_encoding_binary.h"
 
 #include "pcg_basic.h"
 #include "libc_time.h"
@@ -852,3 +853,94 @@ void UA_Array_delete(void *p, size_t size, const UA_DataType *type) {
     }
     UA_free((void*)((uintptr_t)p & ~(uintptr_t)UA_EMPTY_ARRAY_SENTINEL));
 }
+
+/********************/
+/* Borrowed Strings */
+/********************/
+
+static void Variant_deleteMembersBorrowed(UA_Variant *p) {
+    if(p->storageType != UA_VARIANT_DATA)
+        return;
+    if(p->data > UA_EMPTY_ARRAY_SENTINEL) {
+        if(p->arrayLength == 0)
+            p->arrayLength = 1;
+        UA_Array_deleteBorrowed(p->data, p->arrayLength, p->type);
+        p->data = NULL;
+        p->arrayLength = 0;
+    }
+    if(p->arrayDimensions) {
+        UA_Array_delete(p->arrayDimensions, p->arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
+        p->arrayDimensions = NULL;
+        p->arrayDimensionsSize = 0;
+    }
+}
+
+static void DiagnosticInfo_deleteMembersBorrowed(UA_DiagnosticInfo *p) {
+    if(p->hasInnerDiagnosticInfo && p->innerDiagnosticInfo) {
+        DiagnosticInfo_deleteMembersBorrowed(p->innerDiagnosticInfo);
+        UA_free(p->innerDiagnosticInfo);
+        p->innerDiagnosticInfo = NULL;
+        p->hasInnerDiagnosticInfo = false;
+    }
+}
+
+void UA_deleteMembersBorrowed(void *p, const UA_DataType *type) {
+    if(type->builtin) {
+        switch(type->typeIndex) {
+        case UA_TYPES_EXTENSIONOBJECT: {
+            /* The body of an encoded ExtensionObject is a borrowed bytestring */
+            UA_ExtensionObject *eo = p;
+            if(eo->encoding == UA_EXTENSIONOBJECT_DECODED && eo->content.decoded.data) {
+                UA_deleteMembersBorrowed(eo->content.decoded.data, eo->content.decoded.type);
+                UA_free(eo->content.decoded.data);
+                eo->content.decoded.data = NULL;
+            }
+            break;
+        }
+        case UA_TYPES_DATAVALUE:
+            Variant_deleteMembersBorrowed(&((UA_DataValue*)p)->value);
+            break;
+        case UA_TYPES_VARIANT:
+            Variant_deleteMembersBorrowed(p);
+            break;
+        case UA_TYPES_DIAGNOSTICINFO:
+            DiagnosticInfo_deleteMembersBorrowed(p);
+            break;
+        default:
+            /* The other builtins own no memory besides borrowed strings */
+            break;
+        }
+        return;
+    }
+
+    uintptr_t ptr = (uintptr_t)p;
+    UA_Byte membersSize = type->membersSize;
+    for(size_t i = 0; i < membersSize; i++) {
+        const UA_DataTypeMember *member = &type->members[i];
+        const UA_DataType *typelists[2] = { UA_TYPES, &type[-type->typeIndex] };
+        const UA_DataType *memberType = &typelists[!member->namespaceZero][member->memberTypeIndex];
+        ptr += member->padding;
+        if(!member->isArray) {
+            UA_deleteMembersBorrowed((void*)ptr, memberType);
+            ptr += memberType->memSize;
+        } else {
+            size_t length = *(size_t*)ptr;
+            *(size_t*)ptr = 0;
+            ptr += sizeof(size_t);
+            UA_Array_deleteBorrowed(*(void**)ptr, length, memberType);
+            *(void**)ptr = NULL;
+            ptr += sizeof(void*);
+        }
+    }
+}
+
+void UA_Array_deleteBorrowed(void *p, size_t size, const UA_DataType *type) {
+    if(!type->fixedSize) {
+        uintptr_t ptr = (uintptr_t)p;
+        for(size_t i = 0; i < size; i++) {
+            UA_deleteMembersBorrowed((void*)ptr, type);
+            ptr += type->memSize;
+        }
+    }
+    UA_free((void*)((uintptr_t)p & ~(uintptr_t)UA_EMPTY_ARRAY_SENTINEL));
+}
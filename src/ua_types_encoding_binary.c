@@ -1,23 +1,142 @@
 #include "ua_util.h"
 #include "ua_types_generated.h"
 #include "ua_types_encoding_binary.h"
+#include "ua_types_encoding_binary_kernels.h"
 
-/* All de- and encoding functions have the same signature up to the pointer type.
-   So we can use a jump-table to switch into member types. */
+/* All de- and encoding functions of the builtin types have the same signature
+   up to the pointer type. So we can use a jump-table to switch into member
+   types. Structured types are de- and encoded member by member with the
+   datatype passed along explicitly. */
 
 typedef UA_Byte * UA_RESTRICT * const bufpos;
-typedef const UA_Byte * const bufend;
 
-typedef UA_StatusCode (*UA_encodeBinarySignature)(const void *UA_RESTRICT src, bufpos pos, bufend end);
-static const UA_encodeBinarySignature encodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1];
-
-typedef UA_StatusCode (*UA_decodeBinarySignature)(bufpos pos, bufend end, void *UA_RESTRICT dst);
-static const UA_decodeBinarySignature decodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1];
+/* The encoding continues in a new buffer when the current buffer is full and
+ * an exchange callback is set. So the end of the buffer can move. When the
+ * content is kept, the exchanged buffer begins with the bytes encoded so far
+ * (the buffer was grown). Otherwise they are gone (e.g. sent as a chunk). */
+typedef struct {
+    UA_ByteString *buf;
+    const UA_Byte *end;
+    UA_exchangeEncodeBuffer exchangeCallback;
+    void *exchangeHandle;
+    UA_Boolean keepsContent;
+} EncodeContext;
+typedef EncodeContext * const encodectx;
+
+/* The options of the decoding are passed along with the end of the buffer */
+typedef struct {
+    const UA_Byte *end;
+    /* ExtensionObjects in Variants keep their body in the binary encoding */
+    UA_Boolean lazyExtensionObjects;
+    /* Strings point into the buffer instead of being copied */
+    UA_Boolean borrowStrings;
+} DecodeContext;
+typedef const DecodeContext * const decodectx;
+
+/* Deletes a value whose decoding failed. Borrowed strings are not freed. */
+static void
+deleteDecoded(void *p, const UA_DataType *type, decodectx ctx) {
+    if(ctx->borrowStrings)
+        UA_deleteMembersBorrowed(p, type);
+    else
+        UA_deleteMembers(p, type);
+}
+
+static void
+deleteDecodedArray(void *p, size_t size, const UA_DataType *type, decodectx ctx) {
+    if(ctx->borrowStrings)
+        UA_Array_deleteBorrowed(p, size, type);
+    else
+        UA_Array_delete(p, size, type);
+}
+
+typedef UA_StatusCode (*UA_encodeBinarySignature)(const void *UA_RESTRICT src, bufpos pos, encodectx ctx);
+static const UA_encodeBinarySignature encodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT];
+
+typedef UA_StatusCode (*UA_decodeBinarySignature)(bufpos pos, decodectx ctx, void *UA_RESTRICT dst);
+static const UA_decodeBinarySignature decodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT];
 
 typedef size_t (*UA_calcSizeBinarySignature)(const void *UA_RESTRICT p, const UA_DataType *contenttype);
 static const UA_calcSizeBinarySignature calcSizeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1];
 
-UA_THREAD_LOCAL const UA_DataType *type; // used to pass the datatype into the jumptable
+static UA_StatusCode
+encodeBinaryStructure(const void *src, const UA_DataType *type, bufpos pos, encodectx ctx);
+
+static UA_StatusCode
+decodeBinaryStructure(bufpos pos, decodectx ctx, void *dst, const UA_DataType *type);
+
+#ifdef UA_ENABLE_GENERATED_CODEC
+/* Specialized functions for selected structures of UA_TYPES. They are generated
+ * with generate_datatypes.py --generate-codec and included at the end of this
+ * file. The entries of all other types are NULL. */
+static const UA_encodeBinarySignature generatedEncodeBinaryJumpTable[UA_TYPES_COUNT];
+static const UA_decodeBinarySignature generatedDecodeBinaryJumpTable[UA_TYPES_COUNT];
+static const UA_calcSizeBinarySignature generatedCalcSizeBinaryJumpTable[UA_TYPES_COUNT];
+#endif
+
+static UA_INLINE UA_Boolean
+isTypesEntry(const UA_DataType *type) {
+    return type->typeIndex < UA_TYPES_COUNT && type == &UA_TYPES[type->typeIndex];
+}
+
+static UA_INLINE UA_StatusCode
+encodeBinaryJump(const void *src, const UA_DataType *type, bufpos pos, encodectx ctx) {
+    if(type->builtin)
+        return encodeBinaryJumpTable[type->typeIndex](src, pos, ctx);
+#ifdef UA_ENABLE_GENERATED_CODEC
+    if(isTypesEntry(type) && generatedEncodeBinaryJumpTable[type->typeIndex])
+        return generatedEncodeBinaryJumpTable[type->typeIndex](src, pos, ctx);
+#endif
+    return encodeBinaryStructure(src, type, pos, ctx);
+}
+
+static UA_INLINE UA_StatusCode
+decodeBinaryJump(bufpos pos, decodectx ctx, void *dst, const UA_DataType *type) {
+    if(type->builtin)
+        return decodeBinaryJumpTable[type->typeIndex](pos, ctx, dst);
+#ifdef UA_ENABLE_GENERATED_CODEC
+    if(isTypesEntry(type) && generatedDecodeBinaryJumpTable[type->typeIndex])
+        return generatedDecodeBinaryJumpTable[type->typeIndex](pos, ctx, dst);
+#endif
+    return decodeBinaryStructure(pos, ctx, dst, type);
+}
+
+/* Hands the full buffer to the exchange callback. The new buffer has room for
+ * at least length bytes. */
+static UA_StatusCode
+exchangeBuffer(bufpos pos, encodectx ctx, size_t length) {
+    if(!ctx->exchangeCallback)
+        return UA_STATUSCODE_BADENCODINGERROR;
+    size_t offset = (size_t)(*pos - ctx->buf->data);
+    UA_StatusCode retval = ctx->exchangeCallback(ctx->exchangeHandle, ctx->buf, &offset);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    *pos = &ctx->buf->data[offset];
+    ctx->end = &ctx->buf->data[ctx->buf->length];
+    if(*pos + length > ctx->end)
+        return UA_STATUSCODE_BADENCODINGERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Copies the bytes over as many buffers as required */
+static UA_StatusCode
+encodeBytes(const UA_Byte *src, size_t length, bufpos pos, encodectx ctx) {
+    while(*pos + length > ctx->end) {
+        if(!ctx->exchangeCallback)
+            return UA_STATUSCODE_BADENCODINGERROR;
+        size_t part = (size_t)(ctx->end - *pos);
+        memcpy(*pos, src, part);
+        *pos += part;
+        src += part;
+        length -= part;
+        UA_StatusCode retval = exchangeBuffer(pos, ctx, 1);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+    memcpy(*pos, src, length);
+    *pos += length;
+    return UA_STATUSCODE_GOOD;
+}
 
 /*****************/
 /* Integer Types */
@@ -54,17 +173,20 @@ static void UA_decode64(const UA_Byte buf[4], UA_UInt64 *v) {
 
 /* Boolean */
 static UA_StatusCode
-Boolean_encodeBinary(const UA_Boolean *src, bufpos pos, bufend end) {
-    if(*pos + sizeof(UA_Boolean) > end)
-        return UA_STATUSCODE_BADENCODINGERROR;
+Boolean_encodeBinary(const UA_Boolean *src, bufpos pos, encodectx ctx) {
+    if(*pos + sizeof(UA_Boolean) > ctx->end) {
+        UA_StatusCode retval = exchangeBuffer(pos, ctx, sizeof(UA_Boolean));
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
     **pos = *(const UA_Byte*)src;
     (*pos)++;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
-Boolean_decodeBinary(bufpos pos, bufend end, UA_Boolean *dst) {
-    if(*pos + sizeof(UA_Boolean) > end)
+Boolean_decodeBinary(bufpos pos, decodectx ctx, UA_Boolean *dst) {
+    if(*pos + sizeof(UA_Boolean) > ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
     *dst = (**pos > 0) ? true : false;
     (*pos)++;
@@ -73,17 +195,20 @@ Boolean_decodeBinary(bufpos pos, bufend end, UA_Boolean *dst) {
 
 /* Byte */
 static UA_StatusCode
-Byte_encodeBinary(const UA_Byte *src, bufpos pos, bufend end) {
-    if(*pos + sizeof(UA_Byte) > end)
-        return UA_STATUSCODE_BADENCODINGERROR;
+Byte_encodeBinary(const UA_Byte *src, bufpos pos, encodectx ctx) {
+    if(*pos + sizeof(UA_Byte) > ctx->end) {
+        UA_StatusCode retval = exchangeBuffer(pos, ctx, sizeof(UA_Byte));
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
     **pos = *(const UA_Byte*)src;
     (*pos)++;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
-Byte_decodeBinary(bufpos pos, bufend end, UA_Byte *dst) {
-    if(*pos + sizeof(UA_Byte) > end)
+Byte_decodeBinary(bufpos pos, decodectx ctx, UA_Byte *dst) {
+    if(*pos + sizeof(UA_Byte) > ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
     *dst = **pos;
     (*pos)++;
@@ -92,9 +217,12 @@ Byte_decodeBinary(bufpos pos, bufend end, UA_Byte *dst) {
 
 /* UInt16 */
 static UA_StatusCode
-UInt16_encodeBinary(UA_UInt16 const *src, bufpos pos, bufend end) {
-    if(*pos + sizeof(UA_UInt16) > end)
-        return UA_STATUSCODE_BADENCODINGERROR;
+UInt16_encodeBinary(UA_UInt16 const *src, bufpos pos, encodectx ctx) {
+    if(*pos + sizeof(UA_UInt16) > ctx->end) {
+        UA_StatusCode retval = exchangeBuffer(pos, ctx, sizeof(UA_UInt16));
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
 #ifndef UA_ENCODING_INTEGER_GENERIC
     UA_UInt16 le_uint16 = htole16(*src);
     memcpy(*pos, &le_uint16, sizeof(UA_UInt16));
@@ -106,13 +234,13 @@ UInt16_encodeBinary(UA_UInt16 const *src, bufpos pos, bufend end) {
 }
 
 static UA_INLINE UA_StatusCode
-Int16_encodeBinary(UA_Int16 const *src, bufpos pos, bufend end) {
-    return UInt16_encodeBinary((const UA_UInt16*)src, pos, end);
+Int16_encodeBinary(UA_Int16 const *src, bufpos pos, encodectx ctx) {
+    return UInt16_encodeBinary((const UA_UInt16*)src, pos, ctx);
 }
 
 static UA_StatusCode
-UInt16_decodeBinary(bufpos pos, bufend end, UA_UInt16 *dst) {
-    if(*pos + sizeof(UA_UInt16) > end)
+UInt16_decodeBinary(bufpos pos, decodectx ctx, UA_UInt16 *dst) {
+    if(*pos + sizeof(UA_UInt16) > ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
 #ifndef UA_ENCODING_INTEGER_GENERIC
     memcpy(dst, *pos, sizeof(UA_UInt16));
@@ -125,15 +253,18 @@ UInt16_decodeBinary(bufpos pos, bufend end, UA_UInt16 *dst) {
 }
 
 static UA_INLINE UA_StatusCode
-Int16_decodeBinary(bufpos pos, bufend end, UA_Int16 *dst) {
-    return UInt16_decodeBinary(pos, end, (UA_UInt16*)dst);
+Int16_decodeBinary(bufpos pos, decodectx ctx, UA_Int16 *dst) {
+    return UInt16_decodeBinary(pos, ctx, (UA_UInt16*)dst);
 }
 
 /* UInt32 */
 static UA_StatusCode
-UInt32_encodeBinary(UA_UInt32 const *src, bufpos pos, bufend end) {
-    if(*pos + sizeof(UA_UInt32) > end)
-        return UA_STATUSCODE_BADENCODINGERROR;
+UInt32_encodeBinary(UA_UInt32 const *src, bufpos pos, encodectx ctx) {
+    if(*pos + sizeof(UA_UInt32) > ctx->end) {
+        UA_StatusCode retval = exchangeBuffer(pos, ctx, sizeof(UA_UInt32));
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
 #ifndef UA_ENCODING_INTEGER_GENERIC
     UA_UInt32 le_uint32 = htole32(*src);
     memcpy(*pos, &le_uint32, sizeof(UA_UInt32));
@@ -145,18 +276,18 @@ UInt32_encodeBinary(UA_UInt32 const *src, bufpos pos, bufend end) {
 }
 
 static UA_INLINE UA_StatusCode
-Int32_encodeBinary(UA_Int32 const *src, bufpos pos, bufend end) {
-    return UInt32_encodeBinary((const UA_UInt32*)src, pos, end);
+Int32_encodeBinary(UA_Int32 const *src, bufpos pos, encodectx ctx) {
+    return UInt32_encodeBinary((const UA_UInt32*)src, pos, ctx);
 }
 
 static UA_INLINE UA_StatusCode
-StatusCode_encodeBinary(UA_StatusCode const *src, bufpos pos, bufend end) {
-    return UInt32_encodeBinary((const UA_UInt32*)src, pos, end);
+StatusCode_encodeBinary(UA_StatusCode const *src, bufpos pos, encodectx ctx) {
+    return UInt32_encodeBinary((const UA_UInt32*)src, pos, ctx);
 }
 
 static UA_StatusCode
-UInt32_decodeBinary(bufpos pos, bufend end, UA_UInt32 *dst) {
-    if(*pos + sizeof(UA_UInt32) > end)
+UInt32_decodeBinary(bufpos pos, decodectx ctx, UA_UInt32 *dst) {
+    if(*pos + sizeof(UA_UInt32) > ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
 #ifndef UA_ENCODING_INTEGER_GENERIC
     memcpy(dst, *pos, sizeof(UA_UInt32));
@@ -169,20 +300,23 @@ UInt32_decodeBinary(bufpos pos, bufend end, UA_UInt32 *dst) {
 }
 
 static UA_INLINE UA_StatusCode
-Int32_decodeBinary(bufpos pos, bufend end, UA_Int32 *dst) {
-    return UInt32_decodeBinary(pos, end, (UA_UInt32*)dst);
+Int32_decodeBinary(bufpos pos, decodectx ctx, UA_Int32 *dst) {
+    return UInt32_decodeBinary(pos, ctx, (UA_UInt32*)dst);
 }
 
 static UA_INLINE UA_StatusCode
-StatusCode_decodeBinary(bufpos pos, bufend end, UA_StatusCode *dst) {
-    return UInt32_decodeBinary(pos, end, (UA_UInt32*)dst);
+StatusCode_decodeBinary(bufpos pos, decodectx ctx, UA_StatusCode *dst) {
+    return UInt32_decodeBinary(pos, ctx, (UA_UInt32*)dst);
 }
 
 /* UInt64 */
 static UA_StatusCode
-UInt64_encodeBinary(UA_UInt64 const *src, bufpos pos, bufend end) {
-    if(*pos + sizeof(UA_UInt64) > end)
-        return UA_STATUSCODE_BADENCODINGERROR;
+UInt64_encodeBinary(UA_UInt64 const *src, bufpos pos, encodectx ctx) {
+    if(*pos + sizeof(UA_UInt64) > ctx->end) {
+        UA_StatusCode retval = exchangeBuffer(pos, ctx, sizeof(UA_UInt64));
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
 #ifndef UA_ENCODING_INTEGER_GENERIC
     UA_UInt64 le_uint64 = htole64(*src);
     memcpy(*pos, &le_uint64, sizeof(UA_UInt64));
@@ -194,18 +328,18 @@ UInt64_encodeBinary(UA_UInt64 const *src, bufpos pos, bufend end) {
 }
 
 static UA_INLINE UA_StatusCode
-Int64_encodeBinary(UA_Int64 const *src, bufpos pos, bufend end) {
-    return UInt64_encodeBinary((const UA_UInt64*)src, pos, end);
+Int64_encodeBinary(UA_Int64 const *src, bufpos pos, encodectx ctx) {
+    return UInt64_encodeBinary((const UA_UInt64*)src, pos, ctx);
 }
 
 static UA_INLINE UA_StatusCode
-DateTime_encodeBinary(UA_DateTime const *src, bufpos pos, bufend end) {
-    return UInt64_encodeBinary((const UA_UInt64*)src, pos, end);
+DateTime_encodeBinary(UA_DateTime const *src, bufpos pos, encodectx ctx) {
+    return UInt64_encodeBinary((const UA_UInt64*)src, pos, ctx);
 }
 
 static UA_StatusCode
-UInt64_decodeBinary(bufpos pos, bufend end, UA_UInt64 *dst) {
-    if(*pos + sizeof(UA_UInt64) > end)
+UInt64_decodeBinary(bufpos pos, decodectx ctx, UA_UInt64 *dst) {
+    if(*pos + sizeof(UA_UInt64) > ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
 #ifndef UA_ENCODING_INTEGER_GENERIC
     memcpy(dst, *pos, sizeof(UA_UInt64));
@@ -218,13 +352,13 @@ UInt64_decodeBinary(bufpos pos, bufend end, UA_UInt64 *dst) {
 }
 
 static UA_INLINE UA_StatusCode
-Int64_decodeBinary(bufpos pos, bufend end, UA_Int64 *dst) {
-    return UInt64_decodeBinary(pos, end, (UA_UInt64*)dst);
+Int64_decodeBinary(bufpos pos, decodectx ctx, UA_Int64 *dst) {
+    return UInt64_decodeBinary(pos, ctx, (UA_UInt64*)dst);
 }
 
 static UA_INLINE UA_StatusCode
-DateTime_decodeBinary(bufpos pos, bufend end, UA_DateTime *dst) {
-    return UInt64_decodeBinary(pos, end, (UA_UInt64*)dst);
+DateTime_decodeBinary(bufpos pos, decodectx ctx, UA_DateTime *dst) {
+    return UInt64_decodeBinary(pos, ctx, (UA_UInt64*)dst);
 }
 
 /************************/
@@ -242,15 +376,15 @@ DateTime_decodeBinary(bufpos pos, bufend end, UA_DateTime *dst) {
 #ifdef UA_ENCODING_FLOAT_SWAP
 
 static UA_StatusCode
-Float_encodeBinary(UA_Float const *src, bufpos pos, bufend end) {
+Float_encodeBinary(UA_Float const *src, bufpos pos, encodectx ctx) {
     const UA_UInt32 *f = (const UA_UInt32*)src;
     UA_UInt32 encoded = UA_swap32(*f);
-    return UInt32_encodeBinary(&encoded, pos, end);
+    return UInt32_encodeBinary(&encoded, pos, ctx);
 }
 
-static UA_StatusCode Float_decodeBinary(bufpos pos, bufend end, UA_Float *dst) {
+static UA_StatusCode Float_decodeBinary(bufpos pos, decodectx ctx, UA_Float *dst) {
     UA_UInt32 decoded;
-    UA_StatusCode retval = UInt32_decodeBinary(pos, end, &decoded);
+    UA_StatusCode retval = UInt32_decodeBinary(pos, ctx, &decoded);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     decoded = UA_swap32(decoded);
@@ -259,15 +393,15 @@ static UA_StatusCode Float_decodeBinary(bufpos pos, bufend end, UA_Float *dst) {
 }
 
 static UA_StatusCode
-Double_encodeBinary(UA_Double const *src, bufpos pos, bufend end) {
+Double_encodeBinary(UA_Double const *src, bufpos pos, encodectx ctx) {
     const UA_UInt64 *f = (const UA_UInt64*)src;
     UA_UInt64 encoded = UA_swap64(*f);
-    return UInt64_encodeBinary(&encoded, pos, end);
+    return UInt64_encodeBinary(&encoded, pos, ctx);
 }
 
-static UA_StatusCode Double_decodeBinary(bufpos pos, bufend end, UA_Double *dst) {
+static UA_StatusCode Double_decodeBinary(bufpos pos, decodectx ctx, UA_Double *dst) {
     UA_UInt64 decoded;
-    UA_StatusCode retval = UInt64_decodeBinary(pos, end, &decoded);
+    UA_StatusCode retval = UInt64_decodeBinary(pos, ctx, &decoded);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     decoded = UA_swap64(decoded);
@@ -317,20 +451,20 @@ static long double unpack754(uint64_t i, unsigned bits, unsigned expbits) {
 #define FLOAT_NEG_ZERO 0x80000000
 
 static UA_StatusCode
-Float_encodeBinary(UA_Float const *src, bufpos pos, bufend end) {
+Float_encodeBinary(UA_Float const *src, bufpos pos, encodectx ctx) {
     UA_Float f = *src;
     UA_UInt32 encoded;
     if(f != f) encoded = FLOAT_NAN;
     else if(f == 0.0f) encoded = signbit(f) ? FLOAT_NEG_ZERO : 0;
     else if(f/f != f/f) encoded = f > 0 ? FLOAT_INF : FLOAT_NEG_INF;
     else encoded = (UA_UInt32)pack754(f, 32, 8);
-    return UInt32_encodeBinary(&encoded, pos, end);
+    return UInt32_encodeBinary(&encoded, pos, ctx);
 }
 
 static UA_StatusCode
-Float_decodeBinary(bufpos pos, bufend end, UA_Float *dst) {
+Float_decodeBinary(bufpos pos, decodectx ctx, UA_Float *dst) {
     UA_UInt32 decoded;
-    UA_StatusCode retval = UInt32_decodeBinary(pos, end, &decoded);
+    UA_StatusCode retval = UInt32_decodeBinary(pos, ctx, &decoded);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(decoded == 0) *dst = 0.0f;
@@ -350,20 +484,20 @@ Float_decodeBinary(bufpos pos, bufend end, UA_Float *dst) {
 #define DOUBLE_NEG_ZERO 0x8000000000000000L
 
 static UA_StatusCode
-Double_encodeBinary(UA_Double const *src, bufpos pos, bufend end) {
+Double_encodeBinary(UA_Double const *src, bufpos pos, encodectx ctx) {
     UA_Double d = *src;
     UA_UInt64 encoded;
     if(d != d) encoded = DOUBLE_NAN;
     else if(d == 0.0) encoded = signbit(d) ? DOUBLE_NEG_ZERO : 0;
     else if(d/d != d/d) encoded = d > 0 ? DOUBLE_INF : DOUBLE_NEG_INF;
     else encoded = pack754(d, 64, 11);
-    return UInt64_encodeBinary(&encoded, pos, end);
+    return UInt64_encodeBinary(&encoded, pos, ctx);
 }
 
 static UA_StatusCode
-Double_decodeBinary(bufpos pos, bufend end, UA_Double *dst) {
+Double_decodeBinary(bufpos pos, decodectx ctx, UA_Double *dst) {
     UA_UInt64 decoded;
-    UA_StatusCode retval = UInt64_decodeBinary(pos, end, &decoded);
+    UA_StatusCode retval = UInt64_decodeBinary(pos, ctx, &decoded);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(decoded == 0) *dst = 0.0;
@@ -383,8 +517,144 @@ Double_decodeBinary(bufpos pos, bufend end, UA_Double *dst) {
 /* Array Handling */
 /******************/
 
+/* Arrays of zero-copyable types are encoded in bulk. On little-endian hosts,
+ * they are copied. On big-endian hosts, the elements of 2, 4 and 8 bytes are
+ * copied with their byte order reversed. The floating point types only if they
+ * are encoded natively (IEEE 754 in the byte order of the integers). Returns
+ * the element size or 0 if the array is encoded element by element. */
+#if defined(UA_NON_LITTLEENDIAN_ARCHITECTURE) && defined(__BYTE_ORDER__) && \
+    defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+# define UA_ARRAY_BYTESWAP
+#endif
+
+static size_t
+bulkElementSize(const UA_DataType *type) {
+    if(!type->zeroCopyable)
+        return 0;
+#if defined(UA_ENCODING_FLOAT_GENERIC) || defined(UA_ENCODING_FLOAT_SWAP)
+    if(type->builtin && (type->typeIndex == UA_TYPES_FLOAT || type->typeIndex == UA_TYPES_DOUBLE))
+        return 0;
+#endif
+#ifdef UA_NON_LITTLEENDIAN_ARCHITECTURE
+# ifndef UA_ARRAY_BYTESWAP
+    if(type->memSize > 1)
+        return 0;
+# endif
+    /* Structures can only be swapped if they have a single member */
+    if(type->memSize > 1 && !type->builtin && (type->membersSize != 1 || type->members[0].isArray))
+        return 0;
+#endif
+    return type->memSize;
+}
+
+/* Copies the elements to the wire representation */
+static void
+bulkCopy(UA_Byte *dst, const UA_Byte *src, size_t count, size_t size) {
+#ifdef UA_ARRAY_BYTESWAP
+    switch(size) {
+    case 2: UA_swapBytes16(dst, src, count); return;
+    case 4: UA_swapBytes32(dst, src, count); return;
+    case 8: UA_swapBytes64(dst, src, count); return;
+    default: break;
+    }
+#endif
+    memcpy(dst, src, count * size);
+}
+
+/* Encodes over as many buffers as required. Elements are not split. */
+static UA_StatusCode
+Array_encodeBinaryBulk(const UA_Byte *src, size_t length, size_t size, bufpos pos, encodectx ctx) {
+    while(length > 0) {
+        size_t fit = (size_t)(ctx->end - *pos) / size;
+        if(fit == 0) {
+            UA_StatusCode retval = exchangeBuffer(pos, ctx, size);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            continue;
+        }
+        if(fit > length)
+            fit = length;
+        bulkCopy(*pos, src, fit, size);
+        *pos += fit * size;
+        src += fit * size;
+        length -= fit;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The wire layout of packed structures is their memory layout without the
+ * padding. Arrays of them are copied member by member from a table, without a
+ * call for every member. The tables of the packed structures in UA_TYPES are
+ * generated with generate_datatypes.py and included at the end of this file.
+ * Not on big-endian hosts, where every member would be swapped. */
+typedef struct {
+    size_t offset;
+    size_t length;
+} PackedRun;
+
+typedef struct {
+    size_t wireSize;
+    size_t runsSize;
+    const PackedRun *runs;
+} PackedLayout;
+
+static const PackedLayout *const packedLayouts[UA_TYPES_COUNT];
+
+/* Members are copied with fixed-size moves */
+static UA_INLINE void
+copyRun(UA_Byte *UA_RESTRICT dst, const UA_Byte *UA_RESTRICT src, size_t length) {
+    switch(length) {
+    case 1: *dst = *src; break;
+    case 2: memcpy(dst, src, 2); break;
+    case 4: memcpy(dst, src, 4); break;
+    case 8: memcpy(dst, src, 8); break;
+    default: memcpy(dst, src, length); break;
+    }
+}
+
+/* Returns NULL if the type is not packed (or zero-copyable anyway) */
+static const PackedLayout *
+packedLayout(const UA_DataType *type) {
+#ifdef UA_NON_LITTLEENDIAN_ARCHITECTURE
+    return NULL;
+#else
+    if(type->builtin || type->zeroCopyable || !isTypesEntry(type))
+        return NULL;
+    return packedLayouts[type->typeIndex];
+#endif
+}
+
 static UA_StatusCode
-Array_encodeBinary(const void *src, size_t length, const UA_DataType *contenttype, bufpos pos, bufend end) {
+Array_encodeBinaryPacked(const UA_Byte *src, size_t length, const UA_DataType *contenttype,
+                         const PackedLayout *layout, bufpos pos, encodectx ctx) {
+    while(length > 0) {
+        size_t fit = (size_t)(ctx->end - *pos) / layout->wireSize;
+        if(fit == 0) {
+            UA_StatusCode retval = exchangeBuffer(pos, ctx, layout->wireSize);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            continue;
+        }
+        if(fit > length)
+            fit = length;
+        UA_Byte *p = *pos;
+        for(size_t i = 0; i < fit; i++) {
+            for(size_t j = 0; j < layout->runsSize; j++) {
+                copyRun(p, &src[layout->runs[j].offset], layout->runs[j].length);
+                p += layout->runs[j].length;
+            }
+            src += contenttype->memSize;
+        }
+        *pos = p;
+        length -= fit;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Encodes the length in front of the array members. -1 stands for a NULL array
+ * and 0 for an empty array. */
+static UA_StatusCode
+Array_encodeBinaryLength(const void *src, size_t length, bufpos pos, encodectx ctx) {
     UA_Int32 signed_length = -1;
     if(length > UA_INT32_MAX)
         return UA_STATUSCODE_BADINTERNALERROR;
@@ -392,33 +662,35 @@ Array_encodeBinary(const void *src, size_t length, const UA_DataType *contenttyp
         signed_length = (UA_Int32)length;
     else if(src == UA_EMPTY_ARRAY_SENTINEL)
         signed_length = 0;
-    UA_StatusCode retval = Int32_encodeBinary(&signed_length, pos, end);
+    return Int32_encodeBinary(&signed_length, pos, ctx);
+}
+
+static UA_StatusCode
+Array_encodeBinary(const void *src, size_t length, const UA_DataType *contenttype, bufpos pos, encodectx ctx) {
+    UA_StatusCode retval = Array_encodeBinaryLength(src, length, pos, ctx);
     if(retval != UA_STATUSCODE_GOOD || length == 0)
         return retval;
 
-#ifndef UA_NON_LITTLEENDIAN_ARCHITECTURE
-    if(contenttype->zeroCopyable) {
-        if(end < *pos + (contenttype->memSize * length))
-            return UA_STATUSCODE_BADENCODINGERROR;
-        memcpy(*pos, src, contenttype->memSize * length);
-        (*pos) += contenttype->memSize * length;
-        return retval;
-    }
-#endif
+    size_t size = bulkElementSize(contenttype);
+    if(size > 0)
+        return Array_encodeBinaryBulk((const UA_Byte*)src, length, size, pos, ctx);
+    const PackedLayout *layout = packedLayout(contenttype);
+    if(layout)
+        return Array_encodeBinaryPacked((const UA_Byte*)src, length, contenttype, layout, pos, ctx);
 
     uintptr_t ptr = (uintptr_t)src;
-    size_t encode_index = contenttype->builtin ? contenttype->typeIndex : UA_BUILTIN_TYPES_COUNT;
     for(size_t i = 0; i < length && retval == UA_STATUSCODE_GOOD; i++) {
-        type = contenttype;
-        retval = encodeBinaryJumpTable[encode_index]((const void*)ptr, pos, end);
+        retval = encodeBinaryJump((const void*)ptr, contenttype, pos, ctx);
         ptr += contenttype->memSize;
     }
     return retval;
 }
 
+/* Allocates the zeroed array for the decoded length. The members are decoded by
+ * the caller. */
 static UA_StatusCode
-Array_decodeBinary(bufpos pos, bufend end, UA_Int32 signed_length, void *UA_RESTRICT *UA_RESTRICT dst,
-                   size_t *out_length, const UA_DataType *contenttype) {
+Array_decodeBinaryAlloc(bufpos pos, decodectx ctx, UA_Int32 signed_length, void *UA_RESTRICT *UA_RESTRICT dst,
+                        size_t *out_length, const UA_DataType *contenttype) {
     *out_length = 0;
     if(signed_length <= 0) {
         *dst = NULL;
@@ -430,31 +702,66 @@ Array_decodeBinary(bufpos pos, bufend end, UA_Int32 signed_length, void *UA_REST
         
     /* filter out arrays that can obviously not be parsed, because the message
        is too small */
-    if(*pos + ((contenttype->memSize * length) / 32) > end)
+    if(*pos + ((contenttype->memSize * length) / 32) > ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
 
     *dst = UA_calloc(1, contenttype->memSize * length);
     if(!*dst)
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    *out_length = length;
+    return UA_STATUSCODE_GOOD;
+}
 
-#ifndef UA_NON_LITTLEENDIAN_ARCHITECTURE
-    if(contenttype->zeroCopyable) {
-        if(end < *pos + (contenttype->memSize * length))
+static UA_StatusCode
+Array_decodeBinary(bufpos pos, decodectx ctx, UA_Int32 signed_length, void *UA_RESTRICT *UA_RESTRICT dst,
+                   size_t *out_length, const UA_DataType *contenttype) {
+    size_t length;
+    UA_StatusCode retval = Array_decodeBinaryAlloc(pos, ctx, signed_length, dst, &length, contenttype);
+    *out_length = 0;
+    if(retval != UA_STATUSCODE_GOOD || length == 0)
+        return retval;
+
+    size_t size = bulkElementSize(contenttype);
+    if(size > 0) {
+        if(ctx->end < *pos + (size * length)) {
+            UA_free(*dst);
+            *dst = NULL;
             return UA_STATUSCODE_BADDECODINGERROR;
-        memcpy(*dst, *pos, contenttype->memSize * length);
-        (*pos) += contenttype->memSize * length;
+        }
+        /* Booleans are true for every nonzero byte */
+        if(contenttype->builtin && contenttype->typeIndex == UA_TYPES_BOOLEAN)
+            UA_normalizeBooleans((UA_Byte*)*dst, *pos, length);
+        else
+            bulkCopy((UA_Byte*)*dst, *pos, length, size);
+        (*pos) += size * length;
+        *out_length = length;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    const PackedLayout *layout = packedLayout(contenttype);
+    if(layout) {
+        if(ctx->end < *pos + (layout->wireSize * length)) {
+            UA_free(*dst);
+            *dst = NULL;
+            return UA_STATUSCODE_BADDECODINGERROR;
+        }
+        UA_Byte *p = (UA_Byte*)*dst;
+        for(size_t i = 0; i < length; i++) {
+            for(size_t j = 0; j < layout->runsSize; j++) {
+                copyRun(&p[layout->runs[j].offset], *pos, layout->runs[j].length);
+                *pos += layout->runs[j].length;
+            }
+            p += contenttype->memSize;
+        }
         *out_length = length;
         return UA_STATUSCODE_GOOD;
     }
-#endif
 
     uintptr_t ptr = (uintptr_t)*dst;
-    size_t decode_index = contenttype->builtin ? contenttype->typeIndex : UA_BUILTIN_TYPES_COUNT;
     for(size_t i = 0; i < length; i++) {
-        type = contenttype;
-        UA_StatusCode retval = decodeBinaryJumpTable[decode_index](pos, end, (void*)ptr);
+        retval = decodeBinaryJump(pos, ctx, (void*)ptr, contenttype);
         if(retval != UA_STATUSCODE_GOOD) {
-            UA_Array_delete(*dst, i, contenttype);
+            deleteDecodedArray(*dst, i, contenttype, ctx);
             *dst = NULL;
             return retval;
         }
@@ -469,8 +776,8 @@ Array_decodeBinary(bufpos pos, bufend end, UA_Int32 signed_length, void *UA_REST
 /*****************/
 
 static UA_StatusCode
-String_encodeBinary(UA_String const *src, bufpos pos, bufend end) {
-    if(*pos + sizeof(UA_Int32) + src->length > end)
+String_encodeBinary(UA_String const *src, bufpos pos, encodectx ctx) {
+    if(*pos + sizeof(UA_Int32) + src->length > ctx->end && !ctx->exchangeCallback)
         return UA_STATUSCODE_BADENCODINGERROR;
     if(src->length > UA_INT32_MAX)
         return UA_STATUSCODE_BADINTERNALERROR;
@@ -479,25 +786,25 @@ String_encodeBinary(UA_String const *src, bufpos pos, bufend end) {
         UA_Int32 signed_length = -1;
         if(src->data == UA_EMPTY_ARRAY_SENTINEL)
             signed_length = 0;
-        retval = Int32_encodeBinary(&signed_length, pos, end);
+        retval = Int32_encodeBinary(&signed_length, pos, ctx);
     } else {
         UA_Int32 signed_length = (UA_Int32)src->length;
-        retval = Int32_encodeBinary(&signed_length, pos, end);
-        memcpy(*pos, src->data, src->length);
-        *pos += src->length;
+        retval = Int32_encodeBinary(&signed_length, pos, ctx);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = encodeBytes(src->data, src->length, pos, ctx);
     }
     return retval;
 }
 
 static UA_INLINE UA_StatusCode
-ByteString_encodeBinary(UA_ByteString const *src, bufpos pos, bufend end) {
-    return String_encodeBinary((const UA_String*)src, pos, end);
+ByteString_encodeBinary(UA_ByteString const *src, bufpos pos, encodectx ctx) {
+    return String_encodeBinary((const UA_String*)src, pos, ctx);
 }
 
 static UA_StatusCode
-String_decodeBinary(bufpos pos, bufend end, UA_String *dst) {
+String_decodeBinary(bufpos pos, decodectx ctx, UA_String *dst) {
     UA_Int32 signed_length;
-    UA_StatusCode retval = Int32_decodeBinary(pos, end, &signed_length);
+    UA_StatusCode retval = Int32_decodeBinary(pos, ctx, &signed_length);
     if(retval != UA_STATUSCODE_GOOD)
         return UA_STATUSCODE_BADINTERNALERROR;
     if(signed_length <= 0) {
@@ -508,40 +815,44 @@ String_decodeBinary(bufpos pos, bufend end, UA_String *dst) {
         return UA_STATUSCODE_GOOD;
     }
     size_t length = (size_t)signed_length;
-    if(*pos + length > end)
+    if(*pos + length > ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
-    dst->data = UA_malloc(length);
-    if(!dst->data)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    memcpy(dst->data, *pos, length);
+    if(ctx->borrowStrings) {
+        dst->data = *pos;
+    } else {
+        dst->data = UA_malloc(length);
+        if(!dst->data)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memcpy(dst->data, *pos, length);
+    }
     dst->length = length;
     *pos += length;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_INLINE UA_StatusCode
-ByteString_decodeBinary(bufpos pos, bufend end, UA_ByteString *dst) {
-    return String_decodeBinary(pos, end, (UA_ByteString*)dst);
+ByteString_decodeBinary(bufpos pos, decodectx ctx, UA_ByteString *dst) {
+    return String_decodeBinary(pos, ctx, (UA_ByteString*)dst);
 }
 
 /* Guid */
 static UA_StatusCode
-Guid_encodeBinary(UA_Guid const *src, bufpos pos, bufend end) {
-    UA_StatusCode retval = UInt32_encodeBinary(&src->data1, pos, end);
-    retval |= UInt16_encodeBinary(&src->data2, pos, end);
-    retval |= UInt16_encodeBinary(&src->data3, pos, end);
+Guid_encodeBinary(UA_Guid const *src, bufpos pos, encodectx ctx) {
+    UA_StatusCode retval = UInt32_encodeBinary(&src->data1, pos, ctx);
+    retval |= UInt16_encodeBinary(&src->data2, pos, ctx);
+    retval |= UInt16_encodeBinary(&src->data3, pos, ctx);
     for(UA_Int32 i = 0; i < 8; i++)
-        retval |= Byte_encodeBinary(&src->data4[i], pos, end);
+        retval |= Byte_encodeBinary(&src->data4[i], pos, ctx);
     return retval;
 }
 
 static UA_StatusCode
-Guid_decodeBinary(bufpos pos, bufend end, UA_Guid *dst) {
-    UA_StatusCode retval = UInt32_decodeBinary(pos, end, &dst->data1);
-    retval |= UInt16_decodeBinary(pos, end, &dst->data2);
-    retval |= UInt16_decodeBinary(pos, end, &dst->data3);
+Guid_decodeBinary(bufpos pos, decodectx ctx, UA_Guid *dst) {
+    UA_StatusCode retval = UInt32_decodeBinary(pos, ctx, &dst->data1);
+    retval |= UInt16_decodeBinary(pos, ctx, &dst->data2);
+    retval |= UInt16_decodeBinary(pos, ctx, &dst->data3);
     for(size_t i = 0; i < 8; i++)
-        retval |= Byte_decodeBinary(pos, end, &dst->data4[i]);
+        retval |= Byte_decodeBinary(pos, ctx, &dst->data4[i]);
     if(retval != UA_STATUSCODE_GOOD)
         UA_Guid_deleteMembers(dst);
     return retval;
@@ -552,8 +863,9 @@ Guid_decodeBinary(bufpos pos, bufend end, UA_Guid *dst) {
 #define UA_NODEIDTYPE_NUMERIC_FOURBYTE 1
 #define UA_NODEIDTYPE_NUMERIC_COMPLETE 2
 
+/* The flags are set in the encoding byte (used by the ExpandedNodeId) */
 static UA_StatusCode
-NodeId_encodeBinary(UA_NodeId const *src, bufpos pos, bufend end) {
+NodeId_encodeBinaryWithFlags(UA_NodeId const *src, UA_Byte flags, bufpos pos, encodectx ctx) {
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     // temporary variables for endian-save code
     UA_Byte srcByte;
@@ -562,42 +874,42 @@ NodeId_encodeBinary(UA_NodeId const *src, bufpos pos, bufend end) {
     switch (src->identifierType) {
     case UA_NODEIDTYPE_NUMERIC:
         if(src->identifier.numeric > UA_UINT16_MAX || src->namespaceIndex > UA_BYTE_MAX) {
-            srcByte = UA_NODEIDTYPE_NUMERIC_COMPLETE;
-            retval |= Byte_encodeBinary(&srcByte, pos, end);
-            retval |= UInt16_encodeBinary(&src->namespaceIndex, pos, end);
+            srcByte = (UA_Byte)(UA_NODEIDTYPE_NUMERIC_COMPLETE | flags);
+            retval |= Byte_encodeBinary(&srcByte, pos, ctx);
+            retval |= UInt16_encodeBinary(&src->namespaceIndex, pos, ctx);
             srcUInt32 = src->identifier.numeric;
-            retval |= UInt32_encodeBinary(&srcUInt32, pos, end);
+            retval |= UInt32_encodeBinary(&srcUInt32, pos, ctx);
         } else if(src->identifier.numeric > UA_BYTE_MAX || src->namespaceIndex > 0) {
-            srcByte = UA_NODEIDTYPE_NUMERIC_FOURBYTE;
-            retval |= Byte_encodeBinary(&srcByte, pos, end);
+            srcByte = (UA_Byte)(UA_NODEIDTYPE_NUMERIC_FOURBYTE | flags);
+            retval |= Byte_encodeBinary(&srcByte, pos, ctx);
             srcByte = (UA_Byte)src->namespaceIndex;
             srcUInt16 = (UA_UInt16)src->identifier.numeric;
-            retval |= Byte_encodeBinary(&srcByte, pos, end);
-            retval |= UInt16_encodeBinary(&srcUInt16, pos, end);
+            retval |= Byte_encodeBinary(&srcByte, pos, ctx);
+            retval |= UInt16_encodeBinary(&srcUInt16, pos, ctx);
         } else {
-            srcByte = UA_NODEIDTYPE_NUMERIC_TWOBYTE;
-            retval |= Byte_encodeBinary(&srcByte, pos, end);
+            srcByte = (UA_Byte)(UA_NODEIDTYPE_NUMERIC_TWOBYTE | flags);
+            retval |= Byte_encodeBinary(&srcByte, pos, ctx);
             srcByte = (UA_Byte)src->identifier.numeric;
-            retval |= Byte_encodeBinary(&srcByte, pos, end);
+            retval |= Byte_encodeBinary(&srcByte, pos, ctx);
         }
         break;
     case UA_NODEIDTYPE_STRING:
-        srcByte = UA_NODEIDTYPE_STRING;
-        retval |= Byte_encodeBinary(&srcByte, pos, end);
-        retval |= UInt16_encodeBinary(&src->namespaceIndex, pos, end);
-        retval |= String_encodeBinary(&src->identifier.string, pos, end);
+        srcByte = (UA_Byte)(UA_NODEIDTYPE_STRING | flags);
+        retval |= Byte_encodeBinary(&srcByte, pos, ctx);
+        retval |= UInt16_encodeBinary(&src->namespaceIndex, pos, ctx);
+        retval |= String_encodeBinary(&src->identifier.string, pos, ctx);
         break;
     case UA_NODEIDTYPE_GUID:
-        srcByte = UA_NODEIDTYPE_GUID;
-        retval |= Byte_encodeBinary(&srcByte, pos, end);
-        retval |= UInt16_encodeBinary(&src->namespaceIndex, pos, end);
-        retval |= Guid_encodeBinary(&src->identifier.guid, pos, end);
+        srcByte = (UA_Byte)(UA_NODEIDTYPE_GUID | flags);
+        retval |= Byte_encodeBinary(&srcByte, pos, ctx);
+        retval |= UInt16_encodeBinary(&src->namespaceIndex, pos, ctx);
+        retval |= Guid_encodeBinary(&src->identifier.guid, pos, ctx);
         break;
     case UA_NODEIDTYPE_BYTESTRING:
-        srcByte = UA_NODEIDTYPE_BYTESTRING;
-        retval |= Byte_encodeBinary(&srcByte, pos, end);
-        retval |= UInt16_encodeBinary(&src->namespaceIndex, pos, end);
-        retval |= ByteString_encodeBinary(&src->identifier.byteString, pos, end);
+        srcByte = (UA_Byte)(UA_NODEIDTYPE_BYTESTRING | flags);
+        retval |= Byte_encodeBinary(&srcByte, pos, ctx);
+        retval |= UInt16_encodeBinary(&src->namespaceIndex, pos, ctx);
+        retval |= ByteString_encodeBinary(&src->identifier.byteString, pos, ctx);
         break;
     default:
         return UA_STATUSCODE_BADINTERNALERROR;
@@ -606,52 +918,57 @@ NodeId_encodeBinary(UA_NodeId const *src, bufpos pos, bufend end) {
 }
 
 static UA_StatusCode
-NodeId_decodeBinary(bufpos pos, bufend end, UA_NodeId *dst) {
+NodeId_encodeBinary(UA_NodeId const *src, bufpos pos, encodectx ctx) {
+    return NodeId_encodeBinaryWithFlags(src, 0, pos, ctx);
+}
+
+static UA_StatusCode
+NodeId_decodeBinary(bufpos pos, decodectx ctx, UA_NodeId *dst) {
     UA_Byte dstByte = 0, encodingByte = 0;
     UA_UInt16 dstUInt16 = 0;
-    UA_StatusCode retval = Byte_decodeBinary(pos, end, &encodingByte);
+    UA_StatusCode retval = Byte_decodeBinary(pos, ctx, &encodingByte);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     switch (encodingByte) {
     case UA_NODEIDTYPE_NUMERIC_TWOBYTE:
         dst->identifierType = UA_NODEIDTYPE_NUMERIC;
-        retval = Byte_decodeBinary(pos, end, &dstByte);
+        retval = Byte_decodeBinary(pos, ctx, &dstByte);
         dst->identifier.numeric = dstByte;
         dst->namespaceIndex = 0;
         break;
     case UA_NODEIDTYPE_NUMERIC_FOURBYTE:
         dst->identifierType = UA_NODEIDTYPE_NUMERIC;
-        retval |= Byte_decodeBinary(pos, end, &dstByte);
+        retval |= Byte_decodeBinary(pos, ctx, &dstByte);
         dst->namespaceIndex = dstByte;
-        retval |= UInt16_decodeBinary(pos, end, &dstUInt16);
+        retval |= UInt16_decodeBinary(pos, ctx, &dstUInt16);
         dst->identifier.numeric = dstUInt16;
         break;
     case UA_NODEIDTYPE_NUMERIC_COMPLETE:
         dst->identifierType = UA_NODEIDTYPE_NUMERIC;
-        retval |= UInt16_decodeBinary(pos, end, &dst->namespaceIndex);
-        retval |= UInt32_decodeBinary(pos, end, &dst->identifier.numeric);
+        retval |= UInt16_decodeBinary(pos, ctx, &dst->namespaceIndex);
+        retval |= UInt32_decodeBinary(pos, ctx, &dst->identifier.numeric);
         break;
     case UA_NODEIDTYPE_STRING:
         dst->identifierType = UA_NODEIDTYPE_STRING;
-        retval |= UInt16_decodeBinary(pos, end, &dst->namespaceIndex);
-        retval |= String_decodeBinary(pos, end, &dst->identifier.string);
+        retval |= UInt16_decodeBinary(pos, ctx, &dst->namespaceIndex);
+        retval |= String_decodeBinary(pos, ctx, &dst->identifier.string);
         break;
     case UA_NODEIDTYPE_GUID:
         dst->identifierType = UA_NODEIDTYPE_GUID;
-        retval |= UInt16_decodeBinary(pos, end, &dst->namespaceIndex);
-        retval |= Guid_decodeBinary(pos, end, &dst->identifier.guid);
+        retval |= UInt16_decodeBinary(pos, ctx, &dst->namespaceIndex);
+        retval |= Guid_decodeBinary(pos, ctx, &dst->identifier.guid);
         break;
     case UA_NODEIDTYPE_BYTESTRING:
         dst->identifierType = UA_NODEIDTYPE_BYTESTRING;
-        retval |= UInt16_decodeBinary(pos, end, &dst->namespaceIndex);
-        retval |= ByteString_decodeBinary(pos, end, &dst->identifier.byteString);
+        retval |= UInt16_decodeBinary(pos, ctx, &dst->namespaceIndex);
+        retval |= ByteString_decodeBinary(pos, ctx, &dst->identifier.byteString);
         break;
     default:
         retval |= UA_STATUSCODE_BADINTERNALERROR; // the client sends an encodingByte we do not recognize
         break;
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_NodeId_deleteMembers(dst);
+        deleteDecoded(dst, &UA_TYPES[UA_TYPES_NODEID], ctx);
     return retval;
 }
 
@@ -660,35 +977,52 @@ NodeId_decodeBinary(bufpos pos, bufend end, UA_NodeId *dst) {
 #define UA_EXPANDEDNODEID_SERVERINDEX_FLAG 0x40
 
 static UA_StatusCode
-ExpandedNodeId_encodeBinary(UA_ExpandedNodeId const *src, bufpos pos, bufend end) {
-    UA_Byte *start = *pos;
-    UA_StatusCode retval = NodeId_encodeBinary(&src->nodeId, pos, end);
-    if(src->namespaceUri.length > 0) {
-        retval |= String_encodeBinary(&src->namespaceUri, pos, end);
-        *start |= UA_EXPANDEDNODEID_NAMESPACEURI_FLAG;
-    }
-    if(src->serverIndex > 0) {
-        retval |= UInt32_encodeBinary(&src->serverIndex, pos, end);
-        *start |= UA_EXPANDEDNODEID_SERVERINDEX_FLAG;
-    }
+ExpandedNodeId_encodeBinary(UA_ExpandedNodeId const *src, bufpos pos, encodectx ctx) {
+    UA_Byte flags = 0;
+    if(src->namespaceUri.length > 0)
+        flags |= UA_EXPANDEDNODEID_NAMESPACEURI_FLAG;
+    if(src->serverIndex > 0)
+        flags |= UA_EXPANDEDNODEID_SERVERINDEX_FLAG;
+    UA_StatusCode retval = NodeId_encodeBinaryWithFlags(&src->nodeId, flags, pos, ctx);
+    if(src->namespaceUri.length > 0)
+        retval |= String_encodeBinary(&src->namespaceUri, pos, ctx);
+    if(src->serverIndex > 0)
+        retval |= UInt32_encodeBinary(&src->serverIndex, pos, ctx);
     return retval;
 }
 
 static UA_StatusCode
-ExpandedNodeId_decodeBinary(bufpos pos, bufend end, UA_ExpandedNodeId *dst) {
-    if(*pos >= end)
+ExpandedNodeId_decodeBinary(bufpos pos, decodectx ctx, UA_ExpandedNodeId *dst) {
+    if(*pos >= ctx->end)
         return UA_STATUSCODE_BADDECODINGERROR;
     UA_Byte encodingByte = **pos;
     **pos = encodingByte & (UA_Byte)~(UA_EXPANDEDNODEID_NAMESPACEURI_FLAG | UA_EXPANDEDNODEID_SERVERINDEX_FLAG);
-    UA_StatusCode retval = NodeId_decodeBinary(pos, end, &dst->nodeId);
+    UA_StatusCode retval = NodeId_decodeBinary(pos, ctx, &dst->nodeId);
     if(encodingByte & UA_EXPANDEDNODEID_NAMESPACEURI_FLAG) {
         dst->nodeId.namespaceIndex = 0;
-        retval |= String_decodeBinary(pos, end, &dst->namespaceUri);
+        retval |= String_decodeBinary(pos, ctx, &dst->namespaceUri);
     }
     if(encodingByte & UA_EXPANDEDNODEID_SERVERINDEX_FLAG)
-        retval |= UInt32_decodeBinary(pos, end, &dst->serverIndex);
+        retval |= UInt32_decodeBinary(pos, ctx, &dst->serverIndex);
+    if(retval != UA_STATUSCODE_GOOD)
+        deleteDecoded(dst, &UA_TYPES[UA_TYPES_EXPANDEDNODEID], ctx);
+    return retval;
+}
+
+/* QualifiedName */
+static UA_StatusCode
+QualifiedName_encodeBinary(UA_QualifiedName const *src, bufpos pos, encodectx ctx) {
+    UA_StatusCode retval = UInt16_encodeBinary(&src->namespaceIndex, pos, ctx);
+    retval |= String_encodeBinary(&src->name, pos, ctx);
+    return retval;
+}
+
+static UA_StatusCode
+QualifiedName_decodeBinary(bufpos pos, decodectx ctx, UA_QualifiedName *dst) {
+    UA_StatusCode retval = UInt16_decodeBinary(pos, ctx, &dst->namespaceIndex);
+    retval |= String_decodeBinary(pos, ctx, &dst->name);
     if(retval != UA_STATUSCODE_GOOD)
-        UA_ExpandedNodeId_deleteMembers(dst);
+        deleteDecoded(dst, &UA_TYPES[UA_TYPES_QUALIFIEDNAME], ctx);
     return retval;
 }
 
@@ -697,36 +1031,79 @@ ExpandedNodeId_decodeBinary(bufpos pos, bufend end, UA_ExpandedNodeId *dst) {
 #define UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_TEXT 0x02
 
 static UA_StatusCode
-LocalizedText_encodeBinary(UA_LocalizedText const *src, bufpos pos, bufend end) {
+LocalizedText_encodeBinary(UA_LocalizedText const *src, bufpos pos, encodectx ctx) {
     UA_Byte encodingMask = 0;
     if(src->locale.data)
         encodingMask |= UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_LOCALE;
     if(src->text.data)
         encodingMask |= UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_TEXT;
-    UA_StatusCode retval = Byte_encodeBinary(&encodingMask, pos, end);
+    UA_StatusCode retval = Byte_encodeBinary(&encodingMask, pos, ctx);
     if(encodingMask & UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_LOCALE)
-        retval |= String_encodeBinary(&src->locale, pos, end);
+        retval |= String_encodeBinary(&src->locale, pos, ctx);
     if(encodingMask & UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_TEXT)
-        retval |= String_encodeBinary(&src->text, pos, end);
+        retval |= String_encodeBinary(&src->text, pos, ctx);
     return retval;
 }
 
 static UA_StatusCode
-LocalizedText_decodeBinary(bufpos pos, bufend end, UA_LocalizedText *dst) {
+LocalizedText_decodeBinary(bufpos pos, decodectx ctx, UA_LocalizedText *dst) {
     UA_Byte encodingMask = 0;
-    UA_StatusCode retval = Byte_decodeBinary(pos, end, &encodingMask);
+    UA_StatusCode retval = Byte_decodeBinary(pos, ctx, &encodingMask);
     if(encodingMask & UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_LOCALE)
-        retval |= String_decodeBinary(pos, end, &dst->locale);
+        retval |= String_decodeBinary(pos, ctx, &dst->locale);
     if(encodingMask & UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_TEXT)
-        retval |= String_decodeBinary(pos, end, &dst->text);
+        retval |= String_decodeBinary(pos, ctx, &dst->text);
     if(retval != UA_STATUSCODE_GOOD)
-        UA_LocalizedText_deleteMembers(dst);
+        deleteDecoded(dst, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], ctx);
     return retval;
 }
 
 /* ExtensionObject */
+
+/* Encodes the body of a decoded ExtensionObject with the length in front. The
+ * length field is reserved and patched after the body. So the body is walked
+ * only once. The length field must not be sent before it is patched. Unless the
+ * buffer keeps its content, the body is first encoded without exchanging the
+ * buffer. Only if it does not fit, the body is sized up front and encoded
+ * across buffers. */
+static UA_StatusCode
+encodeExtensionObjectBody(const void *src, const UA_DataType *contenttype,
+                          bufpos pos, encodectx ctx) {
+    if(*pos + sizeof(UA_Int32) > ctx->end) {
+        UA_StatusCode retval = exchangeBuffer(pos, ctx, sizeof(UA_Int32));
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+    /* Offsets remain valid when the buffer is grown */
+    size_t lengthOffset = (size_t)(*pos - ctx->buf->data);
+    EncodeContext bodyctx = *ctx;
+    if(!ctx->keepsContent)
+        bodyctx.exchangeCallback = NULL;
+    UA_Byte *bodypos = *pos + sizeof(UA_Int32);
+    UA_StatusCode retval = encodeBinaryJump(src, contenttype, &bodypos, &bodyctx);
+    ctx->end = bodyctx.end;
+    if(retval == UA_STATUSCODE_GOOD) {
+        size_t bodyEnd = (size_t)(bodypos - ctx->buf->data);
+        UA_Int32 length = (UA_Int32)(bodyEnd - lengthOffset - sizeof(UA_Int32));
+        *pos = &ctx->buf->data[lengthOffset];
+        retval = Int32_encodeBinary(&length, pos, ctx);
+        *pos = &ctx->buf->data[bodyEnd];
+        return retval;
+    }
+    *pos = &ctx->buf->data[lengthOffset];
+    if(bodyctx.exchangeCallback || !ctx->exchangeCallback)
+        return retval;
+
+    /* The body spans several buffers */
+    UA_Int32 length = (UA_Int32)UA_calcSizeBinary((void*)(uintptr_t)src, contenttype);
+    retval = Int32_encodeBinary(&length, pos, ctx);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    return encodeBinaryJump(src, contenttype, pos, ctx);
+}
+
 static UA_StatusCode
-ExtensionObject_encodeBinary(UA_ExtensionObject const *src, bufpos pos, bufend end) {
+ExtensionObject_encodeBinary(UA_ExtensionObject const *src, bufpos pos, encodectx ctx) {
     UA_StatusCode retval;
     UA_Byte encoding = src->encoding;
     if(encoding > UA_EXTENSIONOBJECT_ENCODED_XML) {
@@ -737,24 +1114,19 @@ ExtensionObject_encodeBinary(UA_ExtensionObject const *src, bufpos pos, bufend e
             return UA_STATUSCODE_BADENCODINGERROR;
         typeId.identifier.numeric += UA_ENCODINGOFFSET_BINARY;
         encoding = UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
-        retval = NodeId_encodeBinary(&typeId, pos, end);
-        retval |= Byte_encodeBinary(&encoding, pos, end);
-        UA_Byte *old_pos = *pos; // jump back to encode the length
-        (*pos) += 4;
-        type = src->content.decoded.type;
-        size_t encode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
-        retval |= encodeBinaryJumpTable[encode_index](src->content.decoded.data, pos, end);
-        UA_Int32 length = (UA_Int32)(((uintptr_t)*pos - (uintptr_t)old_pos) / sizeof(UA_Byte)) - 4;
-        retval |= Int32_encodeBinary(&length, &old_pos, end);
+        retval = NodeId_encodeBinary(&typeId, pos, ctx);
+        retval |= Byte_encodeBinary(&encoding, pos, ctx);
+        retval |= encodeExtensionObjectBody(src->content.decoded.data,
+                                            src->content.decoded.type, pos, ctx);
     } else {
-        retval = NodeId_encodeBinary(&src->content.encoded.typeId, pos, end);
-        retval |= Byte_encodeBinary(&encoding, pos, end);
+        retval = NodeId_encodeBinary(&src->content.encoded.typeId, pos, ctx);
+        retval |= Byte_encodeBinary(&encoding, pos, ctx);
         switch (src->encoding) {
         case UA_EXTENSIONOBJECT_ENCODED_NOBODY:
             break;
         case UA_EXTENSIONOBJECT_ENCODED_BYTESTRING:
         case UA_EXTENSIONOBJECT_ENCODED_XML:
-            retval |= ByteString_encodeBinary(&src->content.encoded.body, pos, end);
+            retval |= ByteString_encodeBinary(&src->content.encoded.body, pos, ctx);
             break;
         default:
             return UA_STATUSCODE_BADINTERNALERROR;
@@ -773,17 +1145,20 @@ static UA_StatusCode findDataType(const UA_NodeId *typeId, const UA_DataType **f
     return UA_STATUSCODE_BADNODEIDUNKNOWN;
 }
 
+/* The body is decoded if decodeBody is set and the type is known. Otherwise,
+ * the body is kept in the binary encoding together with the NodeId of the
+ * encoding. */
 static UA_StatusCode
-ExtensionObject_decodeBinary(bufpos pos, bufend end, UA_ExtensionObject *dst) {
+decodeExtensionObject(bufpos pos, decodectx ctx, UA_ExtensionObject *dst, UA_Boolean decodeBody) {
     UA_Byte encoding = 0;
     UA_NodeId typeId;
     UA_NodeId_init(&typeId);
-    UA_StatusCode retval = NodeId_decodeBinary(pos, end, &typeId);
-    retval |= Byte_decodeBinary(pos, end, &encoding);
+    UA_StatusCode retval = NodeId_decodeBinary(pos, ctx, &typeId);
+    retval |= Byte_decodeBinary(pos, ctx, &encoding);
     if(typeId.namespaceIndex != 0 || typeId.identifierType != UA_NODEIDTYPE_NUMERIC)
         retval = UA_STATUSCODE_BADDECODINGERROR;
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeId_deleteMembers(&typeId);
+        deleteDecoded(&typeId, &UA_TYPES[UA_TYPES_NODEID], ctx);
         return retval;
     }
 
@@ -794,39 +1169,96 @@ ExtensionObject_decodeBinary(bufpos pos, bufend end, UA_ExtensionObject *dst) {
     } else if(encoding == UA_EXTENSIONOBJECT_ENCODED_XML) {
         dst->encoding = encoding;
         dst->content.encoded.typeId = typeId;
-        retval = ByteString_decodeBinary(pos, end, &dst->content.encoded.body);
+        retval = ByteString_decodeBinary(pos, ctx, &dst->content.encoded.body);
     } else {
         /* try to decode the content */
-        type = NULL;
+        const UA_DataType *type = NULL;
         UA_assert(typeId.identifier.byteString.data == NULL); //helping clang analyzer, typeId is numeric
         UA_assert(typeId.identifier.string.data == NULL); //helping clang analyzer, typeId is numeric
-        typeId.identifier.numeric -= UA_ENCODINGOFFSET_BINARY;
-        findDataType(&typeId, &type);
+        if(decodeBody) {
+            UA_NodeId contentTypeId = typeId;
+            contentTypeId.identifier.numeric -= UA_ENCODINGOFFSET_BINARY;
+            findDataType(&contentTypeId, &type);
+        }
         if(type) {
             /* UA_Int32 length = 0; */
-            /* retval |= Int32_decodeBinary(pos, end, &length); */
+            /* retval |= Int32_decodeBinary(pos, ctx, &length); */
             /* if(retval != UA_STATUSCODE_GOOD) */
             /*     return retval; */
             (*pos) += 4; // jump over the length
             dst->content.decoded.data = UA_new(type);
-            size_t decode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
             if(dst->content.decoded.data) {
                 dst->content.decoded.type = type;
                 dst->encoding = UA_EXTENSIONOBJECT_DECODED;
-                retval = decodeBinaryJumpTable[decode_index](pos, end, dst->content.decoded.data);
+                retval = decodeBinaryJump(pos, ctx, dst->content.decoded.data, type);
             } else
                 retval = UA_STATUSCODE_BADOUTOFMEMORY;
         } else {
-            retval = ByteString_decodeBinary(pos, end, &dst->content.encoded.body);
+            retval = ByteString_decodeBinary(pos, ctx, &dst->content.encoded.body);
             dst->encoding = UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
             dst->content.encoded.typeId = typeId;
         }
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_ExtensionObject_deleteMembers(dst);
+        deleteDecoded(dst, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT], ctx);
     return retval;
 }
 
+static UA_StatusCode
+ExtensionObject_decodeBinary(bufpos pos, decodectx ctx, UA_ExtensionObject *dst) {
+    return decodeExtensionObject(pos, ctx, dst, true);
+}
+
+/* Decodes an array of ExtensionObjects that keep their body encoded */
+static UA_StatusCode
+Array_decodeBinaryLazyExtensionObjects(bufpos pos, decodectx ctx, UA_Int32 signed_length,
+                                       void *UA_RESTRICT *UA_RESTRICT dst, size_t *out_length) {
+    const UA_DataType *eotype = &UA_TYPES[UA_TYPES_EXTENSIONOBJECT];
+    size_t length;
+    UA_StatusCode retval = Array_decodeBinaryAlloc(pos, ctx, signed_length, dst, &length, eotype);
+    *out_length = 0;
+    if(retval != UA_STATUSCODE_GOOD || length == 0)
+        return retval;
+    UA_ExtensionObject *eo = *dst;
+    for(size_t i = 0; i < length; i++) {
+        retval = decodeExtensionObject(pos, ctx, &eo[i], false);
+        if(retval != UA_STATUSCODE_GOOD) {
+            deleteDecodedArray(*dst, i, eotype, ctx);
+            *dst = NULL;
+            return retval;
+        }
+    }
+    *out_length = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_ExtensionObject_decodeBinaryContent(UA_ExtensionObject *eo) {
+    if(eo->encoding != UA_EXTENSIONOBJECT_ENCODED_BYTESTRING ||
+       eo->content.encoded.typeId.namespaceIndex != 0 ||
+       eo->content.encoded.typeId.identifierType != UA_NODEIDTYPE_NUMERIC)
+        return UA_STATUSCODE_GOOD;
+    UA_NodeId contentTypeId = eo->content.encoded.typeId;
+    contentTypeId.identifier.numeric -= UA_ENCODINGOFFSET_BINARY;
+    const UA_DataType *type = NULL;
+    if(findDataType(&contentTypeId, &type) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_GOOD;
+    void *data = UA_new(type);
+    if(!data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    size_t offset = 0;
+    UA_StatusCode retval = UA_decodeBinary(&eo->content.encoded.body, &offset, data, type);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_delete(data, type);
+        return retval;
+    }
+    UA_ExtensionObject_deleteMembers(eo);
+    eo->encoding = UA_EXTENSIONOBJECT_DECODED;
+    eo->content.decoded.type = type;
+    eo->content.decoded.data = data;
+    return UA_STATUSCODE_GOOD;
+}
+
 /* Variant */
 /* Types that are not builtin get wrapped in an ExtensionObject */
 
@@ -837,7 +1269,7 @@ enum UA_VARIANT_ENCODINGMASKTYPE {
 };
 
 static UA_StatusCode
-Variant_encodeBinary(UA_Variant const *src, bufpos pos, bufend end) {
+Variant_encodeBinary(UA_Variant const *src, bufpos pos, encodectx ctx) {
     if(!src->type)
         return UA_STATUSCODE_BADINTERNALERROR;
     const UA_Boolean isArray = src->arrayLength > 0 || src->data <= UA_EMPTY_ARRAY_SENTINEL;
@@ -852,13 +1284,11 @@ Variant_encodeBinary(UA_Variant const *src, bufpos pos, bufend end) {
 
     UA_NodeId typeId;
     UA_NodeId_init(&typeId);
-    size_t encode_index = src->type->typeIndex;
     if(isBuiltin) {
         /* Do an extra lookup. Enums are encoded as UA_UInt32. */
         encodingByte |= UA_VARIANT_ENCODINGMASKTYPE_TYPEID_MASK &
             (UA_Byte) (src->type->typeIndex + 1);
     } else {
-        encode_index = UA_BUILTIN_TYPES_COUNT;
         /* wrap the datatype in an extensionobject */
         encodingByte |= UA_VARIANT_ENCODINGMASKTYPE_TYPEID_MASK & (UA_Byte) 22;
         typeId = src->type->typeId;
@@ -866,7 +1296,7 @@ Variant_encodeBinary(UA_Variant const *src, bufpos pos, bufend end) {
             return UA_STATUSCODE_BADINTERNALERROR;
         typeId.identifier.numeric += UA_ENCODINGOFFSET_BINARY;
     }
-    UA_StatusCode retval = Byte_encodeBinary(&encodingByte, pos, end);
+    UA_StatusCode retval = Byte_encodeBinary(&encodingByte, pos, ctx);
 
     size_t length = src->arrayLength;
     if(!isArray) {
@@ -879,43 +1309,40 @@ Variant_encodeBinary(UA_Variant const *src, bufpos pos, bufend end) {
             encodeLength = (UA_Int32)src->arrayLength;
         else if(src->data == UA_EMPTY_ARRAY_SENTINEL)
             encodeLength = 0;
-        retval |= Int32_encodeBinary(&encodeLength, pos, end);
+        retval |= Int32_encodeBinary(&encodeLength, pos, ctx);
     }
 
     uintptr_t ptr = (uintptr_t)src->data;
     const UA_UInt16 memSize = src->type->memSize;
+    size_t bulkSize = isBuiltin && isArray ? bulkElementSize(src->type) : 0;
+    if(bulkSize > 0 && length > 0 && retval == UA_STATUSCODE_GOOD) {
+        retval = Array_encodeBinaryBulk((const UA_Byte*)ptr, length, bulkSize, pos, ctx);
+        length = 0;
+    }
     for(size_t i = 0; i < length; i++) {
-        UA_Byte *old_pos; // before encoding the actual content
         if(!isBuiltin) {
             /* The type is wrapped inside an extensionobject */
-            retval |= NodeId_encodeBinary(&typeId, pos, end);
+            retval |= NodeId_encodeBinary(&typeId, pos, ctx);
             UA_Byte eoEncoding = UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
-            retval |= Byte_encodeBinary(&eoEncoding, pos, end);
-            (*pos) += 4;
-            old_pos = *pos;
-        }
-        type = src->type;
-        retval |= encodeBinaryJumpTable[encode_index]((const void*)ptr, pos, end);
-        if(!isBuiltin) {
-            /* Jump back and print the length of the extension object */
-            UA_Int32 encodingLength = (UA_Int32)(((uintptr_t)*pos - (uintptr_t)old_pos) / sizeof(UA_Byte));
-            old_pos -= 4;
-            retval |= Int32_encodeBinary(&encodingLength, &old_pos, end);
+            retval |= Byte_encodeBinary(&eoEncoding, pos, ctx);
+            retval |= encodeExtensionObjectBody((const void*)ptr, src->type, pos, ctx);
+        } else {
+            retval |= encodeBinaryJumpTable[src->type->typeIndex]((const void*)ptr, pos, ctx);
         }
         ptr += memSize;
     }
     if(hasDimensions)
         retval |= Array_encodeBinary(src->arrayDimensions, src->arrayDimensionsSize,
-                                     &UA_TYPES[UA_TYPES_INT32], pos, end);
+                                     &UA_TYPES[UA_TYPES_INT32], pos, ctx);
     return retval;
 }
 
 /* The resulting variant always has the storagetype UA_VARIANT_DATA. Currently,
  we only support ns0 types (todo: attach typedescriptions to datatypenodes) */
 static UA_StatusCode
-Variant_decodeBinary(bufpos pos, bufend end, UA_Variant *dst) {
+Variant_decodeBinary(bufpos pos, decodectx ctx, UA_Variant *dst) {
     UA_Byte encodingByte;
-    UA_StatusCode retval = Byte_decodeBinary(pos, end, &encodingByte);
+    UA_StatusCode retval = Byte_decodeBinary(pos, ctx, &encodingByte);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     UA_Boolean isArray = encodingByte & UA_VARIANT_ENCODINGMASKTYPE_ARRAY;
@@ -927,28 +1354,45 @@ Variant_decodeBinary(bufpos pos, bufend end, UA_Variant *dst) {
         /* an array */
         dst->type = &UA_TYPES[typeIndex];
         UA_Int32 signedLength = 0;
-        retval |= Int32_decodeBinary(pos, end, &signedLength);
+        retval |= Int32_decodeBinary(pos, ctx, &signedLength);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
-        retval = Array_decodeBinary(pos, end, signedLength, &dst->data, &dst->arrayLength, dst->type);
+        if(typeIndex == UA_TYPES_EXTENSIONOBJECT && ctx->lazyExtensionObjects)
+            retval = Array_decodeBinaryLazyExtensionObjects(pos, ctx, signedLength, &dst->data,
+                                                            &dst->arrayLength);
+        else
+            retval = Array_decodeBinary(pos, ctx, signedLength, &dst->data, &dst->arrayLength,
+                                        dst->type);
+    } else if (typeIndex == UA_TYPES_EXTENSIONOBJECT && ctx->lazyExtensionObjects) {
+        /* a single extensionobject that keeps the encoded body */
+        dst->type = &UA_TYPES[UA_TYPES_EXTENSIONOBJECT];
+        dst->data = UA_calloc(1, sizeof(UA_ExtensionObject));
+        if(dst->data) {
+            retval = decodeExtensionObject(pos, ctx, dst->data, false);
+            if(retval != UA_STATUSCODE_GOOD) {
+                UA_free(dst->data);
+                dst->data = NULL;
+            }
+        } else
+            retval = UA_STATUSCODE_BADOUTOFMEMORY;
     } else if (typeIndex != UA_TYPES_EXTENSIONOBJECT) {
         /* a builtin type */
         dst->type = &UA_TYPES[typeIndex];
-        retval = Array_decodeBinary(pos, end, 1, &dst->data, &dst->arrayLength, dst->type);
+        retval = Array_decodeBinary(pos, ctx, 1, &dst->data, &dst->arrayLength, dst->type);
         dst->arrayLength = 0;
     } else {
         /* a single extensionobject */
         UA_Byte *old_pos = *pos;
         UA_NodeId typeId;
         UA_NodeId_init(&typeId);
-        retval = NodeId_decodeBinary(pos, end, &typeId);
+        retval = NodeId_decodeBinary(pos, ctx, &typeId);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
 
         UA_Byte eo_encoding;
-        retval = Byte_decodeBinary(pos, end, &eo_encoding);
+        retval = Byte_decodeBinary(pos, ctx, &eo_encoding);
         if(retval != UA_STATUSCODE_GOOD) {
-            UA_NodeId_deleteMembers(&typeId);
+            deleteDecoded(&typeId, &UA_TYPES[UA_TYPES_NODEID], ctx);
             return retval;
         }
 
@@ -957,14 +1401,12 @@ Variant_decodeBinary(bufpos pos, bufend end, UA_Variant *dst) {
         if(typeId.namespaceIndex == 0 && eo_encoding == UA_EXTENSIONOBJECT_ENCODED_BYTESTRING &&
            findDataType(&typeId, &dst->type) == UA_STATUSCODE_GOOD)
             *pos = old_pos;
-        UA_NodeId_deleteMembers(&typeId);
+        deleteDecoded(&typeId, &UA_TYPES[UA_TYPES_NODEID], ctx);
 
         /* decode the type */
         dst->data = UA_calloc(1, dst->type->memSize);
         if(dst->data) {
-            size_t decode_index = dst->type->builtin ? dst->type->typeIndex : UA_BUILTIN_TYPES_COUNT;
-            type = dst->type;
-            retval = decodeBinaryJumpTable[decode_index](pos, end, dst->data);
+            retval = decodeBinaryJump(pos, ctx, dst->data, dst->type);
             if(retval != UA_STATUSCODE_GOOD) {
                 UA_free(dst->data);
                 dst->data = NULL;
@@ -976,114 +1418,114 @@ Variant_decodeBinary(bufpos pos, bufend end, UA_Variant *dst) {
     /* array dimensions */
     if(isArray && (encodingByte & UA_VARIANT_ENCODINGMASKTYPE_DIMENSIONS)) {
         UA_Int32 signed_length = 0;
-        retval |= Int32_decodeBinary(pos, end, &signed_length);
+        retval |= Int32_decodeBinary(pos, ctx, &signed_length);
         if(retval == UA_STATUSCODE_GOOD)
-            retval = Array_decodeBinary(pos, end, signed_length, (void**)&dst->arrayDimensions,
+            retval = Array_decodeBinary(pos, ctx, signed_length, (void**)&dst->arrayDimensions,
                                         &dst->arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_Variant_deleteMembers(dst);
+        deleteDecoded(dst, &UA_TYPES[UA_TYPES_VARIANT], ctx);
     return retval;
 }
 
 /* DataValue */
 static UA_StatusCode
-DataValue_encodeBinary(UA_DataValue const *src, bufpos pos, bufend end) {
-    UA_StatusCode retval = Byte_encodeBinary((const UA_Byte*) src, pos, end);
+DataValue_encodeBinary(UA_DataValue const *src, bufpos pos, encodectx ctx) {
+    UA_StatusCode retval = Byte_encodeBinary((const UA_Byte*) src, pos, ctx);
     if(src->hasValue)
-        retval |= Variant_encodeBinary(&src->value, pos, end);
+        retval |= Variant_encodeBinary(&src->value, pos, ctx);
     if(src->hasStatus)
-        retval |= StatusCode_encodeBinary(&src->status, pos, end);
+        retval |= StatusCode_encodeBinary(&src->status, pos, ctx);
     if(src->hasSourceTimestamp)
-        retval |= DateTime_encodeBinary(&src->sourceTimestamp, pos, end);
+        retval |= DateTime_encodeBinary(&src->sourceTimestamp, pos, ctx);
     if(src->hasSourcePicoseconds)
-        retval |= UInt16_encodeBinary(&src->sourcePicoseconds, pos, end);
+        retval |= UInt16_encodeBinary(&src->sourcePicoseconds, pos, ctx);
     if(src->hasServerTimestamp)
-        retval |= DateTime_encodeBinary(&src->serverTimestamp, pos, end);
+        retval |= DateTime_encodeBinary(&src->serverTimestamp, pos, ctx);
     if(src->hasServerPicoseconds)
-        retval |= UInt16_encodeBinary(&src->serverPicoseconds, pos, end);
+        retval |= UInt16_encodeBinary(&src->serverPicoseconds, pos, ctx);
     return retval;
 }
 
 #define MAX_PICO_SECONDS 999
 static UA_StatusCode
-DataValue_decodeBinary(bufpos pos, bufend end, UA_DataValue *dst) {
-    UA_StatusCode retval = Byte_decodeBinary(pos, end, (UA_Byte*) dst);
+DataValue_decodeBinary(bufpos pos, decodectx ctx, UA_DataValue *dst) {
+    UA_StatusCode retval = Byte_decodeBinary(pos, ctx, (UA_Byte*) dst);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(dst->hasValue)
-        retval |= Variant_decodeBinary(pos, end, &dst->value);
+        retval |= Variant_decodeBinary(pos, ctx, &dst->value);
     if(dst->hasStatus)
-        retval |= StatusCode_decodeBinary(pos, end, &dst->status);
+        retval |= StatusCode_decodeBinary(pos, ctx, &dst->status);
     if(dst->hasSourceTimestamp)
-        retval |= DateTime_decodeBinary(pos, end, &dst->sourceTimestamp);
+        retval |= DateTime_decodeBinary(pos, ctx, &dst->sourceTimestamp);
     if(dst->hasSourcePicoseconds) {
-        retval |= UInt16_decodeBinary(pos, end, &dst->sourcePicoseconds);
+        retval |= UInt16_decodeBinary(pos, ctx, &dst->sourcePicoseconds);
         if(dst->sourcePicoseconds > MAX_PICO_SECONDS)
             dst->sourcePicoseconds = MAX_PICO_SECONDS;
     }
     if(dst->hasServerTimestamp)
-        retval |= DateTime_decodeBinary(pos, end, &dst->serverTimestamp);
+        retval |= DateTime_decodeBinary(pos, ctx, &dst->serverTimestamp);
     if(dst->hasServerPicoseconds) {
-        retval |= UInt16_decodeBinary(pos, end, &dst->serverPicoseconds);
+        retval |= UInt16_decodeBinary(pos, ctx, &dst->serverPicoseconds);
         if(dst->serverPicoseconds > MAX_PICO_SECONDS)
             dst->serverPicoseconds = MAX_PICO_SECONDS;
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_DataValue_deleteMembers(dst);
+        deleteDecoded(dst, &UA_TYPES[UA_TYPES_DATAVALUE], ctx);
     return retval;
 }
 
 /* DiagnosticInfo */
 static UA_StatusCode
-DiagnosticInfo_encodeBinary(const UA_DiagnosticInfo *src, bufpos pos, bufend end) {
-    UA_StatusCode retval = Byte_encodeBinary((const UA_Byte *) src, pos, end);
+DiagnosticInfo_encodeBinary(const UA_DiagnosticInfo *src, bufpos pos, encodectx ctx) {
+    UA_StatusCode retval = Byte_encodeBinary((const UA_Byte *) src, pos, ctx);
     if(src->hasSymbolicId)
-        retval |= Int32_encodeBinary(&src->symbolicId, pos, end);
+        retval |= Int32_encodeBinary(&src->symbolicId, pos, ctx);
     if(src->hasNamespaceUri)
-        retval |= Int32_encodeBinary(&src->namespaceUri, pos, end);
+        retval |= Int32_encodeBinary(&src->namespaceUri, pos, ctx);
     if(src->hasLocalizedText)
-        retval |= Int32_encodeBinary(&src->localizedText, pos, end);
+        retval |= Int32_encodeBinary(&src->localizedText, pos, ctx);
     if(src->hasLocale)
-        retval |= Int32_encodeBinary(&src->locale, pos, end);
+        retval |= Int32_encodeBinary(&src->locale, pos, ctx);
     if(src->hasAdditionalInfo)
-        retval |= String_encodeBinary(&src->additionalInfo, pos, end);
+        retval |= String_encodeBinary(&src->additionalInfo, pos, ctx);
     if(src->hasInnerStatusCode)
-        retval |= StatusCode_encodeBinary(&src->innerStatusCode, pos, end);
+        retval |= StatusCode_encodeBinary(&src->innerStatusCode, pos, ctx);
     if(src->hasInnerDiagnosticInfo)
-        retval |= DiagnosticInfo_encodeBinary(src->innerDiagnosticInfo, pos, end);
+        retval |= DiagnosticInfo_encodeBinary(src->innerDiagnosticInfo, pos, ctx);
     return retval;
 }
 
 static UA_StatusCode
-DiagnosticInfo_decodeBinary(bufpos pos, bufend end, UA_DiagnosticInfo *dst) {
-    UA_StatusCode retval = Byte_decodeBinary(pos, end, (UA_Byte*) dst);
+DiagnosticInfo_decodeBinary(bufpos pos, decodectx ctx, UA_DiagnosticInfo *dst) {
+    UA_StatusCode retval = Byte_decodeBinary(pos, ctx, (UA_Byte*) dst);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(dst->hasSymbolicId)
-        retval |= Int32_decodeBinary(pos, end, &dst->symbolicId);
+        retval |= Int32_decodeBinary(pos, ctx, &dst->symbolicId);
     if(dst->hasNamespaceUri)
-        retval |= Int32_decodeBinary(pos, end, &dst->namespaceUri);
+        retval |= Int32_decodeBinary(pos, ctx, &dst->namespaceUri);
     if(dst->hasLocalizedText)
-        retval |= Int32_decodeBinary(pos, end, &dst->localizedText);
+        retval |= Int32_decodeBinary(pos, ctx, &dst->localizedText);
     if(dst->hasLocale)
-        retval |= Int32_decodeBinary(pos, end, &dst->locale);
+        retval |= Int32_decodeBinary(pos, ctx, &dst->locale);
     if(dst->hasAdditionalInfo)
-        retval |= String_decodeBinary(pos, end, &dst->additionalInfo);
+        retval |= String_decodeBinary(pos, ctx, &dst->additionalInfo);
     if(dst->hasInnerStatusCode)
-        retval |= StatusCode_decodeBinary(pos, end, &dst->innerStatusCode);
+        retval |= StatusCode_decodeBinary(pos, ctx, &dst->innerStatusCode);
     if(dst->hasInnerDiagnosticInfo) {
         // innerDiagnosticInfo is a pointer to struct, therefore allocate
         dst->innerDiagnosticInfo = UA_calloc(1, sizeof(UA_DiagnosticInfo));
         if(dst->innerDiagnosticInfo)
-            retval |= DiagnosticInfo_decodeBinary(pos, end, dst->innerDiagnosticInfo);
+            retval |= DiagnosticInfo_decodeBinary(pos, ctx, dst->innerDiagnosticInfo);
         else {
             dst->hasInnerDiagnosticInfo = false;
             retval |= UA_STATUSCODE_BADOUTOFMEMORY;
         }
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_DiagnosticInfo_deleteMembers(dst);
+        deleteDecoded(dst, &UA_TYPES[UA_TYPES_DIAGNOSTICINFO], ctx);
     return retval;
 }
 
@@ -1092,33 +1534,30 @@ DiagnosticInfo_decodeBinary(bufpos pos, bufend end, UA_DiagnosticInfo *dst) {
 /********************/
 
 static UA_StatusCode
-UA_encodeBinaryInternal(const void *src, bufpos pos, bufend end) {
+encodeBinaryStructure(const void *src, const UA_DataType *type, bufpos pos, encodectx ctx) {
     uintptr_t ptr = (uintptr_t)src;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     UA_Byte membersSize = type->membersSize;
-    const UA_DataType *localtype = type;
-    const UA_DataType *typelists[2] = { UA_TYPES, &localtype[-localtype->typeIndex] };
+    const UA_DataType *typelists[2] = { UA_TYPES, &type[-type->typeIndex] };
     for(size_t i = 0; i < membersSize; i++) {
-        const UA_DataTypeMember *member = &localtype->members[i];
-        type = &typelists[!member->namespaceZero][member->memberTypeIndex];
+        const UA_DataTypeMember *member = &type->members[i];
+        const UA_DataType *membertype = &typelists[!member->namespaceZero][member->memberTypeIndex];
         if(!member->isArray) {
             ptr += member->padding;
-            size_t encode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
-            size_t memSize = type->memSize;
-            retval |= encodeBinaryJumpTable[encode_index]((const void*)ptr, pos, end);
-            ptr += memSize;
+            retval |= encodeBinaryJump((const void*)ptr, membertype, pos, ctx);
+            ptr += membertype->memSize;
         } else {
             ptr += member->padding;
             const size_t length = *((const size_t*)ptr);
             ptr += sizeof(size_t);
-            retval |= Array_encodeBinary(*(void *UA_RESTRICT const *)ptr, length, type, pos, end);
+            retval |= Array_encodeBinary(*(void *UA_RESTRICT const *)ptr, length, membertype, pos, ctx);
             ptr += sizeof(void*);
         }
     }
     return retval;
 }
 
-static const UA_encodeBinarySignature encodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1] = {
+static const UA_encodeBinarySignature encodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT] = {
     (UA_encodeBinarySignature)Boolean_encodeBinary, 
     (UA_encodeBinarySignature)Byte_encodeBinary, // SByte
     (UA_encodeBinarySignature)Byte_encodeBinary, 
@@ -1138,56 +1577,97 @@ static const UA_encodeBinarySignature encodeBinaryJumpTable[UA_BUILTIN_TYPES_COU
     (UA_encodeBinarySignature)NodeId_encodeBinary,
     (UA_encodeBinarySignature)ExpandedNodeId_encodeBinary,
     (UA_encodeBinarySignature)UInt32_encodeBinary, // StatusCode
-    (UA_encodeBinarySignature)UA_encodeBinaryInternal, // QualifiedName
+    (UA_encodeBinarySignature)QualifiedName_encodeBinary,
     (UA_encodeBinarySignature)LocalizedText_encodeBinary,
     (UA_encodeBinarySignature)ExtensionObject_encodeBinary,
     (UA_encodeBinarySignature)DataValue_encodeBinary,
     (UA_encodeBinarySignature)Variant_encodeBinary,
     (UA_encodeBinarySignature)DiagnosticInfo_encodeBinary,
-    (UA_encodeBinarySignature)UA_encodeBinaryInternal,
 };
 
 UA_StatusCode UA_encodeBinary(const void *src, const UA_DataType *localtype, UA_ByteString *dst, size_t *offset) {
+    return UA_encodeBinaryExchange(src, localtype, NULL, NULL, dst, offset);
+}
+
+UA_StatusCode
+UA_encodeBinaryExchange(const void *src, const UA_DataType *localtype,
+                        UA_exchangeEncodeBuffer exchangeCallback, void *exchangeHandle,
+                        UA_ByteString *dst, size_t *offset) {
     UA_Byte *pos = &dst->data[*offset];
-    UA_Byte *end = &dst->data[dst->length];
-    type = localtype;
-    UA_StatusCode retval = UA_encodeBinaryInternal(src, &pos, end);
+    EncodeContext ctx = {dst, &dst->data[dst->length], exchangeCallback, exchangeHandle, false};
+    UA_StatusCode retval = encodeBinaryJump(src, localtype, &pos, &ctx);
     *offset = (size_t)(pos - dst->data) / sizeof(UA_Byte);
     return retval;
 }
 
+/* Doubles the buffer. The offset remains. */
 static UA_StatusCode
-UA_decodeBinaryInternal(bufpos pos, bufend end, void *dst) {
+growBuffer(void *handle, UA_ByteString *buf, size_t *offset) {
+    (void)handle;
+    (void)offset;
+    size_t length = buf->length * 2;
+    UA_Byte *data = UA_realloc(buf->data, length);
+    if(!data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    buf->data = data;
+    buf->length = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_encodeBinaryAlloc(const void *src, const UA_DataType *localtype, UA_ByteString *dst) {
+    UA_StatusCode retval = UA_ByteString_allocBuffer(dst, UA_ENCODEBINARYALLOC_INITIALSIZE);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    UA_Byte *pos = dst->data;
+    EncodeContext ctx = {dst, &dst->data[dst->length], growBuffer, NULL, true};
+    retval = encodeBinaryJump(src, localtype, &pos, &ctx);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(dst);
+        return retval;
+    }
+    /* Release the unused space */
+    size_t length = (size_t)(pos - dst->data);
+    if(length == 0) {
+        UA_ByteString_deleteMembers(dst);
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_Byte *data = UA_realloc(dst->data, length);
+    if(data)
+        dst->data = data;
+    dst->length = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+decodeBinaryStructure(bufpos pos, decodectx ctx, void *dst, const UA_DataType *type) {
     uintptr_t ptr = (uintptr_t)dst;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     UA_Byte membersSize = type->membersSize;
-    const UA_DataType *localtype = type;
-    const UA_DataType *typelists[2] = { UA_TYPES, &localtype[-localtype->typeIndex] };
+    const UA_DataType *typelists[2] = { UA_TYPES, &type[-type->typeIndex] };
     for(size_t i = 0; i < membersSize; i++) {
-        const UA_DataTypeMember *member = &localtype->members[i];
-        type = &typelists[!member->namespaceZero][member->memberTypeIndex];
+        const UA_DataTypeMember *member = &type->members[i];
+        const UA_DataType *membertype = &typelists[!member->namespaceZero][member->memberTypeIndex];
         if(!member->isArray) {
             ptr += member->padding;
-            size_t fi = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
-            size_t memSize = type->memSize;
-            retval |= decodeBinaryJumpTable[fi](pos, end, (void *UA_RESTRICT)ptr);
-            ptr += memSize;
+            retval |= decodeBinaryJump(pos, ctx, (void *UA_RESTRICT)ptr, membertype);
+            ptr += membertype->memSize;
         } else {
             ptr += member->padding;
             size_t *length = (size_t*)ptr;
             ptr += sizeof(size_t);
             UA_Int32 slength = -1;
-            retval |= Int32_decodeBinary(pos, end, &slength);
-            retval |= Array_decodeBinary(pos, end, slength, (void *UA_RESTRICT *UA_RESTRICT)ptr, length, type);
+            retval |= Int32_decodeBinary(pos, ctx, &slength);
+            retval |= Array_decodeBinary(pos, ctx, slength, (void *UA_RESTRICT *UA_RESTRICT)ptr, length, membertype);
             ptr += sizeof(void*);
         }
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_deleteMembers(dst, localtype);
+        deleteDecoded(dst, type, ctx);
     return retval;
 }
 
-static const UA_decodeBinarySignature decodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1] = {
+static const UA_decodeBinarySignature decodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT] = {
     (UA_decodeBinarySignature)Boolean_decodeBinary, 
     (UA_decodeBinarySignature)Byte_decodeBinary, // SByte
     (UA_decodeBinarySignature)Byte_decodeBinary, 
@@ -1207,26 +1687,40 @@ static const UA_decodeBinarySignature decodeBinaryJumpTable[UA_BUILTIN_TYPES_COU
     (UA_decodeBinarySignature)NodeId_decodeBinary,
     (UA_decodeBinarySignature)ExpandedNodeId_decodeBinary,
     (UA_decodeBinarySignature)UInt32_decodeBinary, // StatusCode
-    (UA_decodeBinarySignature)UA_decodeBinaryInternal, // QualifiedName
+    (UA_decodeBinarySignature)QualifiedName_decodeBinary,
     (UA_decodeBinarySignature)LocalizedText_decodeBinary,
     (UA_decodeBinarySignature)ExtensionObject_decodeBinary,
     (UA_decodeBinarySignature)DataValue_decodeBinary,
     (UA_decodeBinarySignature)Variant_decodeBinary,
-    (UA_decodeBinarySignature)DiagnosticInfo_decodeBinary,
-    (UA_decodeBinarySignature)UA_decodeBinaryInternal
+    (UA_decodeBinarySignature)DiagnosticInfo_decodeBinary
 };
 
-UA_StatusCode
-UA_decodeBinary(const UA_ByteString *src, size_t *offset, void *dst, const UA_DataType *localtype) {
+static UA_StatusCode
+decodeBinary(const UA_ByteString *src, size_t *offset, void *dst, const UA_DataType *localtype,
+             const DecodeContext *ctx) {
     memset(dst, 0, localtype->memSize); // init
     UA_Byte *pos = &src->data[*offset];
-    UA_Byte *end = &src->data[src->length];
-    type = localtype;
-    UA_StatusCode retval = UA_decodeBinaryInternal(&pos, end, dst);
+    UA_StatusCode retval = decodeBinaryJump(&pos, ctx, dst, localtype);
+    if(retval != UA_STATUSCODE_GOOD && localtype->builtin)
+        deleteDecoded(dst, localtype, ctx);
     *offset = (size_t)(pos - src->data) / sizeof(UA_Byte);
     return retval;
 }
 
+UA_StatusCode
+UA_decodeBinary(const UA_ByteString *src, size_t *offset, void *dst, const UA_DataType *localtype) {
+    DecodeContext ctx = {&src->data[src->length], false, false};
+    return decodeBinary(src, offset, dst, localtype, &ctx);
+}
+
+UA_StatusCode
+UA_decodeBinaryWithOptions(const UA_ByteString *src, size_t *offset, void *dst,
+                           const UA_DataType *type, const UA_DecodeBinaryOptions *options) {
+    DecodeContext ctx = {&src->data[src->length], options->lazyExtensionObjects,
+                         options->borrowStrings};
+    return decodeBinary(src, offset, dst, type, &ctx);
+}
+
 /******************/
 /* CalcSizeBinary */
 /******************/
@@ -1238,6 +1732,9 @@ Array_calcSizeBinary(const void *src, size_t length, const UA_DataType *contentt
         s += contenttype->memSize * length;
         return s;
     }
+    const PackedLayout *layout = packedLayout(contenttype);
+    if(layout)
+        return s + layout->wireSize * length;
     uintptr_t ptr = (uintptr_t)src;
     size_t encode_index = contenttype->builtin ? contenttype->typeIndex : UA_BUILTIN_TYPES_COUNT;
     for(size_t i = 0; i < length; i++) {
@@ -1259,6 +1756,11 @@ static size_t Guid_calcSizeBinary(const UA_Guid *UA_RESTRICT p, const UA_DataTyp
     return 16;
 }
 
+static size_t
+QualifiedName_calcSizeBinary(const UA_QualifiedName *src, const UA_DataType *_) {
+    return 2 + String_calcSizeBinary(&src->name, NULL);
+}
+
 static size_t
 NodeId_calcSizeBinary(const UA_NodeId *UA_RESTRICT src, const UA_DataType *_) {
     size_t s = 1; // encoding byte
@@ -1316,8 +1818,9 @@ ExtensionObject_calcSizeBinary(const UA_ExtensionObject *src, UA_DataType *_) {
             return 0;
         s += NodeId_calcSizeBinary(&src->content.decoded.type->typeId, NULL);
         s += 4; // length
+        const UA_DataType *type = src->content.decoded.type;
         size_t encode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
-        s += calcSizeBinaryJumpTable[encode_index](src->content.decoded.data, src->content.decoded.type);
+        s += calcSizeBinaryJumpTable[encode_index](src->content.decoded.data, type);
     } else {
         s += NodeId_calcSizeBinary(&src->content.encoded.typeId, NULL);
         switch (src->encoding) {
@@ -1436,7 +1939,7 @@ static const UA_calcSizeBinarySignature calcSizeBinaryJumpTable[UA_BUILTIN_TYPES
     (UA_calcSizeBinarySignature)NodeId_calcSizeBinary,
     (UA_calcSizeBinarySignature)ExpandedNodeId_calcSizeBinary,
     (UA_calcSizeBinarySignature)calcSizeBinaryMemSize, // StatusCode
-    (UA_calcSizeBinarySignature)UA_calcSizeBinary, // QualifiedName
+    (UA_calcSizeBinarySignature)QualifiedName_calcSizeBinary,
     (UA_calcSizeBinarySignature)LocalizedText_calcSizeBinary,
     (UA_calcSizeBinarySignature)ExtensionObject_calcSizeBinary,
     (UA_calcSizeBinarySignature)DataValue_calcSizeBinary,
@@ -1446,6 +1949,11 @@ static const UA_calcSizeBinarySignature calcSizeBinaryJumpTable[UA_BUILTIN_TYPES
 };
 
 size_t UA_calcSizeBinary(void *p, const UA_DataType *contenttype) {
+#ifdef UA_ENABLE_GENERATED_CODEC
+    if(!contenttype->builtin && isTypesEntry(contenttype) &&
+       generatedCalcSizeBinaryJumpTable[contenttype->typeIndex])
+        return generatedCalcSizeBinaryJumpTable[contenttype->typeIndex](p, contenttype);
+#endif
     size_t s = 0;
     uintptr_t ptr = (uintptr_t)p;
     UA_Byte membersSize = contenttype->membersSize;
@@ -1468,3 +1976,9 @@ size_t UA_calcSizeBinary(void *p, const UA_DataType *contenttype) {
     }
     return s;
 }
+
+#include "ua_types_generated_packed.inc"
+
+#ifdef UA_ENABLE_GENERATED_CODEC
+#include "ua_types_generated_codec.inc"
+#endif
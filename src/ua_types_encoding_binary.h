@@ -6,9 +6,50 @@
 UA_StatusCode UA_encodeBinary(const void *src, const UA_DataType *type, UA_ByteString *dst,
                               size_t *offset) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
 
+/* Called when the buffer is full. The callback takes over the buffer up to the
+ * offset (e.g. to send it) and replaces it with a new buffer. The encoding
+ * continues in the new buffer at the returned offset. */
+typedef UA_StatusCode (*UA_exchangeEncodeBuffer)(void *handle, UA_ByteString *buf, size_t *offset);
+
+/* Encodes over several buffers. Ends with the last buffer in dst. */
+UA_StatusCode
+UA_encodeBinaryExchange(const void *src, const UA_DataType *type,
+                        UA_exchangeEncodeBuffer exchangeCallback, void *exchangeHandle,
+                        UA_ByteString *dst, size_t *offset) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
+
+/* Encodes into a newly allocated buffer that is grown as required. So the value
+ * is not sized with UA_calcSizeBinary before the encoding. */
+#define UA_ENCODEBINARYALLOC_INITIALSIZE 128
+UA_StatusCode
+UA_encodeBinaryAlloc(const void *src, const UA_DataType *type,
+                     UA_ByteString *dst) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
+
 UA_StatusCode UA_decodeBinary(const UA_ByteString *src, size_t *offset, void *dst,
                               const UA_DataType *type) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
 
+typedef struct {
+    /* The ExtensionObjects in Variants keep their body in the binary encoding.
+     * So values that are only stored or forwarded are never decoded, and
+     * encoding them again copies the body. Consumers decode the content with
+     * UA_ExtensionObject_decodeBinaryContent. */
+    UA_Boolean lazyExtensionObjects;
+
+    /* Strings, bytestrings and the string identifiers of NodeIds point into
+     * the source buffer instead of being copied out. The decoded value must be
+     * deleted with UA_deleteMembersBorrowed before the buffer is released. */
+    UA_Boolean borrowStrings;
+} UA_DecodeBinaryOptions;
+
+UA_StatusCode
+UA_decodeBinaryWithOptions(const UA_ByteString *src, size_t *offset, void *dst,
+                           const UA_DataType *type,
+                           const UA_DecodeBinaryOptions *options) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
+
+/* Deletes a value that was decoded with borrowStrings. The borrowed strings are
+ * not freed, all other members are. */
+void UA_deleteMembersBorrowed(void *p, const UA_DataType *type);
+void UA_Array_deleteBorrowed(void *p, size_t size, const UA_DataType *type);
+
 size_t UA_calcSizeBinary(void *p, const UA_DataType *type);
 
 #endif /* UA_TYPES_ENCODING_BINARY_H_ */
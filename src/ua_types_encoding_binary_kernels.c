@@ -0,0 +1,222 @@
+#include "ua_types_encoding_binary_kernels.h"
+#include <string.h>
+
+/* The vector kernels work on 16 (SSE2, NEON) or 32 (AVX2) bytes at a time. The
+ * remaining elements are handled by the scalar kernels. SSE2 is part of every
+ * x86-64 CPU. AVX2 is compiled in with a function attribute and used if the
+ * CPU reports it. */
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+# define UA_KERNELS_SSE2
+# include <emmintrin.h>
+# if defined(__clang__) || __GNUC__ >= 5
+#  define UA_KERNELS_AVX2
+#  include <immintrin.h>
+# endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define UA_KERNELS_NEON
+# include <arm_neon.h>
+#endif
+
+/**********/
+/* Scalar */
+/**********/
+
+void
+UA_swapBytes16_scalar(UA_Byte *dst, const UA_Byte *src, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        UA_UInt16 v;
+        memcpy(&v, &src[i * 2], 2);
+        v = (UA_UInt16)((v >> 8) | (v << 8));
+        memcpy(&dst[i * 2], &v, 2);
+    }
+}
+
+void
+UA_swapBytes32_scalar(UA_Byte *dst, const UA_Byte *src, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        UA_UInt32 v;
+        memcpy(&v, &src[i * 4], 4);
+        v = (v >> 24) | ((v >> 8) & 0x0000FF00) | ((v << 8) & 0x00FF0000) | (v << 24);
+        memcpy(&dst[i * 4], &v, 4);
+    }
+}
+
+void
+UA_swapBytes64_scalar(UA_Byte *dst, const UA_Byte *src, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        UA_UInt64 v;
+        memcpy(&v, &src[i * 8], 8);
+        v = ((v & 0x00000000FFFFFFFFULL) << 32) | ((v & 0xFFFFFFFF00000000ULL) >> 32);
+        v = ((v & 0x0000FFFF0000FFFFULL) << 16) | ((v & 0xFFFF0000FFFF0000ULL) >> 16);
+        v = ((v & 0x00FF00FF00FF00FFULL) << 8) | ((v & 0xFF00FF00FF00FF00ULL) >> 8);
+        memcpy(&dst[i * 8], &v, 8);
+    }
+}
+
+void
+UA_normalizeBooleans_scalar(UA_Byte *dst, const UA_Byte *src, size_t count) {
+    for(size_t i = 0; i < count; i++)
+        dst[i] = (src[i] != 0);
+}
+
+/********/
+/* SSE2 */
+/********/
+
+#ifdef UA_KERNELS_SSE2
+
+static UA_INLINE __m128i
+sse2Swap16(__m128i v) {
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static UA_INLINE __m128i
+sse2Swap32(__m128i v) {
+    v = sse2Swap16(v);
+    return _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16));
+}
+
+static UA_INLINE __m128i
+sse2Swap64(__m128i v) {
+    return _mm_shuffle_epi32(sse2Swap32(v), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+/* Returns the number of bytes processed */
+#define UA_KERNEL_SSE2(NAME, OP)                                        \
+    static size_t                                                       \
+    NAME(UA_Byte *dst, const UA_Byte *src, size_t bytes) {              \
+        size_t i = 0;                                                   \
+        for(; i + 16 <= bytes; i += 16) {                               \
+            __m128i v = _mm_loadu_si128((const __m128i*)&src[i]);       \
+            _mm_storeu_si128((__m128i*)&dst[i], OP);                    \
+        }                                                               \
+        return i;                                                       \
+    }
+
+UA_KERNEL_SSE2(sse2SwapBytes16, sse2Swap16(v))
+UA_KERNEL_SSE2(sse2SwapBytes32, sse2Swap32(v))
+UA_KERNEL_SSE2(sse2SwapBytes64, sse2Swap64(v))
+UA_KERNEL_SSE2(sse2NormalizeBooleans, _mm_min_epu8(v, _mm_set1_epi8(1)))
+
+#endif
+
+/********/
+/* AVX2 */
+/********/
+
+#ifdef UA_KERNELS_AVX2
+
+/* The byte shuffle works within the two 128bit lanes */
+#define UA_SHUFFLE_MASK(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+#define UA_KERNEL_AVX2(NAME, OP)                                        \
+    __attribute__((target("avx2"))) static size_t                      \
+    NAME(UA_Byte *dst, const UA_Byte *src, size_t bytes) {              \
+        size_t i = 0;                                                   \
+        for(; i + 32 <= bytes; i += 32) {                               \
+            __m256i v = _mm256_loadu_si256((const __m256i*)&src[i]);    \
+            _mm256_storeu_si256((__m256i*)&dst[i], OP);                 \
+        }                                                               \
+        return i;                                                       \
+    }
+
+UA_KERNEL_AVX2(avx2SwapBytes16, _mm256_shuffle_epi8(v, UA_SHUFFLE_MASK(
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)))
+UA_KERNEL_AVX2(avx2SwapBytes32, _mm256_shuffle_epi8(v, UA_SHUFFLE_MASK(
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)))
+UA_KERNEL_AVX2(avx2SwapBytes64, _mm256_shuffle_epi8(v, UA_SHUFFLE_MASK(
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8)))
+UA_KERNEL_AVX2(avx2NormalizeBooleans, _mm256_min_epu8(v, _mm256_set1_epi8(1)))
+
+static UA_INLINE UA_Boolean
+hasAVX2(void) {
+    return __builtin_cpu_supports("avx2") != 0;
+}
+
+#endif
+
+/********/
+/* NEON */
+/********/
+
+#ifdef UA_KERNELS_NEON
+
+#define UA_KERNEL_NEON(NAME, OP)                                        \
+    static size_t                                                       \
+    NAME(UA_Byte *dst, const UA_Byte *src, size_t bytes) {              \
+        size_t i = 0;                                                   \
+        for(; i + 16 <= bytes; i += 16) {                               \
+            uint8x16_t v = vld1q_u8(&src[i]);                           \
+            vst1q_u8(&dst[i], OP);                                      \
+        }                                                               \
+        return i;                                                       \
+    }
+
+UA_KERNEL_NEON(neonSwapBytes16, vrev16q_u8(v))
+UA_KERNEL_NEON(neonSwapBytes32, vrev32q_u8(v))
+UA_KERNEL_NEON(neonSwapBytes64, vrev64q_u8(v))
+UA_KERNEL_NEON(neonNormalizeBooleans, vminq_u8(v, vdupq_n_u8(1)))
+
+#endif
+
+/************/
+/* Dispatch */
+/************/
+
+/* Runs the best vector kernel on the leading elements and the scalar kernel on
+ * the rest */
+#if defined(UA_KERNELS_AVX2)
+# define UA_KERNEL_DISPATCH(AVX2, SSE2, NEON, SCALAR, SIZE)             \
+    size_t done = hasAVX2() ? AVX2(dst, src, count * SIZE) : SSE2(dst, src, count * SIZE); \
+    SCALAR(&dst[done], &src[done], count - (done / SIZE));
+#elif defined(UA_KERNELS_SSE2)
+# define UA_KERNEL_DISPATCH(AVX2, SSE2, NEON, SCALAR, SIZE)             \
+    size_t done = SSE2(dst, src, count * SIZE);                         \
+    SCALAR(&dst[done], &src[done], count - (done / SIZE));
+#elif defined(UA_KERNELS_NEON)
+# define UA_KERNEL_DISPATCH(AVX2, SSE2, NEON, SCALAR, SIZE)             \
+    size_t done = NEON(dst, src, count * SIZE);                         \
+    SCALAR(&dst[done], &src[done], count - (done / SIZE));
+#else
+# define UA_KERNEL_DISPATCH(AVX2, SSE2, NEON, SCALAR, SIZE) \
+    SCALAR(dst, src, count);
+#endif
+
+void
+UA_swapBytes16(UA_Byte *dst, const UA_Byte *src, size_t count) {
+    UA_KERNEL_DISPATCH(avx2SwapBytes16, sse2SwapBytes16, neonSwapBytes16,
+                       UA_swapBytes16_scalar, 2)
+}
+
+void
+UA_swapBytes32(UA_Byte *dst, const UA_Byte *src, size_t count) {
+    UA_KERNEL_DISPATCH(avx2SwapBytes32, sse2SwapBytes32, neonSwapBytes32,
+                       UA_swapBytes32_scalar, 4)
+}
+
+void
+UA_swapBytes64(UA_Byte *dst, const UA_Byte *src, size_t count) {
+    UA_KERNEL_DISPATCH(avx2SwapBytes64, sse2SwapBytes64, neonSwapBytes64,
+                       UA_swapBytes64_scalar, 8)
+}
+
+void
+UA_normalizeBooleans(UA_Byte *dst, const UA_Byte *src, size_t count) {
+    UA_KERNEL_DISPATCH(avx2NormalizeBooleans, sse2NormalizeBooleans, neonNormalizeBooleans,
+                       UA_normalizeBooleans_scalar, 1)
+}
+
+const char *
+UA_kernelsName(void) {
+#if defined(UA_KERNELS_AVX2)
+    if(hasAVX2())
+        return "avx2";
+#endif
+#if defined(UA_KERNELS_SSE2)
+    return "sse2";
+#elif defined(UA_KERNELS_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
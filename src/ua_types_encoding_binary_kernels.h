@@ -0,0 +1,29 @@
+#ifndef UA_TYPES_ENCODING_BINARY_KERNELS_H_
+#define UA_TYPES_ENCODING_BINARY_KERNELS_H_
+
+#include "ua_types.h"
+
+/* Kernels for the bulk encoding of numeric arrays. The vector instructions
+ * (SSE2 and AVX2 on x86, NEON on ARM) are selected at runtime if the CPU
+ * supports them. The scalar versions are always available. Source and
+ * destination must not overlap and need not be aligned. */
+
+/* Copies count elements of 2, 4 or 8 bytes and reverses the byte order of
+ * every element. Used for the encoding on big-endian hosts. */
+void UA_swapBytes16(UA_Byte *dst, const UA_Byte *src, size_t count);
+void UA_swapBytes32(UA_Byte *dst, const UA_Byte *src, size_t count);
+void UA_swapBytes64(UA_Byte *dst, const UA_Byte *src, size_t count);
+
+/* Writes true for every nonzero byte and false otherwise */
+void UA_normalizeBooleans(UA_Byte *dst, const UA_Byte *src, size_t count);
+
+void UA_swapBytes16_scalar(UA_Byte *dst, const UA_Byte *src, size_t count);
+void UA_swapBytes32_scalar(UA_Byte *dst, const UA_Byte *src, size_t count);
+void UA_swapBytes64_scalar(UA_Byte *dst, const UA_Byte *src, size_t count);
+void UA_normalizeBooleans_scalar(UA_Byte *dst, const UA_Byte *src, size_t count);
+
+/* Name of the instruction set used by the kernels: "avx2", "sse2", "neon" or
+ * "scalar" */
+const char * UA_kernelsName(void);
+
+#endif /* UA_TYPES_ENCODING_BINARY_KERNELS_H_ */
@@ -29,6 +29,64 @@
 # define UA_realloc(ptr, size) realloc(ptr, size)
 #endif
 
+/* The request arena needs thread local storage. Without it, the requests are
+ * decoded on the heap. */
+#ifdef UA_ENABLE_REQUEST_ARENA
+# ifdef __GNUC__
+#  define UA_ARENA_THREAD_LOCAL __thread
+# elif defined(_MSC_VER)
+#  define UA_ARENA_THREAD_LOCAL __declspec(thread)
+# elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#  define UA_ARENA_THREAD_LOCAL _Thread_local
+# endif
+# ifdef UA_ARENA_THREAD_LOCAL
+#  define UA_REQUEST_ARENA
+# endif
+#endif
+
+#ifdef UA_REQUEST_ARENA
+/* The allocators (or the custom allocators) that the arena uses for its blocks
+ * and outside of the arena */
+static UA_INLINE void UA_Heap_free(void *ptr) { UA_free(ptr); }
+static UA_INLINE void * UA_Heap_malloc(size_t size) { return UA_malloc(size); }
+static UA_INLINE void * UA_Heap_calloc(size_t num, size_t size) { return UA_calloc(num, size); }
+static UA_INLINE void * UA_Heap_realloc(void *ptr, size_t size) { return UA_realloc(ptr, size); }
+
+/* While the arena of the thread is active, allocations are served from the
+ * arena. Memory in the arena is not freed individually but when the arena is
+ * reset. Outside of UA_Arena_begin and UA_Arena_end, the heap is used. */
+void * UA_Arena_malloc(size_t size);
+void * UA_Arena_calloc(size_t num, size_t size);
+void * UA_Arena_realloc(void *ptr, size_t size);
+void UA_Arena_free(void *ptr);
+# undef UA_free
+# undef UA_malloc
+# undef UA_calloc
+# undef UA_realloc
+# define UA_free(ptr) UA_Arena_free(ptr)
+# define UA_malloc(size) UA_Arena_malloc(size)
+# define UA_calloc(num, size) UA_Arena_calloc(num, size)
+# define UA_realloc(ptr, size) UA_Arena_realloc(ptr, size)
+
+/* Activates the arena of the thread until UA_Arena_end. Only for decoding,
+ * never while user callbacks run. */
+void UA_Arena_begin(void);
+void UA_Arena_end(void);
+
+/* Releases all memory allocated in the arena. The largest block is kept for
+ * the next use. */
+void UA_Arena_reset(void);
+
+/* Frees the memory of the arena. Call before a thread that used the arena
+ * exits. */
+void UA_Arena_deleteMembers(void);
+#else
+# define UA_Arena_begin() do {} while(0)
+# define UA_Arena_end() do {} while(0)
+# define UA_Arena_reset() do {} while(0)
+# define UA_Arena_deleteMembers() do {} while(0)
+#endif
+
 #ifndef NO_ALLOCA
 # ifdef __GNUC__
 #  define UA_alloca(size) __builtin_alloca (size)
@@ -47,7 +105,8 @@
 /* Thread Local Storage */
 /************************/
 
-#ifdef UA_ENABLE_MULTITHREADING
+/* The loopback networklayer runs the server and clients in different threads */
+#if defined(UA_ENABLE_MULTITHREADING) || defined(UA_ENABLE_LOOPBACK)
 # ifdef __GNUC__
 #  define UA_THREAD_LOCAL __thread
 # elif defined(_MSC_VER)
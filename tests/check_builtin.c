@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 #include "ua_types.h"
 #include "ua_types_encoding_binary.h"
+#include "ua_types_encoding_binary_kernels.h"
 #include "ua_types_generated.h"
 #include "ua_types_generated_encoding_binary.h"
 #include "ua_util.h"
@@ -305,6 +307,68 @@ START_TEST(UA_String_decodeShallAllocateMemoryAndCopyString) {
 }
 END_TEST
 
+START_TEST(UA_NodeId_decodeBorrowedShallPointIntoBuffer) {
+    // given a string nodeid
+    UA_NodeId src = UA_NODEID_STRING(1, "borrowed");
+    UA_Byte data[32];
+    UA_ByteString buf = {sizeof(data), data};
+    size_t pos = 0;
+    ck_assert_uint_eq(UA_encodeBinary(&src, &UA_TYPES[UA_TYPES_NODEID], &buf, &pos),
+                      UA_STATUSCODE_GOOD);
+    buf.length = pos;
+    // when
+    UA_DecodeBinaryOptions options = {false, true};
+    UA_NodeId dst;
+    pos = 0;
+    UA_StatusCode retval = UA_decodeBinaryWithOptions(&buf, &pos, &dst,
+                                                      &UA_TYPES[UA_TYPES_NODEID], &options);
+    // then
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_NodeId_equal(&src, &dst));
+    ck_assert_ptr_eq(dst.identifier.string.data, &data[pos - dst.identifier.string.length]);
+    // finally the borrowed string is not freed
+    UA_deleteMembersBorrowed(&dst, &UA_TYPES[UA_TYPES_NODEID]);
+    // when decoded without borrowing
+    pos = 0;
+    retval = UA_decodeBinary(&buf, &pos, &dst, &UA_TYPES[UA_TYPES_NODEID]);
+    // then the string is copied
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(dst.identifier.string.data < data || dst.identifier.string.data >= &data[sizeof(data)]);
+    UA_NodeId_deleteMembers(&dst);
+}
+END_TEST
+
+START_TEST(UA_ReadRequest_decodeBorrowedTruncatedShallNotFreeBuffer) {
+    // given a read request with string nodeids
+    UA_ReadValueId rvi[2];
+    UA_ReadValueId_init(&rvi[0]);
+    UA_ReadValueId_init(&rvi[1]);
+    rvi[0].nodeId = UA_NODEID_STRING(1, "first");
+    rvi[1].nodeId = UA_NODEID_STRING(1, "second");
+    UA_ReadRequest src;
+    UA_ReadRequest_init(&src);
+    src.nodesToRead = rvi;
+    src.nodesToReadSize = 2;
+    UA_Byte data[256];
+    UA_ByteString buf = {sizeof(data), data};
+    size_t pos = 0;
+    ck_assert_uint_eq(UA_encodeBinary(&src, &UA_TYPES[UA_TYPES_READREQUEST], &buf, &pos),
+                      UA_STATUSCODE_GOOD);
+    // when the message ends in the identifier of the second nodeid (the
+    // attributeId, indexRange and dataEncoding take the last 14 bytes)
+    buf.length = pos - 16;
+    UA_DecodeBinaryOptions options = {false, true};
+    UA_ReadRequest dst;
+    pos = 0;
+    UA_StatusCode retval = UA_decodeBinaryWithOptions(&buf, &pos, &dst,
+                                                      &UA_TYPES[UA_TYPES_READREQUEST], &options);
+    // then the decoded members are released without freeing the borrowed strings
+    ck_assert_uint_ne(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(dst.nodesToRead, NULL);
+    ck_assert_uint_eq(dst.nodesToReadSize, 0);
+}
+END_TEST
+
 START_TEST(UA_String_decodeWithNegativeSizeShallNotAllocateMemoryAndNullPtr) {
     // given
     size_t pos = 0;
@@ -532,6 +596,154 @@ START_TEST(UA_Variant_decodeWithTooSmallSourceShallReturnWithError) {
 }
 END_TEST
 
+START_TEST(UA_Variant_decodeLazyShallKeepExtensionObjectsEncoded) {
+    // given an array of structures in a variant
+    UA_ReadValueId rvi[2];
+    UA_ReadValueId_init(&rvi[0]);
+    UA_ReadValueId_init(&rvi[1]);
+    rvi[0].nodeId = UA_NODEID_NUMERIC(1, 1000);
+    rvi[0].attributeId = UA_ATTRIBUTEID_VALUE;
+    rvi[1].nodeId = UA_NODEID_STRING(1, "lazy");
+    rvi[1].attributeId = UA_ATTRIBUTEID_DISPLAYNAME;
+    UA_Variant src;
+    UA_Variant_setArray(&src, rvi, 2, &UA_TYPES[UA_TYPES_READVALUEID]);
+    UA_Byte data[128];
+    UA_ByteString buf = {sizeof(data), data};
+    size_t pos = 0;
+    ck_assert_uint_eq(UA_encodeBinary(&src, &UA_TYPES[UA_TYPES_VARIANT], &buf, &pos),
+                      UA_STATUSCODE_GOOD);
+    buf.length = pos;
+    // when
+    UA_Variant dst;
+    pos = 0;
+    UA_DecodeBinaryOptions options = {true, false};
+    UA_StatusCode retval = UA_decodeBinaryWithOptions(&buf, &pos, &dst,
+                                                      &UA_TYPES[UA_TYPES_VARIANT], &options);
+    // then the bodies are kept with the nodeid of the encoding
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(pos, buf.length);
+    ck_assert_ptr_eq(dst.type, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]);
+    ck_assert_uint_eq(dst.arrayLength, 2);
+    UA_ExtensionObject *eo = dst.data;
+    ck_assert_int_eq(eo[0].encoding, UA_EXTENSIONOBJECT_ENCODED_BYTESTRING);
+    ck_assert_uint_eq(eo[0].content.encoded.typeId.identifier.numeric,
+                      UA_TYPES[UA_TYPES_READVALUEID].typeId.identifier.numeric + UA_ENCODINGOFFSET_BINARY);
+    // then encoding again gives the same message
+    UA_Byte data2[128];
+    UA_ByteString buf2 = {sizeof(data2), data2};
+    pos = 0;
+    ck_assert_uint_eq(UA_encodeBinary(&dst, &UA_TYPES[UA_TYPES_VARIANT], &buf2, &pos),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(pos, buf.length);
+    ck_assert_int_eq(memcmp(data, data2, pos), 0);
+    // then the content is decoded on demand
+    ck_assert_uint_eq(UA_ExtensionObject_decodeBinaryContent(&eo[1]), UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(eo[1].encoding, UA_EXTENSIONOBJECT_DECODED);
+    ck_assert_ptr_eq(eo[1].content.decoded.type, &UA_TYPES[UA_TYPES_READVALUEID]);
+    UA_ReadValueId *decoded = eo[1].content.decoded.data;
+    ck_assert(UA_NodeId_equal(&decoded->nodeId, &rvi[1].nodeId));
+    ck_assert_uint_eq(decoded->attributeId, UA_ATTRIBUTEID_DISPLAYNAME);
+    // finally
+    UA_Variant_deleteMembers(&dst);
+}
+END_TEST
+
+START_TEST(UA_Variant_decodeBooleanArrayShallNormalize) {
+    // given a boolean array with nonzero bytes other than one
+    UA_Byte data[5 + 70];
+    data[0] = (UA_Byte)(UA_TYPES[UA_TYPES_BOOLEAN].typeId.identifier.numeric |
+                        UA_VARIANT_ENCODINGMASKTYPE_ARRAY);
+    data[1] = 70; data[2] = 0; data[3] = 0; data[4] = 0;
+    for(size_t i = 0; i < 70; i++)
+        data[5 + i] = (UA_Byte)((i % 3) * 0x7F);
+    UA_ByteString src = {sizeof(data), data};
+    // when
+    UA_Variant dst;
+    size_t pos = 0;
+    UA_StatusCode retval = UA_Variant_decodeBinary(&src, &pos, &dst);
+    // then
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(dst.arrayLength, 70);
+    const UA_Byte *b = dst.data;
+    for(size_t i = 0; i < 70; i++)
+        ck_assert_uint_eq(b[i], (i % 3) ? 1 : 0);
+    // finally
+    UA_Variant_deleteMembers(&dst);
+}
+END_TEST
+
+/* Structures with an array of ChannelSecurityTokens, which have padding in front
+ * of the DateTime. The second one refers to a copy of the type outside of
+ * UA_TYPES that is encoded member by member. */
+typedef struct {
+    size_t tokensSize;
+    UA_ChannelSecurityToken *tokens;
+} Tokens;
+
+static UA_DataTypeMember tokensMembers[1] = {
+    {.memberTypeIndex = UA_TYPES_CHANNELSECURITYTOKEN, .namespaceZero = true, .padding = 0,
+     .isArray = true}};
+
+static UA_DataTypeMember memberwiseTokensMembers[1] = {
+    {.memberTypeIndex = 0, .namespaceZero = false, .padding = 0, .isArray = true}};
+
+static UA_DataType tokenTypes[3] = {
+    {.typeId = {0}}, // copy of the ChannelSecurityToken type
+    {.typeId = {.namespaceIndex = 1, .identifierType = UA_NODEIDTYPE_NUMERIC, .identifier.numeric = 1},
+     .memSize = sizeof(Tokens), .typeIndex = 1, .membersSize = 1, .builtin = false,
+     .fixedSize = false, .zeroCopyable = false, .members = tokensMembers},
+    {.typeId = {.namespaceIndex = 1, .identifierType = UA_NODEIDTYPE_NUMERIC, .identifier.numeric = 2},
+     .memSize = sizeof(Tokens), .typeIndex = 2, .membersSize = 1, .builtin = false,
+     .fixedSize = false, .zeroCopyable = false, .members = memberwiseTokensMembers}};
+
+START_TEST(UA_Array_encodePackedShallEqualMemberwise) {
+    // given
+    tokenTypes[0] = UA_TYPES[UA_TYPES_CHANNELSECURITYTOKEN];
+    tokenTypes[0].typeIndex = 0;
+    UA_ChannelSecurityToken tokens[3];
+    for(size_t i = 0; i < 3; i++) {
+        memset(&tokens[i], 0xAB, sizeof(UA_ChannelSecurityToken)); // the padding is not encoded
+        tokens[i].channelId = (UA_UInt32)i + 1;
+        tokens[i].tokenId = (UA_UInt32)i + 10;
+        tokens[i].createdAt = (UA_DateTime)i * UA_SEC_TO_DATETIME;
+        tokens[i].revisedLifetime = (UA_UInt32)i + 100;
+    }
+    Tokens src = {3, tokens};
+    UA_Byte data[128], data2[128];
+    UA_ByteString buf = {sizeof(data), data};
+    UA_ByteString buf2 = {sizeof(data2), data2};
+    // when encoded as packed and member by member
+    size_t pos = 0, pos2 = 0;
+    ck_assert_uint_eq(UA_encodeBinary(&src, &tokenTypes[1], &buf, &pos), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_encodeBinary(&src, &tokenTypes[2], &buf2, &pos2), UA_STATUSCODE_GOOD);
+    // then
+    ck_assert_uint_eq(pos, 4 + 3 * 20);
+    ck_assert_uint_eq(pos, pos2);
+    ck_assert_int_eq(memcmp(data, data2, pos), 0);
+    ck_assert_uint_eq(UA_calcSizeBinary(&src, &tokenTypes[1]), pos);
+    ck_assert_uint_eq(UA_calcSizeBinary(&src, &tokenTypes[2]), pos);
+    // when decoded
+    buf.length = pos;
+    Tokens dst;
+    pos = 0;
+    ck_assert_uint_eq(UA_decodeBinary(&buf, &pos, &dst, &tokenTypes[1]), UA_STATUSCODE_GOOD);
+    // then
+    ck_assert_uint_eq(pos, buf.length);
+    ck_assert_uint_eq(dst.tokensSize, 3);
+    for(size_t i = 0; i < 3; i++) {
+        ck_assert_uint_eq(dst.tokens[i].channelId, tokens[i].channelId);
+        ck_assert_uint_eq(dst.tokens[i].tokenId, tokens[i].tokenId);
+        ck_assert_int_eq(dst.tokens[i].createdAt, tokens[i].createdAt);
+        ck_assert_uint_eq(dst.tokens[i].revisedLifetime, tokens[i].revisedLifetime);
+    }
+    UA_deleteMembers(&dst, &tokenTypes[1]);
+    // when the message is too short
+    buf.length--;
+    pos = 0;
+    ck_assert_uint_ne(UA_decodeBinary(&buf, &pos, &dst, &tokenTypes[1]), UA_STATUSCODE_GOOD);
+}
+END_TEST
+
 START_TEST(UA_Byte_encode_test) {
     // given
     UA_Byte src;
@@ -990,6 +1202,36 @@ START_TEST(UA_DataValue_encodeShallWorkOnExampleWithVariant) {
 }
 END_TEST
 
+START_TEST(UA_swapBytesShallEqualScalar) {
+    // given unaligned input of all lengths around the vector widths
+    UA_Byte src[8 * 70 + 1];
+    for(size_t i = 0; i < sizeof(src); i++)
+        src[i] = (UA_Byte)(i * 37);
+    UA_Byte dst[8 * 70 + 1];
+    UA_Byte expected[8 * 70 + 1];
+    for(size_t count = 0; count <= 70; count++) {
+        // when / then
+        UA_swapBytes16(&dst[1], &src[1], count);
+        UA_swapBytes16_scalar(&expected[1], &src[1], count);
+        ck_assert_int_eq(memcmp(&dst[1], &expected[1], count * 2), 0);
+        UA_swapBytes32(&dst[1], &src[1], count);
+        UA_swapBytes32_scalar(&expected[1], &src[1], count);
+        ck_assert_int_eq(memcmp(&dst[1], &expected[1], count * 4), 0);
+        UA_swapBytes64(&dst[1], &src[1], count);
+        UA_swapBytes64_scalar(&expected[1], &src[1], count);
+        ck_assert_int_eq(memcmp(&dst[1], &expected[1], count * 8), 0);
+        UA_normalizeBooleans(&dst[1], &src[1], count);
+        UA_normalizeBooleans_scalar(&expected[1], &src[1], count);
+        ck_assert_int_eq(memcmp(&dst[1], &expected[1], count), 0);
+    }
+    // then the scalar kernel reverses the bytes
+    UA_UInt32 v = 0x01020304;
+    UA_UInt32 swapped;
+    UA_swapBytes32_scalar((UA_Byte*)&swapped, (const UA_Byte*)&v, 1);
+    ck_assert_uint_eq(swapped, 0x04030201);
+}
+END_TEST
+
 START_TEST(UA_DateTime_toStructShallWorkOnExample) {
     // given
     UA_DateTime src = 13974671891234567 + (11644473600 * 10000000); // ua counts since 1601, unix since 1970
@@ -1473,6 +1715,151 @@ START_TEST(UA_ExtensionObject_encodeDecodeShallWorkOnExtensionObject) {
 }
 END_TEST
 
+/* Collects the exchanged buffers */
+typedef struct {
+    UA_Byte data[4096];
+    size_t length;
+    size_t exchanges;
+} ExchangeTarget;
+
+static UA_StatusCode
+collectBuffer(void *handle, UA_ByteString *buf, size_t *offset) {
+    ExchangeTarget *target = handle;
+    ck_assert_uint_le(target->length + *offset, sizeof(target->data));
+    memcpy(&target->data[target->length], buf->data, *offset);
+    target->length += *offset;
+    target->exchanges++;
+    *offset = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(UA_Variant_encodeExchangeShallEqualSingleBuffer) {
+    // given an array of structures (wrapped in extensionobjects) with strings
+    UA_ReadValueId ids[10];
+    for(size_t i = 0; i < 10; i++) {
+        UA_ReadValueId_init(&ids[i]);
+        ids[i].nodeId = UA_NODEID_STRING(1, "a rather long string nodeid");
+        ids[i].attributeId = (UA_UInt32)i;
+    }
+    UA_Variant v;
+    UA_Variant_setArray(&v, ids, 10, &UA_TYPES[UA_TYPES_READVALUEID]);
+
+    UA_Byte single[4096];
+    UA_ByteString dst = {sizeof(single), single};
+    size_t singlePos = 0;
+    ck_assert_uint_eq(UA_encodeBinary(&v, &UA_TYPES[UA_TYPES_VARIANT], &dst, &singlePos),
+                      UA_STATUSCODE_GOOD);
+
+    // when encoded into small buffers
+    UA_Byte small[13];
+    UA_ByteString buf = {sizeof(small), small};
+    ExchangeTarget target;
+    target.length = 0;
+    target.exchanges = 0;
+    size_t pos = 0;
+    UA_StatusCode retval = UA_encodeBinaryExchange(&v, &UA_TYPES[UA_TYPES_VARIANT], collectBuffer,
+                                                   &target, &buf, &pos);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    memcpy(&target.data[target.length], buf.data, pos);
+    target.length += pos;
+
+    // then
+    ck_assert_uint_gt(target.exchanges, singlePos / sizeof(small) - 1);
+    ck_assert_uint_eq(target.length, singlePos);
+    ck_assert(memcmp(target.data, single, singlePos) == 0);
+}
+END_TEST
+
+START_TEST(UA_Variant_encodeAllocShallEqualSingleBuffer) {
+    // given an array of structures (wrapped in extensionobjects) with strings
+    UA_ReadValueId ids[10];
+    for(size_t i = 0; i < 10; i++) {
+        UA_ReadValueId_init(&ids[i]);
+        ids[i].nodeId = UA_NODEID_STRING(1, "a rather long string nodeid");
+        ids[i].attributeId = (UA_UInt32)i;
+    }
+    UA_Variant v;
+    UA_Variant_setArray(&v, ids, 10, &UA_TYPES[UA_TYPES_READVALUEID]);
+
+    UA_Byte single[4096];
+    UA_ByteString dst = {sizeof(single), single};
+    size_t singlePos = 0;
+    ck_assert_uint_eq(UA_encodeBinary(&v, &UA_TYPES[UA_TYPES_VARIANT], &dst, &singlePos),
+                      UA_STATUSCODE_GOOD);
+
+    // when encoded into a growing buffer
+    UA_ByteString buf;
+    UA_StatusCode retval = UA_encodeBinaryAlloc(&v, &UA_TYPES[UA_TYPES_VARIANT], &buf);
+
+    // then
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_gt(singlePos, UA_ENCODEBINARYALLOC_INITIALSIZE);
+    ck_assert_uint_eq(buf.length, singlePos);
+    ck_assert(memcmp(buf.data, single, singlePos) == 0);
+    UA_ByteString_deleteMembers(&buf);
+}
+END_TEST
+
+START_TEST(UA_String_encodeWithoutExchangeShallFailWhenFull) {
+    // given
+    UA_String src = UA_STRING("too long for the buffer");
+    UA_Byte data[8];
+    UA_ByteString dst = {sizeof(data), data};
+    size_t pos = 0;
+    // when
+    UA_StatusCode retval = UA_encodeBinaryExchange(&src, &UA_TYPES[UA_TYPES_STRING], NULL, NULL,
+                                                   &dst, &pos);
+    // then
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADENCODINGERROR);
+}
+END_TEST
+
+START_TEST(UA_ReadResponse_encodeDecodeShallWorkOnExample) {
+    // given
+    UA_ReadResponse src;
+    UA_ReadResponse_init(&src);
+    src.responseHeader.requestHandle = 42;
+    src.responseHeader.serviceResult = UA_STATUSCODE_BADTIMEOUT;
+    src.results = UA_Array_new(3, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    src.resultsSize = 3;
+    UA_Int32 i32 = 7;
+    UA_Variant_setScalarCopy(&src.results[0].value, &i32, &UA_TYPES[UA_TYPES_INT32]);
+    src.results[0].hasValue = true;
+    src.results[1].status = UA_STATUSCODE_BADNODEIDUNKNOWN;
+    src.results[1].hasStatus = true;
+    UA_String str = UA_STRING("value");
+    UA_Variant_setScalarCopy(&src.results[2].value, &str, &UA_TYPES[UA_TYPES_STRING]);
+    src.results[2].hasValue = true;
+    src.results[2].sourceTimestamp = 1234;
+    src.results[2].hasSourceTimestamp = true;
+    UA_ByteString dst;
+    UA_ByteString_allocBuffer(&dst, UA_calcSizeBinary(&src, &UA_TYPES[UA_TYPES_READRESPONSE]));
+    size_t pos = 0;
+    // when
+    UA_StatusCode retval = UA_encodeBinary(&src, &UA_TYPES[UA_TYPES_READRESPONSE], &dst, &pos);
+    UA_ReadResponse decoded;
+    size_t decodePos = 0;
+    retval |= UA_decodeBinary(&dst, &decodePos, &decoded, &UA_TYPES[UA_TYPES_READRESPONSE]);
+    // then
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(pos, dst.length);
+    ck_assert_uint_eq(decodePos, pos);
+    ck_assert_uint_eq(decoded.responseHeader.requestHandle, 42);
+    ck_assert_uint_eq(decoded.responseHeader.serviceResult, UA_STATUSCODE_BADTIMEOUT);
+    ck_assert_uint_eq(decoded.resultsSize, 3);
+    ck_assert_ptr_eq(decoded.results[0].value.type, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_int_eq(*(UA_Int32*)decoded.results[0].value.data, 7);
+    ck_assert(!decoded.results[1].hasValue);
+    ck_assert_uint_eq(decoded.results[1].status, UA_STATUSCODE_BADNODEIDUNKNOWN);
+    ck_assert(UA_String_equal((UA_String*)decoded.results[2].value.data, &str));
+    ck_assert_int_eq(decoded.results[2].sourceTimestamp, 1234);
+    // finally
+    UA_ReadResponse_deleteMembers(&decoded);
+    UA_ReadResponse_deleteMembers(&src);
+    UA_ByteString_deleteMembers(&dst);
+}
+END_TEST
+
 static Suite *testSuite_builtin(void) {
     Suite *s = suite_create("Built-in Data Types 62541-6 Table 1");
 
@@ -1494,6 +1881,8 @@ static Suite *testSuite_builtin(void) {
     tcase_add_test(tc_decode, UA_Double_decodeShallGive2147483648);
     tcase_add_test(tc_decode, UA_Byte_encode_test);
     tcase_add_test(tc_decode, UA_String_decodeShallAllocateMemoryAndCopyString);
+    tcase_add_test(tc_decode, UA_NodeId_decodeBorrowedShallPointIntoBuffer);
+    tcase_add_test(tc_decode, UA_ReadRequest_decodeBorrowedTruncatedShallNotFreeBuffer);
     tcase_add_test(tc_decode, UA_String_decodeWithNegativeSizeShallNotAllocateMemoryAndNullPtr);
     tcase_add_test(tc_decode, UA_String_decodeWithZeroSizeShallNotAllocateMemoryAndNullPtr);
     tcase_add_test(tc_decode, UA_NodeId_decodeTwoByteShallReadTwoBytesAndSetNamespaceToZero);
@@ -1504,6 +1893,8 @@ static Suite *testSuite_builtin(void) {
     tcase_add_test(tc_decode, UA_Variant_decodeWithArrayFlagSetShallSetVTAndAllocateMemoryForArray);
     tcase_add_test(tc_decode, UA_Variant_decodeWithOutDeleteMembersShallFailInCheckMem);
     tcase_add_test(tc_decode, UA_Variant_decodeWithTooSmallSourceShallReturnWithError);
+    tcase_add_test(tc_decode, UA_Variant_decodeLazyShallKeepExtensionObjectsEncoded);
+    tcase_add_test(tc_decode, UA_Variant_decodeBooleanArrayShallNormalize);
     suite_add_tcase(s, tc_decode);
 
     TCase *tc_encode = tcase_create("encode");
@@ -1523,11 +1914,17 @@ static Suite *testSuite_builtin(void) {
     tcase_add_test(tc_encode, UA_DataValue_encodeShallWorkOnExampleWithoutVariant);
     tcase_add_test(tc_encode, UA_DataValue_encodeShallWorkOnExampleWithVariant);
     tcase_add_test(tc_encode, UA_ExtensionObject_encodeDecodeShallWorkOnExtensionObject);
+    tcase_add_test(tc_encode, UA_Variant_encodeExchangeShallEqualSingleBuffer);
+    tcase_add_test(tc_encode, UA_Variant_encodeAllocShallEqualSingleBuffer);
+    tcase_add_test(tc_encode, UA_String_encodeWithoutExchangeShallFailWhenFull);
+    tcase_add_test(tc_encode, UA_ReadResponse_encodeDecodeShallWorkOnExample);
+    tcase_add_test(tc_encode, UA_Array_encodePackedShallEqualMemberwise);
     suite_add_tcase(s, tc_encode);
 
     TCase *tc_convert = tcase_create("convert");
     tcase_add_test(tc_convert, UA_DateTime_toStructShallWorkOnExample);
     tcase_add_test(tc_convert, UA_DateTime_toStringShallWorkOnExample);
+    tcase_add_test(tc_convert, UA_swapBytesShallEqualScalar);
     suite_add_tcase(s, tc_convert);
 
     TCase *tc_copy = tcase_create("copy");
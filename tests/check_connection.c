@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ua_types.h"
+#include "ua_types_generated.h"
+#include "ua_connection_internal.h"
+#include "check.h"
+
+static UA_Connection connection;
+
+static void
+setup(void) {
+    UA_Connection_init(&connection);
+}
+
+static void
+teardown(void) {
+    UA_Connection_deleteMembers(&connection);
+}
+
+/* Writes a MSG chunk of the given length. The body counts up from seed. */
+static void
+writeMessage(UA_Byte *data, UA_UInt32 length, UA_Byte seed) {
+    memcpy(data, "MSGF", 4);
+    data[4] = (UA_Byte)length;
+    data[5] = (UA_Byte)(length >> 8);
+    data[6] = (UA_Byte)(length >> 16);
+    data[7] = (UA_Byte)(length >> 24);
+    for(size_t i = 8; i < length; i++)
+        data[i] = (UA_Byte)(seed + i);
+}
+
+START_TEST(Connection_completeMessagesInPlace) {
+    UA_Byte data[300];
+    writeMessage(data, 100, 1);
+    writeMessage(&data[100], 200, 2);
+    UA_ByteString buffer = {300, data};
+    UA_ByteString completed, messages;
+    ck_assert_uint_eq(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(completed.length, 0);
+    ck_assert_ptr_eq(messages.data, data);
+    ck_assert_uint_eq(messages.length, 300);
+    ck_assert_uint_eq(connection.incompleteMessage.length, 0);
+}
+END_TEST
+
+/* A message that is split over three buffers. The complete message after it
+ * is framed in place. */
+START_TEST(Connection_completeStraddlingMessage) {
+    UA_Byte data[1100];
+    writeMessage(data, 1000, 1);
+    writeMessage(&data[1000], 100, 2);
+    UA_ByteString completed, messages;
+
+    /* less than the header */
+    UA_ByteString buffer = {5, data};
+    ck_assert_uint_eq(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(completed.length, 0);
+    ck_assert_uint_eq(messages.length, 0);
+    ck_assert_uint_eq(connection.incompleteMessage.length, 5);
+
+    buffer = (UA_ByteString){500, &data[5]};
+    ck_assert_uint_eq(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(completed.length, 0);
+    ck_assert_uint_eq(messages.length, 0);
+    ck_assert_uint_eq(connection.incompleteMessage.length, 505);
+
+    buffer = (UA_ByteString){595, &data[505]};
+    ck_assert_uint_eq(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(completed.length, 1000);
+    ck_assert(memcmp(completed.data, data, 1000) == 0);
+    ck_assert_ptr_eq(messages.data, &data[1000]);
+    ck_assert_uint_eq(messages.length, 100);
+    ck_assert_uint_eq(connection.incompleteMessage.length, 0);
+    UA_ByteString_deleteMembers(&completed);
+}
+END_TEST
+
+START_TEST(Connection_keepIncompleteTail) {
+    UA_Byte data[300];
+    writeMessage(data, 100, 1);
+    writeMessage(&data[100], 200, 2);
+    UA_ByteString completed, messages;
+
+    UA_ByteString buffer = {150, data};
+    ck_assert_uint_eq(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(messages.data, data);
+    ck_assert_uint_eq(messages.length, 100);
+    ck_assert_uint_eq(connection.incompleteMessage.length, 50);
+
+    buffer = (UA_ByteString){150, &data[150]};
+    ck_assert_uint_eq(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(completed.length, 200);
+    ck_assert(memcmp(completed.data, &data[100], 200) == 0);
+    ck_assert_uint_eq(messages.length, 0);
+    UA_ByteString_deleteMembers(&completed);
+}
+END_TEST
+
+START_TEST(Connection_dropGarbage) {
+    UA_Byte data[200];
+    writeMessage(data, 100, 1);
+    memset(&data[100], 'x', 100);
+    UA_ByteString buffer = {200, data};
+    UA_ByteString completed, messages;
+    ck_assert_uint_eq(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(messages.length, 100);
+    ck_assert_uint_eq(connection.incompleteMessage.length, 0);
+
+    /* an incomplete header that turns out to be garbage */
+    buffer = (UA_ByteString){4, data};
+    ck_assert_uint_eq(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    buffer = (UA_ByteString){100, &data[100]};
+    ck_assert_uint_ne(UA_Connection_completeMessages(&connection, &buffer, &completed, &messages),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(completed.length, 0);
+    ck_assert_uint_eq(messages.length, 0);
+    ck_assert_uint_eq(connection.incompleteMessage.length, 0);
+}
+END_TEST
+
+static Suite *testSuite_connection(void) {
+    Suite *s = suite_create("Connection");
+    TCase *tc = tcase_create("Complete Messages");
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, Connection_completeMessagesInPlace);
+    tcase_add_test(tc, Connection_completeStraddlingMessage);
+    tcase_add_test(tc, Connection_keepIncompleteTail);
+    tcase_add_test(tc, Connection_dropGarbage);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_connection();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
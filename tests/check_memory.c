@@ -1,6 +1,7 @@
 #define _XOPEN_SOURCE 500
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "ua_types.h"
 #include "ua_types_generated.h"
@@ -212,6 +213,68 @@ START_TEST(calcSizeBinaryShallBeCorrect) {
 }
 END_TEST
 
+#ifdef UA_REQUEST_ARENA
+START_TEST(arenaShallServeDecodedTypes) {
+    void *obj = UA_new(&UA_TYPES[_i]);
+    size_t size = UA_calcSizeBinary(obj, &UA_TYPES[_i]);
+    UA_ByteString msg;
+    UA_ByteString_allocBuffer(&msg, size);
+    size_t pos = 0;
+    UA_StatusCode retval = UA_encodeBinary(obj, &UA_TYPES[_i], &msg, &pos);
+    UA_delete(obj, &UA_TYPES[_i]);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(&msg);
+        return;
+    }
+
+    /* decode in the arena, deleting is a no-op */
+    UA_Arena_begin();
+    obj = UA_new(&UA_TYPES[_i]);
+    pos = 0;
+    ck_assert_int_eq(UA_decodeBinary(&msg, &pos, obj, &UA_TYPES[_i]), UA_STATUSCODE_GOOD);
+    UA_delete(obj, &UA_TYPES[_i]);
+    UA_Arena_end();
+    UA_Arena_reset();
+    UA_ByteString_deleteMembers(&msg);
+}
+END_TEST
+
+START_TEST(arenaReallocShallKeepContent) {
+    UA_Arena_begin();
+    UA_Byte *p = UA_malloc(10);
+    memset(p, 'a', 10);
+    /* the last allocation grows in place */
+    UA_Byte *p2 = UA_realloc(p, 100);
+    ck_assert_ptr_eq(p, p2);
+    UA_Byte *q = UA_malloc(10);
+    UA_Byte *p3 = UA_realloc(p2, 200000);
+    ck_assert_ptr_ne(p3, NULL);
+    ck_assert_ptr_ne(p3, p2);
+    for(size_t i = 0; i < 10; i++)
+        ck_assert_int_eq(p3[i], 'a');
+    UA_free(q);
+    UA_free(p3);
+    UA_Arena_end();
+
+    /* memory from the heap is not taken by the arena */
+    UA_Byte *h = UA_malloc(10);
+    UA_Arena_begin();
+    h = UA_realloc(h, 20);
+    UA_free(h);
+    UA_Arena_end();
+    UA_Arena_reset();
+
+    /* without an active arena, realloc uses the heap */
+    h = UA_realloc(NULL, 10);
+    ck_assert_ptr_ne(h, NULL);
+    h = UA_realloc(h, 200000);
+    ck_assert_ptr_ne(h, NULL);
+    UA_free(h);
+    UA_Arena_deleteMembers();
+}
+END_TEST
+#endif
+
 int main(void) {
 	int number_failed = 0;
 	SRunner *sr;
@@ -235,6 +298,13 @@ int main(void) {
 	tcase_add_loop_test(tc, calcSizeBinaryShallBeCorrect, UA_TYPES_BOOLEAN, UA_TYPES_COUNT - 1);
 	suite_add_tcase(s, tc);
 
+#ifdef UA_REQUEST_ARENA
+	tc = tcase_create("Request Arena");
+	tcase_add_loop_test(tc, arenaShallServeDecodedTypes, UA_TYPES_BOOLEAN, UA_TYPES_COUNT - 1);
+	tcase_add_test(tc, arenaReallocShallKeepContent);
+	suite_add_tcase(s, tc);
+#endif
+
 	sr = srunner_create(s);
 	srunner_set_fork_status(sr, CK_NOFORK);
 	srunner_run_all (sr, CK_NORMAL);
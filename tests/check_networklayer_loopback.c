@@ -0,0 +1,251 @@
+#define _XOPEN_SOURCE 500 // usleep
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ua_server.h"
+#include "ua_client.h"
+#include "ua_client_highlevel.h"
+#include "networklayer_loopback.h"
+#include "logger_stdout.h"
+#include "check.h"
+#include "testing_serverlayer.h"
+
+#define TESTNAME "check_networklayer_loopback"
+#define TESTURL "opc.loopback://" TESTNAME
+#define CLIENTS 4
+#define READS 200
+
+START_TEST(Server_messagesAreNotCopied) {
+    setupLayer(UA_ServerNetworkLayerLoopback(UA_ConnectionConfig_standard, TESTNAME));
+    UA_Connection c = UA_ClientConnectionLoopback(UA_ConnectionConfig_standard, TESTURL, Logger_Stdout);
+    ck_assert_int_eq(c.state, UA_CONNECTION_OPENING);
+
+    UA_ByteString buf;
+    ck_assert_uint_eq(c.getSendBuffer(&c, 1000, &buf), UA_STATUSCODE_GOOD);
+    memset(buf.data, 'a', buf.length);
+    UA_Byte *sent = buf.data;
+    ck_assert_uint_eq(c.send(&c, &buf), UA_STATUSCODE_GOOD);
+
+    UA_Job *jobs;
+    size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+    ck_assert_uint_eq(jobsSize, 1);
+    ck_assert_int_eq(jobs[0].type, UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER);
+    ck_assert_ptr_eq(jobs[0].job.binaryMessage.message.data, sent);
+    ck_assert_uint_eq(jobs[0].job.binaryMessage.message.length, 1000);
+
+    /* reply with the same buffer size */
+    UA_Connection *server = jobs[0].job.binaryMessage.connection;
+    ck_assert_uint_eq(server->getSendBuffer(server, 500, &buf), UA_STATUSCODE_GOOD);
+    memset(buf.data, 'b', buf.length);
+    sent = buf.data;
+    ck_assert_uint_eq(server->send(server, &buf), UA_STATUSCODE_GOOD);
+    processJobs(jobs, jobsSize);
+
+    UA_ByteString reply = UA_BYTESTRING_NULL;
+    ck_assert_uint_eq(c.recv(&c, &reply, 1000), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(reply.data, sent);
+    ck_assert_uint_eq(reply.length, 500);
+    c.releaseRecvBuffer(&c, &reply);
+
+    /* the server detaches the connection once the client has closed it */
+    c.close(&c);
+    jobsSize = nl.getJobs(&nl, &jobs, 10000);
+    ck_assert_uint_eq(jobsSize, 2);
+    ck_assert_int_eq(jobs[0].type, UA_JOBTYPE_DETACHCONNECTION);
+    ck_assert_ptr_eq(jobs[0].job.closeConnection, server);
+    processJobs(jobs, jobsSize);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_closeWakesClient) {
+    setupLayer(UA_ServerNetworkLayerLoopback(UA_ConnectionConfig_standard, TESTNAME));
+    UA_Connection c = UA_ClientConnectionLoopback(UA_ConnectionConfig_standard, TESTURL, Logger_Stdout);
+    ck_assert_int_eq(c.state, UA_CONNECTION_OPENING);
+    UA_ByteString buf;
+    ck_assert_uint_eq(c.getSendBuffer(&c, 10, &buf), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(c.send(&c, &buf), UA_STATUSCODE_GOOD);
+
+    UA_Job *jobs;
+    size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+    ck_assert_uint_eq(jobsSize, 1);
+    UA_Connection *server = jobs[0].job.binaryMessage.connection;
+    server->close(server);
+    processJobs(jobs, jobsSize);
+
+    UA_ByteString reply = UA_BYTESTRING_NULL;
+    ck_assert_uint_eq(c.recv(&c, &reply, 0), UA_STATUSCODE_BADCONNECTIONCLOSED);
+    ck_assert_int_eq(c.state, UA_CONNECTION_CLOSED);
+
+    jobsSize = nl.getJobs(&nl, &jobs, 0);
+    ck_assert_uint_eq(jobsSize, 2);
+    ck_assert_int_eq(jobs[0].type, UA_JOBTYPE_DETACHCONNECTION);
+    processJobs(jobs, jobsSize);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_stopWithOpenClient) {
+    setupLayer(UA_ServerNetworkLayerLoopback(UA_ConnectionConfig_standard, TESTNAME));
+    UA_Connection c = UA_ClientConnectionLoopback(UA_ConnectionConfig_standard, TESTURL, Logger_Stdout);
+    ck_assert_int_eq(c.state, UA_CONNECTION_OPENING);
+    teardownLayer();
+    UA_ByteString buf;
+    ck_assert_uint_eq(c.getSendBuffer(&c, 10, &buf), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(c.send(&c, &buf), UA_STATUSCODE_BADCONNECTIONCLOSED);
+    c.close(&c);
+
+    /* the name is free again */
+    c = UA_ClientConnectionLoopback(UA_ConnectionConfig_standard, TESTURL, Logger_Stdout);
+    ck_assert_int_eq(c.state, UA_CONNECTION_CLOSED);
+}
+END_TEST
+
+static volatile UA_Boolean running;
+
+static void *
+serverLoop(void *data) {
+    UA_Server_run(data, &running);
+    return NULL;
+}
+
+static void *
+clientLoop(void *data) {
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard, Logger_Stdout);
+    UA_StatusCode retval = UA_Client_connect(client, UA_ClientConnectionLoopback, TESTURL);
+    for(size_t i = 0; i < READS && retval == UA_STATUSCODE_GOOD; i++) {
+        UA_Variant value;
+        UA_Variant_init(&value);
+        retval = UA_Client_readValueAttribute(client, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                                              &value);
+        if(retval == UA_STATUSCODE_GOOD && !UA_Variant_isScalar(&value))
+            retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        UA_Variant_deleteMembers(&value);
+    }
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    *(UA_StatusCode*)data = retval;
+    return NULL;
+}
+
+static UA_Server *server;
+static pthread_t serverThread;
+
+static void
+startServer(void) {
+    nl = UA_ServerNetworkLayerLoopback(UA_ConnectionConfig_standard, TESTNAME);
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.logger = Logger_Stdout;
+    config.networkLayers = &nl;
+    config.networkLayersSize = 1;
+    server = UA_Server_new(config);
+    running = true;
+    ck_assert_int_eq(pthread_create(&serverThread, NULL, serverLoop, server), 0);
+
+    /* wait until the server has started the networklayer */
+    UA_Boolean started = false;
+    for(size_t i = 0; i < 5000 && !started; i++) {
+        UA_Connection probe = UA_ClientConnectionLoopback(UA_ConnectionConfig_standard, TESTURL, Logger_Stdout);
+        started = (probe.state == UA_CONNECTION_OPENING);
+        if(started)
+            probe.close(&probe);
+        else
+            usleep(1000);
+    }
+    ck_assert(started);
+}
+
+static void
+stopServer(void) {
+    running = false;
+    pthread_join(serverThread, NULL);
+    UA_Server_delete(server);
+    nl.deleteMembers(&nl);
+}
+
+START_TEST(Server_concurrentClients) {
+    startServer();
+    pthread_t clientThreads[CLIENTS];
+    UA_StatusCode results[CLIENTS];
+    for(size_t i = 0; i < CLIENTS; i++)
+        ck_assert_int_eq(pthread_create(&clientThreads[i], NULL, clientLoop, &results[i]), 0);
+    for(size_t i = 0; i < CLIENTS; i++) {
+        pthread_join(clientThreads[i], NULL);
+        ck_assert_uint_eq(results[i], UA_STATUSCODE_GOOD);
+    }
+    stopServer();
+}
+END_TEST
+
+#define LARGEARRAY 200000
+
+/* The response is larger than the receive buffer and arrives in chunks */
+START_TEST(Server_largeResponse) {
+    startServer();
+    UA_Double *values = malloc(LARGEARRAY * sizeof(UA_Double));
+    for(size_t i = 0; i < LARGEARRAY; i++)
+        values[i] = (UA_Double)i;
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Variant_setArray(&attr.value, values, LARGEARRAY, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "large.array");
+    ck_assert_uint_eq(UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                UA_QUALIFIEDNAME(1, "large.array"), UA_NODEID_NULL,
+                                                attr, NULL, NULL), UA_STATUSCODE_GOOD);
+
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard, Logger_Stdout);
+    ck_assert_uint_eq(UA_Client_connect(client, UA_ClientConnectionLoopback, TESTURL), UA_STATUSCODE_GOOD);
+    UA_ReadValueId item;
+    UA_ReadValueId_init(&item);
+    item.nodeId = nodeId;
+    item.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = &item;
+    request.nodesToReadSize = 1;
+    UA_ReadResponse response = UA_Client_Service_read(client, request);
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert(response.results[0].hasValue);
+    ck_assert_uint_eq(response.results[0].value.arrayLength, LARGEARRAY);
+    ck_assert(memcmp(response.results[0].value.data, values, LARGEARRAY * sizeof(UA_Double)) == 0);
+    UA_ReadResponse_deleteMembers(&response);
+
+    /* the client still works after the chunked response */
+    UA_Variant value;
+    ck_assert_uint_eq(UA_Client_readValueAttribute(client, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                                                   &value), UA_STATUSCODE_GOOD);
+    UA_Variant_deleteMembers(&value);
+    ck_assert_uint_eq(UA_Client_disconnect(client), UA_STATUSCODE_GOOD);
+    UA_Client_delete(client);
+    UA_Variant_deleteMembers(&attr.value);
+    stopServer();
+}
+END_TEST
+
+static Suite *testSuite_networklayer_loopback(void) {
+    Suite *s = suite_create("Loopback Networklayer");
+    TCase *tc_server = tcase_create("Server");
+    tcase_add_test(tc_server, Server_messagesAreNotCopied);
+    tcase_add_test(tc_server, Server_closeWakesClient);
+    tcase_add_test(tc_server, Server_stopWithOpenClient);
+    tcase_add_test(tc_server, Server_concurrentClients);
+    tcase_add_test(tc_server, Server_largeResponse);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_networklayer_loopback();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,427 @@
+#define _XOPEN_SOURCE 500 // usleep
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "ua_server.h"
+#include "ua_securechannel.h"
+#include "networklayer_tcp.h"
+#include "logger_stdout.h"
+#include "check.h"
+#include "testing_serverlayer.h"
+
+#define TESTPORT 16668
+
+START_TEST(Server_receiveAndSend) {
+    setupLayer(UA_ServerNetworkLayerTCP(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    UA_Byte counter = 0;
+    ck_assert_uint_eq(sendPattern(c, 1000, &counter), UA_STATUSCODE_GOOD);
+    UA_Byte reply[1000];
+    size_t received = 0;
+    while(received < sizeof(reply)) {
+        ssize_t n = recv(fd, &reply[received], sizeof(reply) - received, 0);
+        ck_assert_int_gt(n, 0);
+        received += (size_t)n;
+    }
+    for(size_t i = 0; i < sizeof(reply); i++)
+        ck_assert_uint_eq(reply[i], (UA_Byte)i);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_queueUntilWritable) {
+    setupLayer(UA_ServerNetworkLayerTCP(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    /* the client does not read. send more than the socket buffers can hold. */
+    UA_Byte counter = 0;
+    size_t total = 0;
+    for(size_t i = 0; i < 12; i++) {
+        ck_assert_uint_eq(sendPattern(c, 65536, &counter), UA_STATUSCODE_GOOD);
+        total += 65536;
+    }
+
+    /* read everything while the networklayer flushes the queue */
+    UA_Byte buf[65536];
+    UA_Byte expected = 0;
+    size_t received = 0;
+    while(received < total) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 1000);
+        processJobs(jobs, jobsSize);
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if(n <= 0)
+            continue;
+        for(ssize_t i = 0; i < n; i++)
+            ck_assert_uint_eq(buf[i], expected++);
+        received += (size_t)n;
+    }
+    ck_assert_uint_eq(received, total);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_closeWhenQueueLimitExceeded) {
+    UA_ServerNetworkLayerTCPConfig tcpConf = UA_ServerNetworkLayerTCPConfig_standard;
+    tcpConf.maxSendQueueSize = 65536;
+    setupLayer(UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    /* the client does not read. the socket buffers fill up, then the queue */
+    UA_Byte counter = 0;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < 10000 && retval == UA_STATUSCODE_GOOD; i++)
+        retval = sendPattern(c, 65536, &counter);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADCONNECTIONCLOSED);
+    ck_assert_int_eq(c->state, UA_CONNECTION_CLOSED);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_coalesceSends) {
+    UA_ServerNetworkLayerTCPConfig tcpConf = UA_ServerNetworkLayerTCPConfig_standard;
+    tcpConf.coalesceSends = true;
+    setupLayer(UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    /* less than one gather write. nothing is sent before the next
+       iteration. */
+    UA_Byte counter = 0;
+    for(size_t i = 0; i < 50; i++)
+        ck_assert_uint_eq(sendPattern(c, 1000, &counter), UA_STATUSCODE_GOOD);
+    UA_Byte buf[65536];
+    ck_assert_int_lt(recv(fd, buf, sizeof(buf), MSG_DONTWAIT), 0);
+
+    UA_Byte expected = 0;
+    size_t received = 0;
+    while(received < 50 * 1000) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 1000);
+        processJobs(jobs, jobsSize);
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if(n <= 0)
+            continue;
+        for(ssize_t i = 0; i < n; i++)
+            ck_assert_uint_eq(buf[i], expected++);
+        received += (size_t)n;
+    }
+    ck_assert_uint_eq(received, 50 * 1000);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_coalesceLargeResponse) {
+    UA_ServerNetworkLayerTCPConfig tcpConf = UA_ServerNetworkLayerTCPConfig_standard;
+    tcpConf.coalesceSends = true;
+    tcpConf.maxSendQueueSize = 65536;
+    setupLayer(UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    /* the chunks of a response beyond the queue limit are written as they are
+       sent and do not close the connection */
+    UA_Byte counter = 0;
+    UA_Byte expected = 0;
+    size_t received = 0;
+    UA_Byte buf[65536];
+    for(size_t i = 0; i < 128; i++) {
+        ck_assert_uint_eq(sendPattern(c, 16384, &counter), UA_STATUSCODE_GOOD);
+        ssize_t n;
+        while((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            for(ssize_t j = 0; j < n; j++)
+                ck_assert_uint_eq(buf[j], expected++);
+            received += (size_t)n;
+        }
+    }
+    ck_assert_uint_gt(received, 0);
+
+    while(received < 128 * 16384) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 1000);
+        processJobs(jobs, jobsSize);
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if(n <= 0)
+            continue;
+        for(ssize_t j = 0; j < n; j++)
+            ck_assert_uint_eq(buf[j], expected++);
+        received += (size_t)n;
+    }
+    ck_assert_uint_eq(received, 128 * 16384);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+/* Reads the chunks of a message from the client socket in small pieces */
+typedef struct {
+    int fd;
+    unsigned int delay; /* microseconds between the reads */
+    size_t chunks;
+    UA_Byte lastChunkType;
+    volatile UA_Boolean done;
+} ChunkReader;
+
+static UA_Boolean
+readFull(ChunkReader *r, UA_Byte *buf, size_t length) {
+    size_t received = 0;
+    while(received < length) {
+        size_t piece = length - received;
+        if(piece > 4096)
+            piece = 4096;
+        ssize_t n = recv(r->fd, &buf[received], piece, 0);
+        if(n <= 0)
+            return false;
+        received += (size_t)n;
+        if(r->delay > 0)
+            usleep(r->delay);
+    }
+    return true;
+}
+
+static void *
+readChunks(void *data) {
+    ChunkReader *r = data;
+    UA_Byte buf[65536];
+    while(readFull(r, buf, 8)) {
+        size_t length = (size_t)buf[4] | (size_t)buf[5] << 8 |
+            (size_t)buf[6] << 16 | (size_t)buf[7] << 24;
+        if(length < 8 || length > sizeof(buf) || !readFull(r, &buf[8], length - 8))
+            break;
+        r->chunks++;
+        r->lastChunkType = buf[3];
+        if(r->lastChunkType != 'C')
+            break;
+    }
+    r->done = true;
+    return NULL;
+}
+
+#define VALUES 250000
+
+/* Sends a ReadResponse of several MiB in chunks of 8 KiB over the server-side
+   connection. The socket buffers are kept small so that the client holds back
+   the server. */
+static UA_StatusCode
+sendLargeResponse(UA_Connection *c, int fd) {
+    int bufsize = 65536;
+    setsockopt(c->sockfd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    channel.securityToken.channelId = 1;
+    channel.securityToken.tokenId = 1;
+    UA_Connection_attachSecureChannel(c, &channel);
+    c->remoteConf.recvBufferSize = 8192;
+    c->remoteConf.maxMessageSize = 0;
+    c->remoteConf.maxChunkCount = 0;
+
+    UA_DataValue dv;
+    UA_DataValue_init(&dv);
+    dv.hasValue = true;
+    UA_Double *values = UA_Array_new(VALUES, &UA_TYPES[UA_TYPES_DOUBLE]);
+    for(size_t i = 0; i < VALUES; i++)
+        values[i] = (UA_Double)i;
+    UA_Variant_setArray(&dv.value, values, VALUES, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_ReadResponse response;
+    UA_ReadResponse_init(&response);
+    response.results = &dv;
+    response.resultsSize = 1;
+    UA_StatusCode retval = UA_SecureChannel_sendBinaryMessage(&channel, 7, &response,
+                                                              &UA_TYPES[UA_TYPES_READRESPONSE]);
+    UA_DataValue_deleteMembers(&dv);
+    UA_Connection_detachSecureChannel(c);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+    return retval;
+}
+
+START_TEST(Server_waitForSlowReader) {
+    UA_ServerNetworkLayerTCPConfig tcpConf = UA_ServerNetworkLayerTCPConfig_standard;
+    tcpConf.maxSendQueueSize = 65536;
+    setupLayer(UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    /* the response is much larger than the queue limit. the encoding waits
+       for the client instead of closing the connection. */
+    ChunkReader r = {fd, 100, 0, 0, false};
+    pthread_t reader;
+    pthread_create(&reader, NULL, readChunks, &r);
+    ck_assert_uint_eq(sendLargeResponse(c, fd), UA_STATUSCODE_GOOD);
+    ck_assert_int_ne(c->state, UA_CONNECTION_CLOSED);
+    while(!r.done) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 1000);
+        processJobs(jobs, jobsSize);
+    }
+    pthread_join(reader, NULL);
+    ck_assert_int_eq(r.lastChunkType, 'F');
+    ck_assert_uint_gt(r.chunks, VALUES * sizeof(UA_Double) / 8192);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_abortWhenNotRead) {
+    UA_ServerNetworkLayerTCPConfig tcpConf = UA_ServerNetworkLayerTCPConfig_standard;
+    tcpConf.maxSendQueueSize = 65536;
+    tcpConf.sendTimeout = 100;
+    setupLayer(UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    /* the client does not read. the response is aborted after the send
+       timeout and the connection stays open. */
+    ck_assert_uint_eq(sendLargeResponse(c, fd), UA_STATUSCODE_GOOD);
+    ck_assert_int_ne(c->state, UA_CONNECTION_CLOSED);
+    ChunkReader r = {fd, 0, 0, 0, false};
+    pthread_t reader;
+    pthread_create(&reader, NULL, readChunks, &r);
+    while(!r.done) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 1000);
+        processJobs(jobs, jobsSize);
+    }
+    pthread_join(reader, NULL);
+    ck_assert_int_eq(r.lastChunkType, 'A');
+    ck_assert_uint_lt(r.chunks, VALUES * sizeof(UA_Double) / 8192);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_shareListeningPort) {
+    UA_ServerNetworkLayerTCPConfig tcpConf = UA_ServerNetworkLayerTCPConfig_standard;
+    tcpConf.reusePort = true;
+    setupLayer(UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf));
+    UA_ServerNetworkLayer nl2 =
+        UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf);
+    ck_assert_uint_eq(nl2.start(&nl2, Logger_Stdout), UA_STATUSCODE_GOOD);
+
+    /* every connection is accepted by one of the two layers */
+    int fd = connectClient(TESTPORT);
+    ck_assert_int_eq(send(fd, "ping", 4, 0), 4);
+    size_t received = 0;
+    for(size_t i = 0; i < 100 && received < 4; i++) {
+        UA_ServerNetworkLayer *layers[2] = {&nl, &nl2};
+        for(size_t k = 0; k < 2; k++) {
+            UA_Job *jobs;
+            size_t jobsSize = layers[k]->getJobs(layers[k], &jobs, 10000);
+            for(size_t j = 0; j < jobsSize; j++) {
+                if(jobs[j].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
+                    received += jobs[j].job.binaryMessage.message.length;
+            }
+            processJobs(jobs, jobsSize);
+        }
+    }
+    ck_assert_uint_eq(received, 4);
+
+    close(fd);
+    UA_Job *jobs;
+    size_t jobsSize = nl2.stop(&nl2, &jobs);
+    processJobs(jobs, jobsSize);
+    nl2.deleteMembers(&nl2);
+    teardownLayer();
+}
+END_TEST
+
+/* stops the layer and returns the number of connections that were open */
+static size_t
+teardownLayerCountConnections(void) {
+    UA_Job *jobs;
+    size_t jobsSize = nl.stop(&nl, &jobs);
+    size_t connections = 0;
+    for(size_t i = 0; i < jobsSize; i++) {
+        if(jobs[i].type == UA_JOBTYPE_DETACHCONNECTION)
+            connections++;
+    }
+    processJobs(jobs, jobsSize);
+    nl.deleteMembers(&nl);
+    return connections;
+}
+
+START_TEST(Server_acceptAllPending) {
+    UA_ServerNetworkLayerTCPConfig tcpConf = UA_ServerNetworkLayerTCPConfig_standard;
+    tcpConf.listenBacklog = 256;
+    setupLayer(UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf));
+
+    /* the connections wait in the backlog. a single iteration takes them all. */
+    int fds[200];
+    for(size_t i = 0; i < 200; i++)
+        fds[i] = connectClient(TESTPORT);
+    UA_Job *jobs;
+    size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+    processJobs(jobs, jobsSize);
+    ck_assert_uint_eq(teardownLayerCountConnections(), 200);
+
+    for(size_t i = 0; i < 200; i++)
+        close(fds[i]);
+}
+END_TEST
+
+START_TEST(Server_limitAcceptRate) {
+    UA_ServerNetworkLayerTCPConfig tcpConf = UA_ServerNetworkLayerTCPConfig_standard;
+    tcpConf.maxAcceptRate = 10;
+    setupLayer(UA_ServerNetworkLayerTCPWithConfig(UA_ConnectionConfig_standard, TESTPORT, &tcpConf));
+
+    int fds[50];
+    for(size_t i = 0; i < 50; i++)
+        fds[i] = connectClient(TESTPORT);
+    UA_Job *jobs;
+    size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+    processJobs(jobs, jobsSize);
+    jobsSize = nl.getJobs(&nl, &jobs, 10000);
+    processJobs(jobs, jobsSize);
+    ck_assert_uint_eq(teardownLayerCountConnections(), 10);
+
+    for(size_t i = 0; i < 50; i++)
+        close(fds[i]);
+}
+END_TEST
+
+static Suite *testSuite_networklayer_tcp(void) {
+    Suite *s = suite_create("TCP Networklayer");
+    TCase *tc_server = tcase_create("Server");
+    tcase_add_test(tc_server, Server_receiveAndSend);
+    tcase_add_test(tc_server, Server_queueUntilWritable);
+    tcase_add_test(tc_server, Server_closeWhenQueueLimitExceeded);
+    tcase_add_test(tc_server, Server_coalesceSends);
+    tcase_add_test(tc_server, Server_coalesceLargeResponse);
+    tcase_add_test(tc_server, Server_waitForSlowReader);
+    tcase_add_test(tc_server, Server_abortWhenNotRead);
+    tcase_add_test(tc_server, Server_shareListeningPort);
+    tcase_add_test(tc_server, Server_acceptAllPending);
+    tcase_add_test(tc_server, Server_limitAcceptRate);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_networklayer_tcp();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ua_server.h"
+#include "networklayer_udp.h"
+#include "logger_stdout.h"
+#include "check.h"
+#include "testing_serverlayer.h"
+
+#define TESTPORT 16670
+
+static int
+openClient(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ck_assert_int_ge(fd, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TESTPORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ck_assert_int_eq(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    return fd;
+}
+
+/* Collects the connections of the next count datagrams. The jobs are processed
+   right away, the connections stay alive in the networklayer. */
+static void
+receiveDatagrams(UA_Connection **connections, size_t count) {
+    size_t received = 0;
+    for(size_t i = 0; i < 100 && received < count; i++) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+        for(size_t j = 0; j < jobsSize; j++) {
+            if(jobs[j].type != UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
+                continue;
+            ck_assert_uint_eq(jobs[j].job.binaryMessage.message.length, 4);
+            connections[received++] = jobs[j].job.binaryMessage.connection;
+        }
+        processJobs(jobs, jobsSize);
+    }
+    ck_assert_uint_eq(received, count);
+}
+
+START_TEST(Server_reuseConnectionOfPeer) {
+    setupLayer(UA_ServerNetworkLayerUDP(UA_ConnectionConfig_standard, TESTPORT));
+    int fd1 = openClient();
+    int fd2 = openClient();
+
+    UA_Connection *c[4];
+    ck_assert_int_eq(send(fd1, "ping", 4, 0), 4);
+    ck_assert_int_eq(send(fd1, "ping", 4, 0), 4);
+    receiveDatagrams(c, 2);
+    ck_assert_int_eq(send(fd2, "ping", 4, 0), 4);
+    receiveDatagrams(&c[2], 1);
+    ck_assert_int_eq(send(fd1, "ping", 4, 0), 4);
+    receiveDatagrams(&c[3], 1);
+    ck_assert_ptr_eq(c[0], c[1]);
+    ck_assert_ptr_ne(c[0], c[2]);
+    ck_assert_ptr_eq(c[0], c[3]);
+
+    close(fd1);
+    close(fd2);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_replaceClosedConnection) {
+    setupLayer(UA_ServerNetworkLayerUDP(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = openClient();
+
+    UA_Connection *c[2];
+    ck_assert_int_eq(send(fd, "ping", 4, 0), 4);
+    receiveDatagrams(c, 1);
+    c[0]->close(c[0]);
+
+    /* the closed connection is detached and a new one created */
+    ck_assert_int_eq(send(fd, "ping", 4, 0), 4);
+    UA_Boolean detached = false;
+    UA_Job *jobs;
+    size_t jobsSize = 0;
+    for(size_t i = 0; i < 100 && jobsSize == 0; i++)
+        jobsSize = nl.getJobs(&nl, &jobs, 10000);
+    for(size_t j = 0; j < jobsSize; j++) {
+        if(jobs[j].type == UA_JOBTYPE_DETACHCONNECTION) {
+            ck_assert_ptr_eq(jobs[j].job.closeConnection, c[0]);
+            detached = true;
+        }
+        if(jobs[j].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
+            ck_assert_ptr_ne(jobs[j].job.binaryMessage.connection, c[0]);
+    }
+    ck_assert(detached);
+    processJobs(jobs, jobsSize);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_batchReplies) {
+    setupLayer(UA_ServerNetworkLayerUDP(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = openClient();
+
+    UA_Connection *c;
+    ck_assert_int_eq(send(fd, "ping", 4, 0), 4);
+    receiveDatagrams(&c, 1);
+
+    /* more replies than fit into one batch. the rest goes out in getJobs. */
+    for(UA_Byte i = 0; i < 100; i++) {
+        UA_ByteString buf;
+        ck_assert_uint_eq(c->getSendBuffer(c, 1, &buf), UA_STATUSCODE_GOOD);
+        buf.data[0] = i;
+        ck_assert_uint_eq(c->send(c, &buf), UA_STATUSCODE_GOOD);
+    }
+    UA_Job *jobs;
+    size_t jobsSize = nl.getJobs(&nl, &jobs, 0);
+    processJobs(jobs, jobsSize);
+
+    for(UA_Byte i = 0; i < 100; i++) {
+        UA_Byte reply[16];
+        ck_assert_int_eq(recv(fd, reply, sizeof(reply), 0), 1);
+        ck_assert_uint_eq(reply[0], i);
+    }
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_moreDatagramsThanBuffers) {
+    setupLayer(UA_ServerNetworkLayerUDP(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = openClient();
+
+    /* hold on to the received buffers. the remaining datagrams wait in the
+       socket until buffers are released. */
+    UA_Job *held[100];
+    size_t heldSize[100];
+    size_t rounds = 0;
+    size_t received = 0;
+    for(size_t i = 0; i < 100; i++) {
+        ck_assert_int_eq(send(fd, "ping", 4, 0), 4);
+        heldSize[rounds] = nl.getJobs(&nl, &held[rounds], 1000);
+        for(size_t j = 0; j < heldSize[rounds]; j++) {
+            if(held[rounds][j].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
+                received++;
+        }
+        rounds++;
+    }
+    ck_assert_uint_lt(received, 100);
+    for(size_t i = 0; i < rounds; i++)
+        processJobs(held[i], heldSize[i]);
+
+    UA_Connection *c[100];
+    receiveDatagrams(c, 100 - received);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+static Suite *testSuite_networklayer_udp(void) {
+    Suite *s = suite_create("UDP Networklayer");
+    TCase *tc_server = tcase_create("Server");
+    tcase_add_test(tc_server, Server_reuseConnectionOfPeer);
+    tcase_add_test(tc_server, Server_replaceClosedConnection);
+    tcase_add_test(tc_server, Server_batchReplies);
+    tcase_add_test(tc_server, Server_moreDatagramsThanBuffers);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_networklayer_udp();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
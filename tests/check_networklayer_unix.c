@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "ua_server.h"
+#include "networklayer_unix.h"
+#include "logger_stdout.h"
+#include "check.h"
+#include "testing_serverlayer.h"
+
+#define TESTPATH "check_networklayer_unix.sock"
+#define TESTURL "opc.unix://" TESTPATH
+
+/* Echoes everything that arrives until the client has disconnected */
+static void
+echoUntilDetached(void) {
+    UA_Boolean detached = false;
+    for(size_t i = 0; i < 100000 && !detached; i++) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+        for(size_t j = 0; j < jobsSize; j++) {
+            if(jobs[j].type == UA_JOBTYPE_DETACHCONNECTION)
+                detached = true;
+            if(jobs[j].type != UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
+                continue;
+            UA_Connection *c = jobs[j].job.binaryMessage.connection;
+            UA_ByteString *msg = &jobs[j].job.binaryMessage.message;
+            c->remoteConf = c->localConf;
+            UA_ByteString buf;
+            ck_assert_uint_eq(c->getSendBuffer(c, msg->length, &buf), UA_STATUSCODE_GOOD);
+            memcpy(buf.data, msg->data, msg->length);
+            ck_assert_uint_eq(c->send(c, &buf), UA_STATUSCODE_GOOD);
+        }
+        processJobs(jobs, jobsSize);
+    }
+    ck_assert(detached);
+}
+
+static UA_Boolean
+receiveEcho(UA_Connection *c, size_t length, UA_Byte *expected) {
+    size_t received = 0;
+    while(received < length) {
+        UA_ByteString reply = UA_BYTESTRING_NULL;
+        if(c->recv(c, &reply, 5000) != UA_STATUSCODE_GOOD)
+            return false;
+        for(size_t k = 0; k < reply.length; k++) {
+            if(reply.data[k] != (*expected)++)
+                return false;
+        }
+        received += reply.length;
+        c->releaseRecvBuffer(c, &reply);
+    }
+    return true;
+}
+
+/* Runs in a forked process. Sends 40 messages of 64kB (more than the
+ * shared memory rings hold) and checks the echo. Pipelined, all messages are
+ * sent before the echo is read. So the server has to queue the echo. */
+static int
+runClient(UA_Connection (*connectFunc)(UA_ConnectionConfig, const char*, UA_Logger),
+          UA_Boolean expectSharedMemory, UA_Boolean pipelined) {
+    UA_Connection c = connectFunc(UA_ConnectionConfig_standard, TESTURL, Logger_Stdout);
+    if(c.state != UA_CONNECTION_OPENING || (c.handle != NULL) != expectSharedMemory)
+        return EXIT_FAILURE;
+    UA_Byte expected = 0;
+    UA_Byte counter = 0;
+    for(size_t i = 0; i < 40; i++) {
+        UA_ByteString buf;
+        if(UA_ByteString_allocBuffer(&buf, 65536) != UA_STATUSCODE_GOOD)
+            return EXIT_FAILURE;
+        for(size_t k = 0; k < buf.length; k++)
+            buf.data[k] = counter++;
+        if(c.send(&c, &buf) != UA_STATUSCODE_GOOD)
+            return EXIT_FAILURE;
+        if(!pipelined && !receiveEcho(&c, 65536, &expected))
+            return EXIT_FAILURE;
+    }
+    if(pipelined && !receiveEcho(&c, 40 * 65536, &expected))
+        return EXIT_FAILURE;
+    c.close(&c);
+    return EXIT_SUCCESS;
+}
+
+static void
+echoWithClient(UA_Connection (*connectFunc)(UA_ConnectionConfig, const char*, UA_Logger),
+               UA_Boolean expectSharedMemory, UA_Boolean pipelined) {
+    pid_t pid = fork();
+    ck_assert_int_ge(pid, 0);
+    if(pid == 0)
+        _exit(runClient(connectFunc, expectSharedMemory, pipelined));
+    echoUntilDetached();
+    int status;
+    ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+    ck_assert(WIFEXITED(status));
+    ck_assert_int_eq(WEXITSTATUS(status), EXIT_SUCCESS);
+}
+
+START_TEST(Server_echoOverSocket) {
+    setupLayer(UA_ServerNetworkLayerUnix(UA_ConnectionConfig_standard, TESTPATH));
+    echoWithClient(UA_ClientConnectionUnix, false, false);
+    teardownLayer();
+}
+END_TEST
+
+#ifdef __linux__
+START_TEST(Server_echoOverSharedMemory) {
+    setupLayer(UA_ServerNetworkLayerUnix(UA_ConnectionConfig_standard, TESTPATH));
+    echoWithClient(UA_ClientConnectionUnixSharedMemory, true, false);
+    teardownLayer();
+}
+END_TEST
+#endif
+
+START_TEST(Server_queueEchoOverSocket) {
+    UA_ServerNetworkLayerUnixConfig unixConf = UA_ServerNetworkLayerUnixConfig_standard;
+    unixConf.maxSendQueueSize = 4 * 1048576;
+    setupLayer(UA_ServerNetworkLayerUnixWithConfig(UA_ConnectionConfig_standard, TESTPATH, &unixConf));
+    echoWithClient(UA_ClientConnectionUnix, false, true);
+    teardownLayer();
+}
+END_TEST
+
+#ifdef __linux__
+START_TEST(Server_queueEchoOverSharedMemory) {
+    UA_ServerNetworkLayerUnixConfig unixConf = UA_ServerNetworkLayerUnixConfig_standard;
+    unixConf.maxSendQueueSize = 4 * 1048576;
+    setupLayer(UA_ServerNetworkLayerUnixWithConfig(UA_ConnectionConfig_standard, TESTPATH, &unixConf));
+    echoWithClient(UA_ClientConnectionUnixSharedMemory, true, true);
+    teardownLayer();
+}
+END_TEST
+#endif
+
+START_TEST(Server_closeWhenQueueLimitExceeded) {
+    UA_ServerNetworkLayerUnixConfig unixConf = UA_ServerNetworkLayerUnixConfig_standard;
+    unixConf.maxSendQueueSize = 65536;
+    setupLayer(UA_ServerNetworkLayerUnixWithConfig(UA_ConnectionConfig_standard, TESTPATH, &unixConf));
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ck_assert_int_ge(fd, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, TESTPATH);
+    ck_assert_int_eq(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+
+    UA_Connection *c = getConnection(fd);
+    c->remoteConf = c->localConf;
+
+    /* the client does not read. the socket buffers fill up, then the queue */
+    UA_Byte counter = 0;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < 10000 && retval == UA_STATUSCODE_GOOD; i++)
+        retval = sendPattern(c, 65536, &counter);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADCONNECTIONCLOSED);
+    ck_assert_int_eq(c->state, UA_CONNECTION_CLOSED);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_declineSharedMemory) {
+    UA_ServerNetworkLayerUnixConfig unixConf = UA_ServerNetworkLayerUnixConfig_standard;
+    unixConf.allowSharedMemory = false;
+    setupLayer(UA_ServerNetworkLayerUnixWithConfig(UA_ConnectionConfig_standard, TESTPATH, &unixConf));
+    echoWithClient(UA_ClientConnectionUnixSharedMemory, false, false);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_removeSocketFile) {
+    setupLayer(UA_ServerNetworkLayerUnix(UA_ConnectionConfig_standard, TESTPATH));
+    ck_assert_int_eq(access(TESTPATH, F_OK), 0);
+    teardownLayer();
+    ck_assert_int_ne(access(TESTPATH, F_OK), 0);
+}
+END_TEST
+
+static Suite *testSuite_networklayer_unix(void) {
+    Suite *s = suite_create("Unix Domain Socket Networklayer");
+    TCase *tc_server = tcase_create("Server");
+    tcase_add_test(tc_server, Server_echoOverSocket);
+#ifdef __linux__
+    tcase_add_test(tc_server, Server_echoOverSharedMemory);
+#endif
+    tcase_add_test(tc_server, Server_queueEchoOverSocket);
+#ifdef __linux__
+    tcase_add_test(tc_server, Server_queueEchoOverSharedMemory);
+#endif
+    tcase_add_test(tc_server, Server_closeWhenQueueLimitExceeded);
+    tcase_add_test(tc_server, Server_declineSharedMemory);
+    tcase_add_test(tc_server, Server_removeSocketFile);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_networklayer_unix();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "ua_server.h"
+#include "networklayer_uring.h"
+#include "logger_stdout.h"
+#include "check.h"
+#include "testing_serverlayer.h"
+
+#define TESTPORT 16669
+
+/* the sends are submitted in getJobs. read until everything has arrived. */
+static void
+receivePattern(int fd, size_t total) {
+    UA_Byte buf[65536];
+    UA_Byte expected = 0;
+    size_t received = 0;
+    while(received < total) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 1000);
+        processJobs(jobs, jobsSize);
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if(n <= 0)
+            continue;
+        for(ssize_t i = 0; i < n; i++)
+            ck_assert_uint_eq(buf[i], expected++);
+        received += (size_t)n;
+    }
+    ck_assert_uint_eq(received, total);
+}
+
+START_TEST(Server_receiveAndSend) {
+    setupLayer(UA_ServerNetworkLayerIOUring(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    UA_Byte counter = 0;
+    ck_assert_uint_eq(sendPattern(c, 1000, &counter), UA_STATUSCODE_GOOD);
+    receivePattern(fd, 1000);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_sendInOrder) {
+    setupLayer(UA_ServerNetworkLayerIOUring(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = connectClient(TESTPORT);
+    UA_Connection *c = getConnection(fd);
+
+    /* more than the socket buffers can hold. only one send is in flight. */
+    UA_Byte counter = 0;
+    for(size_t i = 0; i < 12; i++)
+        ck_assert_uint_eq(sendPattern(c, 65536, &counter), UA_STATUSCODE_GOOD);
+    receivePattern(fd, 12 * 65536);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_moreMessagesThanBuffers) {
+    setupLayer(UA_ServerNetworkLayerIOUring(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = connectClient(TESTPORT);
+    getConnection(fd);
+
+    /* hold on to the received buffers. the receive is re-armed once they are
+       released. */
+    UA_Job *held[200];
+    size_t heldSize[200];
+    size_t rounds = 0;
+    size_t received = 0;
+    for(size_t i = 0; i < 200; i++) {
+        ck_assert_int_eq(send(fd, "ping", 4, 0), 4);
+        size_t jobsSize = nl.getJobs(&nl, &held[rounds], 10000);
+        heldSize[rounds++] = jobsSize;
+        for(size_t j = 0; j < jobsSize; j++) {
+            if(held[rounds-1][j].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
+                received += held[rounds-1][j].job.binaryMessage.message.length;
+        }
+    }
+    for(size_t i = 0; i < rounds; i++)
+        processJobs(held[i], heldSize[i]);
+    for(size_t i = 0; i < 100 && received < 200 * 4; i++) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+        for(size_t j = 0; j < jobsSize; j++) {
+            if(jobs[j].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
+                received += jobs[j].job.binaryMessage.message.length;
+        }
+        processJobs(jobs, jobsSize);
+    }
+    ck_assert_uint_eq(received, 200 * 4);
+
+    close(fd);
+    teardownLayer();
+}
+END_TEST
+
+START_TEST(Server_detachClosedConnection) {
+    setupLayer(UA_ServerNetworkLayerIOUring(UA_ConnectionConfig_standard, TESTPORT));
+    int fd = connectClient(TESTPORT);
+    getConnection(fd);
+    close(fd);
+
+    UA_Boolean detached = false;
+    for(size_t i = 0; i < 100 && !detached; i++) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+        for(size_t j = 0; j < jobsSize; j++) {
+            if(jobs[j].type == UA_JOBTYPE_DETACHCONNECTION)
+                detached = true;
+        }
+        processJobs(jobs, jobsSize);
+    }
+    ck_assert(detached);
+    teardownLayer();
+}
+END_TEST
+
+static Suite *testSuite_networklayer_uring(void) {
+    Suite *s = suite_create("io_uring Networklayer");
+    TCase *tc_server = tcase_create("Server");
+    tcase_add_test(tc_server, Server_receiveAndSend);
+    tcase_add_test(tc_server, Server_sendInOrder);
+    tcase_add_test(tc_server, Server_moreMessagesThanBuffers);
+    tcase_add_test(tc_server, Server_detachClosedConnection);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_networklayer_uring();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,378 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ua_server.h"
+#include "ua_server_internal.h"
+#include "ua_securechannel.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_types_generated_encoding_binary.h"
+#include "logger_stdout.h"
+#include "testing_networklayers.h"
+#include "check.h"
+
+#define REQUESTHANDLE 42
+#define CHUNKBODY 1000
+
+static UA_Server *server;
+static UA_Connection connection;
+static UA_SecureChannel channel;
+static UA_ByteString request;
+static UA_UInt32 sequenceNumber;
+
+/* The last response */
+static size_t responses;
+static UA_UInt32 responseType;
+static UA_UInt32 responseHandle;
+static UA_StatusCode responseResult;
+static UA_Boolean closed;
+
+static UA_StatusCode
+captureSend(UA_Connection *c, UA_ByteString *buf) {
+    size_t pos = 24;
+    UA_NodeId typeId;
+    UA_ResponseHeader header;
+    ck_assert_uint_eq(UA_NodeId_decodeBinary(buf, &pos, &typeId), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_ResponseHeader_decodeBinary(buf, &pos, &header), UA_STATUSCODE_GOOD);
+    responses++;
+    responseType = typeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY;
+    responseHandle = header.requestHandle;
+    responseResult = header.serviceResult;
+    UA_ResponseHeader_deleteMembers(&header);
+    UA_ByteString_deleteMembers(buf);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+captureClose(UA_Connection *c) {
+    closed = true;
+}
+
+static void
+setup(void) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.logger = Logger_Stdout;
+    config.maxChunkedRequests = 2;
+    config.maxChunkedRequestsBytes = 4 * CHUNKBODY;
+    server = UA_Server_new(config);
+
+    connection = createDummyConnection();
+    connection.send = captureSend;
+    connection.close = captureClose;
+    UA_SecureChannel_init(&channel);
+    channel.securityToken.channelId = 1;
+    channel.securityToken.tokenId = 1;
+    UA_Connection_attachSecureChannel(&connection, &channel);
+
+    /* a request that needs three chunks */
+    UA_GetEndpointsRequest req;
+    UA_GetEndpointsRequest_init(&req);
+    req.requestHeader.requestHandle = REQUESTHANDLE;
+    req.endpointUrl.length = 2 * CHUNKBODY + 100;
+    req.endpointUrl.data = malloc(req.endpointUrl.length);
+    memset(req.endpointUrl.data, 'x', req.endpointUrl.length);
+    UA_NodeId typeId = UA_NODEID_NUMERIC(0, UA_NS0ID_GETENDPOINTSREQUEST + UA_ENCODINGOFFSET_BINARY);
+    UA_ByteString_allocBuffer(&request, 4 * CHUNKBODY);
+    size_t pos = 0;
+    UA_NodeId_encodeBinary(&typeId, &request, &pos);
+    UA_GetEndpointsRequest_encodeBinary(&req, &request, &pos);
+    request.length = pos;
+    UA_GetEndpointsRequest_deleteMembers(&req);
+
+    sequenceNumber = 0;
+    responses = 0;
+    responseType = 0;
+    responseHandle = 0;
+    responseResult = UA_STATUSCODE_GOOD;
+    closed = false;
+}
+
+static void
+teardown(void) {
+    UA_ByteString_deleteMembers(&request);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+    UA_Server_delete(server);
+}
+
+static void
+writeUInt32(UA_Byte *data, UA_UInt32 value) {
+    data[0] = (UA_Byte)value;
+    data[1] = (UA_Byte)(value >> 8);
+    data[2] = (UA_Byte)(value >> 16);
+    data[3] = (UA_Byte)(value >> 24);
+}
+
+static void
+sendChunk(UA_Byte chunkType, UA_UInt32 requestId, const UA_Byte *body, size_t length) {
+    UA_ByteString msg;
+    UA_ByteString_allocBuffer(&msg, 24 + length);
+    memcpy(msg.data, "MSG", 3);
+    msg.data[3] = chunkType;
+    writeUInt32(&msg.data[4], (UA_UInt32)msg.length);
+    writeUInt32(&msg.data[8], channel.securityToken.channelId);
+    writeUInt32(&msg.data[12], channel.securityToken.tokenId);
+    writeUInt32(&msg.data[16], ++sequenceNumber);
+    writeUInt32(&msg.data[20], requestId);
+    memcpy(&msg.data[24], body, length);
+    UA_Server_processBinaryMessage(server, &connection, &msg);
+    UA_ByteString_deleteMembers(&msg);
+}
+
+/* Sends the chunk with the given index of the request */
+static void
+sendRequestChunk(UA_UInt32 requestId, size_t index) {
+    size_t offset = index * CHUNKBODY;
+    size_t length = request.length - offset;
+    UA_Byte chunkType = 'F';
+    if(length > CHUNKBODY) {
+        length = CHUNKBODY;
+        chunkType = 'C';
+    }
+    sendChunk(chunkType, requestId, &request.data[offset], length);
+}
+
+START_TEST(Chunks_reassemble) {
+    sendRequestChunk(1, 0);
+    sendRequestChunk(1, 1);
+    ck_assert_uint_eq(channel.chunksSize, 1);
+    ck_assert_uint_eq(responses, 0);
+    sendRequestChunk(1, 2);
+    ck_assert_uint_eq(responses, 1);
+    ck_assert_uint_eq(responseType, UA_NS0ID_GETENDPOINTSRESPONSE);
+    ck_assert_uint_eq(responseHandle, REQUESTHANDLE);
+    ck_assert_uint_eq(responseResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(channel.chunksSize, 0);
+    ck_assert_uint_eq(channel.chunksAllocated, 0);
+}
+END_TEST
+
+START_TEST(Chunks_interleaved) {
+    server->config.maxChunkedRequestsBytes = 0;
+    sendRequestChunk(1, 0);
+    sendRequestChunk(2, 0);
+    sendRequestChunk(2, 1);
+    sendRequestChunk(1, 1);
+    sendRequestChunk(1, 2);
+    ck_assert_uint_eq(responses, 1);
+    ck_assert_uint_eq(responseType, UA_NS0ID_GETENDPOINTSRESPONSE);
+    sendRequestChunk(2, 2);
+    ck_assert_uint_eq(responses, 2);
+    ck_assert_uint_eq(responseType, UA_NS0ID_GETENDPOINTSRESPONSE);
+    ck_assert_uint_eq(channel.chunksSize, 0);
+    ck_assert_uint_eq(channel.chunksAllocated, 0);
+}
+END_TEST
+
+START_TEST(Chunks_messageTooLarge) {
+    connection.localConf.maxMessageSize = 2 * CHUNKBODY;
+    sendRequestChunk(1, 0);
+    sendRequestChunk(1, 1);
+    ck_assert_uint_eq(channel.chunksAllocated, 2 * CHUNKBODY);
+    sendRequestChunk(1, 2);
+    ck_assert_uint_eq(responses, 1);
+    ck_assert_uint_eq(responseType, UA_NS0ID_SERVICEFAULT);
+    ck_assert_uint_eq(responseHandle, REQUESTHANDLE);
+    ck_assert_uint_eq(responseResult, UA_STATUSCODE_BADREQUESTTOOLARGE);
+    ck_assert_uint_eq(channel.chunksSize, 0);
+    ck_assert_uint_eq(channel.chunksAllocated, 0);
+}
+END_TEST
+
+/* The first request takes up the buffer limit of the channel */
+START_TEST(Chunks_bufferLimit) {
+    sendRequestChunk(1, 0);
+    ck_assert_uint_eq(channel.chunksAllocated, 4 * CHUNKBODY);
+    sendRequestChunk(2, 0);
+    sendRequestChunk(2, 1);
+    sendRequestChunk(2, 2);
+    ck_assert_uint_eq(responses, 1);
+    ck_assert_uint_eq(responseType, UA_NS0ID_SERVICEFAULT);
+    ck_assert_uint_eq(responseResult, UA_STATUSCODE_BADTCPNOTENOUGHRESOURCES);
+    sendRequestChunk(1, 1);
+    sendRequestChunk(1, 2);
+    ck_assert_uint_eq(responses, 2);
+    ck_assert_uint_eq(responseType, UA_NS0ID_GETENDPOINTSRESPONSE);
+    ck_assert_uint_eq(channel.chunksAllocated, 0);
+}
+END_TEST
+
+START_TEST(Chunks_tooManyRequests) {
+    sendRequestChunk(1, 0);
+    sendRequestChunk(2, 0);
+    ck_assert(!closed);
+    sendRequestChunk(3, 0);
+    ck_assert(closed);
+    ck_assert_uint_eq(channel.chunksSize, 2);
+}
+END_TEST
+
+START_TEST(Chunks_abort) {
+    sendRequestChunk(1, 0);
+    sendRequestChunk(1, 1);
+    sendChunk('A', 1, request.data, 0);
+    ck_assert_uint_eq(channel.chunksSize, 0);
+    ck_assert_uint_eq(channel.chunksAllocated, 0);
+    ck_assert_uint_eq(responses, 0);
+}
+END_TEST
+
+/* Reassembles the chunks sent by the server */
+static UA_ByteString sentBody;
+static size_t sentChunks;
+static size_t sentMaxChunkSize;
+static UA_Byte sentLastChunkType;
+
+static UA_StatusCode
+collectSend(UA_Connection *c, UA_ByteString *buf) {
+    ck_assert_uint_ge(buf->length, 24);
+    ck_assert(buf->data[20] == 7); // requestId
+    ck_assert(sentLastChunkType == 0 || sentLastChunkType == 'C');
+    sentLastChunkType = buf->data[3];
+    if(buf->length > sentMaxChunkSize)
+        sentMaxChunkSize = buf->length;
+    size_t length = buf->length - 24;
+    sentBody.data = realloc(sentBody.data, sentBody.length + length);
+    memcpy(&sentBody.data[sentBody.length], &buf->data[24], length);
+    sentBody.length += length;
+    sentChunks++;
+    UA_ByteString_deleteMembers(buf);
+    return UA_STATUSCODE_GOOD;
+}
+
+#define VALUES 20000
+
+/* Sends a ReadResponse with the given number of values. The last chunk is 'F'
+   if the response fits into the limits of the remote side and 'A' if it is
+   aborted. Without a chunk, the response fits into a single chunk and the
+   error is returned. */
+static void
+sendReadResponse(size_t valuesSize, UA_Byte lastChunkType) {
+    UA_Double *values = malloc(valuesSize * sizeof(UA_Double));
+    for(size_t i = 0; i < valuesSize; i++)
+        values[i] = (UA_Double)i;
+    UA_DataValue dv;
+    UA_DataValue_init(&dv);
+    dv.hasValue = true;
+    UA_Variant_setArray(&dv.value, values, valuesSize, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_ReadResponse response;
+    UA_ReadResponse_init(&response);
+    response.results = &dv;
+    response.resultsSize = 1;
+
+    connection.send = collectSend;
+    connection.remoteConf.recvBufferSize = 8192;
+    UA_ByteString_init(&sentBody);
+    sentChunks = 0;
+    sentMaxChunkSize = 0;
+    sentLastChunkType = 0;
+    UA_StatusCode expected = UA_STATUSCODE_GOOD;
+    if(lastChunkType == 0)
+        expected = UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    ck_assert_uint_eq(UA_SecureChannel_sendBinaryMessage(&channel, 7, &response,
+                                                         &UA_TYPES[UA_TYPES_READRESPONSE]),
+                      expected);
+    ck_assert_int_eq(sentLastChunkType, lastChunkType);
+    ck_assert_uint_le(sentMaxChunkSize, 8192);
+
+    if(lastChunkType == 'F') {
+        ck_assert_uint_gt(sentChunks, valuesSize * sizeof(UA_Double) / 8192);
+        size_t pos = 0;
+        UA_NodeId typeId;
+        UA_ReadResponse decoded;
+        ck_assert_uint_eq(UA_NodeId_decodeBinary(&sentBody, &pos, &typeId), UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(typeId.identifier.numeric, UA_NS0ID_READRESPONSE + UA_ENCODINGOFFSET_BINARY);
+        ck_assert_uint_eq(UA_ReadResponse_decodeBinary(&sentBody, &pos, &decoded), UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(pos, sentBody.length);
+        ck_assert_uint_eq(decoded.results[0].value.arrayLength, valuesSize);
+        ck_assert(memcmp(decoded.results[0].value.data, values, valuesSize * sizeof(UA_Double)) == 0);
+        UA_ReadResponse_deleteMembers(&decoded);
+    } else if(lastChunkType == 'A') {
+        /* the abort chunk carries the error and an empty reason */
+        const UA_ConnectionConfig *remoteConf = &connection.remoteConf;
+        ck_assert_uint_ge(sentBody.length, 8);
+        size_t bodySize = sentBody.length - 8;
+        size_t pos = bodySize;
+        UA_StatusCode error;
+        UA_String reason;
+        ck_assert_uint_eq(UA_StatusCode_decodeBinary(&sentBody, &pos, &error), UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(UA_String_decodeBinary(&sentBody, &pos, &reason), UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(error, UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED);
+        ck_assert_uint_eq(reason.length, 0);
+        if(remoteConf->maxChunkCount > 0)
+            ck_assert_uint_le(sentChunks, remoteConf->maxChunkCount);
+        if(remoteConf->maxMessageSize > 0)
+            ck_assert_uint_le(bodySize, remoteConf->maxMessageSize);
+    } else {
+        ck_assert_uint_eq(sentChunks, 0);
+    }
+    UA_ByteString_deleteMembers(&sentBody);
+    UA_DataValue_deleteMembers(&dv);
+}
+
+START_TEST(Chunks_sendLargeResponse) {
+    connection.remoteConf.maxChunkCount = 0;
+    connection.remoteConf.maxMessageSize = 0;
+    sendReadResponse(VALUES, 'F');
+}
+END_TEST
+
+START_TEST(Chunks_sendOverChunkCount) {
+    connection.remoteConf.maxChunkCount = 4;
+    connection.remoteConf.maxMessageSize = 0;
+    sendReadResponse(VALUES, 'A');
+}
+END_TEST
+
+START_TEST(Chunks_sendOverMessageSize) {
+    connection.remoteConf.maxChunkCount = 0;
+    connection.remoteConf.maxMessageSize = 100000;
+    sendReadResponse(VALUES, 'A');
+}
+END_TEST
+
+START_TEST(Chunks_sendLastChunkOverMessageSize) {
+    /* the limit is exceeded only with the final chunk */
+    connection.remoteConf.maxChunkCount = 0;
+    connection.remoteConf.maxMessageSize = 10000;
+    sendReadResponse(1500, 'A');
+}
+END_TEST
+
+START_TEST(Chunks_sendSingleChunkOverMessageSize) {
+    connection.remoteConf.maxChunkCount = 0;
+    connection.remoteConf.maxMessageSize = 500;
+    sendReadResponse(100, 0);
+}
+END_TEST
+
+static Suite *testSuite_chunks(void) {
+    Suite *s = suite_create("Chunked Requests");
+    TCase *tc = tcase_create("Reassembly");
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, Chunks_reassemble);
+    tcase_add_test(tc, Chunks_interleaved);
+    tcase_add_test(tc, Chunks_messageTooLarge);
+    tcase_add_test(tc, Chunks_bufferLimit);
+    tcase_add_test(tc, Chunks_tooManyRequests);
+    tcase_add_test(tc, Chunks_abort);
+    suite_add_tcase(s, tc);
+    TCase *tc_send = tcase_create("Sending");
+    tcase_add_checked_fixture(tc_send, setup, teardown);
+    tcase_add_test(tc_send, Chunks_sendLargeResponse);
+    tcase_add_test(tc_send, Chunks_sendOverChunkCount);
+    tcase_add_test(tc_send, Chunks_sendOverMessageSize);
+    tcase_add_test(tc_send, Chunks_sendLastChunkOverMessageSize);
+    tcase_add_test(tc_send, Chunks_sendSingleChunkOverMessageSize);
+    suite_add_tcase(s, tc_send);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_chunks();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
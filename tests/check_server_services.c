@@ -0,0 +1,578 @@
+#define _XOPEN_SOURCE 500 // usleep
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ua_server.h"
+#include "ua_server_internal.h"
+#include "ua_securechannel.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_types_generated_encoding_binary.h"
+#include "ua_transport_generated_encoding_binary.h"
+#include "logger_stdout.h"
+#include "testing_networklayers.h"
+#include "check.h"
+
+static UA_Server *server;
+static UA_Connection connection;
+static UA_SecureChannel channel;
+static UA_Session *session;
+static UA_UInt32 sequenceNumber;
+
+/* The last response */
+static UA_UInt32 responseType;
+static UA_ByteString response;
+
+/* The headers of all responses in the order they were sent */
+#define MAXRESPONSES 64
+static UA_SequenceHeader responseHeaders[MAXRESPONSES];
+static UA_UInt32 responseTypes[MAXRESPONSES];
+static UA_UInt32 responsesSize;
+
+/* Sends from worker threads are serialized by the SecureChannel */
+static UA_StatusCode
+captureSend(UA_Connection *c, UA_ByteString *buf) {
+    size_t pos = 16;
+    UA_SequenceHeader seqHeader;
+    UA_SequenceHeader_decodeBinary(buf, &pos, &seqHeader);
+    UA_NodeId typeId;
+    UA_NodeId_decodeBinary(buf, &pos, &typeId);
+    responseType = typeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY;
+    if(responsesSize < MAXRESPONSES) {
+        responseHeaders[responsesSize] = seqHeader;
+        responseTypes[responsesSize] = responseType;
+#ifdef UA_ENABLE_MULTITHREADING
+        uatomic_inc(&responsesSize);
+#else
+        responsesSize++;
+#endif
+    }
+    UA_ByteString body = {buf->length - pos, &buf->data[pos]};
+    UA_ByteString_deleteMembers(&response);
+    UA_ByteString_copy(&body, &response);
+    UA_ByteString_deleteMembers(buf);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+setupServer(UA_ServerConfig config) {
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_register_thread();
+#endif
+    config.logger = Logger_Stdout;
+    server = UA_Server_new(config);
+
+    connection = createDummyConnection();
+    connection.send = captureSend;
+    UA_SecureChannel_init(&channel);
+    channel.securityToken.channelId = 1;
+    channel.securityToken.tokenId = 1;
+    UA_Connection_attachSecureChannel(&connection, &channel);
+
+    UA_CreateSessionRequest req;
+    UA_CreateSessionRequest_init(&req);
+    UA_SessionManager_createSession(&server->sessionManager, &channel, &req, &session);
+    UA_SecureChannel_attachSession(&channel, session);
+    session->activated = true;
+
+    sequenceNumber = 0;
+    responseType = 0;
+    responsesSize = 0;
+    UA_ByteString_init(&response);
+}
+
+static void
+setup(void) {
+    setupServer(UA_ServerConfig_standard);
+}
+
+static void
+teardown(void) {
+    UA_ByteString_deleteMembers(&response);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+    UA_Server_delete(server);
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_unregister_thread();
+#endif
+}
+
+/* Encodes the request in a single chunk at the position. The request id is
+ * the sequence number. */
+static void
+encodeRequest(const void *request, const UA_DataType *requestType,
+              UA_ByteString *msg, size_t *pos) {
+    size_t start = *pos;
+    *pos += 24;
+    UA_NodeId typeId = UA_NODEID_NUMERIC(0, requestType->typeId.identifier.numeric +
+                                         UA_ENCODINGOFFSET_BINARY);
+    ck_assert_uint_eq(UA_NodeId_encodeBinary(&typeId, msg, pos), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_encodeBinary(request, requestType, msg, pos), UA_STATUSCODE_GOOD);
+
+    UA_SecureConversationMessageHeader header;
+    header.messageHeader.messageTypeAndFinal = UA_MESSAGETYPEANDFINAL_MSGF;
+    header.messageHeader.messageSize = (UA_UInt32)(*pos - start);
+    header.secureChannelId = channel.securityToken.channelId;
+    UA_SymmetricAlgorithmSecurityHeader symHeader = {channel.securityToken.tokenId};
+    UA_SequenceHeader seqHeader = {++sequenceNumber, sequenceNumber};
+    size_t headerPos = start;
+    UA_SecureConversationMessageHeader_encodeBinary(&header, msg, &headerPos);
+    UA_SymmetricAlgorithmSecurityHeader_encodeBinary(&symHeader, msg, &headerPos);
+    UA_SequenceHeader_encodeBinary(&seqHeader, msg, &headerPos);
+}
+
+/* Sends the request in a single chunk */
+static void
+sendRequest(const void *request, const UA_DataType *requestType) {
+    UA_ByteString msg;
+    UA_ByteString_allocBuffer(&msg, 100 + UA_calcSizeBinary((void*)(uintptr_t)request, requestType));
+    size_t pos = 0;
+    encodeRequest(request, requestType, &msg, &pos);
+    msg.length = pos;
+    UA_RCU_LOCK();
+    UA_Server_processBinaryMessage(server, &connection, &msg);
+    UA_RCU_UNLOCK();
+    UA_ByteString_deleteMembers(&msg);
+}
+
+static UA_StatusCode
+readValue(UA_NodeId nodeId, UA_DataValue *value) {
+    UA_ReadValueId item;
+    UA_ReadValueId_init(&item);
+    item.nodeId = nodeId;
+    item.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.requestHeader.authenticationToken = session->authenticationToken;
+    request.nodesToRead = &item;
+    request.nodesToReadSize = 1;
+    sendRequest(&request, &UA_TYPES[UA_TYPES_READREQUEST]);
+
+    size_t pos = 0;
+    if(responseType == UA_NS0ID_SERVICEFAULT) {
+        UA_ResponseHeader header;
+        ck_assert_uint_eq(UA_ResponseHeader_decodeBinary(&response, &pos, &header), UA_STATUSCODE_GOOD);
+        UA_StatusCode retval = header.serviceResult;
+        UA_ResponseHeader_deleteMembers(&header);
+        return retval;
+    }
+    ck_assert_uint_eq(responseType, UA_NS0ID_READRESPONSE);
+    UA_ReadResponse res;
+    ck_assert_uint_eq(UA_ReadResponse_decodeBinary(&response, &pos, &res), UA_STATUSCODE_GOOD);
+    UA_StatusCode retval = res.responseHeader.serviceResult;
+    if(retval == UA_STATUSCODE_GOOD) {
+        ck_assert_uint_eq(res.resultsSize, 1);
+        *value = res.results[0];
+        UA_DataValue_init(&res.results[0]);
+    }
+    UA_ReadResponse_deleteMembers(&res);
+    return retval;
+}
+
+/* Answers the reads of namespace 1 and forwards all others */
+static UA_ServiceEntry defaultRead;
+
+static void
+fastRead(UA_Server *s, UA_Session *sess, const UA_ReadRequest *request,
+         UA_ReadResponse *res) {
+    if(request->nodesToReadSize != 1 || request->nodesToRead[0].nodeId.namespaceIndex != 1) {
+        defaultRead.handler(s, sess, request, res);
+        return;
+    }
+    res->results = UA_DataValue_new();
+    res->resultsSize = 1;
+    UA_Double value = 42.0;
+    UA_Variant_setScalarCopy(&res->results[0].value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    res->results[0].hasValue = true;
+}
+
+START_TEST(Services_overrideRead) {
+    UA_ServiceEntry fast = {&UA_TYPES[UA_TYPES_READREQUEST], &UA_TYPES[UA_TYPES_READRESPONSE],
+                            (UA_ServiceHandler)fastRead, true, true, false, false, 0};
+    ck_assert_uint_eq(UA_Server_setService(server, &fast, &defaultRead), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(defaultRead.requestType, &UA_TYPES[UA_TYPES_READREQUEST]);
+    ck_assert(defaultRead.handler != NULL);
+
+    UA_DataValue value;
+    ck_assert_uint_eq(readValue(UA_NODEID_STRING(1, "fast"), &value), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.value.type, &UA_TYPES[UA_TYPES_DOUBLE]);
+    ck_assert(*(UA_Double*)value.value.data == 42.0);
+    UA_DataValue_deleteMembers(&value);
+
+    /* forwarded to the built-in service */
+    ck_assert_uint_eq(readValue(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                                &value), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.value.type, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_DataValue_deleteMembers(&value);
+
+    UA_ServiceEntry entry;
+    ck_assert_uint_eq(UA_Server_getService(server, &UA_TYPES[UA_TYPES_READREQUEST], &entry),
+                      UA_STATUSCODE_GOOD);
+    ck_assert(entry.handler == (UA_ServiceHandler)fastRead);
+    ck_assert_uint_eq(entry.calls, 2);
+
+    /* restore the built-in service, the counter is kept */
+    ck_assert_uint_eq(UA_Server_setService(server, &defaultRead, NULL), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(readValue(UA_NODEID_STRING(1, "fast"), &value), UA_STATUSCODE_GOOD);
+    ck_assert(!value.hasValue || value.value.type != &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_DataValue_deleteMembers(&value);
+    ck_assert_uint_eq(UA_Server_getService(server, &UA_TYPES[UA_TYPES_READREQUEST], &entry),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(entry.calls, 3);
+}
+END_TEST
+
+START_TEST(Services_remove) {
+    ck_assert_uint_eq(UA_Server_removeService(server, &UA_TYPES[UA_TYPES_READREQUEST]),
+                      UA_STATUSCODE_GOOD);
+    UA_DataValue value;
+    ck_assert_uint_eq(readValue(UA_NODEID_STRING(1, "fast"), &value),
+                      UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+    UA_ServiceEntry entry;
+    ck_assert_uint_eq(UA_Server_getService(server, &UA_TYPES[UA_TYPES_READREQUEST], &entry),
+                      UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+    ck_assert_uint_eq(UA_Server_removeService(server, &UA_TYPES[UA_TYPES_READREQUEST]),
+                      UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+
+    /* add it again */
+    UA_ServiceEntry fast = {&UA_TYPES[UA_TYPES_READREQUEST], &UA_TYPES[UA_TYPES_READRESPONSE],
+                            (UA_ServiceHandler)fastRead, true, true, false, false, 5};
+    ck_assert_uint_eq(UA_Server_setService(server, &fast, &entry), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(entry.requestType, NULL);
+    ck_assert_uint_eq(readValue(UA_NODEID_STRING(1, "fast"), &value), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.value.type, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_DataValue_deleteMembers(&value);
+    ck_assert_uint_eq(UA_Server_getService(server, &UA_TYPES[UA_TYPES_READREQUEST], &entry),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(entry.calls, 1);
+}
+END_TEST
+
+/* The read is decoded in the request arena */
+START_TEST(Services_readManyItems) {
+    UA_ReadValueId items[1000];
+    for(size_t i = 0; i < 1000; i++) {
+        UA_ReadValueId_init(&items[i]);
+        items[i].nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_STATE);
+        items[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.requestHeader.authenticationToken = session->authenticationToken;
+    request.nodesToRead = items;
+    request.nodesToReadSize = 1000;
+    sendRequest(&request, &UA_TYPES[UA_TYPES_READREQUEST]);
+
+    ck_assert_uint_eq(responseType, UA_NS0ID_READRESPONSE);
+    size_t pos = 0;
+    UA_ReadResponse res;
+    ck_assert_uint_eq(UA_ReadResponse_decodeBinary(&response, &pos, &res), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(res.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(res.resultsSize, 1000);
+    for(size_t i = 0; i < 1000; i++) {
+        ck_assert(res.results[i].hasValue);
+        ck_assert(UA_Variant_isScalar(&res.results[i].value));
+    }
+    UA_ReadResponse_deleteMembers(&res);
+}
+END_TEST
+
+/* A datasource that keeps memory allocated during the read. The memory is
+ * not taken from the request arena. */
+static UA_String kept;
+
+static UA_StatusCode
+keepingRead(void *handle, const UA_NodeId nodeid, UA_Boolean includeSourceTimeStamp,
+            const UA_NumericRange *range, UA_DataValue *value) {
+    if(kept.data)
+        ck_assert(UA_String_equal(&kept, (UA_String*)handle));
+    UA_String_deleteMembers(&kept);
+    UA_String_copy(handle, &kept);
+    UA_Variant_setScalarCopy(&value->value, handle, &UA_TYPES[UA_TYPES_STRING]);
+    value->hasValue = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(Services_dataSourceKeepsMemory) {
+    UA_String content = UA_STRING("kept beyond the read");
+    UA_DataSource source = {.handle = &content, .read = keepingRead, .write = NULL};
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "keeping");
+    ck_assert_uint_eq(UA_Server_addDataSourceVariableNode(server, nodeId,
+                          UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                          UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                          UA_QUALIFIEDNAME(1, "keeping"), UA_NODEID_NULL,
+                          attr, source, NULL), UA_STATUSCODE_GOOD);
+
+    /* The reads in between reuse the arena */
+    UA_ReadValueId items[100];
+    for(size_t i = 0; i < 100; i++) {
+        UA_ReadValueId_init(&items[i]);
+        items[i].nodeId = nodeId;
+        items[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.requestHeader.authenticationToken = session->authenticationToken;
+    request.nodesToRead = items;
+    request.nodesToReadSize = 100;
+    for(size_t i = 0; i < 3; i++) {
+        sendRequest(&request, &UA_TYPES[UA_TYPES_READREQUEST]);
+        ck_assert_uint_eq(responseType, UA_NS0ID_READRESPONSE);
+    }
+    ck_assert(UA_String_equal(&kept, &content));
+    UA_String_deleteMembers(&kept);
+}
+END_TEST
+
+/* Written structures are stored and handed to onWrite decoded, although the
+ * Write service keeps the ExtensionObjects of the request encoded */
+static const UA_DataType *writtenType;
+
+static void
+onWriteType(void *handle, const UA_NodeId nodeid, const UA_Variant *data,
+            const UA_NumericRange *range) {
+    writtenType = data->type;
+}
+
+START_TEST(Services_writeStructure) {
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "argument");
+    ck_assert_uint_eq(UA_Server_addVariableNode(server, nodeId,
+                          UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                          UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                          UA_QUALIFIEDNAME(1, "argument"), UA_NODEID_NULL,
+                          attr, NULL, NULL), UA_STATUSCODE_GOOD);
+    UA_ValueCallback callback = {NULL, NULL, onWriteType};
+    ck_assert_uint_eq(UA_Server_setVariableNode_valueCallback(server, nodeId, callback),
+                      UA_STATUSCODE_GOOD);
+
+    UA_Argument argument;
+    UA_Argument_init(&argument);
+    argument.name = UA_STRING("input");
+    argument.valueRank = -1;
+    UA_WriteValue wv;
+    UA_WriteValue_init(&wv);
+    wv.nodeId = nodeId;
+    wv.attributeId = UA_ATTRIBUTEID_VALUE;
+    wv.value.hasValue = true;
+    UA_Variant_setScalar(&wv.value.value, &argument, &UA_TYPES[UA_TYPES_ARGUMENT]);
+    UA_WriteRequest request;
+    UA_WriteRequest_init(&request);
+    request.requestHeader.authenticationToken = session->authenticationToken;
+    request.nodesToWrite = &wv;
+    request.nodesToWriteSize = 1;
+    sendRequest(&request, &UA_TYPES[UA_TYPES_WRITEREQUEST]);
+
+    ck_assert_uint_eq(responseType, UA_NS0ID_WRITERESPONSE);
+    size_t pos = 0;
+    UA_WriteResponse res;
+    ck_assert_uint_eq(UA_WriteResponse_decodeBinary(&response, &pos, &res), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(res.resultsSize, 1);
+    ck_assert_uint_eq(res.results[0], UA_STATUSCODE_GOOD);
+    UA_WriteResponse_deleteMembers(&res);
+    ck_assert_ptr_eq(writtenType, &UA_TYPES[UA_TYPES_ARGUMENT]);
+
+    UA_Variant value;
+    ck_assert_uint_eq(UA_Server_readValue(server, nodeId, &value), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.type, &UA_TYPES[UA_TYPES_ARGUMENT]);
+    ck_assert(UA_String_equal(&((UA_Argument*)value.data)->name, &argument.name));
+    ck_assert_int_eq(((UA_Argument*)value.data)->valueRank, -1);
+    UA_Variant_deleteMembers(&value);
+}
+END_TEST
+
+/* The error response from the template is a regular ServiceFault */
+START_TEST(Services_serviceFault) {
+    ck_assert_uint_eq(UA_Server_removeService(server, &UA_TYPES[UA_TYPES_READREQUEST]),
+                      UA_STATUSCODE_GOOD);
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.requestHeader.authenticationToken = session->authenticationToken;
+    request.requestHeader.requestHandle = 42;
+    sendRequest(&request, &UA_TYPES[UA_TYPES_READREQUEST]);
+
+    ck_assert_uint_eq(responseType, UA_NS0ID_SERVICEFAULT);
+    size_t pos = 0;
+    UA_ServiceFault fault;
+    ck_assert_uint_eq(UA_decodeBinary(&response, &pos, &fault, &UA_TYPES[UA_TYPES_SERVICEFAULT]),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(pos, response.length);
+    ck_assert_uint_eq(fault.responseHeader.requestHandle, 42);
+    ck_assert_uint_eq(fault.responseHeader.serviceResult, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+    ck_assert(fault.responseHeader.timestamp > 0);
+
+    /* Same as the generic encoding */
+    UA_ByteString encoded;
+    UA_ByteString_allocBuffer(&encoded, response.length);
+    pos = 0;
+    ck_assert_uint_eq(UA_encodeBinary(&fault, &UA_TYPES[UA_TYPES_SERVICEFAULT], &encoded, &pos),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(pos, response.length);
+    ck_assert(memcmp(encoded.data, response.data, pos) == 0);
+    UA_ByteString_deleteMembers(&encoded);
+    UA_ServiceFault_deleteMembers(&fault);
+}
+END_TEST
+
+START_TEST(Services_invalidType) {
+    /* not a service request */
+    UA_ServiceEntry entry = {&UA_TYPES[UA_TYPES_DOUBLE], &UA_TYPES[UA_TYPES_DOUBLE],
+                             (UA_ServiceHandler)fastRead, true, true, false, false, 0};
+    ck_assert_uint_eq(UA_Server_setService(server, &entry, NULL), UA_STATUSCODE_BADINVALIDARGUMENT);
+    entry.requestType = &UA_TYPES[UA_TYPES_READREQUEST];
+    entry.responseType = NULL;
+    ck_assert_uint_eq(UA_Server_setService(server, &entry, NULL), UA_STATUSCODE_BADINVALIDARGUMENT);
+    ck_assert_uint_eq(UA_Server_getService(server, &UA_TYPES[UA_TYPES_DOUBLE], &entry),
+                      UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+}
+END_TEST
+
+/* Request types outside the service index are found by their type id. There
+ * is no fixed limit for the number of services. */
+#define CUSTOMSERVICES 100
+static UA_DataType customTypes[CUSTOMSERVICES];
+
+START_TEST(Services_notIndexed) {
+    for(size_t i = 0; i < CUSTOMSERVICES; i++) {
+        customTypes[i] = UA_TYPES[UA_TYPES_READREQUEST];
+        customTypes[i].typeId = UA_NODEID_NUMERIC(0, 20000 + 10 * (UA_UInt32)i);
+        UA_ServiceEntry entry = {&customTypes[i], &UA_TYPES[UA_TYPES_READRESPONSE],
+                                 (UA_ServiceHandler)fastRead, true, true, false, false, 0};
+        ck_assert_uint_eq(UA_Server_setService(server, &entry, NULL), UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(UA_Server_getService(server, &UA_TYPES[UA_TYPES_READREQUEST],
+                                           &defaultRead), UA_STATUSCODE_GOOD);
+
+    UA_ReadValueId item;
+    UA_ReadValueId_init(&item);
+    item.nodeId = UA_NODEID_STRING(1, "fast");
+    item.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.requestHeader.authenticationToken = session->authenticationToken;
+    request.nodesToRead = &item;
+    request.nodesToReadSize = 1;
+    sendRequest(&request, &customTypes[CUSTOMSERVICES - 1]);
+    ck_assert_uint_eq(responseType, UA_NS0ID_READRESPONSE);
+
+    UA_ServiceEntry entry;
+    ck_assert_uint_eq(UA_Server_getService(server, &customTypes[CUSTOMSERVICES - 1], &entry),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(entry.requestType, &customTypes[CUSTOMSERVICES - 1]);
+    ck_assert_uint_eq(entry.calls, 1);
+
+    ck_assert_uint_eq(UA_Server_removeService(server, &customTypes[CUSTOMSERVICES - 1]),
+                      UA_STATUSCODE_GOOD);
+    sendRequest(&request, &customTypes[CUSTOMSERVICES - 1]);
+    ck_assert_uint_eq(responseType, UA_NS0ID_SERVICEFAULT);
+    ck_assert_uint_eq(UA_Server_getService(server, &customTypes[CUSTOMSERVICES - 1], &entry),
+                      UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+
+    /* the indexed services are unchanged */
+    UA_DataValue value;
+    ck_assert_uint_eq(readValue(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                                &value), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.value.type, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_DataValue_deleteMembers(&value);
+}
+END_TEST
+
+static void
+setupParallel(void) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.nThreads = 4;
+    config.parallelRequests = true;
+    setupServer(config);
+    UA_Server_run_startup(server);
+}
+
+static void
+teardownParallel(void) {
+    UA_Server_run_shutdown(server);
+    teardown();
+}
+
+/* With multithreading, the pipelined reads are executed in parallel and
+ * answered in the order of completion */
+START_TEST(Services_pipelinedReads) {
+    UA_ReadValueId item;
+    UA_ReadValueId_init(&item);
+    item.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME);
+    item.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.requestHeader.authenticationToken = session->authenticationToken;
+    request.nodesToRead = &item;
+    request.nodesToReadSize = 1;
+
+    /* All requests in one buffer */
+    const UA_UInt32 requests = 32;
+    UA_ByteString msg;
+    UA_ByteString_allocBuffer(&msg, requests * (100 + UA_calcSizeBinary(&request, &UA_TYPES[UA_TYPES_READREQUEST])));
+    size_t pos = 0;
+    for(UA_UInt32 i = 0; i < requests; i++)
+        encodeRequest(&request, &UA_TYPES[UA_TYPES_READREQUEST], &msg, &pos);
+    msg.length = pos;
+    UA_RCU_LOCK();
+    UA_Server_processBinaryMessage(server, &connection, &msg);
+    UA_RCU_UNLOCK();
+    UA_ByteString_deleteMembers(&msg);
+
+#ifdef UA_ENABLE_MULTITHREADING
+    for(size_t i = 0; i < 5000 && uatomic_read(&responsesSize) < requests; i++)
+        usleep(1000);
+#endif
+    ck_assert_uint_eq(responsesSize, requests);
+
+    /* Every request is answered once. The sequence numbers follow the order
+     * in which the responses were sent. */
+    UA_Boolean answered[32];
+    memset(answered, 0, sizeof(answered));
+    for(UA_UInt32 i = 0; i < requests; i++) {
+        ck_assert_uint_eq(responseTypes[i], UA_NS0ID_READRESPONSE);
+        ck_assert_uint_eq(responseHeaders[i].sequenceNumber, i + 1);
+        UA_UInt32 requestId = responseHeaders[i].requestId;
+        ck_assert(requestId >= 1 && requestId <= requests);
+        ck_assert(!answered[requestId - 1]);
+        answered[requestId - 1] = true;
+    }
+
+    UA_ServiceEntry entry;
+    UA_Server_getService(server, &UA_TYPES[UA_TYPES_READREQUEST], &entry);
+    ck_assert_uint_eq(entry.calls, requests);
+}
+END_TEST
+
+static Suite *testSuite_services(void) {
+    Suite *s = suite_create("Server Services");
+    TCase *tc = tcase_create("Service Table");
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, Services_overrideRead);
+    tcase_add_test(tc, Services_remove);
+    tcase_add_test(tc, Services_readManyItems);
+    tcase_add_test(tc, Services_dataSourceKeepsMemory);
+    tcase_add_test(tc, Services_writeStructure);
+    tcase_add_test(tc, Services_serviceFault);
+    tcase_add_test(tc, Services_invalidType);
+    tcase_add_test(tc, Services_notIndexed);
+    suite_add_tcase(s, tc);
+
+    TCase *tc_parallel = tcase_create("Parallel Requests");
+    tcase_add_checked_fixture(tc_parallel, setupParallel, teardownParallel);
+    tcase_add_test(tc_parallel, Services_pipelinedReads);
+    suite_add_tcase(s, tc_parallel);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_services();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
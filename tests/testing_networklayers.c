@@ -41,6 +41,7 @@ UA_Connection createDummyConnection(void) {
     c.getSendBuffer = dummyGetSendBuffer;
     c.releaseSendBuffer = dummyReleaseSendBuffer;
     c.send = dummySend;
+    c.waitSendable = NULL;
     c.recv = NULL;
     c.releaseRecvBuffer = dummyReleaseRecvBuffer;
     c.close = dummyClose;
@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "testing_serverlayer.h"
+#include "logger_stdout.h"
+#include "check.h"
+
+UA_ServerNetworkLayer nl;
+
+void
+setupLayer(UA_ServerNetworkLayer layer) {
+    nl = layer;
+    ck_assert_uint_eq(nl.start(&nl, Logger_Stdout), UA_STATUSCODE_GOOD);
+}
+
+void
+processJobs(UA_Job *jobs, size_t jobsSize) {
+    for(size_t i = 0; i < jobsSize; i++) {
+        if(jobs[i].type == UA_JOBTYPE_METHODCALL_DELAYED)
+            jobs[i].job.methodCall.method(NULL, jobs[i].job.methodCall.data);
+        else if(jobs[i].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER) {
+            UA_Connection *c = jobs[i].job.binaryMessage.connection;
+            c->releaseRecvBuffer(c, &jobs[i].job.binaryMessage.message);
+        }
+    }
+    if(jobsSize > 0)
+        free(jobs);
+}
+
+void
+teardownLayer(void) {
+    UA_Job *jobs;
+    size_t jobsSize = nl.stop(&nl, &jobs);
+    processJobs(jobs, jobsSize);
+    nl.deleteMembers(&nl);
+}
+
+int
+connectClient(UA_UInt16 port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    ck_assert_int_ge(fd, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ck_assert_int_eq(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    return fd;
+}
+
+UA_Connection *
+getConnection(int fd) {
+    ck_assert_int_eq(send(fd, "ping", 4, 0), 4);
+    UA_Connection *c = NULL;
+    for(size_t i = 0; i < 100 && !c; i++) {
+        UA_Job *jobs;
+        size_t jobsSize = nl.getJobs(&nl, &jobs, 10000);
+        for(size_t j = 0; j < jobsSize; j++) {
+            if(jobs[j].type != UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER)
+                continue;
+            c = jobs[j].job.binaryMessage.connection;
+            ck_assert_uint_eq(jobs[j].job.binaryMessage.message.length, 4);
+            ck_assert(memcmp(jobs[j].job.binaryMessage.message.data, "ping", 4) == 0);
+        }
+        processJobs(jobs, jobsSize);
+    }
+    ck_assert_ptr_ne(c, NULL);
+    return c;
+}
+
+UA_StatusCode
+sendPattern(UA_Connection *c, size_t length, UA_Byte *counter) {
+    UA_ByteString buf;
+    UA_StatusCode retval = c->getSendBuffer(c, length, &buf);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    for(size_t i = 0; i < length; i++)
+        buf.data[i] = (*counter)++;
+    return c->send(c, &buf);
+}
@@ -0,0 +1,30 @@
+#ifndef TESTING_SERVERLAYER_H_
+#define TESTING_SERVERLAYER_H_
+
+#include "ua_server.h"
+
+/* The server networklayer under test */
+extern UA_ServerNetworkLayer nl;
+
+/** @brief Start the networklayer and make it the layer under test */
+void setupLayer(UA_ServerNetworkLayer layer);
+
+/** @brief Run the jobs returned by the networklayer. The received messages
+ * are released without processing them. */
+void processJobs(UA_Job *jobs, size_t jobsSize);
+
+/** @brief Stop the networklayer under test and delete it */
+void teardownLayer(void);
+
+/** @brief Open a TCP connection to the port on the local host */
+int connectClient(UA_UInt16 port);
+
+/** @brief Send a few bytes from the client socket to get hold of the
+ * server-side connection */
+UA_Connection * getConnection(int fd);
+
+/** @brief Send a message of the given length with a counting byte pattern
+ * from the server-side connection */
+UA_StatusCode sendPattern(UA_Connection *c, size_t length, UA_Byte *counter);
+
+#endif /* TESTING_SERVERLAYER_H_ */
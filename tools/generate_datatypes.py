@@ -71,6 +71,19 @@ subscription_types = ["CreateSubscriptionRequest", "CreateSubscriptionResponse",
                       "MonitoredItemNotification", "DataChangeNotification", "ModifySubscriptionRequest",
                       "ModifySubscriptionResponse", "RepublishRequest", "RepublishResponse"]
 
+# The functions of ua_types_encoding_binary.c that de- and encode the builtin
+# types. The specialized structure functions call them directly.
+codec_functions = {"UA_Boolean": "Boolean", "UA_SByte": "Byte", "UA_Byte": "Byte",
+                   "UA_Int16": "UInt16", "UA_UInt16": "UInt16", "UA_Int32": "UInt32",
+                   "UA_UInt32": "UInt32", "UA_Int64": "UInt64", "UA_UInt64": "UInt64",
+                   "UA_Float": "Float", "UA_Double": "Double", "UA_String": "String",
+                   "UA_DateTime": "UInt64", "UA_Guid": "Guid", "UA_ByteString": "String",
+                   "UA_XmlElement": "String", "UA_NodeId": "NodeId",
+                   "UA_ExpandedNodeId": "ExpandedNodeId", "UA_StatusCode": "UInt32",
+                   "UA_QualifiedName": "QualifiedName", "UA_LocalizedText": "LocalizedText",
+                   "UA_ExtensionObject": "ExtensionObject", "UA_DataValue": "DataValue",
+                   "UA_Variant": "Variant", "UA_DiagnosticInfo": "DiagnosticInfo"}
+
 class TypeDescription(object):
     def __init__(self, name, nodeid, namespaceid):
         self.name = name # without the UA_ prefix
@@ -111,6 +124,10 @@ class Type(object):
     def zero_copy(self):
         return self.name in zero_copy
 
+    def packed(self):
+        # booleans are normalized when decoded
+        return self.zero_copy() and self.name != "UA_Boolean"
+
     def typedef_c(self):
         pass
     
@@ -265,6 +282,12 @@ class StructType(Type):
                 return False
         return True
 
+    def packed(self):
+        for m in self.members.values():
+            if m.isArray or not m.memberType.packed():
+                return False
+        return len(self.members) > 0
+
     def typedef_c(self):
         if len(self.members) == 0:
             return "typedef void * " + self.name + ";"
@@ -326,6 +349,130 @@ class StructType(Type):
             layout += "}"
         return layout + "}"
 
+def codecFunction(t):
+    """Returns the prefix of the codec function for a member type and whether
+       the member pointer has to be converted to the argument type."""
+    if isinstance(t, EnumerationType):
+        return ("UInt32", True)
+    if isinstance(t, OpaqueType):
+        return ("String", True)
+    if isinstance(t, StructType):
+        return (t.name[3:], False)
+    f = codec_functions[t.name]
+    # Float and Double are defined as the integer functions on some platforms
+    return (f, t.name != "UA_" + f or f in ["Float", "Double"])
+
+def typeReference(t):
+    return "&UA_TYPES[UA_TYPES_" + t.name[3:].upper() + "]"
+
+def codecEncodeMember(m):
+    f, convert = codecFunction(m.memberType)
+    if not m.isArray:
+        ptr = ("(const void*)&src->%s" if convert else "&src->%s") % m.name
+        return "    retval |= %s_encodeBinary(%s, pos, ctx);" % (f, ptr)
+    if m.memberType.zero_copy():
+        return "    retval |= Array_encodeBinary(src->%s, src->%sSize, %s, pos, ctx);" % \
+            (m.name, m.name, typeReference(m.memberType))
+    ptr = ("(const void*)&src->%s[i]" if convert else "&src->%s[i]") % m.name
+    return "    retval |= Array_encodeBinaryLength(src->%s, src->%sSize, pos, ctx);\n" % (m.name, m.name) + \
+        "    for(size_t i = 0; i < src->%sSize && retval == UA_STATUSCODE_GOOD; i++)\n" % m.name + \
+        "        retval |= %s_encodeBinary(%s, pos, ctx);" % (f, ptr)
+
+def codecDecodeMember(m):
+    f, convert = codecFunction(m.memberType)
+    if not m.isArray:
+        ptr = ("(void*)&dst->%s" if convert else "&dst->%s") % m.name
+        return "    retval |= %s_decodeBinary(pos, ctx, %s);" % (f, ptr)
+    code = "    signed_length = -1;\n" + \
+           "    retval |= Int32_decodeBinary(pos, ctx, &signed_length);\n"
+    array = "(void *UA_RESTRICT *UA_RESTRICT)&dst->%s, &dst->%sSize, %s" % \
+            (m.name, m.name, typeReference(m.memberType))
+    if m.memberType.zero_copy():
+        return code + "    retval |= Array_decodeBinary(pos, ctx, signed_length, %s);" % array
+    ptr = ("(void*)&dst->%s[i]" if convert else "&dst->%s[i]") % m.name
+    return code + "    retval |= Array_decodeBinaryAlloc(pos, ctx, signed_length, %s);\n" % array + \
+        "    for(size_t i = 0; i < dst->%sSize && retval == UA_STATUSCODE_GOOD; i++)\n" % m.name + \
+        "        retval |= %s_decodeBinary(pos, ctx, %s);" % (f, ptr)
+
+def codecCalcSizeMember(m):
+    t = m.memberType
+    f, convert = codecFunction(t)
+    if m.isArray:
+        if t.zero_copy():
+            return "    s += Array_calcSizeBinary(src->%s, src->%sSize, %s);" % (m.name, m.name, typeReference(t))
+        ptr = ("(const void*)&src->%s[i]" if convert else "&src->%s[i]") % m.name
+        return "    s += 4;\n" + \
+            "    for(size_t i = 0; i < src->%sSize; i++)\n" % m.name + \
+            "        s += %s_calcSizeBinary(%s, NULL);" % (f, ptr)
+    if t.fixed_size() and not isinstance(t, StructType):
+        return "    s += %d;" % t.mem_size()
+    ptr = ("(const void*)&src->%s" if convert else "&src->%s") % m.name
+    return "    s += %s_calcSizeBinary(%s, NULL);" % (f, ptr)
+
+def codecFunctions(t):
+    name = t.name[3:]
+    members = list(t.members.values())
+    hasArrays = any(m.isArray for m in members)
+    return "/* " + t.name + " */\n" + \
+        "static UA_StatusCode\n" + \
+        "%s_encodeBinary(const %s *src, bufpos pos, encodectx ctx) {\n" % (name, t.name) + \
+        "    UA_StatusCode retval = UA_STATUSCODE_GOOD;\n" + \
+        "\n".join(map(codecEncodeMember, members)) + "\n" + \
+        "    return retval;\n}\n\n" + \
+        "static UA_StatusCode\n" + \
+        "%s_decodeBinary(bufpos pos, decodectx ctx, %s *dst) {\n" % (name, t.name) + \
+        "    UA_StatusCode retval = UA_STATUSCODE_GOOD;\n" + \
+        ("    UA_Int32 signed_length;\n" if hasArrays else "") + \
+        "\n".join(map(codecDecodeMember, members)) + "\n" + \
+        "    if(retval != UA_STATUSCODE_GOOD)\n" + \
+        "        deleteDecoded(dst, %s, ctx);\n" % typeReference(t) + \
+        "    return retval;\n}\n\n" + \
+        "static size_t\n" + \
+        "%s_calcSizeBinary(const %s *src, const UA_DataType *_) {\n" % (name, t.name) + \
+        "    size_t s = 0;\n" + \
+        "\n".join(map(codecCalcSizeMember, members)) + "\n" + \
+        "    return s;\n}\n"
+
+def codecTypes(types, names):
+    """The selected structures and the structures they contain. Contained types
+       come first."""
+    selected = OrderedDict()
+    visited = set()
+    def add(t):
+        if not isinstance(t, StructType) or len(t.members) == 0 or t.name in visited:
+            return
+        visited.add(t.name)
+        for m in t.members.values():
+            add(m.memberType)
+        selected[t.name] = t
+    for n in names:
+        if "UA_" + n in types:
+            add(types["UA_" + n])
+    return selected
+
+def packedRuns(t, offset = ""):
+    """The member copies of a packed structure as (offset, member type). Nested
+       structures are flattened."""
+    runs = []
+    for m in t.members.values():
+        memberoffset = offset + "offsetof(%s, %s)" % (t.name, m.name)
+        if isinstance(m.memberType, StructType):
+            runs += packedRuns(m.memberType, memberoffset + " + ")
+        else:
+            runs.append((memberoffset, m.memberType))
+    return runs
+
+def packedLayout(t):
+    runs = packedRuns(t)
+    layout = "    [UA_TYPES_%s] = &(const PackedLayout){%d, %d, (const PackedRun[]){\n" % \
+             (t.name[3:].upper(), t.mem_size(), len(runs)) + \
+             ",\n".join(["        {%s, sizeof(%s)}" % (o, mt.name) for (o, mt) in runs]) + "}},"
+    # Floats are not copied if their encoding differs from the memory layout
+    if any(mt.name in ["UA_Float", "UA_Double"] for (_, mt) in runs):
+        layout = "#if !defined(UA_ENCODING_FLOAT_GENERIC) && !defined(UA_ENCODING_FLOAT_SWAP)\n" + \
+                 layout + "\n#endif"
+    return layout
+
 def parseTypeDefinitions(xmlDescription, existing_types = OrderedDict()):
     '''Returns an ordered dict that maps names to types. The order is such that
        every type depends only on known types. '''
@@ -439,6 +586,7 @@ parser.add_argument('--ns0-types-xml', nargs=1, help='xml-definition of the ns0
 parser.add_argument('--enable-subscription-types', nargs=1, help='Generate datatypes necessary for Montoring and Subscriptions.')
 parser.add_argument('--typedescriptions', nargs=1, help='csv file with type descriptions')
 parser.add_argument('--typeintrospection', help='add the type and member names to the idatatype structures', action='store_true')
+parser.add_argument('--generate-codec', nargs=1, help='comma-separated list of structures that get specialized binary de- and encoding functions (namespace 0 only)')
 parser.add_argument('namespace_id', type=int, help='the id of the target namespace')
 parser.add_argument('types_xml', help='path/to/Opc.Ua.Types.bsd')
 parser.add_argument('outfile', help='output file w/o extension')
@@ -560,3 +708,47 @@ printc("};\n")
 fh.close()
 fe.close()
 fc.close()
+
+if args.namespace_id == 0:
+    fp = open(args.outfile + "_generated_packed.inc",'w')
+    def printp(string):
+        print(string, end='\n', file=fp)
+    printp('''/* Generated from ''' + inname + ''' with script ''' + sys.argv[0] + '''
+ * on host ''' + platform.uname()[1] + ''' by user ''' + getpass.getuser() + ''' at ''' + time.strftime("%Y-%m-%d %I:%M:%S") + ''' */
+
+/* The member copies of the packed structures of UA_TYPES. This file is included
+ * at the end of ua_types_encoding_binary.c. */
+''')
+    printp("static const PackedLayout *const packedLayouts[UA_TYPES_COUNT] = {")
+    packed = [t for t in types.values() if isinstance(t, StructType) and t.packed()]
+    if len(packed) == 0:
+        printp("    NULL")
+    for t in packed:
+        printp(packedLayout(t))
+    printp("};")
+    fp.close()
+
+if args.generate_codec and args.namespace_id == 0:
+    fg = open(args.outfile + "_generated_codec.inc",'w')
+    def printg(string):
+        print(string, end='\n', file=fg)
+    printg('''/* Generated from ''' + inname + ''' with script ''' + sys.argv[0] + '''
+ * on host ''' + platform.uname()[1] + ''' by user ''' + getpass.getuser() + ''' at ''' + time.strftime("%Y-%m-%d %I:%M:%S") + ''' */
+
+/* Specialized binary de- and encoding of selected structures. This file is
+ * included at the end of ua_types_encoding_binary.c and uses its functions for
+ * the builtin types. */
+''')
+    selected = codecTypes(types, args.generate_codec[0].split(","))
+    for t in selected.values():
+        printg(codecFunctions(t))
+    for (table, signature, function) in [("generatedEncodeBinaryJumpTable", "UA_encodeBinarySignature", "encodeBinary"),
+                                         ("generatedDecodeBinaryJumpTable", "UA_decodeBinarySignature", "decodeBinary"),
+                                         ("generatedCalcSizeBinaryJumpTable", "UA_calcSizeBinarySignature", "calcSizeBinary")]:
+        printg("static const %s %s[UA_TYPES_COUNT] = {" % (signature, table))
+        if len(selected) == 0:
+            printg("    NULL")
+        for t in selected.values():
+            printg("    [UA_TYPES_%s] = (%s)%s_%s," % (t.name[3:].upper(), signature, t.name[3:], function))
+        printg("};\n")
+    fg.close()